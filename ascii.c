@@ -0,0 +1,567 @@
+/*  $Id: ascii.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	ascii.c - Line ending conversion used by rtpip
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtpip.h"
+
+/**
+ * @file ascii.c
+ * Line ending conversion used by rtpip.
+ */
+
+/*
+ * Note: Copying an ASCII file in means changing every lone lf into crlf. That
+ * is done in two passes over the buffer the file was read into. The first
+ * pass just counts the lone lf's so the caller can make the buffer big enough.
+ * The second pass works from the end of the buffer back to the front, moving
+ * each run of text between lf's up to its final place with memmove() and
+ * dropping in the cr. Since text only ever moves towards the end of the buffer,
+ * nothing that has yet to be looked at gets overwritten, so no second buffer
+ * is needed.
+ *
+ * Both passes look for lf's 16 (SSE2) or 32 (AVX2) bytes at a time when the
+ * CPU can do it, comparing each block against itself shifted by one byte to
+ * see which lf's already have a cr in front of them. Which kernel is used is
+ * decided the first time one is needed by asking cpuLevel() (see cpu.c).
+ *
+ * Copying an ASCII file out goes the other way. The text ends at the first
+ * null or control Z (found with wide compares) and each cr that is followed by
+ * an lf is dropped. A block with nothing to drop is stored as is. Otherwise
+ * each 8 byte half is squeezed together with a pshufb using a table indexed by
+ * which bytes are being dropped. The text can be handed over in pieces; a cr at
+ * the end of one piece is held until the first byte of the next is known.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !NO_SIMD
+	#define ASCII_X86 (1)
+	#include <immintrin.h>
+#else
+	#define ASCII_X86 (0)
+#endif
+
+#define CTL_Z ('Z' & 63)
+
+typedef size_t (*CountFunc_t)(const char *src, size_t len);
+typedef void (*ExpandFunc_t)(char *buf, size_t len, size_t extra);
+typedef size_t (*TermFunc_t)(const char *src, size_t len);
+typedef size_t (*CompactFunc_t)(const char *src, size_t len, char *dst);
+
+/* Move the text after the lone lf at pos to the end of the output and put crlf in front of it */
+#define EMIT_CRLF(pos) \
+	do { \
+		size_t run_ = end - (pos) - 1; \
+		dst -= run_; \
+		memmove(buf + dst, buf + (pos) + 1, run_); \
+		buf[--dst] = '\n'; \
+		buf[--dst] = '\r'; \
+		end = (pos); \
+	} while ( 0 )
+
+/**
+ * Count lone lf's one byte at a time.
+ * @param src - pointer to text.
+ * @param len - number of bytes in text.
+ * @param prev - the character just before src (0 if none).
+ * @return number of lf's not preceeded by a cr.
+ */
+static size_t countScalarFrom(const char *src, size_t len, int prev)
+{
+	size_t cnt = 0;
+	const char *end = src + len;
+
+	while ( src < end )
+	{
+		if ( *src == '\n' && prev != '\r' )
+			++cnt;
+		prev = *src++;
+	}
+	return cnt;
+}
+
+static size_t countScalar(const char *src, size_t len)
+{
+	return countScalarFrom(src, len, 0);
+}
+
+/**
+ * Insert cr's in front of lone lf's one byte at a time.
+ * @param buf - pointer to text.
+ * @param end - index of end of text not yet moved.
+ * @param dst - index of end of output not yet written.
+ * @return nothing
+ */
+static void expandScalarTo(char *buf, size_t end, size_t dst)
+{
+	size_t ii = end;
+
+	while ( ii > 0 && dst != end )
+	{
+		--ii;
+		if ( buf[ii] == '\n' && (!ii || buf[ii - 1] != '\r') )
+			EMIT_CRLF(ii);
+	}
+}
+
+static void expandScalar(char *buf, size_t len, size_t extra)
+{
+	expandScalarTo(buf, len, len + extra);
+}
+
+/**
+ * Find the end of text one byte at a time.
+ * @param src - pointer to text.
+ * @param len - number of bytes of text.
+ * @return index of first null or control Z, len if none.
+ */
+static size_t termScalar(const char *src, size_t len)
+{
+	size_t ii;
+
+	for ( ii = 0; ii < len; ++ii )
+	{
+		if ( !src[ii] || src[ii] == CTL_Z )
+			break;
+	}
+	return ii;
+}
+
+/**
+ * Drop the cr from crlf pairs one byte at a time.
+ * @param src - pointer to text. src[len] must be readable.
+ * @param len - number of bytes of text to look at.
+ * @param dst - where to put result. Can be the same as src.
+ * @return number of bytes written to dst.
+ */
+static size_t compactScalar(const char *src, size_t len, char *dst)
+{
+	char *out = dst;
+	size_t ii;
+
+	for ( ii = 0; ii < len; ++ii )
+	{
+		if ( src[ii] != '\r' || src[ii + 1] != '\n' )
+			*out++ = src[ii];
+	}
+	return out - dst;
+}
+
+#if ASCII_X86
+__attribute__((target("sse2")))
+static size_t countSSE2(const char *src, size_t len)
+{
+	const __m128i lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+	size_t ii, cnt;
+
+	if ( len < 17 )
+		return countScalar(src, len);
+	cnt = (src[0] == '\n');
+	for ( ii = 1; ii + 16 <= len; ii += 16 )
+	{
+		__m128i cur = _mm_loadu_si128((const __m128i *)(src + ii));
+		__m128i prv = _mm_loadu_si128((const __m128i *)(src + ii - 1));
+		unsigned int msk;
+
+		msk = _mm_movemask_epi8(_mm_cmpeq_epi8(cur, lf)) & ~_mm_movemask_epi8(_mm_cmpeq_epi8(prv, cr));
+		cnt += __builtin_popcount(msk);
+	}
+	return cnt + countScalarFrom(src + ii, len - ii, src[ii - 1]);
+}
+
+__attribute__((target("sse2")))
+static void expandSSE2(char *buf, size_t len, size_t extra)
+{
+	const __m128i lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+	size_t end = len, dst = len + extra, ii = len, base;
+
+	while ( ii >= 17 && dst != end )
+	{
+		__m128i cur, prv;
+		unsigned int msk;
+		int bit;
+
+		base = ii - 16;
+		cur = _mm_loadu_si128((const __m128i *)(buf + base));
+		prv = _mm_loadu_si128((const __m128i *)(buf + base - 1));
+		msk = _mm_movemask_epi8(_mm_cmpeq_epi8(cur, lf)) & ~_mm_movemask_epi8(_mm_cmpeq_epi8(prv, cr));
+		msk &= 0xFFFF;
+		while ( msk )
+		{
+			bit = 31 - __builtin_clz(msk);
+			EMIT_CRLF(base + bit);
+			msk &= ~(1U << bit);
+		}
+		ii = base;
+	}
+	if ( dst != end )
+		expandScalarTo(buf, end, dst);
+}
+
+__attribute__((target("avx2")))
+static size_t countAVX2(const char *src, size_t len)
+{
+	const __m256i lf = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r');
+	size_t ii, cnt;
+
+	if ( len < 33 )
+		return countScalar(src, len);
+	cnt = (src[0] == '\n');
+	for ( ii = 1; ii + 32 <= len; ii += 32 )
+	{
+		__m256i cur = _mm256_loadu_si256((const __m256i *)(src + ii));
+		__m256i prv = _mm256_loadu_si256((const __m256i *)(src + ii - 1));
+		unsigned int msk;
+
+		msk = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(cur, lf))
+			  & ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(prv, cr));
+		cnt += __builtin_popcount(msk);
+	}
+	return cnt + countScalarFrom(src + ii, len - ii, src[ii - 1]);
+}
+
+__attribute__((target("avx2")))
+static void expandAVX2(char *buf, size_t len, size_t extra)
+{
+	const __m256i lf = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r');
+	size_t end = len, dst = len + extra, ii = len, base;
+
+	while ( ii >= 33 && dst != end )
+	{
+		__m256i cur, prv;
+		unsigned int msk;
+		int bit;
+
+		base = ii - 32;
+		cur = _mm256_loadu_si256((const __m256i *)(buf + base));
+		prv = _mm256_loadu_si256((const __m256i *)(buf + base - 1));
+		msk = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(cur, lf))
+			  & ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(prv, cr));
+		while ( msk )
+		{
+			bit = 31 - __builtin_clz(msk);
+			EMIT_CRLF(base + bit);
+			msk &= ~(1U << bit);
+		}
+		ii = base;
+	}
+	if ( dst != end )
+		expandScalarTo(buf, end, dst);
+}
+
+__attribute__((target("sse2")))
+static size_t termSSE2(const char *src, size_t len)
+{
+	const __m128i zero = _mm_setzero_si128(), ctlz = _mm_set1_epi8(CTL_Z);
+	size_t ii;
+
+	for ( ii = 0; ii + 16 <= len; ii += 16 )
+	{
+		__m128i cur = _mm_loadu_si128((const __m128i *)(src + ii));
+		unsigned int msk;
+
+		msk = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(cur, zero), _mm_cmpeq_epi8(cur, ctlz)));
+		if ( msk )
+			return ii + __builtin_ctz(msk);
+	}
+	return ii + termScalar(src + ii, len - ii);
+}
+
+__attribute__((target("avx2")))
+static size_t termAVX2(const char *src, size_t len)
+{
+	const __m256i zero = _mm256_setzero_si256(), ctlz = _mm256_set1_epi8(CTL_Z);
+	size_t ii;
+
+	for ( ii = 0; ii + 32 <= len; ii += 32 )
+	{
+		__m256i cur = _mm256_loadu_si256((const __m256i *)(src + ii));
+		unsigned int msk;
+
+		msk = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(cur, zero),
+																 _mm256_cmpeq_epi8(cur, ctlz)));
+		if ( msk )
+			return ii + __builtin_ctz(msk);
+	}
+	return ii + termScalar(src + ii, len - ii);
+}
+
+/* pshufb control for squeezing out the bytes whose bits are set in the index */
+static U8 CompactTbl[256][8];
+
+static void mkCompactTbl(void)
+{
+	int msk, ii, jj;
+
+	for ( msk = 0; msk < 256; ++msk )
+	{
+		memset(CompactTbl[msk], 0x80, 8);
+		for ( ii = jj = 0; ii < 8; ++ii )
+		{
+			if ( !(msk & (1 << ii)) )
+				CompactTbl[msk][jj++] = ii;
+		}
+	}
+}
+
+/**
+ * Squeeze 16 bytes together dropping those with a bit set in drop.
+ * @param cur - 16 bytes of text.
+ * @param drop - bit mask of bytes to drop.
+ * @param out - where to put result. Up to 16 bytes will be stored.
+ * @return pointer to just past the bytes kept.
+ */
+__attribute__((target("ssse3")))
+static char *squeeze16(__m128i cur, unsigned int drop, char *out)
+{
+	unsigned int lo = drop & 0xFF, hi = drop >> 8;
+
+	_mm_storel_epi64((__m128i *)out,
+					 _mm_shuffle_epi8(cur, _mm_loadl_epi64((const __m128i *)CompactTbl[lo])));
+	out += 8 - __builtin_popcount(lo);
+	_mm_storel_epi64((__m128i *)out,
+					 _mm_shuffle_epi8(_mm_srli_si128(cur, 8), _mm_loadl_epi64((const __m128i *)CompactTbl[hi])));
+	return out + 8 - __builtin_popcount(hi);
+}
+
+/* Same as squeeze16() but VEX encoded. Calling the SSE one from AVX2 code with
+ * the upper halves of the ymm registers dirty stalls on every call. */
+__attribute__((target("avx2")))
+static char *squeeze16AVX2(__m128i cur, unsigned int drop, char *out)
+{
+	unsigned int lo = drop & 0xFF, hi = drop >> 8;
+
+	_mm_storel_epi64((__m128i *)out,
+					 _mm_shuffle_epi8(cur, _mm_loadl_epi64((const __m128i *)CompactTbl[lo])));
+	out += 8 - __builtin_popcount(lo);
+	_mm_storel_epi64((__m128i *)out,
+					 _mm_shuffle_epi8(_mm_srli_si128(cur, 8), _mm_loadl_epi64((const __m128i *)CompactTbl[hi])));
+	return out + 8 - __builtin_popcount(hi);
+}
+
+__attribute__((target("ssse3")))
+static size_t compactSSSE3(const char *src, size_t len, char *dst)
+{
+	const __m128i cr = _mm_set1_epi8('\r'), lf = _mm_set1_epi8('\n');
+	char *out = dst;
+	size_t ii;
+
+	for ( ii = 0; ii + 16 <= len; ii += 16 )
+	{
+		__m128i cur = _mm_loadu_si128((const __m128i *)(src + ii));
+		__m128i nxt = _mm_loadu_si128((const __m128i *)(src + ii + 1));
+		unsigned int drop;
+
+		drop = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(cur, cr), _mm_cmpeq_epi8(nxt, lf)));
+		if ( !drop )
+		{
+			_mm_storeu_si128((__m128i *)out, cur);
+			out += 16;
+		}
+		else
+			out = squeeze16(cur, drop, out);
+	}
+	return (out - dst) + compactScalar(src + ii, len - ii, out);
+}
+
+__attribute__((target("avx2")))
+static size_t compactAVX2(const char *src, size_t len, char *dst)
+{
+	const __m256i cr = _mm256_set1_epi8('\r'), lf = _mm256_set1_epi8('\n');
+	char *out = dst;
+	size_t ii;
+
+	for ( ii = 0; ii + 32 <= len; ii += 32 )
+	{
+		__m256i cur = _mm256_loadu_si256((const __m256i *)(src + ii));
+		__m256i nxt = _mm256_loadu_si256((const __m256i *)(src + ii + 1));
+		unsigned int drop;
+
+		drop = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(cur, cr),
+																   _mm256_cmpeq_epi8(nxt, lf)));
+		if ( !drop )
+		{
+			_mm256_storeu_si256((__m256i *)out, cur);
+			out += 32;
+		}
+		else
+		{
+			out = squeeze16AVX2(_mm256_castsi256_si128(cur), drop & 0xFFFF, out);
+			out = squeeze16AVX2(_mm256_extracti128_si256(cur, 1), drop >> 16, out);
+		}
+	}
+	return (out - dst) + compactScalar(src + ii, len - ii, out);
+}
+#endif	/* ASCII_X86 */
+
+static int kernelsPicked;
+static CountFunc_t countFunc;
+static ExpandFunc_t expandFunc;
+static TermFunc_t termFunc;
+static CompactFunc_t compactFunc;
+
+/**
+ * Pick the fastest kernels this CPU can run. There are no NEON versions of
+ * these yet, so ARM (and anything else that isn't x86) uses the scalar ones.
+ * @return nothing
+ */
+static void pickKernels(void)
+{
+	CountFunc_t cf = countScalar;
+	ExpandFunc_t ef = expandScalar;
+	TermFunc_t tf = termScalar;
+	CompactFunc_t pf = compactScalar;
+
+#if ASCII_X86
+	switch (cpuLevel())
+	{
+	case CPU_AVX512:
+	case CPU_AVX2:
+		cf = countAVX2;
+		ef = expandAVX2;
+		tf = termAVX2;
+		pf = compactAVX2;
+		break;
+	case CPU_SSE42:
+		pf = compactSSSE3;
+		/* Fall through */
+	case CPU_SSE2:
+		cf = countSSE2;
+		ef = expandSSE2;
+		tf = termSSE2;
+		break;
+	default:
+		break;
+	}
+	mkCompactTbl();
+#endif
+	expandFunc = ef;
+	countFunc = cf;
+	termFunc = tf;
+	compactFunc = pf;
+	kernelsPicked = 1;
+}
+
+/**
+ * Pick the kernels now rather than on first use, so threads that convert text
+ * at the same time don't race to do it. Call before starting them.
+ * @return nothing
+ */
+void asciiInit(void)
+{
+	if ( !kernelsPicked )
+		pickKernels();
+}
+
+/**
+ * Count the lf's that are not preceeded by a cr.
+ * @param src - pointer to text.
+ * @param len - number of bytes of text.
+ * @return number of lone lf's.
+ */
+size_t asciiCountLF(const char *src, size_t len)
+{
+	if ( !kernelsPicked )
+		pickKernels();
+	return countFunc(src, len);
+}
+
+/**
+ * Change lone lf's to crlf's in place.
+ * @param buf - pointer to text. Must have room for len+extra bytes.
+ * @param len - number of bytes of text.
+ * @param extra - number of lone lf's in text (as returned by asciiCountLF()).
+ * @return nothing
+ */
+void asciiExpandLF(char *buf, size_t len, size_t extra)
+{
+	if ( !extra )
+		return;
+	if ( !kernelsPicked )
+		pickKernels();
+	expandFunc(buf, len, extra);
+}
+
+/**
+ * Get ready to strip cr's from a file.
+ * @param asp - pointer to state.
+ * @return nothing
+ */
+void asciiStripInit(AsciiStrip_t *asp)
+{
+	asp->pendingCR = 0;
+	asp->done = 0;
+}
+
+/**
+ * Change crlf's to lf's and stop at the first null or control Z.
+ * @param asp - pointer to state (see asciiStripInit()).
+ * @param src - pointer to next piece of text.
+ * @param len - number of bytes in this piece.
+ * @param dst - where to put result. Must have room for len+1 bytes. Can be the
+ * same as src only if this is the first (or only) piece.
+ * @return number of bytes written to dst.
+ */
+size_t asciiStripCR(AsciiStrip_t *asp, const char *src, size_t len, char *dst)
+{
+	size_t term;
+	char *out = dst;
+
+	if ( asp->done || !len )
+		return 0;
+	if ( !kernelsPicked )
+		pickKernels();
+	term = termFunc(src, len);
+	if ( asp->pendingCR )
+	{
+		/* Last piece ended with a cr. Keep it unless this piece starts with an lf */
+		asp->pendingCR = 0;
+		if ( !term || src[0] != '\n' )
+			*out++ = '\r';
+	}
+	if ( term )
+	{
+		/* Every byte but the last has the one after it to look at */
+		out += compactFunc(src, term - 1, out);
+		if ( src[term - 1] != '\r' )
+			*out++ = src[term - 1];
+		else if ( term < len )
+			*out++ = '\r';         /* cr right before a null or control Z stays */
+		else
+			asp->pendingCR = 1;
+	}
+	if ( term < len )
+		asp->done = 1;
+	return out - dst;
+}
+
+/**
+ * Finish stripping cr's from a file.
+ * @param asp - pointer to state.
+ * @param dst - where to put any last byte. Must have room for 1 byte.
+ * @return number of bytes written to dst.
+ */
+size_t asciiStripFinish(AsciiStrip_t *asp, char *dst)
+{
+	if ( asp->pendingCR )
+	{
+		asp->pendingCR = 0;
+		*dst = '\r';
+		return 1;
+	}
+	return 0;
+}
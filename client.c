@@ -0,0 +1,675 @@
+/*  $Id: client.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	client.c - Send commands to rtpipd instead of doing them here.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MINGW
+	#define _XOPEN_SOURCE 700
+#endif
+#include "rtpip.h"
+#include "librtpip.h"
+#ifndef MINGW
+	#include <sys/socket.h>
+	#include <sys/un.h>
+#endif
+
+/**
+ * @file client.c
+ * Talk to rtpipd (rtpip --server). rtpipd keeps containers open with their
+ * directories parsed, so a command sent to it doesn't have to read them again.
+ *
+ * Everything goes over a Unix domain socket as frames: a 4 byte big endian length
+ * followed by that many bytes. A request is a header frame holding these strings,
+ * each followed by a null:
+ *  - op: "ls", "read", "write", "del" or "sqz"
+ *  - container: absolute path to the container
+ *  - flags: RT_OPEN_RX01 or RT_OPEN_RX02 (see librtpip.h) as a decimal number
+ *  - name: RT11 filename (read, write and del, otherwise empty)
+ *  - date: RT11 date word as a decimal number (write, 0 for 1-Jan-72)
+ *
+ * A write is followed by the file's contents in any number of frames and then an
+ * empty frame. The reply is any number of data frames, an empty frame and then a
+ * status frame of '0' (worked) or '1' (didn't) followed by the messages, if any.
+ * The data frames of ls hold RTPIPD_ENTSIZ bytes per directory entry: the name
+ * (12 bytes, null padded), control, date (2 bytes each), blocks, LBA (4 bytes
+ * each), segment, index in segment, channel and process id (1 byte each). Those of
+ * read hold the file. Any number of requests can be sent on one connection.
+ *
+ * ls, out and del get the directory from rtpipd and then do all their selecting,
+ * sorting and showing here, so they take the same options as always.
+ */
+
+/**
+ * Get the path of rtpipd's socket.
+ * @param name - path given with --server or -s (NULL or empty for the default).
+ * @param buf - place to build the default.
+ * @param bufSize - size of buf.
+ * @return pointer to path.
+ */
+const char *clientSocket(const char *name, char *buf, int bufSize)
+{
+	if ( name && *name )
+		return name;
+	name = getenv("RTPIPD_SOCKET");
+	if ( name && *name )
+		return name;
+#ifndef MINGW
+	snprintf(buf, bufSize, "/tmp/rtpipd-%d.sock", (int)getuid());
+#else
+	snprintf(buf, bufSize, "rtpipd.sock");
+#endif
+	return buf;
+}
+
+#ifndef MINGW
+/**
+ * Send one frame (4 byte big endian length followed by the bytes).
+ * @param fd - socket.
+ * @param buf - pointer to bytes.
+ * @param len - number of bytes (0 is an end marker).
+ * @return 0 if success; 1 if failure.
+ */
+int frameSend(int fd, const void *buf, long len)
+{
+	unsigned char lenBuf[4];
+	const char *src;
+	long left, sts;
+	int part;
+
+	lenBuf[0] = (len >> 24) & 0xFF;
+	lenBuf[1] = (len >> 16) & 0xFF;
+	lenBuf[2] = (len >> 8) & 0xFF;
+	lenBuf[3] = len & 0xFF;
+	for ( part = 0; part < 2; ++part )
+	{
+		src = part ? (const char *)buf : (const char *)lenBuf;
+		left = part ? len : 4;
+		while ( left > 0 )
+		{
+			/* MSG_NOSIGNAL so a peer that went away is an error, not a SIGPIPE */
+			sts = send(fd, src, left, MSG_NOSIGNAL);
+			if ( sts < 0 && errno == EINTR )
+				continue;
+			if ( sts <= 0 )
+				return 1;
+			src += sts;
+			left -= sts;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Read exactly len bytes.
+ * @param fd - socket.
+ * @param buf - where to put them.
+ * @param len - number of bytes.
+ * @return 0 if success; 1 if error or end of file.
+ */
+static int recvAll(int fd, char *buf, long len)
+{
+	long sts;
+
+	while ( len > 0 )
+	{
+		sts = recv(fd, buf, len, 0);
+		if ( sts < 0 && errno == EINTR )
+			continue;
+		if ( sts <= 0 )
+			return 1;
+		buf += sts;
+		len -= sts;
+	}
+	return 0;
+}
+
+/**
+ * Receive one frame.
+ * @param fd - socket.
+ * @param bufp - pointer to malloc'd buffer (grown as needed, can point to NULL).
+ * @param sizep - pointer to size of *bufp.
+ * @param maxLen - longest frame allowed.
+ * @return length of frame or -1 on error or end of file.
+ */
+long frameRecv(int fd, char **bufp, long *sizep, long maxLen)
+{
+	unsigned char lenBuf[4];
+	long len;
+	char *nBuf;
+
+	if ( recvAll(fd, (char *)lenBuf, 4) )
+		return -1;
+	len = ((long)lenBuf[0] << 24) | ((long)lenBuf[1] << 16) | (lenBuf[2] << 8) | lenBuf[3];
+	if ( len > maxLen )
+		return -1;
+	/* Always room for a null at the end */
+	if ( len + 1 > *sizep )
+	{
+		nBuf = (char *)realloc(*bufp, len + 1);
+		if ( !nBuf )
+			return -1;
+		*bufp = nBuf;
+		*sizep = len + 1;
+	}
+	if ( recvAll(fd, *bufp, len) )
+		return -1;
+	(*bufp)[len] = 0;
+	return len;
+}
+
+/**
+ * Send a request header.
+ * @param options - pointer to options.
+ * @param op - request.
+ * @param name - RT11 filename (NULL if none).
+ * @param date - RT11 date.
+ * @return 0 if success; 1 if failure.
+ */
+static int request(Options_t *options, const char *op, const char *name, unsigned short date)
+{
+	char hdr[RTPIPD_MAXHDR];
+	int len, flags = 0;
+
+	if ( (options->cmdOpts & CMDOPT_SINGLE_FLPY) )
+		flags = RT_OPEN_RX01;
+	else if ( (options->cmdOpts & CMDOPT_DOUBLE_FLPY) )
+		flags = RT_OPEN_RX02;
+	len = snprintf(hdr, sizeof(hdr), "%s%c%s%c%d%c%s%c%u", op, 0, options->serverPath, 0,
+				   flags, 0, name ? name : "", 0, date);
+	if ( len < 0 || len >= (int)sizeof(hdr) )
+	{
+		msgErr(options, "Path to container '%s' is too long for rtpipd\n", options->serverPath);
+		return 1;
+	}
+	if ( frameSend(options->serverFd, hdr, len + 1) )
+	{
+		msgErr(options, "Error sending to rtpipd: %s\n", strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Get the status frame that ends a reply and show any messages in it.
+ * @param options - pointer to options.
+ * @return 0 if the request worked, 1 if it didn't and 2 if the connection is gone.
+ */
+static int replyStatus(Options_t *options)
+{
+	char *buf = NULL;
+	long size = 0, len;
+	int sts = 2;
+
+	len = frameRecv(options->serverFd, &buf, &size, RTPIPD_CHUNK);
+	if ( len < 1 )
+		msgErr(options, "Lost connection to rtpipd\n");
+	else
+	{
+		sts = buf[0] == '0' ? 0 : 1;
+		if ( len > 1 )
+		{
+			if ( sts )
+				msgErr(options, "%s", buf + 1);
+			else
+				msgOut(options, "%s", buf + 1);
+		}
+	}
+	free(buf);
+	return sts;
+}
+
+/**
+ * Throw away data frames up to the empty one.
+ * @param options - pointer to options.
+ * @return 0 if success, 2 if the connection is gone.
+ */
+static int skipData(Options_t *options)
+{
+	char *buf = NULL;
+	long size = 0, len;
+
+	while ( (len = frameRecv(options->serverFd, &buf, &size, RTPIPD_CHUNK)) > 0 )
+		;
+	free(buf);
+	if ( len < 0 )
+	{
+		msgErr(options, "Lost connection to rtpipd\n");
+		return 2;
+	}
+	return 0;
+}
+
+/**
+ * Get the directory from rtpipd and make the working directory out of it just like
+ * parse_directory() would have.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure.
+ */
+static int clientLoad(Options_t *options)
+{
+	char *buf = NULL;
+	const unsigned char *ep;
+	long size = 0, len, ii;
+	int maxWdirs = 0, sts;
+	InWorkingDir_t *wdp;
+	void *nArr;
+
+	if ( request(options, "ls", NULL, 0) )
+		return 1;
+	while ( (len = frameRecv(options->serverFd, &buf, &size, RTPIPD_CHUNK)) > 0 )
+	{
+		if ( options->numWdirs + len / RTPIPD_ENTSIZ > maxWdirs )
+		{
+			maxWdirs = options->numWdirs + len / RTPIPD_ENTSIZ;
+			nArr = realloc(options->wDirArray, maxWdirs * sizeof(InWorkingDir_t));
+			if ( nArr )
+				options->wDirArray = (InWorkingDir_t *)nArr;
+			nArr = nArr ? realloc(options->linArray, maxWdirs * sizeof(InWorkingDir_t *)) : NULL;
+			if ( !nArr )
+			{
+				msgErr(options, "Ran out of memory for %d directory entries\n", maxWdirs);
+				free(buf);
+				return 1;
+			}
+			options->linArray = (InWorkingDir_t **)nArr;
+		}
+		for ( ii = 0; ii + RTPIPD_ENTSIZ <= len; ii += RTPIPD_ENTSIZ )
+		{
+			ep = (const unsigned char *)buf + ii;
+			wdp = options->wDirArray + options->numWdirs++;
+			memset(wdp, 0, sizeof(InWorkingDir_t));
+			strncpy(wdp->ffull, (const char *)ep, sizeof(wdp->ffull) - 1);
+			wdp->rt11.control = (ep[12] << 8) | ep[13];
+			wdp->rt11.date = (ep[14] << 8) | ep[15];
+			wdp->rt11.blocks = ((long)ep[16] << 24) | ((long)ep[17] << 16) | (ep[18] << 8) | ep[19];
+			wdp->lba = ((long)ep[20] << 24) | ((long)ep[21] << 16) | (ep[22] << 8) | ep[23];
+			wdp->segNo = ep[24];
+			wdp->segIdx = ep[25];
+			wdp->rt11.channel = ep[26];
+			wdp->rt11.procid = ep[27];
+			if ( (wdp->rt11.control & PERM) )
+				r50EncodeName(wdp->rt11.name, wdp->ffull);
+		}
+	}
+	free(buf);
+	if ( len < 0 )
+	{
+		msgErr(options, "Lost connection to rtpipd\n");
+		return 1;
+	}
+	sts = replyStatus(options);
+	if ( !sts )
+		relinkDirectory(options);
+	return sts ? 1 : 0;
+}
+
+/**
+ * Copy a file out of the container through rtpipd. Used by do_out().
+ * @param options - pointer to options.
+ * @param wdp - pointer to directory entry of file.
+ * @return number of bytes written (or would have been), -1 on error or -2 if the
+ * connection to rtpipd is gone.
+ */
+int clientFileOut(Options_t *options, InWorkingDir_t *wdp)
+{
+	char *buf = NULL, *oBuf = NULL;
+	FILE *oFile = NULL;
+	AsciiStrip_t as;
+	long size = 0, len = 0, outLen, retv;
+	int total = 0, sts;
+
+	if ( !(options->cmdOpts & CMDOPT_NOWRITE) )
+	{
+		oFile = statFopen(options, STAT_IO_HOST, wdp->ffull, "wb");
+		if ( !oFile )
+		{
+			msgErr(options, "Unable to open '%s' for output: %s\n",
+					wdp->ffull, strerror(errno));
+			return -1;
+		}
+	}
+	if ( (options->outOpts & OUTOPTS_ASC) )
+	{
+		oBuf = (char *)malloc(RTPIPD_CHUNK + 1);
+		if ( !oBuf )
+		{
+			msgErr(options, "Ran out of memory allocating %d bytes to read '%s'\n",
+					RTPIPD_CHUNK + 1, wdp->ffull);
+			if ( oFile )
+				fclose(oFile);
+			return -1;
+		}
+	}
+	if ( request(options, "read", wdp->ffull, 0) )
+		total = -2;
+	asciiStripInit(&as);
+	while ( total != -2 && (len = frameRecv(options->serverFd, &buf, &size, RTPIPD_CHUNK)) > 0 )
+	{
+		if ( total < 0 )
+			continue;
+		outLen = len;
+		if ( oBuf )
+		{
+			outLen = as.done ? 0 : asciiStripCR(&as, buf, len, oBuf);
+		}
+		if ( oFile && outLen && (retv = statFwrite(options, STAT_IO_HOST, oBuf ? oBuf : buf, 1, outLen, oFile)) != outLen )
+		{
+			msgErr(options, "Error writing %ld bytes to '%s'. Wrote %ld. '%s'\n",
+					outLen, wdp->ffull, retv, strerror(errno));
+			total = -1;
+			continue;
+		}
+		total += outLen;
+	}
+	if ( total != -2 && len < 0 )
+	{
+		msgErr(options, "Lost connection to rtpipd\n");
+		total = -2;
+	}
+	if ( total >= 0 && oBuf )
+	{
+		outLen = asciiStripFinish(&as, oBuf);
+		if ( oFile && outLen )
+			statFwrite(options, STAT_IO_HOST, oBuf, 1, outLen, oFile);
+		total += outLen;
+	}
+	if ( total != -2 && (sts = replyStatus(options)) )
+		total = sts == 2 ? -2 : -1;
+	if ( oFile && fclose(oFile) && total >= 0 )
+	{
+		msgErr(options, "Error closing '%s': %s\n", wdp->ffull, strerror(errno));
+		total = -1;
+	}
+	free(buf);
+	free(oBuf);
+	return total;
+}
+
+/**
+ * Send the contents of a file to rtpipd as data frames.
+ * @param options - pointer to options.
+ * @param inp - file to send.
+ * @param fileName - name of file for messages.
+ * @return 0 if success; 2 if the connection had to be dropped.
+ */
+static int sendFile(Options_t *options, FILE *inp, const char *fileName)
+{
+	char *buf;
+	size_t got;
+
+	buf = (char *)malloc(RTPIPD_CHUNK);
+	if ( !buf )
+	{
+		msgErr(options, "Ran out of memory allocating %d bytes to send '%s'\n",
+				RTPIPD_CHUNK, fileName);
+		return 2;
+	}
+	while ( (got = statFread(options, STAT_IO_HOST, buf, 1, RTPIPD_CHUNK, inp)) > 0 )
+	{
+		if ( frameSend(options->serverFd, buf, got) )
+		{
+			msgErr(options, "Error sending to rtpipd: %s\n", strerror(errno));
+			free(buf);
+			return 2;
+		}
+	}
+	free(buf);
+	if ( ferror(inp) )
+	{
+		/* rtpipd only writes the file after the empty frame, so hanging up here leaves it alone */
+		msgErr(options, "Error reading '%s': %s\n", fileName, strerror(errno));
+		return 2;
+	}
+	return 0;
+}
+
+/**
+ * Copy files into the container through rtpipd.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure.
+ */
+static int clientIn(Options_t *options)
+{
+	InHandle_t *ihp = &options->iHandle;
+	unsigned short date;
+	long len, sent;
+	FILE *inp;
+	int ii, sts = 0;
+
+	for ( ii = 0; ii < options->numArgFiles && sts != 2; ++ii )
+	{
+		if ( cvtName(options, options->argFiles[ii]) )
+			continue;
+		if ( !(options->inOpts & INOPTS_NOASK) )
+		{
+			char prompt[128];
+			int yn;
+
+			snprintf(prompt, sizeof(prompt) - 1, "Copy in '%s'?", ihp->argFN);
+			yn = getYN(prompt, YN_YES);
+			if ( yn == YN_QUIT )
+				break;
+			if ( yn != YN_YES )
+				continue;
+		}
+		statBegin(options, STAT_PH_HOSTIN);
+		sts = readInpFile(options, options->argFiles[ii]);
+		statEnd(options, STAT_PH_HOSTIN);
+		if ( sts )
+			continue;
+		if ( (options->cmdOpts & CMDOPT_NOWRITE) )
+		{
+			printf("Would have copied '%s' to '%s', %d blocks\n",
+				   options->argFiles[ii], ihp->argFN, ihp->fileBlks);
+			continue;
+		}
+		date = options->inDate;
+		if ( !date && (options->fileOpts & FILEOPTS_TIMESTAMP) )
+			date = timeToDate(ihp->fileTimeStamp);
+		inp = NULL;
+		if ( ihp->directName )
+		{
+			/* Binary files aren't read in by readInpFile(), so send them a piece at a time */
+			inp = statFopen(options, STAT_IO_HOST, ihp->directName, "rb");
+			if ( !inp )
+			{
+				msgErr(options, "Error opening '%s' for input: %s\n",
+						ihp->directName, strerror(errno));
+				continue;
+			}
+		}
+		if ( request(options, "write", ihp->argFN, date) )
+			sts = 2;
+		else if ( inp )
+			sts = sendFile(options, inp, ihp->directName);
+		else
+		{
+			for ( sent = 0; sent < ihp->fileBlks * BLKSIZ && !sts; sent += len )
+			{
+				len = ihp->fileBlks * BLKSIZ - sent;
+				if ( len > RTPIPD_CHUNK )
+					len = RTPIPD_CHUNK;
+				if ( frameSend(options->serverFd, ihp->inFileBuf + sent, len) )
+				{
+					msgErr(options, "Error sending to rtpipd: %s\n", strerror(errno));
+					sts = 2;
+				}
+			}
+		}
+		if ( inp )
+			fclose(inp);
+		if ( !sts && frameSend(options->serverFd, NULL, 0) )
+		{
+			msgErr(options, "Error sending to rtpipd: %s\n", strerror(errno));
+			sts = 2;
+		}
+		if ( !sts )
+			sts = skipData(options);
+		if ( !sts )
+			sts = replyStatus(options);
+		if ( !sts )
+		{
+			if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) || options->verbose || (options->inOpts & INOPTS_VERB) )
+			{
+				printf("Copied '%s' to '%s', %d blocks\n",
+					   options->argFiles[ii], ihp->argFN, ihp->fileBlks);
+			}
+			ihp->totUsed += ihp->fileBlks;
+			++ihp->totIns;
+		}
+	}
+	if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) || options->verbose || (options->inOpts & INOPTS_VERB) )
+	{
+		printf("Added a total of %d file%s, %d blocks.\n",
+			   ihp->totIns, ihp->totIns == 1 ? "" : "s", ihp->totUsed);
+	}
+	return sts ? 1 : 0;
+}
+
+/**
+ * Send one request that has no data either way.
+ * @param options - pointer to options.
+ * @param op - request.
+ * @param name - RT11 filename (NULL if none).
+ * @return 0 if it worked, 1 if it didn't and 2 if the connection is gone.
+ */
+static int simpleRequest(Options_t *options, const char *op, const char *name)
+{
+	int sts;
+
+	if ( request(options, op, name, 0) )
+		return 2;
+	sts = skipData(options);
+	if ( !sts )
+		sts = replyStatus(options);
+	return sts;
+}
+
+/**
+ * Connect to rtpipd.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure.
+ */
+static int clientConnect(Options_t *options)
+{
+	struct sockaddr_un addr;
+	const char *path;
+	char buf[64];
+
+	path = clientSocket(options->server, buf, sizeof(buf));
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if ( strlen(path) >= sizeof(addr.sun_path) )
+	{
+		msgErr(options, "Socket path '%s' is too long\n", path);
+		return 1;
+	}
+	strcpy(addr.sun_path, path);
+	options->serverFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( options->serverFd < 0 )
+	{
+		msgErr(options, "Unable to make a socket: %s\n", strerror(errno));
+		return 1;
+	}
+	if ( connect(options->serverFd, (struct sockaddr *)&addr, sizeof(addr)) )
+	{
+		msgErr(options, "Unable to connect to rtpipd at '%s': %s\n", path, strerror(errno));
+		close(options->serverFd);
+		options->serverFd = -1;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Do the command by sending it to rtpipd (--server).
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure.
+ */
+int clientRun(Options_t *options)
+{
+	InWorkingDir_t *wdp;
+	int ii, sts = 1;
+
+	if ( (options->todo & (TODO_NEW | TODO_SCRIPT | TODO_MKFS | TODO_SYNC | TODO_DIFF | TODO_MANIFEST)) )
+	{
+		msgErr(options, "The '%s' command can't be used with --server\n", options->cmd);
+		return 1;
+	}
+	if ( options->seg1LBA != DIRBLK || options->newMaxSeg || options->tarFile )
+	{
+		msgErr(options, "--lba, sqz --segments and --tar can't be used with --server\n");
+		return 1;
+	}
+	/* rtpipd has its own current directory */
+	options->serverPath = realpath(options->container, NULL);
+	if ( !options->serverPath )
+	{
+		msgErr(options, "Unable to open input file '%s': %s\n", options->container, strerror(errno));
+		return 1;
+	}
+	if ( clientConnect(options) )
+	{
+		free(options->serverPath);
+		options->serverPath = NULL;
+		return 1;
+	}
+	if ( (options->todo & TODO_INP) )
+		sts = clientIn(options);
+	else if ( (options->todo & TODO_SQZ) )
+	{
+		if ( (options->cmdOpts & CMDOPT_NOWRITE) )
+		{
+			printf("Would have squeezed '%s'\n", options->container);
+			sts = 0;
+		}
+		else if ( !(sts = simpleRequest(options, "sqz", NULL)) && (options->verbose || (options->sqzOpts & SQZOPTS_VERB)) )
+			printf("Squeezed '%s'\n", options->container);
+	}
+	else if ( !clientLoad(options) )
+	{
+		if ( (options->todo & TODO_LIST) )
+			sts = do_directory(options);
+		else if ( (options->todo & TODO_OUT) )
+			sts = do_out(options);
+		else if ( (options->todo & TODO_DEL) )
+		{
+			sts = do_del(options);
+			/* do_del() only marked them in the directory here */
+			wdp = options->wDirArray;
+			for ( ii = 0; !sts && options->dirDirty && ii < options->numWdirs; ++ii, ++wdp )
+			{
+				if ( wdp->freed && !(options->cmdOpts & CMDOPT_NOWRITE) )
+					sts = simpleRequest(options, "del", wdp->ffull) == 2;
+			}
+			options->dirDirty = 0;
+		}
+	}
+	close(options->serverFd);
+	options->serverFd = -1;
+	free(options->serverPath);
+	options->serverPath = NULL;
+	return sts || options->numErrors ? 1 : 0;
+}
+#else
+int clientRun(Options_t *options)
+{
+	msgErr(options, "--server is not available on this system\n");
+	return 1;
+}
+#endif	/* MINGW */
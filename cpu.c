@@ -0,0 +1,618 @@
+/*  $Id: cpu.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	cpu.c - Pick the fastest kernels the CPU can run.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtpip.h"
+
+/**
+ * @file cpu.c
+ * Pick the fastest kernels the CPU can run.
+ */
+
+/*
+ * Note: The first time anything asks, the CPU is checked for what it can do
+ * and the best level is picked. That can be lowered (but never raised) with
+ * --cpu=level on the command line or RTPIP_CPU=level in the environment, so
+ * the plain C versions can be tested on any machine. The block kernels below
+ * are bound to function pointers at that point. ascii.c has its own kernels
+ * but asks cpuLevel() which ones to use.
+ *
+ * Every x86 level is compiled in using function target attributes so the
+ * regular build doesn't need any -m options. On ARM only NEON is supported
+ * and only if the compiler was told it can use it (HOST_CPU = -mfpu=neon on
+ * a 32 bit Pi, always on 64 bit ARM). AVX2 and AVX-512 are never used on
+ * Windows because gcc can't be trusted to keep the stack 32 byte aligned
+ * there.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !NO_SIMD
+	#define CPU_X86 (1)
+	#include <immintrin.h>
+#else
+	#define CPU_X86 (0)
+#endif
+
+#if defined(__GNUC__) && (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !NO_SIMD
+	#define CPU_ARM_NEON (1)
+	#include <arm_neon.h>
+#else
+	#define CPU_ARM_NEON (0)
+#endif
+
+typedef int (*IsZeroFunc_t)(const U8 *buf, size_t len);
+typedef size_t (*DiffFunc_t)(const U8 *aa, const U8 *bb, size_t len);
+typedef U16 (*Sum16Func_t)(const U16 *buf, size_t numWords);
+typedef U32 (*Crc32cFunc_t)(U32 crc, const U8 *buf, size_t len);
+
+static const char *const LevelNames[CPU_MAX] =
+{
+	"c", "sse2", "sse4.2", "avx2", "avx512", "neon"
+};
+
+static int levelUsed = -1;              /* Level in use (-1 until picked) */
+static unsigned int levelsHave;         /* Bit for each level this CPU can do */
+static IsZeroFunc_t isZeroFunc;
+static DiffFunc_t diffFunc;
+static Sum16Func_t sum16Func;
+static Crc32cFunc_t crc32cFunc;
+static U32 crcTable[256];               /* CRC32C (Castagnoli) one byte at a time */
+
+/*
+ * Plain C versions.
+ */
+
+static int isZeroScalar(const U8 *buf, size_t len)
+{
+	size_t ii;
+
+	for ( ii = 0; ii < len; ++ii )
+	{
+		if ( buf[ii] )
+			return 0;
+	}
+	return 1;
+}
+
+static size_t diffScalar(const U8 *aa, const U8 *bb, size_t len)
+{
+	size_t ii;
+
+	for ( ii = 0; ii < len && aa[ii] == bb[ii]; ++ii )
+		;
+	return ii;
+}
+
+static U16 sum16Scalar(const U16 *buf, size_t numWords)
+{
+	U16 sum = 0;
+	size_t ii;
+
+	for ( ii = 0; ii < numWords; ++ii )
+		sum += buf[ii];
+	return sum;
+}
+
+static U32 crc32cScalar(U32 crc, const U8 *buf, size_t len)
+{
+	size_t ii;
+
+	for ( ii = 0; ii < len; ++ii )
+		crc = crcTable[(crc ^ buf[ii]) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+#if CPU_X86
+/*
+ * SSE2 and SSE4.2 versions. SSE4.2 gets ptest for the zero check and the crc32 instruction.
+ */
+
+__attribute__((target("sse2")))
+static int isZeroSSE2(const U8 *buf, size_t len)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t ii;
+
+	for ( ii = 0; ii + 64 <= len; ii += 64 )
+	{
+		__m128i acc;
+
+		acc = _mm_or_si128(_mm_or_si128(_mm_loadu_si128((const __m128i *)(buf + ii)),
+										_mm_loadu_si128((const __m128i *)(buf + ii + 16))),
+						   _mm_or_si128(_mm_loadu_si128((const __m128i *)(buf + ii + 32)),
+										_mm_loadu_si128((const __m128i *)(buf + ii + 48))));
+		if ( _mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xFFFF )
+			return 0;
+	}
+	return isZeroScalar(buf + ii, len - ii);
+}
+
+__attribute__((target("sse4.2")))
+static int isZeroSSE42(const U8 *buf, size_t len)
+{
+	size_t ii;
+
+	for ( ii = 0; ii + 64 <= len; ii += 64 )
+	{
+		__m128i acc;
+
+		acc = _mm_or_si128(_mm_or_si128(_mm_loadu_si128((const __m128i *)(buf + ii)),
+										_mm_loadu_si128((const __m128i *)(buf + ii + 16))),
+						   _mm_or_si128(_mm_loadu_si128((const __m128i *)(buf + ii + 32)),
+										_mm_loadu_si128((const __m128i *)(buf + ii + 48))));
+		if ( !_mm_testz_si128(acc, acc) )
+			return 0;
+	}
+	return isZeroScalar(buf + ii, len - ii);
+}
+
+__attribute__((target("sse2")))
+static size_t diffSSE2(const U8 *aa, const U8 *bb, size_t len)
+{
+	size_t ii;
+	unsigned int msk;
+
+	for ( ii = 0; ii + 16 <= len; ii += 16 )
+	{
+		msk = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(aa + ii)),
+											   _mm_loadu_si128((const __m128i *)(bb + ii))));
+		if ( msk != 0xFFFF )
+			return ii + __builtin_ctz(~msk);
+	}
+	return ii + diffScalar(aa + ii, bb + ii, len - ii);
+}
+
+__attribute__((target("sse2")))
+static U16 sum16SSE2(const U16 *buf, size_t numWords)
+{
+	__m128i acc = _mm_setzero_si128();
+	size_t ii;
+
+	for ( ii = 0; ii + 8 <= numWords; ii += 8 )
+		acc = _mm_add_epi16(acc, _mm_loadu_si128((const __m128i *)(buf + ii)));
+	acc = _mm_add_epi16(acc, _mm_srli_si128(acc, 8));
+	acc = _mm_add_epi16(acc, _mm_srli_si128(acc, 4));
+	acc = _mm_add_epi16(acc, _mm_srli_si128(acc, 2));
+	return (U16)_mm_cvtsi128_si32(acc) + sum16Scalar(buf + ii, numWords - ii);
+}
+
+__attribute__((target("sse4.2")))
+static U32 crc32cSSE42(U32 crc, const U8 *buf, size_t len)
+{
+	size_t ii = 0;
+	#if defined(__x86_64__)
+	U64 crc64 = crc;
+
+	for ( ; ii + 8 <= len; ii += 8 )
+	{
+		U64 word;
+
+		memcpy(&word, buf + ii, 8);
+		crc64 = _mm_crc32_u64(crc64, word);
+	}
+	crc = (U32)crc64;
+	#endif
+	for ( ; ii + 4 <= len; ii += 4 )
+	{
+		U32 word;
+
+		memcpy(&word, buf + ii, 4);
+		crc = _mm_crc32_u32(crc, word);
+	}
+	for ( ; ii < len; ++ii )
+		crc = _mm_crc32_u8(crc, buf[ii]);
+	return crc;
+}
+
+/*
+ * AVX2 versions.
+ */
+
+__attribute__((target("avx2")))
+static int isZeroAVX2(const U8 *buf, size_t len)
+{
+	size_t ii;
+
+	for ( ii = 0; ii + 128 <= len; ii += 128 )
+	{
+		__m256i acc;
+
+		acc = _mm256_or_si256(_mm256_or_si256(_mm256_loadu_si256((const __m256i *)(buf + ii)),
+											  _mm256_loadu_si256((const __m256i *)(buf + ii + 32))),
+							  _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(buf + ii + 64)),
+											  _mm256_loadu_si256((const __m256i *)(buf + ii + 96))));
+		if ( !_mm256_testz_si256(acc, acc) )
+			return 0;
+	}
+	return isZeroScalar(buf + ii, len - ii);
+}
+
+__attribute__((target("avx2")))
+static size_t diffAVX2(const U8 *aa, const U8 *bb, size_t len)
+{
+	size_t ii;
+	unsigned int msk;
+
+	for ( ii = 0; ii + 32 <= len; ii += 32 )
+	{
+		msk = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(aa + ii)),
+																   _mm256_loadu_si256((const __m256i *)(bb + ii))));
+		if ( msk != 0xFFFFFFFF )
+			return ii + __builtin_ctz(~msk);
+	}
+	return ii + diffScalar(aa + ii, bb + ii, len - ii);
+}
+
+__attribute__((target("avx2")))
+static U16 sum16AVX2(const U16 *buf, size_t numWords)
+{
+	__m256i acc = _mm256_setzero_si256();
+	__m128i half;
+	size_t ii;
+
+	for ( ii = 0; ii + 16 <= numWords; ii += 16 )
+		acc = _mm256_add_epi16(acc, _mm256_loadu_si256((const __m256i *)(buf + ii)));
+	half = _mm_add_epi16(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+	half = _mm_add_epi16(half, _mm_srli_si128(half, 8));
+	half = _mm_add_epi16(half, _mm_srli_si128(half, 4));
+	half = _mm_add_epi16(half, _mm_srli_si128(half, 2));
+	return (U16)_mm_cvtsi128_si32(half) + sum16Scalar(buf + ii, numWords - ii);
+}
+
+/*
+ * AVX-512 versions (needs BW for the byte and word compares and adds).
+ */
+
+__attribute__((target("avx512f,avx512bw")))
+static int isZeroAVX512(const U8 *buf, size_t len)
+{
+	size_t ii;
+
+	for ( ii = 0; ii + 256 <= len; ii += 256 )
+	{
+		__m512i acc;
+
+		acc = _mm512_or_si512(_mm512_or_si512(_mm512_loadu_si512((const void *)(buf + ii)),
+											  _mm512_loadu_si512((const void *)(buf + ii + 64))),
+							  _mm512_or_si512(_mm512_loadu_si512((const void *)(buf + ii + 128)),
+											  _mm512_loadu_si512((const void *)(buf + ii + 192))));
+		if ( _mm512_test_epi64_mask(acc, acc) )
+			return 0;
+	}
+	return isZeroScalar(buf + ii, len - ii);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t diffAVX512(const U8 *aa, const U8 *bb, size_t len)
+{
+	size_t ii;
+	__mmask64 msk;
+
+	for ( ii = 0; ii + 64 <= len; ii += 64 )
+	{
+		msk = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512((const void *)(aa + ii)),
+									  _mm512_loadu_si512((const void *)(bb + ii)));
+		if ( msk )
+			return ii + __builtin_ctzll(msk);
+	}
+	return ii + diffScalar(aa + ii, bb + ii, len - ii);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static U16 sum16AVX512(const U16 *buf, size_t numWords)
+{
+	__m512i acc = _mm512_setzero_si512();
+	__m256i quad;
+	__m128i half;
+	size_t ii;
+
+	for ( ii = 0; ii + 32 <= numWords; ii += 32 )
+		acc = _mm512_add_epi16(acc, _mm512_loadu_si512((const void *)(buf + ii)));
+	quad = _mm256_add_epi16(_mm512_castsi512_si256(acc), _mm512_extracti64x4_epi64(acc, 1));
+	half = _mm_add_epi16(_mm256_castsi256_si128(quad), _mm256_extracti128_si256(quad, 1));
+	half = _mm_add_epi16(half, _mm_srli_si128(half, 8));
+	half = _mm_add_epi16(half, _mm_srli_si128(half, 4));
+	half = _mm_add_epi16(half, _mm_srli_si128(half, 2));
+	return (U16)_mm_cvtsi128_si32(half) + sum16Scalar(buf + ii, numWords - ii);
+}
+#endif	/* CPU_X86 */
+
+#if CPU_ARM_NEON
+/*
+ * NEON versions.
+ */
+
+static int isZeroNEON(const U8 *buf, size_t len)
+{
+	uint64x2_t acc;
+	size_t ii;
+
+	for ( ii = 0; ii + 64 <= len; ii += 64 )
+	{
+		acc = vreinterpretq_u64_u8(vorrq_u8(vorrq_u8(vld1q_u8(buf + ii), vld1q_u8(buf + ii + 16)),
+											vorrq_u8(vld1q_u8(buf + ii + 32), vld1q_u8(buf + ii + 48))));
+		if ( vgetq_lane_u64(acc, 0) | vgetq_lane_u64(acc, 1) )
+			return 0;
+	}
+	return isZeroScalar(buf + ii, len - ii);
+}
+
+static size_t diffNEON(const U8 *aa, const U8 *bb, size_t len)
+{
+	uint64x2_t xx;
+	size_t ii;
+
+	for ( ii = 0; ii + 16 <= len; ii += 16 )
+	{
+		xx = vreinterpretq_u64_u8(veorq_u8(vld1q_u8(aa + ii), vld1q_u8(bb + ii)));
+		if ( vgetq_lane_u64(xx, 0) | vgetq_lane_u64(xx, 1) )
+			return ii + diffScalar(aa + ii, bb + ii, 16);
+	}
+	return ii + diffScalar(aa + ii, bb + ii, len - ii);
+}
+
+static U16 sum16NEON(const U16 *buf, size_t numWords)
+{
+	uint16x8_t acc = vdupq_n_u16(0);
+	U16 lanes[8];
+	size_t ii;
+
+	for ( ii = 0; ii + 8 <= numWords; ii += 8 )
+		acc = vaddq_u16(acc, vld1q_u16(buf + ii));
+	vst1q_u16(lanes, acc);
+	return sum16Scalar(lanes, 8) + sum16Scalar(buf + ii, numWords - ii);
+}
+#endif	/* CPU_ARM_NEON */
+
+/**
+ * Find what this CPU can do.
+ * @return nothing
+ */
+static void detect(void)
+{
+	levelsHave = 1 << CPU_SCALAR;
+#if CPU_X86
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports("sse2") )
+		levelsHave |= 1 << CPU_SSE2;
+	if ( __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("ssse3") )
+		levelsHave |= 1 << CPU_SSE42;
+	#if !defined(_WIN32)
+	if ( __builtin_cpu_supports("avx2") )
+		levelsHave |= 1 << CPU_AVX2;
+	if ( __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") )
+		levelsHave |= 1 << CPU_AVX512;
+	#endif
+#endif
+#if CPU_ARM_NEON
+	levelsHave |= 1 << CPU_NEON;
+#endif
+}
+
+/**
+ * Bind the kernels for a level.
+ * @param level - one of CPU_xxx. Must be one the CPU can do.
+ * @return nothing
+ */
+static void bind(int level)
+{
+	U32 crc;
+	int ii, jj;
+
+	for ( ii = 0; ii < 256; ++ii )
+	{
+		crc = ii;
+		for ( jj = 0; jj < 8; ++jj )
+			crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78 : 0);
+		crcTable[ii] = crc;
+	}
+	isZeroFunc = isZeroScalar;
+	diffFunc = diffScalar;
+	sum16Func = sum16Scalar;
+	crc32cFunc = crc32cScalar;
+	switch (level)
+	{
+#if CPU_X86
+	case CPU_SSE2:
+		isZeroFunc = isZeroSSE2;
+		diffFunc = diffSSE2;
+		sum16Func = sum16SSE2;
+		break;
+	case CPU_SSE42:
+		isZeroFunc = isZeroSSE42;
+		diffFunc = diffSSE2;
+		sum16Func = sum16SSE2;
+		crc32cFunc = crc32cSSE42;
+		break;
+	case CPU_AVX2:
+		isZeroFunc = isZeroAVX2;
+		diffFunc = diffAVX2;
+		sum16Func = sum16AVX2;
+		crc32cFunc = crc32cSSE42;
+		break;
+	case CPU_AVX512:
+		isZeroFunc = isZeroAVX512;
+		diffFunc = diffAVX512;
+		sum16Func = sum16AVX512;
+		crc32cFunc = crc32cSSE42;
+		break;
+#endif
+#if CPU_ARM_NEON
+	case CPU_NEON:
+		isZeroFunc = isZeroNEON;
+		diffFunc = diffNEON;
+		sum16Func = sum16NEON;
+		break;
+#endif
+	default:
+		break;
+	}
+	levelUsed = level;
+}
+
+/**
+ * Look up a level by name.
+ * @param name - name of level.
+ * @return CPU_xxx or -1 if there is no such level.
+ */
+static int findLevel(const char *name)
+{
+	int ii;
+
+	for ( ii = 0; ii < CPU_MAX; ++ii )
+	{
+		if ( !strcmp(name, LevelNames[ii]) )
+			return ii;
+	}
+	return -1;
+}
+
+/**
+ * Show the levels this CPU can do.
+ * @param fp - where to show them.
+ * @return nothing
+ */
+static void showLevels(FILE *fp)
+{
+	int ii;
+
+	fprintf(fp, "This CPU can use:");
+	for ( ii = 0; ii < CPU_MAX; ++ii )
+	{
+		if ( (levelsHave & (1 << ii)) )
+			fprintf(fp, " %s", LevelNames[ii]);
+	}
+	fprintf(fp, "\n");
+}
+
+/**
+ * Get the level of kernels in use, picking one if not yet done.
+ * @return one of CPU_xxx.
+ */
+int cpuLevel(void)
+{
+	const char *env;
+	int level;
+
+	if ( levelUsed >= 0 )
+		return levelUsed;
+	detect();
+	for ( level = CPU_MAX - 1; !(levelsHave & (1 << level)); --level )
+		;
+	env = getenv("RTPIP_CPU");
+	if ( env && *env )
+	{
+		int want = findLevel(env);
+
+		if ( want >= 0 && (levelsHave & (1 << want)) )
+			level = want;
+		else
+		{
+			fprintf(stderr, "WARNING: Ignoring RTPIP_CPU=%s. Using %s. ", env, LevelNames[level]);
+			showLevels(stderr);
+		}
+	}
+	bind(level);
+	return levelUsed;
+}
+
+/**
+ * Get the name of a level.
+ * @param level - one of CPU_xxx.
+ * @return name as used with --cpu.
+ */
+const char *cpuName(int level)
+{
+	return (level >= 0 && level < CPU_MAX) ? LevelNames[level] : "?";
+}
+
+/**
+ * Use a lower level of kernels than the best the CPU can do.
+ * @param name - name of level (as from cpuName()).
+ * @return 0 on success, 1 on error. Error message will have been displayed.
+ */
+int cpuForce(const char *name)
+{
+	int level;
+
+	cpuLevel();
+	level = findLevel(name);
+	if ( level < 0 || !(levelsHave & (1 << level)) )
+	{
+		fprintf(stderr, "Invalid --cpu level: \"%s\". ", name);
+		showLevels(stderr);
+		return 1;
+	}
+	bind(level);
+	return 0;
+}
+
+/**
+ * Check whether a buffer is all zeros.
+ * @param buf - pointer to buffer.
+ * @param len - number of bytes in buffer.
+ * @return 1 if every byte is 0, 0 if not.
+ */
+int memIsZero(const void *buf, size_t len)
+{
+	if ( levelUsed < 0 )
+		cpuLevel();
+	return isZeroFunc((const U8 *)buf, len);
+}
+
+/**
+ * Find the first byte that differs between two buffers.
+ * @param aa - pointer to one buffer.
+ * @param bb - pointer to the other.
+ * @param len - number of bytes to compare.
+ * @return index of first byte that differs or len if they are the same.
+ */
+size_t memDiff(const void *aa, const void *bb, size_t len)
+{
+	if ( levelUsed < 0 )
+		cpuLevel();
+	return diffFunc((const U8 *)aa, (const U8 *)bb, len);
+}
+
+/**
+ * Add up 16 bit words (as for the home block checksum).
+ * @param buf - pointer to words. Must be 2 byte aligned.
+ * @param numWords - number of words.
+ * @return sum of the words modulo 65536.
+ */
+U16 memSum16(const void *buf, size_t numWords)
+{
+	if ( levelUsed < 0 )
+		cpuLevel();
+	return sum16Func((const U16 *)buf, numWords);
+}
+
+/**
+ * Compute a CRC32C (Castagnoli, as used by iSCSI and ext4). It can be done in pieces
+ * by passing what the last piece returned.
+ * @param crc - 0 to start, or what was returned for the data before buf.
+ * @param buf - pointer to data.
+ * @param len - number of bytes.
+ * @return CRC of everything so far.
+ */
+U32 memCrc32c(U32 crc, const void *buf, size_t len)
+{
+	if ( levelUsed < 0 )
+		cpuLevel();
+	return ~crc32cFunc(~crc, (const U8 *)buf, len);
+}
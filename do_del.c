@@ -35,6 +35,7 @@ int do_del(Options_t *options)
 	Rt11DirEnt_t *dirptr;
 	int ii, totFiles = 0, totUsed = 0;
 	InWorkingDir_t *wdp;
+	U64 traceStart;
 
 	wdp = options->wDirArray;
 	for ( ii = 0; ii < options->numWdirs; ++ii, ++wdp )
@@ -44,7 +45,7 @@ int do_del(Options_t *options)
 		{
 			continue;
 		}
-		if ( !filterFilename(options, wdp->ffull) )
+		if ( !selectDirEnt(options, wdp) )
 			continue;
 		if ( !(options->delOpts & DELOPTS_NOASK) )
 		{
@@ -57,7 +58,9 @@ int do_del(Options_t *options)
 			if ( yn != YN_YES )
 				continue;
 		}
+		TRACE_START(options, traceStart);
 		dirptr->control = EMPTY;
+		wdp->freed = 1;
 		options->dirDirty = 1;
 		if ( options->verbose || (options->delOpts & DELOPTS_VERB) )
 		{
@@ -67,8 +70,11 @@ int do_del(Options_t *options)
 		options->totPerm -= dirptr->blocks;
 		totUsed += dirptr->blocks;
 		++totFiles;
+		TRACE_FILE(options, "del", traceStart, wdp->ffull, wdp->lba, dirptr->blocks, 0);
 	}
-	linearToDisk(options);
+	/* With --server there is no directory here; clientRun() sends the deletes to rtpipd */
+	if ( !options->server )
+		linearToDisk(options);
 	if ( options->verbose || (options->delOpts & DELOPTS_VERB) )
 	{
 		printf("Deleted a total of %d file%s, %d blocks.\n"
@@ -98,6 +104,7 @@ int preDelete(Options_t *options)
 				 && dirptr->name[2] == options->iHandle.iNameR50[2] )
 			{
 				dirptr->control = EMPTY;
+				wdp->freed = 1;
 				options->dirDirty = 1;
 				if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
 				{
@@ -108,8 +115,10 @@ int preDelete(Options_t *options)
 				options->totPerm -= dirptr->blocks;
 			}
 		}
-		/* While we're sweeping, keep track of an entry we can use for the new file */
-		if ( !(dirptr->control & PERM) )
+		/* While we're sweeping, keep track of an entry we can use for the new file. Space
+		 * given up by a file deleted this run is still that file's until the directory
+		 * is written, so leave it alone if asked to. */
+		if ( !(dirptr->control & PERM) && !(wdp->freed && options->holdFreed) )
 		{
 			if ( options->iHandle.fileBlks <= dirptr->blocks
 				 && (!options->iHandle.sizeMatch
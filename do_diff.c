@@ -0,0 +1,486 @@
+/*  $Id: do_diff.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $
+
+	do_diff.c - Show how two containers, or a container and a host directory, differ.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtpip.h"
+
+/**
+ * @file do_diff.c
+ * Show how two containers, or a container and a host directory, differ. Called from rtpip.
+ */
+
+/*
+ * Note: Both sides are made into lists of files sorted by name and walked together.
+ * Files on both sides with the same size have their blocks compared a chunk at a
+ * time, stopping at the first chunk that differs, so a file that changed near its
+ * start costs next to nothing and one that didn't change is read once from each
+ * side. Files in a host directory are compared as they would be in the container
+ * (ascii converted and padded to a whole block).
+ */
+
+#define DIFF_CHUNK_BLKS (64)        /* Blocks compared at a time */
+
+/** One file on one side */
+typedef struct
+{
+	char ffull[6+1+3+1];    /**< RT11 filename */
+	int blocks;             /**< Size in blocks */
+	U16 date;               /**< RT11 date */
+	int lba;                /**< Where it starts (container) */
+	HostFile_t *host;       /**< Host file (NULL if in a container) */
+} DiffEnt_t;
+
+/** One side of the diff */
+typedef struct
+{
+	Options_t *cont;        /**< Container (NULL if a host directory) */
+	DiffEnt_t *ents;        /**< Files (sorted by name) */
+	int num;                /**< Number of files */
+	FILE *fp;               /**< Host file being compared (if it isn't in inFileBuf) */
+	U8 *buf;                /**< Buffer for DIFF_CHUNK_BLKS blocks */
+} DiffSide_t;
+
+/** What was found */
+typedef struct
+{
+	int added;              /**< Files only in the other one */
+	int removed;            /**< Files only in the container */
+	int resized;            /**< Files whose size changed */
+	int redated;            /**< Files whose date changed */
+	int changed;            /**< Files whose contents changed */
+	int same;               /**< Files that are the same */
+	int trouble;            /**< Errors */
+} DiffTotals_t;
+
+/**
+ * Compare two files by RT11 name (for qsort).
+ * @param a - pointer to one DiffEnt_t.
+ * @param b - pointer to the other.
+ * @return <0, 0 or >0.
+ */
+static int cmpName(const void *a, const void *b)
+{
+	return strcmp(((const DiffEnt_t *)a)->ffull, ((const DiffEnt_t *)b)->ffull);
+}
+
+/**
+ * Make the list of selected files in a container.
+ * @param options - pointer to options (has the filters).
+ * @param sp - pointer to side (cont has been read in).
+ * @return 0 if success; 1 if out of memory.
+ */
+static int listContainer(Options_t *options, DiffSide_t *sp)
+{
+	InWorkingDir_t *wdp;
+	DiffEnt_t *ep;
+	int ii;
+
+	sp->ents = (DiffEnt_t *)malloc((sp->cont->numWdirs + 1) * sizeof(DiffEnt_t));
+	if ( !sp->ents )
+	{
+		msgErr(options, "Ran out of memory for %d files: %s\n", sp->cont->numWdirs, strerror(errno));
+		return 1;
+	}
+	for ( ii = 0, wdp = sp->cont->wDirArray; ii < sp->cont->numWdirs; ++ii, ++wdp )
+	{
+		if ( !(wdp->rt11.control & PERM) || !selectDirEnt(options, wdp) )
+			continue;
+		ep = sp->ents + sp->num++;
+		strcpy(ep->ffull, wdp->ffull);
+		ep->blocks = wdp->rt11.blocks;
+		ep->date = wdp->rt11.date;
+		ep->lba = wdp->lba;
+		ep->host = NULL;
+	}
+	qsort(sp->ents, sp->num, sizeof(DiffEnt_t), cmpName);
+	return 0;
+}
+
+/**
+ * Make the list of selected files in a host directory.
+ * @param options - pointer to options (has the filters).
+ * @param sp - pointer to side.
+ * @param hosts - pointer to host files (from hostDirScan()).
+ * @param num - number of host files.
+ * @return 0 if success; 1 if out of memory.
+ */
+static int listHost(Options_t *options, DiffSide_t *sp, HostFile_t *hosts, int num)
+{
+	InWorkingDir_t wd;
+	DiffEnt_t *ep;
+	int ii;
+
+	sp->ents = (DiffEnt_t *)malloc((num + 1) * sizeof(DiffEnt_t));
+	if ( !sp->ents )
+	{
+		msgErr(options, "Ran out of memory for %d files: %s\n", num, strerror(errno));
+		return 1;
+	}
+	memset(&wd, 0, sizeof(wd));
+	wd.rt11.control = PERM;
+	for ( ii = 0; ii < num; ++ii )
+	{
+		/* Filter it just like it was in a container */
+		memcpy(wd.rt11.name, hosts[ii].name, sizeof(wd.rt11.name));
+		strcpy(wd.ffull, hosts[ii].ffull);
+		wd.rt11.blocks = hosts[ii].blocks;
+		wd.rt11.date = hosts[ii].date;
+		if ( !selectDirEnt(options, &wd) )
+			continue;
+		ep = sp->ents + sp->num++;
+		strcpy(ep->ffull, hosts[ii].ffull);
+		ep->blocks = hosts[ii].blocks;
+		ep->date = hosts[ii].date;
+		ep->lba = 0;
+		ep->host = hosts + ii;
+	}
+	/* hostDirScan() already sorted them */
+	return 0;
+}
+
+/**
+ * Get ready to read a file.
+ * @param options - pointer to options.
+ * @param sp - pointer to side.
+ * @param ep - pointer to file.
+ * @return 0 if success; 1 if failure.
+ */
+static int openSide(Options_t *options, DiffSide_t *sp, const DiffEnt_t *ep)
+{
+	int retv;
+
+	sp->fp = NULL;
+	if ( sp->cont )
+		return 0;
+	options->inOpts = ep->host->ascii ? INOPTS_ASC : 0;
+	statBegin(options, STAT_PH_HOSTIN);
+	retv = hostFileRead(options, ep->host);
+	statEnd(options, STAT_PH_HOSTIN);
+	if ( retv )
+		return 1;
+	if ( options->iHandle.fileBlks != ep->blocks )
+	{
+		msgErr(options, "'%s' changed size while being compared\n", ep->host->path);
+		return 1;
+	}
+	if ( options->iHandle.directName )
+	{
+		sp->fp = statFopen(options, STAT_IO_HOST, ep->host->path, "rb");
+		if ( !sp->fp )
+		{
+			msgErr(options, "Error opening '%s' for input: %s\n", ep->host->path, strerror(errno));
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Read the next chunk of a file into the side's buffer.
+ * @param options - pointer to options.
+ * @param sp - pointer to side.
+ * @param ep - pointer to file.
+ * @param blk - block in file to start at (chunks are read in order).
+ * @param len - number of blocks.
+ * @return 0 if success; 1 if failure.
+ */
+static int readSide(Options_t *options, DiffSide_t *sp, const DiffEnt_t *ep, int blk, int len)
+{
+	Options_t *cp = sp->cont;
+	int got;
+
+	if ( !cp )
+	{
+		if ( !sp->fp )
+		{
+			/* Ascii files and files for floppies have already been read in */
+			memcpy(sp->buf, options->iHandle.inFileBuf + blk * BLKSIZ, len * BLKSIZ);
+			return 0;
+		}
+		got = statFread(options, STAT_IO_HOST, sp->buf, 1, len * BLKSIZ, sp->fp);
+		if ( got < len * BLKSIZ )
+		{
+			if ( ferror(sp->fp) )
+			{
+				msgErr(options, "Error reading '%s': %s\n", ep->host->path, strerror(errno));
+				return 1;
+			}
+			/* pad file to multiple of BLKSIZ with 0's */
+			memset(sp->buf + got, 0, len * BLKSIZ - got);
+		}
+		return 0;
+	}
+	if ( cp->floppyImageUnscrambled )
+	{
+		memcpy(sp->buf, cp->floppyImageUnscrambled + (ep->lba + blk) * BLKSIZ, len * BLKSIZ);
+		return 0;
+	}
+	if (    statFseek(options, STAT_IO_CONT, cp->inp, (long)(ep->lba + blk) * BLKSIZ, SEEK_SET) < 0
+		 || (int)statFread(options, STAT_IO_CONT, sp->buf, BLKSIZ, len, cp->inp) != len )
+	{
+		msgErr(options, "Error reading blocks %d-%d of '%s': %s\n",
+				ep->lba + blk, ep->lba + blk + len - 1, cp->container, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Compare the contents of two files of the same size.
+ * @param options - pointer to options.
+ * @param aa - pointer to one side.
+ * @param ea - pointer to file on that side.
+ * @param bb - pointer to the other side.
+ * @param eb - pointer to file on the other side.
+ * @return -1 if they are the same, -2 if they couldn't be compared, else the first block that differs.
+ */
+static int cmpContents(Options_t *options, DiffSide_t *aa, const DiffEnt_t *ea, DiffSide_t *bb, const DiffEnt_t *eb)
+{
+	int blk, len, retv = -1;
+	size_t off;
+
+	if ( openSide(options, aa, ea) || openSide(options, bb, eb) )
+		retv = -2;
+	for ( blk = 0; retv == -1 && blk < ea->blocks; blk += len )
+	{
+		len = ea->blocks - blk > DIFF_CHUNK_BLKS ? DIFF_CHUNK_BLKS : ea->blocks - blk;
+		if ( readSide(options, aa, ea, blk, len) || readSide(options, bb, eb, blk, len) )
+		{
+			retv = -2;
+			break;
+		}
+		off = memDiff(aa->buf, bb->buf, (size_t)len * BLKSIZ);
+		if ( off < (size_t)len * BLKSIZ )
+			retv = blk + off / BLKSIZ;
+	}
+	if ( aa->fp )
+		fclose(aa->fp);
+	if ( bb->fp )
+		fclose(bb->fp);
+	aa->fp = bb->fp = NULL;
+	return retv;
+}
+
+/**
+ * Show one difference.
+ * @param options - pointer to options.
+ * @param kind - what it is ("added", "removed", "resized", "redated" or "changed").
+ * @param ea - pointer to file in container (NULL if none).
+ * @param eb - pointer to file in the other one (NULL if none).
+ * @param blk - first block that differs (-1 if not known).
+ * @return nothing
+ */
+static void showDiff(Options_t *options, const char *kind, const DiffEnt_t *ea, const DiffEnt_t *eb, int blk)
+{
+	char da[INSTR_LEN], db[INSTR_LEN];
+	const DiffEnt_t *ep = ea ? ea : eb;
+
+	if ( (options->diffOpts & DIFFOPTS_MACHINE) )
+	{
+		/* kind name blocks1 blocks2 date1 date2 block, with - for anything there isn't */
+		printf("%s\t%s\t", kind, ep->ffull);
+		if ( ea )
+			printf("%d\t", ea->blocks);
+		else
+			printf("-\t");
+		if ( eb )
+			printf("%d\t", eb->blocks);
+		else
+			printf("-\t");
+		printf("%s\t%s\t", dateIso(da, ea ? ea->date : 0), dateIso(db, eb ? eb->date : 0));
+		if ( blk >= 0 )
+			printf("%d\n", blk);
+		else
+			printf("-\n");
+		return;
+	}
+	if ( !ea )
+		printf("added:   %-10s %5d blocks %s\n", ep->ffull, ep->blocks, dateStr(db, ep->date));
+	else if ( !eb )
+		printf("removed: %-10s %5d blocks %s\n", ep->ffull, ep->blocks, dateStr(da, ep->date));
+	else if ( !strcmp(kind, "resized") )
+		printf("resized: %-10s %5d -> %d blocks\n", ep->ffull, ea->blocks, eb->blocks);
+	else if ( !strcmp(kind, "redated") )
+		printf("redated: %-10s %s -> %s\n", ep->ffull, dateStr(da, ea->date), dateStr(db, eb->date));
+	else
+		printf("changed: %-10s first differs at block %d\n", ep->ffull, blk);
+}
+
+/**
+ * Compare a file that is on both sides.
+ * @param options - pointer to options.
+ * @param aa - pointer to container's side.
+ * @param ea - pointer to file in container.
+ * @param bb - pointer to the other side.
+ * @param eb - pointer to file in the other one.
+ * @param tp - pointer to totals.
+ * @return nothing
+ */
+static void diffOne(Options_t *options, DiffSide_t *aa, const DiffEnt_t *ea, DiffSide_t *bb, const DiffEnt_t *eb, DiffTotals_t *tp)
+{
+	int differs = 0, blk;
+
+	/* Host files only have a date worth comparing with --time */
+	if ( ea->date != eb->date && (bb->cont || (options->fileOpts & FILEOPTS_TIMESTAMP)) )
+	{
+		showDiff(options, "redated", ea, eb, -1);
+		++tp->redated;
+		differs = 1;
+	}
+	if ( ea->blocks != eb->blocks )
+	{
+		showDiff(options, "resized", ea, eb, -1);
+		++tp->resized;
+		differs = 1;
+	}
+	else if ( !(options->diffOpts & DIFFOPTS_QUICK) && ea->blocks )
+	{
+		blk = cmpContents(options, aa, ea, bb, eb);
+		if ( blk == -2 )
+		{
+			++tp->trouble;
+			return;
+		}
+		if ( blk >= 0 )
+		{
+			showDiff(options, "changed", ea, eb, blk);
+			++tp->changed;
+			differs = 1;
+		}
+	}
+	if ( !differs )
+	{
+		++tp->same;
+		if ( (options->diffOpts & DIFFOPTS_VERB) && !(options->diffOpts & DIFFOPTS_MACHINE) )
+			printf("same:    %s\n", ea->ffull);
+	}
+}
+
+/**
+ * Show how the container and the container or host directory in options->diffWith differ.
+ * @param options - pointer to options.
+ * @return 0 if they are the same, 1 if they differ, 2 if there was trouble.
+ */
+int do_diff(Options_t *options)
+{
+	Options_t other;
+	DiffSide_t aa, bb;
+	DiffTotals_t tot;
+	HostFile_t *hosts = NULL;
+	struct stat st;
+	int numHosts = 0, ia, ib, cmp, sts = 0;
+
+	memset(&aa, 0, sizeof(aa));
+	memset(&bb, 0, sizeof(bb));
+	memset(&tot, 0, sizeof(tot));
+	memset(&other, 0, sizeof(other));
+	aa.cont = options;
+	if ( stat(options->diffWith, &st) )
+	{
+		msgErr(options, "Unable to stat '%s': %s\n", options->diffWith, strerror(errno));
+		return 2;
+	}
+	if ( S_ISDIR(st.st_mode) )
+	{
+		options->hostDir = options->diffWith;
+		if ( hostDirScan(options, &hosts, &numHosts) )
+			return 2;
+		sts = listHost(options, &bb, hosts, numHosts);
+	}
+	else
+	{
+		/* Read the other container just like this one was */
+		other.container = options->diffWith;
+		other.seg1LBA = DIRBLK;
+		other.msgFunc = options->msgFunc;
+		other.msgUser = options->msgUser;
+		other.cmdOpts = options->cmdOpts & CMDOPT_DBG_NORMAL;
+		if ( (options->diffOpts & DIFFOPTS_SGL) )
+			other.cmdOpts |= CMDOPT_SINGLE_FLPY;
+		else if ( (options->diffOpts & DIFFOPTS_DBL) )
+			other.cmdOpts |= CMDOPT_DOUBLE_FLPY;
+		bb.cont = &other;
+		sts = checkHeader(&other) || parse_directory(&other) || listContainer(options, &bb);
+	}
+	if ( !sts )
+		sts = listContainer(options, &aa);
+	if ( !sts )
+	{
+		aa.buf = (U8 *)malloc(2 * DIFF_CHUNK_BLKS * BLKSIZ);
+		bb.buf = aa.buf + DIFF_CHUNK_BLKS * BLKSIZ;
+		if ( !aa.buf )
+		{
+			msgErr(options, "Ran out of memory for compare buffers: %s\n", strerror(errno));
+			sts = 1;
+		}
+	}
+	if ( sts )
+	{
+		free(aa.ents);
+		free(bb.ents);
+		if ( hosts )
+			hostDirFree(hosts, numHosts);
+		freeContainer(&other);
+		return 2;
+	}
+	if ( (options->diffOpts & DIFFOPTS_VERB) && !(options->diffOpts & DIFFOPTS_MACHINE) )
+		printf("Comparing '%s' (%d files) with '%s' (%d files)\n", options->container, aa.num, options->diffWith, bb.num);
+	/* Both lists are sorted by name, so walk them together */
+	for ( ia = ib = 0; ia < aa.num || ib < bb.num; )
+	{
+		if ( ia >= aa.num )
+			cmp = 1;
+		else if ( ib >= bb.num )
+			cmp = -1;
+		else
+			cmp = strcmp(aa.ents[ia].ffull, bb.ents[ib].ffull);
+		if ( cmp < 0 )
+		{
+			showDiff(options, "removed", aa.ents + ia, NULL, -1);
+			++tot.removed;
+			++ia;
+		}
+		else if ( cmp > 0 )
+		{
+			showDiff(options, "added", NULL, bb.ents + ib, -1);
+			++tot.added;
+			++ib;
+		}
+		else
+		{
+			diffOne(options, &aa, aa.ents + ia, &bb, bb.ents + ib, &tot);
+			++ia;
+			++ib;
+		}
+	}
+	if ( (options->diffOpts & DIFFOPTS_VERB) && !(options->diffOpts & DIFFOPTS_MACHINE) )
+	{
+		printf("%d added, %d removed, %d resized, %d redated, %d changed, %d the same.\n",
+			   tot.added, tot.removed, tot.resized, tot.redated, tot.changed, tot.same);
+	}
+	free(aa.buf);
+	free(aa.ents);
+	free(bb.ents);
+	if ( hosts )
+		hostDirFree(hosts, numHosts);
+	freeContainer(&other);
+	if ( tot.trouble )
+		return 2;
+	return (tot.added || tot.removed || tot.resized || tot.redated || tot.changed) ? 1 : 0;
+}
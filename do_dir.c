@@ -53,7 +53,7 @@ static int showDirEnt(Options_t *options, InWorkingDir_t *wdp, FileDetails_t *co
 	}
 	if ( (dirptr->control & PERM) )
 	{
-		if ( !filterFilename(options, wdp->ffull) )
+		if ( !selectDirEnt(options, wdp) )
 			return 0;
 		counts->totUsed += dirptr->blocks;
 		++counts->totFiles;
@@ -129,24 +129,8 @@ int do_directory(Options_t *options)
 	}
 	if ( options->numWdirs > 2 && options->sortby )
 	{
-		ii = (options->sortby & SORTBY_REV) ? 4 : 0;
-		if ( (options->sortby & SORTBY_TYPE) )
-		{
-			ii |= 1;
-		}
-		else if ( (options->sortby & SORTBY_DATE) )
-		{
-			ii |= 2;
-		}
-		else if ( (options->sortby & SORTBY_SIZE) )
-		{
-			ii |= 3;
-		}
-		if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
-		{
-			printf("do_directory: using cmpFunc[%d]\n", ii);
-		}
-		qsort(options->linArray, options->numWdirs, sizeof(InWorkingDir_t *), cmpFuncs[ii]);
+		if ( sortDirectory(options) )
+			return 1;
 	}
 	if ( options->columns > 0 )
 	{
@@ -156,7 +140,7 @@ int do_directory(Options_t *options)
 		permFiles = (InWorkingDir_t **)calloc(options->numWdirs, sizeof(InWorkingDir_t *));
 		if ( !permFiles )
 		{
-			fprintf(stderr, "Ran out of memory calloc()ing %d bytes for permlist\n",
+			msgErr(options, "Ran out of memory calloc()ing %d bytes for permlist\n",
 					(int)(options->numWdirs * sizeof(InWorkingDir_t *)));
 			return 1;
 		}
@@ -172,7 +156,7 @@ int do_directory(Options_t *options)
 			}
 			else
 			{
-				if ( !filterFilename(options, wdp->ffull) )
+				if ( !selectDirEnt(options, wdp) )
 					continue;
 				counts.totUsed += dirptr->blocks;
 				++counts.totFiles;
@@ -26,172 +26,156 @@
  */
 
 /**
- * Copy a file into RT11 container.
+ * Make a directory entry for the file described by options->iHandle, deleting any
+ * existing file of the same name. It goes in the smallest empty area it fits.
  * @param options - pointer to options.
- * @return 0 if success; 1 if failure.
+ * @param what - name of file for error messages.
+ * @param wdpp - pointer to place to put pointer to new entry.
+ * @return 0 if success, 1 if not enough room for the file, 2 if out of directory entries.
+ * Error message will have been displayed.
  */
-int do_in(Options_t *options)
+int newDirEnt(Options_t *options, const char *what, InWorkingDir_t **wdpp)
 {
 	Rt11DirEnt_t *dirptr;
-	int ii, retv, outLBA;
 	InWorkingDir_t *wdp;
-	InHandle_t *ihp;
+	InHandle_t *ihp = &options->iHandle;
+	int retv, outLBA;
 
-	for ( ii = 0; ii < options->numArgFiles; ++ii )
+	if ( preDelete(options) )
+		return 1;
+	wdp = options->iHandle.sizeMatch;
+	if ( !wdp || wdp->rt11.blocks < options->iHandle.fileBlks )
 	{
-
-		/* Convert name to RAD50 */
-		if ( cvtName(options, options->argFiles[ii]) )
-			continue;
-		if ( !(options->inOpts & INOPTS_NOASK) )
+		msgErr(options, "Not enough contigiuos space left on disk for '%s'. Need %d blocks. Total free space: %d\n",
+				what, options->iHandle.fileBlks,
+				options->totEmpty);
+		if ( options->totEmpty > options->iHandle.fileBlks )
 		{
-			char prompt[128];
-			int yn;
-
-			snprintf(prompt, sizeof(prompt) - 1, "Copy in '%s'?", options->iHandle.argFN);
-			yn = getYN(prompt, YN_YES);
-			if ( yn == YN_QUIT )
-				break;
-			if ( yn != YN_YES )
-				continue;
+			msgErr(options, "Try doing an rtpip sqz command to consolidate all the free space\n");
 		}
-		if ( readInpFile(options, options->argFiles[ii]) )
-			continue;
-		if ( preDelete(options) )
-			continue;
-		wdp = options->iHandle.sizeMatch;
-		if ( !wdp || wdp->rt11.blocks < options->iHandle.fileBlks )
+		return 1;
+	}
+	dirptr = &wdp->rt11;
+	outLBA = wdp->lba;
+	if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
+	{
+		printf("newDirEnt: '%s', cvt: %s, outLBA:%d, fileBlks: %d\n",
+			   what,
+			   options->iHandle.argFN,
+			   outLBA,
+			   options->iHandle.fileBlks);
+	}
+	if ( dirptr->blocks != options->iHandle.fileBlks )
+	{
+		int moveAmt;
+		retv = options->maxseg * options->numdent;
+		/* We need to split the empty space (be sure to leave room for one last entry) */
+		if ( retv - 1 <= options->numWdirs )
 		{
-			fprintf(stderr, "Not enough contigiuos space left on disk for '%s'. Need %d blocks. Total free space: %d\n",
-					options->argFiles[ii], options->iHandle.fileBlks,
-					options->totEmpty);
-			if ( options->totEmpty > options->iHandle.fileBlks )
-			{
-				fprintf(stderr, "Try doing an rtpip sqz command to consolidate all the free space\n");
-			}
-			continue;
+			msgErr(options, "Ran out of directory entries. Currently has room for %d and used %d\n",
+					retv - 1, options->numWdirs);
+			return 2;
 		}
-		dirptr = &wdp->rt11;
-		outLBA = wdp->lba;
+		/* Compute starting index */
+		retv = wdp - options->wDirArray;
+		/* Compute number of entries to end of list */
+		moveAmt = options->numWdirs - retv;
+		dirptr->blocks -= options->iHandle.fileBlks;
+		wdp->lba += options->iHandle.fileBlks;
 		if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
 		{
-			printf("do_in: '%s', cvt: %s, outLBA:%d, fileBlks: %d\n",
-				   options->argFiles[ii],
-				   options->iHandle.argFN,
-				   outLBA,
-				   options->iHandle.fileBlks);
+			printf("newDirEnt: Inserted empty entry at index %d. New LBA: %d, new size: %d\n",
+				   retv + 1, wdp->lba, dirptr->blocks);
 		}
-		if ( dirptr->blocks != options->iHandle.fileBlks )
-		{
-			int moveAmt;
-			retv = options->maxseg * options->numdent;
-			/* We need to split the empty space (be sure to leave room for one last entry) */
-			if ( retv - 1 <= options->numWdirs )
-			{
-				fprintf(stderr, "Ran out of directory entries. Currently has room for %d and used %d\n",
-						retv - 1, options->numWdirs);
-				break;
-			}
-			/* Compute starting index */
-			retv = wdp - options->wDirArray;
-			/* Compute number of entries to end of list */
-			moveAmt = options->numWdirs - retv;
-			dirptr->blocks -= options->iHandle.fileBlks;
-			wdp->lba += options->iHandle.fileBlks;
-			if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
-			{
-				printf("do_in: Inserted empty entry at index %d. New LBA: %d, new size: %d\n",
-					   retv + 1, wdp->lba, dirptr->blocks);
-			}
-			memmove(wdp + 1, wdp, moveAmt * sizeof(InWorkingDir_t));
-			++options->numWdirs;
-		}
-		else
+		memmove(wdp + 1, wdp, moveAmt * sizeof(InWorkingDir_t));
+		++options->numWdirs;
+	}
+	else
+	{
+		if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
 		{
-			if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
-			{
-				printf("do_in: Found an exact replacement entry at index %d\n",
-					   (int)(wdp - options->wDirArray));
-			}
+			printf("newDirEnt: Found an exact replacement entry at index %d\n",
+				   (int)(wdp - options->wDirArray));
 		}
-		dirptr->name[0] = options->iHandle.iNameR50[0];        /* Need to copy file here */
-		dirptr->name[1] = options->iHandle.iNameR50[1];
-		dirptr->name[2] = options->iHandle.iNameR50[2];
-		dirptr->blocks = options->iHandle.fileBlks;
-		if ( options->inDate )
-			dirptr->date = options->inDate;
-		else if ( (options->fileOpts & FILEOPTS_TIMESTAMP) )
-		{
-			int yr, mo, day, age;
-			struct tm *tm;
+	}
+	dirptr->name[0] = options->iHandle.iNameR50[0];        /* Need to copy file here */
+	dirptr->name[1] = options->iHandle.iNameR50[1];
+	dirptr->name[2] = options->iHandle.iNameR50[2];
+	dirptr->blocks = options->iHandle.fileBlks;
+	if ( options->inDate )
+		dirptr->date = options->inDate;
+	else if ( (options->fileOpts & FILEOPTS_TIMESTAMP) )
+		dirptr->date = timeToDate(options->iHandle.fileTimeStamp);
+	else
+	{
+		dirptr->date = ((1) << 10) | (1 << 5) | ((0) & 31);
+	}
+	dirptr->control = PERM;
+	wdp->lba = outLBA;
+	options->totEmpty -= ihp->fileBlks;
+	options->totPerm += ihp->fileBlks;
+	ihp->totUsed += ihp->fileBlks;
+	++ihp->totIns;
+	*wdpp = wdp;
+	return 0;
+}
 
-			tm = localtime(&options->iHandle.fileTimeStamp);
-			yr = tm->tm_year + 1900;
-			mo = tm->tm_mon + 1;
-			day = tm->tm_mday;
-			age = 0;
-			if ( yr >= 1972 && yr < 2004  )
-			{
-				yr -= 1972;
-				age = 0;
-			}
-			else if ( yr >= 2004 && yr < 2036 )
-			{
-				yr -= 2004;
-				age = 1;
-			}
-			else if ( yr >= 2036 && yr < 2068 )
-			{
-				yr -= 2036;
-				age = 2;
-			}
-			else
-			{
-				yr -= 2068;
-				age = 3;
-			}
-			dirptr->date = (age << 14) | ((mo & 15) << 10) | ((day & 31) << 5) | (yr & 31);
-		}
-		else
-		{
-			dirptr->date = ((1) << 10) | (1 << 5) | ((0) & 31);
-		}
-		ihp = &options->iHandle;
-		dirptr->control = PERM;
-		wdp->lba = outLBA;
-		options->totEmpty -= ihp->fileBlks;
-		options->totPerm += ihp->fileBlks;
-		ihp->totUsed += ihp->fileBlks;
-		++ihp->totIns;
-		if ( !(options->cmdOpts & CMDOPT_NOWRITE) )
+/**
+ * Copy the file read by readInpFile() or fillInpBuf() into the container.
+ * @param options - pointer to options.
+ * @param what - name of file for messages.
+ * @param traceStart - when reading it started (for --trace).
+ * @return 0 if success, 1 if it wasn't copied, 2 if out of directory entries or
+ * 3 if the container couldn't be written. Error message will have been displayed.
+ */
+int copyInFile(Options_t *options, const char *what, U64 traceStart)
+{
+	InWorkingDir_t *wdp;
+	InHandle_t *ihp = &options->iHandle;
+	int retv;
+
+	retv = newDirEnt(options, what, &wdp);
+	if ( retv )
+		return retv;
+	if ( !(options->cmdOpts & CMDOPT_NOWRITE) )
+	{
+		if ( (options->cmdOpts & (CMDOPT_DOUBLE_FLPY | CMDOPT_SINGLE_FLPY)) )
 		{
-			if ( (options->cmdOpts & (CMDOPT_DOUBLE_FLPY | CMDOPT_SINGLE_FLPY)) )
+			U8 *dst = options->floppyImageUnscrambled + wdp->lba * BLKSIZ;
+			memcpy(dst, ihp->inFileBuf, ihp->fileBlks * BLKSIZ);
+			if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) || options->verbose || (options->inOpts & INOPTS_VERB) )
 			{
-				U8 *dst = options->floppyImageUnscrambled + wdp->lba * BLKSIZ;
-				memcpy(dst, ihp->inFileBuf, ihp->fileBlks * BLKSIZ);
-				if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) || options->verbose || (options->inOpts & INOPTS_VERB) )
-				{
-					printf("Copied '%s' to '%s', %d blocks\n",
-						   options->argFiles[ii], options->iHandle.argFN, options->iHandle.fileBlks);
-				}
-			}
-			else
-			{
-				retv = writeFileToContainer(options,wdp);
-				if ( retv == 1 )
-					return 1;
+				printf("Copied '%s' to '%s', %d blocks\n",
+					   what, ihp->argFN, ihp->fileBlks);
 			}
 		}
 		else
 		{
-			printf("Would have copied '%s' to '%s', %d blocks at LBA %d\n",
-				   options->argFiles[ii], options->iHandle.argFN, options->iHandle.fileBlks, wdp->lba);
+			retv = writeFileToContainer(options,wdp);
+			if ( retv == 1 )
+				return 3;
 		}
 	}
+	else
+	{
+		printf("Would have copied '%s' to '%s', %d blocks at LBA %d\n",
+			   what, ihp->argFN, ihp->fileBlks, wdp->lba);
+	}
+	TRACE_FILE(options, "in", traceStart, what, wdp->lba, ihp->fileBlks, (long)ihp->fileBlks * BLKSIZ);
+	return 0;
+}
+
+/**
+ * Put the new files in the directory and say what was done.
+ * @param options - pointer to options.
+ * @return nothing
+ */
+void inSummary(Options_t *options)
+{
 	linearToDisk(options);
 	if ( (options->cmdOpts & CMDOPT_NOWRITE) || (options->cmdOpts & CMDOPT_DBG_NORMAL) || options->verbose || (options->inOpts & INOPTS_VERB) )
 	{
-		fseek(options->inp,0,SEEK_END);
+		statFseek(options, STAT_IO_CONT, options->inp,0,SEEK_END);
 		printf("%sAdded a total of %d file%s, %d blocks. %d free blocks now. Container EOF block is %ld.\n",
 			   (options->cmdOpts & CMDOPT_NOWRITE) ? "Would have " : "",
 			   options->iHandle.totIns,
@@ -200,9 +184,50 @@ int do_in(Options_t *options)
 			   options->totEmpty,
 			   ftell(options->inp)/BLKSIZ);
 	}
-	return 0;
 }
 
+/**
+ * Copy a file into RT11 container.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure.
+ */
+int do_in(Options_t *options)
+{
+	int ii, retv;
+	U64 traceStart = 0;
 
+	if ( options->tarFile )
+		return tarIn(options);
+	for ( ii = 0; ii < options->numArgFiles; ++ii )
+	{
 
+		/* Convert name to RAD50 */
+		if ( cvtName(options, options->argFiles[ii]) )
+			continue;
+		if ( !(options->inOpts & INOPTS_NOASK) )
+		{
+			char prompt[128];
+			int yn;
 
+			snprintf(prompt, sizeof(prompt) - 1, "Copy in '%s'?", options->iHandle.argFN);
+			yn = getYN(prompt, YN_YES);
+			if ( yn == YN_QUIT )
+				break;
+			if ( yn != YN_YES )
+				continue;
+		}
+		TRACE_START(options, traceStart);
+		statBegin(options, STAT_PH_HOSTIN);
+		retv = readInpFile(options, options->argFiles[ii]);
+		statEnd(options, STAT_PH_HOSTIN);
+		if ( retv )
+			continue;
+		retv = copyInFile(options, options->argFiles[ii], traceStart);
+		if ( retv == 2 )
+			break;
+		if ( retv == 3 )
+			return 1;
+	}
+	inSummary(options);
+	return 0;
+}
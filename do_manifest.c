@@ -0,0 +1,627 @@
+/*  $Id: do_manifest.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $
+
+	do_manifest.c - List files with hashes of their contents, or check them against such a list.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MINGW
+	#define _POSIX_C_SOURCE 200809L
+#endif
+#include "rtpip.h"
+#ifndef MINGW
+	#include <pthread.h>
+#endif
+
+/**
+ * @file do_manifest.c
+ * List files with hashes of their contents, or check them against such a list. Called from rtpip.
+ */
+
+/*
+ * Note: The files are hashed straight out of the container (or the floppy image
+ * in memory) by a few threads, each taking the next file not yet done, so nothing
+ * is copied out to the host. The blocks are read with pread() so the threads
+ * don't share a file position, and nothing is printed or counted until they are
+ * all done. The ascii form is the file as out -a would make it.
+ */
+
+#define MAN_CHUNK_BLKS (64)         /* Blocks hashed at a time */
+#define MAN_MAX_JOBS   (16)         /* Most threads used */
+
+/** One file and its hashes */
+typedef struct
+{
+	char ffull[6+1+3+1];    /**< RT11 filename */
+	U16 name[3];            /**< Rad50 filename */
+	int blocks;             /**< Size in blocks */
+	U16 date;               /**< RT11 date */
+	int lba;                /**< Where it starts */
+	int ascii;              /**< Also hash the ascii form */
+	U32 crc;                /**< CRC32C of the blocks */
+	U8 sha[32];             /**< SHA-256 of the blocks */
+	U32 asciiCrc;           /**< CRC32C of the ascii form */
+	U8 asciiSha[32];        /**< SHA-256 of the ascii form */
+	int err;                /**< errno if the blocks couldn't be read (0 if they could) */
+	int errBlk;             /**< Block that couldn't be read */
+	int checked;            /**< Found in the manifest being checked */
+} ManEnt_t;
+
+/** The work shared by the threads */
+typedef struct
+{
+	Options_t *options;     /**< Container */
+	ManEnt_t *ents;         /**< Files (sorted by name) */
+	int num;                /**< Number of files */
+	int next;               /**< Next file to do */
+#ifndef MINGW
+	pthread_mutex_t lock;   /**< Protects next */
+#endif
+} ManWork_t;
+
+/**
+ * Compare two files by RT11 name (for qsort and bsearch).
+ * @param a - pointer to one ManEnt_t.
+ * @param b - pointer to the other.
+ * @return <0, 0 or >0.
+ */
+static int cmpName(const void *a, const void *b)
+{
+	return strcmp(((const ManEnt_t *)a)->ffull, ((const ManEnt_t *)b)->ffull);
+}
+
+/**
+ * Turn bytes into hex.
+ * @param dst - where to put it (2*len+1 bytes).
+ * @param src - pointer to bytes.
+ * @param len - number of bytes.
+ * @return dst
+ */
+static char *hexStr(char *dst, const U8 *src, int len)
+{
+	static const char Hex[] = "0123456789abcdef";
+	int ii;
+
+	for ( ii = 0; ii < len; ++ii )
+	{
+		dst[2 * ii] = Hex[src[ii] >> 4];
+		dst[2 * ii + 1] = Hex[src[ii] & 15];
+	}
+	dst[2 * len] = 0;
+	return dst;
+}
+
+/**
+ * Read some blocks of the container.
+ * @param options - pointer to options.
+ * @param buf - where to put them.
+ * @param lba - first block.
+ * @param len - number of blocks.
+ * @return 0 if success; errno if failure.
+ */
+static int readBlocks(Options_t *options, U8 *buf, int lba, int len)
+{
+#ifndef MINGW
+	long got, done;
+
+	for ( done = 0; done < (long)len * BLKSIZ; done += got )
+	{
+		got = pread(fileno(options->inp), buf + done, (long)len * BLKSIZ - done, (off_t)lba * BLKSIZ + done);
+		if ( got <= 0 )
+			return got ? errno : EIO;
+	}
+#else
+	/* Only one thread on Windows */
+	if (    fseek(options->inp, (long)lba * BLKSIZ, SEEK_SET) < 0
+		 || (int)fread(buf, BLKSIZ, len, options->inp) != len )
+		return errno ? errno : EIO;
+#endif
+	return 0;
+}
+
+/**
+ * Hash one file.
+ * @param wp - pointer to work.
+ * @param ep - pointer to file.
+ * @param iBuf - buffer for MAN_CHUNK_BLKS blocks.
+ * @param oBuf - buffer for MAN_CHUNK_BLKS blocks plus one byte.
+ * @return nothing (ep->err is set if it couldn't be read)
+ */
+static void hashOne(ManWork_t *wp, ManEnt_t *ep, U8 *iBuf, U8 *oBuf)
+{
+	Options_t *options = wp->options;
+	Sha256_t sha, asciiSha;
+	AsciiStrip_t as;
+	U8 *src;
+	int blk, len;
+	size_t outLen;
+	U32 crc = 0, asciiCrc = 0;
+
+	sha256Init(&sha);
+	sha256Init(&asciiSha);
+	asciiStripInit(&as);
+	for ( blk = 0; blk < ep->blocks; blk += len )
+	{
+		len = ep->blocks - blk > MAN_CHUNK_BLKS ? MAN_CHUNK_BLKS : ep->blocks - blk;
+		if ( options->floppyImageUnscrambled )
+			src = options->floppyImageUnscrambled + (ep->lba + blk) * BLKSIZ;
+		else
+		{
+			ep->err = readBlocks(options, iBuf, ep->lba + blk, len);
+			if ( ep->err )
+			{
+				ep->errBlk = ep->lba + blk;
+				return;
+			}
+			src = iBuf;
+		}
+		if ( (options->manOpts & MANOPTS_CRC) )
+			crc = memCrc32c(crc, src, (size_t)len * BLKSIZ);
+		if ( (options->manOpts & MANOPTS_SHA) )
+			sha256Update(&sha, src, (size_t)len * BLKSIZ);
+		if ( ep->ascii && !as.done )
+		{
+			outLen = asciiStripCR(&as, (const char *)src, (size_t)len * BLKSIZ, (char *)oBuf);
+			if ( blk + len >= ep->blocks )
+				outLen += asciiStripFinish(&as, (char *)oBuf + outLen);
+			if ( (options->manOpts & MANOPTS_CRC) )
+				asciiCrc = memCrc32c(asciiCrc, oBuf, outLen);
+			if ( (options->manOpts & MANOPTS_SHA) )
+				sha256Update(&asciiSha, oBuf, outLen);
+		}
+	}
+	ep->crc = crc;
+	sha256Final(&sha, ep->sha);
+	ep->asciiCrc = asciiCrc;
+	sha256Final(&asciiSha, ep->asciiSha);
+}
+
+/**
+ * Hash files until there are none left. Run by each thread.
+ * @param arg - pointer to work.
+ * @return NULL
+ */
+static void *hashFiles(void *arg)
+{
+	ManWork_t *wp = (ManWork_t *)arg;
+	U8 *iBuf;
+	int ii;
+
+	iBuf = (U8 *)malloc(2 * MAN_CHUNK_BLKS * BLKSIZ + 1);
+	while ( 1 )
+	{
+#ifndef MINGW
+		pthread_mutex_lock(&wp->lock);
+#endif
+		ii = wp->next++;
+#ifndef MINGW
+		pthread_mutex_unlock(&wp->lock);
+#endif
+		if ( ii >= wp->num )
+			break;
+		if ( !iBuf )
+		{
+			wp->ents[ii].err = ENOMEM;
+			continue;
+		}
+		hashOne(wp, wp->ents + ii, iBuf, iBuf + MAN_CHUNK_BLKS * BLKSIZ);
+	}
+	free(iBuf);
+	return NULL;
+}
+
+/**
+ * Hash all the files, using as many threads as makes sense.
+ * @param wp - pointer to work.
+ * @return nothing
+ */
+static void hashAll(ManWork_t *wp)
+{
+#ifndef MINGW
+	pthread_t tids[MAN_MAX_JOBS];
+	int jobs, started, ii;
+
+	jobs = wp->options->manJobs;
+	if ( !jobs )
+		jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if ( jobs > MAN_MAX_JOBS )
+		jobs = MAN_MAX_JOBS;
+	if ( jobs > wp->num )
+		jobs = wp->num;
+	/* Fill in the tables that would otherwise be made on first use */
+	cpuLevel();
+	asciiInit();
+	pthread_mutex_init(&wp->lock, NULL);
+	for ( started = 0; started < jobs - 1; ++started )
+	{
+		if ( pthread_create(tids + started, NULL, hashFiles, wp) )
+			break;
+	}
+	/* This one helps too (and does it all if no threads could be started) */
+	hashFiles(wp);
+	for ( ii = 0; ii < started; ++ii )
+		pthread_join(tids[ii], NULL);
+	pthread_mutex_destroy(&wp->lock);
+#else
+	hashFiles(wp);
+#endif
+}
+
+/**
+ * Write a string as JSON.
+ * @param fp - where to write it.
+ * @param str - the string.
+ * @return nothing
+ */
+static void jsonStr(FILE *fp, const char *str)
+{
+	putc('"', fp);
+	for ( ; *str; ++str )
+	{
+		if ( *str == '"' || *str == '\\' )
+			fprintf(fp, "\\%c", *str);
+		else if ( (unsigned char)*str < ' ' )
+			fprintf(fp, "\\u%04x", (unsigned char)*str);
+		else
+			putc(*str, fp);
+	}
+	putc('"', fp);
+}
+
+/**
+ * Write the manifest.
+ * @param options - pointer to options.
+ * @param fp - where to write it.
+ * @param ents - pointer to files.
+ * @param num - number of files.
+ * @return nothing
+ */
+static void writeManifest(Options_t *options, FILE *fp, const ManEnt_t *ents, int num)
+{
+	char date[INSTR_LEN], crc[9], acrc[9], sha[65], asha[65];
+	const ManEnt_t *ep;
+	int ii, doCrc, doSha;
+
+	doCrc = (options->manOpts & MANOPTS_CRC);
+	doSha = (options->manOpts & MANOPTS_SHA);
+	if ( (options->manOpts & MANOPTS_CSV) )
+		fprintf(fp, "name,blocks,date,lba,crc32c,sha256,ascii_crc32c,ascii_sha256\n");
+	else
+	{
+		fprintf(fp, "{\n  \"container\": ");
+		jsonStr(fp, options->container);
+		fprintf(fp, ",\n  \"files\": [\n");
+	}
+	for ( ii = 0, ep = ents; ii < num; ++ii, ++ep )
+	{
+		dateIso(date, ep->date);
+		sprintf(crc, "%08lx", (unsigned long)ep->crc);
+		sprintf(acrc, "%08lx", (unsigned long)ep->asciiCrc);
+		hexStr(sha, ep->sha, 32);
+		hexStr(asha, ep->asciiSha, 32);
+		if ( (options->manOpts & MANOPTS_CSV) )
+		{
+			fprintf(fp, "%s,%d,%s,%d,%s,%s,%s,%s\n", ep->ffull, ep->blocks, date, ep->lba,
+					doCrc ? crc : "", doSha ? sha : "",
+					doCrc && ep->ascii ? acrc : "", doSha && ep->ascii ? asha : "");
+			continue;
+		}
+		/* One file per line so it's easy to read back in (and to diff) */
+		fprintf(fp, "    {\"name\": \"%s\", \"blocks\": %d, \"date\": \"%s\", \"lba\": %d",
+				ep->ffull, ep->blocks, date, ep->lba);
+		if ( doCrc )
+			fprintf(fp, ", \"crc32c\": \"%s\"", crc);
+		if ( doSha )
+			fprintf(fp, ", \"sha256\": \"%s\"", sha);
+		if ( doCrc && ep->ascii )
+			fprintf(fp, ", \"ascii_crc32c\": \"%s\"", acrc);
+		if ( doSha && ep->ascii )
+			fprintf(fp, ", \"ascii_sha256\": \"%s\"", asha);
+		fprintf(fp, "}%s\n", ii + 1 < num ? "," : "");
+	}
+	if ( !(options->manOpts & MANOPTS_CSV) )
+		fprintf(fp, "  ]\n}\n");
+}
+
+/**
+ * Get a value from a line of a JSON manifest as written by writeManifest().
+ * @param line - the line.
+ * @param key - name of value.
+ * @param dst - where to put it.
+ * @param dstLen - size of dst.
+ * @return 1 if found, 0 if not.
+ */
+static int jsonValue(const char *line, const char *key, char *dst, int dstLen)
+{
+	const char *cp;
+	int len = strlen(key), ii;
+
+	for ( cp = strchr(line, '"'); cp; cp = strchr(cp + 1, '"') )
+	{
+		if ( !strncmp(cp + 1, key, len) && cp[len + 1] == '"' )
+			break;
+	}
+	if ( !cp )
+		return 0;
+	cp += len + 2;
+	while ( *cp == ' ' || *cp == ':' )
+		++cp;
+	if ( *cp == '"' )
+		++cp;
+	for ( ii = 0; ii < dstLen - 1 && *cp && *cp != '"' && *cp != ',' && *cp != '}'; ++ii )
+		dst[ii] = *cp++;
+	dst[ii] = 0;
+	return 1;
+}
+
+/**
+ * Get a field from a line of a CSV manifest.
+ * @param line - the line.
+ * @param col - which field (0 is the first).
+ * @param dst - where to put it.
+ * @param dstLen - size of dst.
+ * @return 1 if found, 0 if not.
+ */
+static int csvValue(const char *line, int col, char *dst, int dstLen)
+{
+	int ii;
+
+	for ( ; col > 0 && line; --col )
+	{
+		line = strchr(line, ',');
+		if ( line )
+			++line;
+	}
+	if ( col < 0 || !line )
+		return 0;
+	for ( ii = 0; ii < dstLen - 1 && *line && *line != ',' && *line != '\n' && *line != '\r'; ++ii )
+		dst[ii] = *line++;
+	dst[ii] = 0;
+	return 1;
+}
+
+/** The fields a manifest can have (in the order of the CSV header) */
+static const char *const ManKeys[] =
+{
+	"name", "blocks", "date", "lba", "crc32c", "sha256", "ascii_crc32c", "ascii_sha256"
+};
+#define MAN_KEY_NAME   (0)
+#define MAN_KEY_BLOCKS (1)
+#define MAN_KEY_HASHES (4)  /* The ones from here on are hashes */
+#define MAN_NUM_KEYS   (8)
+
+/**
+ * Check the files against a manifest.
+ * @param options - pointer to options.
+ * @param ents - pointer to files (sorted by name).
+ * @param num - number of files.
+ * @return 0 if everything matched; 1 if not.
+ */
+static int checkManifest(Options_t *options, ManEnt_t *ents, int num)
+{
+	char line[512], vals[MAN_NUM_KEYS][65], mine[65], date[INSTR_LEN];
+	int csvCols[MAN_NUM_KEYS], csv = 0, lineNo = 0, bad = 0, good = 0, ii, kk, found;
+	InWorkingDir_t wd;
+	ManEnt_t key, *ep;
+	FILE *fp;
+
+	fp = fopen(options->manCheck, "r");
+	if ( !fp )
+	{
+		msgErr(options, "Unable to open '%s': %s\n", options->manCheck, strerror(errno));
+		return 1;
+	}
+	memset(&wd, 0, sizeof(wd));
+	wd.rt11.control = PERM;
+	while ( fgets(line, sizeof(line), fp) )
+	{
+		++lineNo;
+		if ( !csv && !strncmp(line, "name,", 5) )
+		{
+			/* CSV header says which column is which */
+			for ( kk = 0; kk < MAN_NUM_KEYS; ++kk )
+			{
+				csvCols[kk] = -1;
+				for ( ii = 0; csvValue(line, ii, mine, sizeof(mine)); ++ii )
+				{
+					if ( !strcmp(mine, ManKeys[kk]) )
+						csvCols[kk] = ii;
+				}
+			}
+			csv = 1;
+			continue;
+		}
+		for ( kk = found = 0; kk < MAN_NUM_KEYS; ++kk )
+		{
+			vals[kk][0] = 0;
+			if ( csv )
+				found += csvValue(line, csvCols[kk], vals[kk], sizeof(vals[kk]));
+			else
+				found += jsonValue(line, ManKeys[kk], vals[kk], sizeof(vals[kk]));
+		}
+		if ( !vals[MAN_KEY_NAME][0] )
+			continue;
+		/* Only the files that were asked for */
+		if ( r50EncodeName(wd.rt11.name, vals[MAN_KEY_NAME]) )
+		{
+			msgErr(options, "Line %d of '%s': bad filename '%s'\n", lineNo, options->manCheck, vals[MAN_KEY_NAME]);
+			++bad;
+			continue;
+		}
+		r50DecodeName(wd.ffull, wd.rt11.name);
+		wd.rt11.blocks = atoi(vals[MAN_KEY_BLOCKS]);
+		if ( !selectDirEnt(options, &wd) )
+			continue;
+		strcpy(key.ffull, wd.ffull);
+		ep = num ? (ManEnt_t *)bsearch(&key, ents, num, sizeof(ManEnt_t), cmpName) : NULL;
+		if ( !ep )
+		{
+			printf("missing: %s\n", wd.ffull);
+			++bad;
+			continue;
+		}
+		ep->checked = 1;
+		if ( ep->err )
+		{
+			++bad;
+			continue;
+		}
+		found = 0;
+		if ( ep->blocks != wd.rt11.blocks )
+		{
+			printf("changed: %s is %d blocks, not %d\n", ep->ffull, ep->blocks, wd.rt11.blocks);
+			++bad;
+			continue;
+		}
+		/* Check every hash both have */
+		for ( kk = MAN_KEY_HASHES; kk < MAN_NUM_KEYS; ++kk )
+		{
+			if ( !vals[kk][0] )
+				continue;
+			if ( kk == MAN_KEY_HASHES + 2 || kk == MAN_KEY_HASHES + 3 )
+			{
+				if ( !ep->ascii )
+					continue;
+			}
+			if ( kk == MAN_KEY_HASHES || kk == MAN_KEY_HASHES + 2 )
+			{
+				if ( !(options->manOpts & MANOPTS_CRC) )
+					continue;
+				sprintf(mine, "%08lx", (unsigned long)(kk == MAN_KEY_HASHES ? ep->crc : ep->asciiCrc));
+			}
+			else
+			{
+				if ( !(options->manOpts & MANOPTS_SHA) )
+					continue;
+				hexStr(mine, kk == MAN_KEY_HASHES + 1 ? ep->sha : ep->asciiSha, 32);
+			}
+			for ( ii = 0; vals[kk][ii]; ++ii )
+				vals[kk][ii] = tolower((unsigned char)vals[kk][ii]);
+			if ( strcmp(mine, vals[kk]) )
+			{
+				printf("changed: %s %s is %s, not %s\n", ep->ffull, ManKeys[kk], mine, vals[kk]);
+				found = -1;
+				break;
+			}
+			++found;
+		}
+		if ( found < 0 )
+			++bad;
+		else if ( !found )
+		{
+			printf("unchecked: %s (no hash in '%s' to check)\n", ep->ffull, options->manCheck);
+			++bad;
+		}
+		else
+		{
+			++good;
+			if ( (options->manOpts & MANOPTS_VERB) || options->verbose )
+				printf("ok:      %s\n", ep->ffull);
+		}
+	}
+	fclose(fp);
+	for ( ii = 0, ep = ents; ii < num; ++ii, ++ep )
+	{
+		if ( !ep->checked )
+		{
+			printf("extra:   %s (%d blocks %s)\n", ep->ffull, ep->blocks, dateIso(date, ep->date));
+			++bad;
+		}
+	}
+	if ( (options->manOpts & MANOPTS_VERB) || options->verbose )
+		printf("%d file%s matched, %d didn't.\n", good, good == 1 ? "" : "s", bad);
+	return bad ? 1 : 0;
+}
+
+/**
+ * Write a manifest of the selected files in the container (or check the container
+ * against the one in options->manCheck).
+ * @param options - pointer to options.
+ * @return 0 if success (and everything matched); 1 if not.
+ */
+int do_manifest(Options_t *options)
+{
+	ManWork_t work;
+	ManEnt_t *ep;
+	InWorkingDir_t *wdp;
+	FILE *fp = stdout;
+	int ii, sts = 0;
+
+	if ( !(options->manOpts & (MANOPTS_CRC | MANOPTS_SHA)) )
+		options->manOpts |= MANOPTS_CRC | MANOPTS_SHA;
+	memset(&work, 0, sizeof(work));
+	work.options = options;
+	work.ents = (ManEnt_t *)calloc(options->numWdirs + 1, sizeof(ManEnt_t));
+	if ( !work.ents )
+	{
+		msgErr(options, "Ran out of memory for %d files: %s\n", options->numWdirs, strerror(errno));
+		return 1;
+	}
+	for ( ii = 0, wdp = options->wDirArray; ii < options->numWdirs; ++ii, ++wdp )
+	{
+		if ( !(wdp->rt11.control & PERM) || !selectDirEnt(options, wdp) )
+			continue;
+		ep = work.ents + work.num++;
+		strcpy(ep->ffull, wdp->ffull);
+		memcpy(ep->name, wdp->rt11.name, sizeof(ep->name));
+		ep->blocks = wdp->rt11.blocks;
+		ep->date = wdp->rt11.date;
+		ep->lba = wdp->lba;
+		ep->ascii = isAsciiType(options, wdp->ffull);
+	}
+	qsort(work.ents, work.num, sizeof(ManEnt_t), cmpName);
+	hashAll(&work);
+	/* The threads don't touch options so count (and complain) here */
+	for ( ii = 0, ep = work.ents; ii < work.num; ++ii, ++ep )
+	{
+		if ( ep->err )
+		{
+			msgErr(options, "Error reading '%s' at block %d of '%s': %s\n",
+					ep->ffull, ep->errBlk, options->container, strerror(ep->err));
+			sts = 1;
+		}
+		else if ( !options->floppyImageUnscrambled )
+			statCount(options, STAT_IO_CONT, 0, (long)ep->blocks * BLKSIZ);
+	}
+	if ( options->manCheck )
+	{
+		if ( checkManifest(options, work.ents, work.num) )
+			sts = 1;
+	}
+	else
+	{
+		if ( options->manOutput && strcmp(options->manOutput, "-") )
+		{
+			fp = fopen(options->manOutput, "w");
+			if ( !fp )
+			{
+				msgErr(options, "Unable to create '%s': %s\n", options->manOutput, strerror(errno));
+				free(work.ents);
+				return 1;
+			}
+		}
+		writeManifest(options, fp, work.ents, work.num);
+		if ( fp != stdout && fclose(fp) )
+		{
+			msgErr(options, "Error writing '%s': %s\n", options->manOutput, strerror(errno));
+			sts = 1;
+		}
+		if ( (options->manOpts & MANOPTS_VERB) && fp != stdout )
+			printf("Wrote %d file%s to '%s'\n", work.num, work.num == 1 ? "" : "s", options->manOutput);
+	}
+	free(work.ents);
+	return sts;
+}
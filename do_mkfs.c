@@ -0,0 +1,518 @@
+/*  $Id: do_mkfs.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $
+
+	do_mkfs.c - Make a new container holding the files in a host directory.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MINGW
+	#define _POSIX_C_SOURCE 200112L
+#endif
+#include "rtpip.h"
+#include <dirent.h>
+#ifndef MINGW
+	#include <fcntl.h>
+#endif
+
+/**
+ * @file do_mkfs.c
+ * Make a new container holding the files in a host directory. Called from rtpip.
+ */
+
+/*
+ * Note: Unlike new followed by in, nothing is looked up or moved around. The
+ * whole layout is worked out first: the files go one after the other in name
+ * order right after the directory, with one empty area after the last one, and
+ * the directory entries are spread evenly over the segments (leaving room in
+ * each for files added later). Then the boot blocks, home block and directory
+ * are written once, the files are copied in one pass from front to back and the
+ * rest of the container is left as a hole. It is all done in a temporary file
+ * that replaces the container only if everything worked.
+ */
+
+/**
+ * Compare two files by RT11 name (for qsort).
+ * @param a - pointer to one HostFile_t.
+ * @param b - pointer to the other.
+ * @return <0, 0 or >0.
+ */
+static int cmpName(const void *a, const void *b)
+{
+	return strcmp(((const HostFile_t *)a)->ffull, ((const HostFile_t *)b)->ffull);
+}
+
+/**
+ * Free a list of host files.
+ * @param ents - pointer to list (from hostDirScan()).
+ * @param num - number of entries.
+ * @return nothing
+ */
+void hostDirFree(HostFile_t *ents, int num)
+{
+	int ii;
+
+	for ( ii = 0; ii < num; ++ii )
+	{
+		free(ents[ii].path);
+		free(ents[ii].text);
+	}
+	free(ents);
+}
+
+/**
+ * Get a file from hostDirScan() ready to copy in, as readInpFile() would. Text
+ * converted by the scan is handed over rather than read again.
+ * @param options - pointer to options (inOpts set for the file as for readInpFile()).
+ * @param ep - pointer to file.
+ * @return 0 if success, 1 if failure
+ */
+int hostFileRead(Options_t *options, HostFile_t *ep)
+{
+	InHandle_t *ihp = &options->iHandle;
+
+	if ( !ep->text )
+		return readInpFile(options, ep->path);
+	free(ihp->inFileBuf);
+	ihp->inFileBuf = ep->text;
+	ihp->inFileBufSize = ep->blocks * BLKSIZ;
+	ihp->fileBlks = ep->blocks;
+	ihp->directName = NULL;
+	ep->text = NULL;
+	return 0;
+}
+
+/**
+ * Get the list of files in options->hostDir and size each one as it will be in the container.
+ * @param options - pointer to options.
+ * @param entsP - where to put the pointer to the list (sorted by RT11 name).
+ * @param numP - where to put the number of files.
+ * @return 0 if success; 1 if failure (nothing is returned).
+ */
+int hostDirScan(Options_t *options, HostFile_t **entsP, int *numP)
+{
+	DIR *dp;
+	struct dirent *de;
+	struct stat st;
+	HostFile_t *ents = NULL, *ep;
+	int num = 0, max = 0, sts = 0, ii;
+
+	dp = opendir(options->hostDir);
+	if ( !dp )
+	{
+		msgErr(options, "Unable to open directory '%s': %s\n", options->hostDir, strerror(errno));
+		return 1;
+	}
+	while ( (de = readdir(dp)) )
+	{
+		char *path;
+
+		if ( de->d_name[0] == '.' )
+			continue;
+		path = (char *)malloc(strlen(options->hostDir) + strlen(de->d_name) + 2);
+		if ( !path )
+		{
+			msgErr(options, "Ran out of memory for filename '%s': %s\n", de->d_name, strerror(errno));
+			sts = 1;
+			break;
+		}
+		sprintf(path, "%s/%s", options->hostDir, de->d_name);
+		if ( stat(path, &st) || !S_ISREG(st.st_mode) )
+		{
+			/* Subdirectories and such are left out */
+			if ( (options->newOpts & NEWOPTS_VERB) || (options->syncOpts & SYNCOPTS_VERB)
+				 || (options->diffOpts & DIFFOPTS_VERB) || options->verbose )
+				printf("Skipped '%s': not a file\n", path);
+			free(path);
+			continue;
+		}
+		if ( cvtName(options, path) )
+		{
+			free(path);
+			sts = 1;
+			continue;
+		}
+		if ( num >= max )
+		{
+			ep = (HostFile_t *)realloc(ents, (max + 256) * sizeof(HostFile_t));
+			if ( !ep )
+			{
+				msgErr(options, "Ran out of memory for %d files: %s\n", max + 256, strerror(errno));
+				free(path);
+				sts = 1;
+				break;
+			}
+			ents = ep;
+			max += 256;
+		}
+		ep = ents + num++;
+		memset(ep, 0, sizeof(HostFile_t));
+		ep->path = path;
+		ep->hostSize = st.st_size;
+		ep->hostTime = st.st_mtime;
+		ep->name[0] = options->iHandle.iNameR50[0];
+		ep->name[1] = options->iHandle.iNameR50[1];
+		ep->name[2] = options->iHandle.iNameR50[2];
+		r50DecodeName(ep->ffull, ep->name);
+		ep->ascii = isAsciiType(options, ep->ffull);
+		if ( ep->ascii )
+		{
+			/* Only converting it tells how big it will be, so keep what that makes for hostFileRead() */
+			options->inOpts = INOPTS_ASC;
+			statBegin(options, STAT_PH_HOSTIN);
+			ii = readInpFile(options, path);
+			statEnd(options, STAT_PH_HOSTIN);
+			if ( ii )
+			{
+				sts = 1;
+				continue;
+			}
+			ep->blocks = options->iHandle.fileBlks;
+			ep->text = options->iHandle.inFileBuf;
+			options->iHandle.inFileBuf = NULL;
+			options->iHandle.inFileBufSize = 0;
+		}
+		else
+			ep->blocks = (st.st_size + BLKSIZ - 1) / BLKSIZ;
+		if ( (options->fileOpts & FILEOPTS_TIMESTAMP) )
+			ep->date = timeToDate(st.st_ctime);
+		else
+			ep->date = (1 << 10) | (1 << 5);
+	}
+	closedir(dp);
+	if ( !sts && num )
+	{
+		qsort(ents, num, sizeof(HostFile_t), cmpName);
+		for ( ii = 1; ii < num; ++ii )
+		{
+			if ( !memcmp(ents[ii - 1].name, ents[ii].name, sizeof(ents[ii].name)) )
+			{
+				msgErr(options, "'%s' and '%s' would both be %s\n", ents[ii - 1].path, ents[ii].path, ents[ii].ffull);
+				sts = 1;
+			}
+		}
+	}
+	if ( sts )
+	{
+		hostDirFree(ents, num);
+		return 1;
+	}
+	*entsP = ents;
+	*numP = num;
+	return 0;
+}
+
+/**
+ * Fill in the directory segments.
+ * @param options - pointer to options.
+ * @param segs - pointer to maxSeg segments of 0's.
+ * @param maxSeg - number of segments.
+ * @param perSeg - number of entries to put in each segment.
+ * @param ents - pointer to list of files.
+ * @param num - number of files.
+ * @param left - number of blocks left over after the last file.
+ * @return nothing
+ */
+static void fillSegments(Options_t *options, U8 *segs, int maxSeg, int perSeg, const HostFile_t *ents, int num, int left)
+{
+	Rt11SegEnt_t *segptr = NULL;
+	Rt11DirEnt_t *dirptr = NULL;
+	int ii, lba, segNo = 0, inSeg = 0, numEnts;
+
+	lba = options->seg1LBA + maxSeg * BLKS_P_SEGMENT;
+	numEnts = num + (left ? 1 : 0);
+	for ( ii = 0; ii < numEnts; ++ii )
+	{
+		if ( !segptr || inSeg >= perSeg )
+		{
+			if ( segptr )
+			{
+				dirptr->control = ENDBLK;
+				segptr->link = segNo + 1;
+			}
+			segptr = (Rt11SegEnt_t *)(segs + segNo * SEGSIZ);
+			++segNo;
+			segptr->smax = maxSeg;
+			segptr->start = lba;
+			dirptr = (Rt11DirEnt_t *)(segptr + 1);
+			inSeg = 0;
+		}
+		if ( ii < num )
+		{
+			dirptr->control = PERM;
+			dirptr->name[0] = ents[ii].name[0];
+			dirptr->name[1] = ents[ii].name[1];
+			dirptr->name[2] = ents[ii].name[2];
+			dirptr->blocks = ents[ii].blocks;
+			dirptr->date = ents[ii].date;
+		}
+		else
+		{
+			dirptr->control = EMPTY;
+			dirptr->blocks = left;
+		}
+		lba += dirptr->blocks;
+		++dirptr;
+		++inSeg;
+	}
+	dirptr->control = ENDBLK;
+	/* Only the first segment has to have the right number in use */
+	((Rt11SegEnt_t *)segs)->last = segNo;
+}
+
+/**
+ * Copy the files into the container (or the unscrambled floppy image) one after the other.
+ * @param options - pointer to options.
+ * @param ents - pointer to list of files.
+ * @param num - number of files.
+ * @param lba - where the first one goes.
+ * @return 0 if success; 1 if failure.
+ */
+static int copyFiles(Options_t *options, HostFile_t *ents, int num, int lba)
+{
+	InHandle_t *ihp = &options->iHandle;
+	InWorkingDir_t wd;
+	int ii, retv;
+	U64 traceStart;
+
+	memset(&wd, 0, sizeof(wd));
+	for ( ii = 0; ii < num; lba += ents[ii].blocks, ++ii )
+	{
+		TRACE_START(options, traceStart);
+		if ( cvtName(options, ents[ii].path) )
+			return 1;
+		options->inOpts = ents[ii].ascii ? INOPTS_ASC : 0;
+		statBegin(options, STAT_PH_HOSTIN);
+		retv = hostFileRead(options, ents + ii);
+		statEnd(options, STAT_PH_HOSTIN);
+		if ( retv )
+			return 1;
+		if ( ihp->fileBlks != ents[ii].blocks )
+		{
+			msgErr(options, "'%s' changed size while the container was being made\n", ents[ii].path);
+			return 1;
+		}
+		if ( options->floppyImageUnscrambled )
+			memcpy(options->floppyImageUnscrambled + lba * BLKSIZ, ihp->inFileBuf, ihp->fileBlks * BLKSIZ);
+		else
+		{
+			wd.rt11.blocks = ents[ii].blocks;
+			wd.lba = lba;
+			if ( writeFileToContainer(options, &wd) )
+				return 1;
+		}
+		if ( (options->newOpts & NEWOPTS_VERB) || options->verbose )
+			printf("Copied '%s' to '%s'%s, %d blocks at LBA %d\n",
+				   ents[ii].path, ents[ii].ffull, ents[ii].ascii ? " as text" : "", ents[ii].blocks, lba);
+		TRACE_FILE(options, "mkfs", traceStart, ents[ii].path, lba, ents[ii].blocks, (long)ents[ii].blocks * BLKSIZ);
+	}
+	return 0;
+}
+
+/**
+ * Make a new container holding all the files in a host directory.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure.
+ */
+int do_mkfs(Options_t *options)
+{
+	HostFile_t *ents;
+	int num, ii, used, blocks, maxSeg, dirBlks, numdent, numEnts, perSeg, isFloppy, hdrSize, sts;
+	char *tmpName;
+	struct stat st;
+	U8 *hdr;
+	FILE *fp;
+
+	isFloppy = (options->cmdOpts & (CMDOPT_DOUBLE_FLPY | CMDOPT_SINGLE_FLPY)) ? 1 : 0;
+	if ( isFloppy && options->newDiskSize )
+	{
+		msgErr(options, "The size of a floppy image is fixed. Cannot use --blocks with -f or -F\n");
+		return 1;
+	}
+	if ( hostDirScan(options, &ents, &num) )
+		return 1;
+	for ( used = ii = 0; ii < num; ++ii )
+		used += ents[ii].blocks;
+	/* Enough segments to have them half full, but no fewer than new would make */
+	numdent = (SEGSIZ - SEGLEN) / DIRLEN;
+	maxSeg = options->newMaxSeg;
+	if ( !maxSeg )
+	{
+		maxSeg = (num + 1 + numdent / 2 - 1) / (numdent / 2);
+		ii = 4 + (options->newDiskSize ? options->newDiskSize : used) / 1000;
+		if ( maxSeg < ii )
+			maxSeg = ii;
+		if ( maxSeg > MAXSEGMENTS - 1 )
+			maxSeg = MAXSEGMENTS - 1;
+		if ( (options->cmdOpts & CMDOPT_SINGLE_FLPY) && maxSeg > MAX_SGL_FLPY_SEGS )
+			maxSeg = MAX_SGL_FLPY_SEGS;
+		if ( (options->cmdOpts & CMDOPT_DOUBLE_FLPY) && maxSeg > MAX_DBL_FLPY_SEGS )
+			maxSeg = MAX_DBL_FLPY_SEGS;
+	}
+	dirBlks = options->seg1LBA + maxSeg * BLKS_P_SEGMENT;
+	if ( isFloppy )
+	{
+		options->floppyImageSize = NUM_SECTORS * NUM_TRACKS * ((options->cmdOpts & CMDOPT_SINGLE_FLPY) ? 128 : 256);
+		blocks = NUM_SECTORS * (NUM_TRACKS - 1) * ((options->cmdOpts & CMDOPT_SINGLE_FLPY) ? 128 : 256) / BLKSIZ;
+	}
+	else if ( options->newDiskSize )
+		blocks = options->newDiskSize;
+	else
+	{
+		/* Just big enough, but no smaller than new allows */
+		blocks = dirBlks + used;
+		if ( blocks < 400 )
+			blocks = 400;
+	}
+	if ( options->seg1LBA <= HOME_BLK_LBA || dirBlks + used > blocks || blocks > 65535 )
+	{
+		msgErr(options, "%d files of %d blocks and %d segments need %d blocks. The container can have %d.\n",
+			   num, used, maxSeg, dirBlks + used, blocks > 65535 ? 65535 : blocks);
+		hostDirFree(ents, num);
+		return 1;
+	}
+	numEnts = num + (blocks > dirBlks + used ? 1 : 0);
+	perSeg = (numEnts + maxSeg - 1) / maxSeg;
+	if ( perSeg >= numdent
+		 || ((options->cmdOpts & CMDOPT_SINGLE_FLPY) && maxSeg > MAX_SGL_FLPY_SEGS)
+		 || ((options->cmdOpts & CMDOPT_DOUBLE_FLPY) && maxSeg > MAX_DBL_FLPY_SEGS) )
+	{
+		msgErr(options, "ERROR: Too many files (%d) to fit in %d segments at %d files each\n", num, maxSeg, numdent - 1);
+		hostDirFree(ents, num);
+		return 1;
+	}
+	if ( (options->newOpts & NEWOPTS_VERB) || options->verbose || (options->cmdOpts & CMDOPT_NOWRITE) )
+		printf("%s'%s': %d blocks, %d segments of %d entries, %d files of %d blocks, %d blocks free\n",
+			   (options->cmdOpts & CMDOPT_NOWRITE) ? "Would have made " : "Making ",
+			   options->container, blocks, maxSeg, perSeg, num, used, blocks - dirBlks - used);
+	if ( (options->cmdOpts & CMDOPT_NOWRITE) )
+	{
+		hostDirFree(ents, num);
+		return 0;
+	}
+	if ( !stat(options->container, &st) && !(options->newOpts & NEWOPTS_NOASK) )
+	{
+		char prompt[128];
+
+		snprintf(prompt, sizeof(prompt) - 1, "Replace existing '%s'?", options->container);
+		if ( getYN(prompt, YN_NO) != YN_YES )
+		{
+			hostDirFree(ents, num);
+			return 1;
+		}
+	}
+	/* Boot blocks, home block and directory */
+	hdrSize = dirBlks * BLKSIZ;
+	if ( isFloppy )
+	{
+		options->floppyImage = (U8 *)calloc(2, options->floppyImageSize);
+		options->floppyImageUnscrambled = options->floppyImage + options->floppyImageSize;
+		hdr = options->floppyImageUnscrambled;
+	}
+	else
+		hdr = (U8 *)calloc(hdrSize, 1);
+	tmpName = (char *)malloc(strlen(options->container) + 5);
+	if ( !hdr || !tmpName )
+	{
+		msgErr(options, "Ran out of memory getting a %d byte buffer: %s\n",
+			   isFloppy ? 2 * options->floppyImageSize : hdrSize, strerror(errno));
+		if ( !isFloppy )
+			free(hdr);
+		free(tmpName);
+		hostDirFree(ents, num);
+		return 1;
+	}
+	newBootBlocks(options, hdr);
+	fillSegments(options, hdr + options->seg1LBA * BLKSIZ, maxSeg, perSeg, ents, num, blocks - dirBlks - used);
+	strcpy(tmpName, options->container);
+	strcat(tmpName, "-tmp");
+	fp = statFopen(options, STAT_IO_CONT, tmpName, "wb+");
+	if ( !fp )
+	{
+		msgErr(options, "Error creating temp file '%s' for write: %s\n", tmpName, strerror(errno));
+		if ( !isFloppy )
+			free(hdr);
+		free(tmpName);
+		hostDirFree(ents, num);
+		return 1;
+	}
+	sts = 0;
+	if ( !isFloppy && statFwrite(options, STAT_IO_CONT, hdr, 1, hdrSize, fp) != hdrSize )
+	{
+		msgErr(options, "Error writing %d blocks to '%s': %s\n", dirBlks, tmpName, strerror(errno));
+		sts = 1;
+	}
+	if ( !isFloppy )
+		free(hdr);
+	/* The files (writeFileToContainer() writes to options->inp) */
+	options->inp = fp;
+	options->openedWrite = 1;
+	statBegin(options, STAT_PH_COPY);
+	if ( !sts )
+		sts = copyFiles(options, ents, num, dirBlks);
+	statEnd(options, STAT_PH_COPY);
+	options->inp = NULL;
+	options->openedWrite = 0;
+	hostDirFree(ents, num);
+	if ( !sts && isFloppy )
+	{
+		rescramble(options, NULL);
+		if ( statFwrite(options, STAT_IO_CONT, options->floppyImage, 1, options->floppyImageSize, fp) != options->floppyImageSize )
+		{
+			msgErr(options, "Error writing %d bytes to '%s': %s\n", options->floppyImageSize, tmpName, strerror(errno));
+			sts = 1;
+		}
+	}
+	if ( !sts && fflush(fp) )
+	{
+		msgErr(options, "Error writing to '%s': %s\n", tmpName, strerror(errno));
+		sts = 1;
+	}
+	if ( !sts && !isFloppy )
+	{
+		/* Whatever is after the last file reads as zeros without being written */
+		if ( ftruncate(fileno(fp), (off_t)blocks * BLKSIZ) )
+		{
+			msgErr(options, "Error setting size of '%s' to %d blocks: %s\n", tmpName, blocks, strerror(errno));
+			sts = 1;
+		}
+#ifndef MINGW
+		else if ( (options->newOpts & NEWOPTS_PREALLOC) && (ii = posix_fallocate(fileno(fp), 0, (off_t)blocks * BLKSIZ)) )
+		{
+			msgErr(options, "Error allocating %d blocks for '%s': %s\n", blocks, tmpName, strerror(ii));
+			sts = 1;
+		}
+#endif
+	}
+	if ( fclose(fp) && !sts )
+	{
+		msgErr(options, "Error closing '%s': %s\n", tmpName, strerror(errno));
+		sts = 1;
+	}
+#ifdef MINGW
+	/* Can't rename over an existing file */
+	if ( !sts )
+		unlink(options->container);
+#endif
+	if ( !sts && rename(tmpName, options->container) )
+	{
+		msgErr(options, "Error renaming '%s' to '%s': %s\n", tmpName, options->container, strerror(errno));
+		sts = 1;
+	}
+	if ( sts )
+		unlink(tmpName);
+	free(tmpName);
+	return sts;
+}
@@ -18,6 +18,9 @@
 	along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#ifndef MINGW
+	#define _POSIX_C_SOURCE 200112L
+#endif
 #include "rtpip.h"
 
 #if MSYS2 || MINGW
@@ -50,7 +53,7 @@ static int doChDir(Options_t *options)
 			ii = MKDIR(options->outDir, 0775);
 			if ( ii )
 			{
-				fprintf(stderr, "Unable to create directory '%s': %s\n",
+				msgErr(options, "Unable to create directory '%s': %s\n",
 						options->outDir, strerror(errno));
 				return 1;
 			}
@@ -77,21 +80,247 @@ static int doChDir(Options_t *options)
 					}
 					return 0;
 				}
-				fprintf(stderr, "Unable to chdir() to '%s': %s\n",
+				msgErr(options, "Unable to chdir() to '%s': %s\n",
 						options->outDir, strerror(errno));
 				return 1;
 			}
-			fprintf(stderr, "'%s' is not a directory\n", options->outDir);
+			msgErr(options, "'%s' is not a directory\n", options->outDir);
 			return 1;
 		}
 		printf("Would have changed directory to '%s'\n", options->outDir);
 		return 0;
 	}
-	fprintf(stderr, "Internal error with doChDir(): '%s'\n",
+	msgErr(options, "Internal error with doChDir(): '%s'\n",
 			strerror(errno));
 	return 1;
 }
 
+/**
+ * Set the timestamp of a file copied out to the date in the container.
+ * @param options - pointer to options.
+ * @param wdp - pointer to directory entry of file.
+ * @return nothing
+ */
+static void setTimeStamp(Options_t *options, InWorkingDir_t *wdp)
+{
+	struct utimbuf uTime;
+
+	uTime.actime = time(NULL);
+	uTime.modtime = dateToTime(wdp->rt11.date);
+	if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
+	{
+		printf("do_out(): preserve timestamp: file '%s', bDate=0x%04X, age=%d, time=%s",
+			   wdp->ffull, wdp->rt11.date, (wdp->rt11.date >> 14) & 3, ctime(&uTime.modtime));
+	}
+	utime(wdp->ffull, &uTime);
+}
+
+#define ASCII_CHUNK_BLKS (64)   /* Blocks read at a time when copying ascii files out */
+
+/**
+ * Copy an ascii file out of a hard disk container a piece at a time.
+ * @param options - pointer to options.
+ * @param wdp - pointer to directory entry of file.
+ * @return number of bytes written (or would have been) or -1 on error. Error message will have been displayed.
+ */
+static int streamAsciiOut(Options_t *options, InWorkingDir_t *wdp)
+{
+	char *iBuf, *oBuf;
+	FILE *oFile = NULL;
+	AsciiStrip_t as;
+	int blk, nBlks, retv, outLen, total = 0;
+
+	iBuf = (char *)malloc(ASCII_CHUNK_BLKS * BLKSIZ);
+	oBuf = (char *)malloc(ASCII_CHUNK_BLKS * BLKSIZ + 1);
+	if ( !iBuf || !oBuf )
+	{
+		msgErr(options, "Ran out of memory allocating %d bytes to read '%s'\n",
+				2 * ASCII_CHUNK_BLKS * BLKSIZ + 1, wdp->ffull);
+		free(iBuf);
+		free(oBuf);
+		return -1;
+	}
+	retv = statFseek(options, STAT_IO_CONT, options->inp, wdp->lba * BLKSIZ, SEEK_SET);
+	if ( retv < 0 || ferror(options->inp) || (ftell(options->inp) != wdp->lba * BLKSIZ) )
+	{
+		msgErr(options, "Unable to seek to %d in input '%s': %s\n",
+				wdp->lba, options->container, strerror(errno));
+		free(iBuf);
+		free(oBuf);
+		return -1;
+	}
+	if ( !(options->cmdOpts & CMDOPT_NOWRITE) )
+	{
+		oFile = statFopen(options, STAT_IO_HOST, wdp->ffull, "wb");
+		if ( !oFile )
+		{
+			msgErr(options, "Unable to open '%s' for output: %s\n",
+					wdp->ffull, strerror(errno));
+			free(iBuf);
+			free(oBuf);
+			return -1;
+		}
+	}
+	asciiStripInit(&as);
+	for ( blk = 0; blk < wdp->rt11.blocks && !as.done; blk += nBlks )
+	{
+		nBlks = wdp->rt11.blocks - blk;
+		if ( nBlks > ASCII_CHUNK_BLKS )
+			nBlks = ASCII_CHUNK_BLKS;
+		retv = statFread(options, STAT_IO_CONT, iBuf, 1, nBlks * BLKSIZ, options->inp);
+		if ( retv != nBlks * BLKSIZ )
+		{
+			msgErr(options, "Error reading %d bytes from '%s' starting at LBA %d. Read %d: %s\n",
+					nBlks * BLKSIZ, options->container, wdp->lba + blk, retv, strerror(errno));
+			total = -1;
+			break;
+		}
+		outLen = asciiStripCR(&as, iBuf, retv, oBuf);
+		if ( blk + nBlks >= wdp->rt11.blocks )
+			outLen += asciiStripFinish(&as, oBuf + outLen);
+		if ( oFile && outLen && (retv = statFwrite(options, STAT_IO_HOST, oBuf, 1, outLen, oFile)) != outLen )
+		{
+			msgErr(options, "Error writing %d bytes to '%s'. Wrote %d. '%s'\n",
+					outLen, wdp->ffull, retv, strerror(errno));
+			total = -1;
+			break;
+		}
+		total += outLen;
+	}
+	if ( oFile )
+		fclose(oFile);
+	free(iBuf);
+	free(oBuf);
+	return total;
+}
+
+/**
+ * Copy a file out of a container by reading all of it into memory.
+ * @param options - pointer to options.
+ * @param wdp - pointer to directory entry of file.
+ * @return number of bytes written (or would have been), -1 on error or -2 if out of memory.
+ * Error message will have been displayed.
+ */
+static int wholeFileOut(Options_t *options, InWorkingDir_t *wdp)
+{
+	Rt11DirEnt_t *dirptr = &wdp->rt11;
+	unsigned char *iBuf;
+	FILE *oFile;
+	int retv, jj;
+
+	iBuf = (unsigned char *)malloc(dirptr->blocks * BLKSIZ + 1);
+	if ( !iBuf )
+	{
+		msgErr(options, "Ran out of memory allocating %d bytes to read '%s'\n",
+				dirptr->blocks * BLKSIZ, wdp->ffull);
+		return -2;
+	}
+	if ( !(options->cmdOpts & (CMDOPT_SINGLE_FLPY | CMDOPT_DOUBLE_FLPY)) )
+	{
+		retv = statFseek(options, STAT_IO_CONT, options->inp, wdp->lba * BLKSIZ, SEEK_SET);
+		if ( retv < 0 || ferror(options->inp) || (ftell(options->inp) != wdp->lba*BLKSIZ) )
+		{
+			msgErr(options, "Unable to seek to %d in input '%s': %s\n",
+					wdp->lba, options->container, strerror(errno));
+			free(iBuf);
+			return -1;
+		}
+		retv = statFread(options, STAT_IO_CONT, iBuf, 1, dirptr->blocks * BLKSIZ, options->inp);
+		if ( retv != dirptr->blocks * BLKSIZ )
+		{
+			msgErr(options, "Error reading %d bytes from '%s' starting at LBA %d. Read %d: %s\n",
+					dirptr->blocks * BLKSIZ, options->container,
+					wdp->lba, retv, strerror(errno));
+			free(iBuf);
+			return -1;
+		}
+	}
+	else
+	{
+		if ( wdp->lba * BLKSIZ >= options->floppyImageSize )
+		{
+			msgErr(options, "Error seeking to %d. Outside of floppy image of %d bytes. Probably corruption in container directory.\n", wdp->lba * BLKSIZ, options->floppyImageSize);
+			free(iBuf);
+			return -1;
+		}
+		if ( (wdp->lba+dirptr->blocks)*BLKSIZ > options->floppyImageSize )
+		{
+			msgErr(options, "Error in file size of %d. Would read beyond EOF of container of %d bytes. Probably corruption in container directory.\n", dirptr->blocks * BLKSIZ, options->floppyImageSize);
+			free(iBuf);
+			return -1;
+		}
+		retv = dirptr->blocks*BLKSIZ;
+		memcpy(iBuf,options->floppyImageUnscrambled+wdp->lba*BLKSIZ, retv);
+	}
+	if ( (options->outOpts & OUTOPTS_ASC) )
+	{
+		AsciiStrip_t as;
+
+		/* Whole file is in memory so strip the cr's in place */
+		asciiStripInit(&as);
+		retv = asciiStripCR(&as, (char *)iBuf, retv, (char *)iBuf);
+		retv += asciiStripFinish(&as, (char *)iBuf + retv);
+	}
+	if ( !(options->cmdOpts & CMDOPT_NOWRITE) )
+	{
+		oFile = statFopen(options, STAT_IO_HOST, wdp->ffull, "wb");
+		if ( !oFile )
+		{
+			msgErr(options, "Unable to open '%s' for output: %s\n",
+					wdp->ffull, strerror(errno));
+			free(iBuf);
+			return -1;
+		}
+		jj = statFwrite(options, STAT_IO_HOST, iBuf, 1, retv, oFile);
+		if ( jj != retv )
+		{
+			msgErr(options, "Error writing %d bytes to '%s'. Wrote %d. '%s'\n",
+					retv, wdp->ffull, jj, strerror(errno));
+		}
+		fclose(oFile);
+	}
+	free(iBuf);
+	return retv;
+}
+
+/**
+ * Copy a binary file out of a hard disk container without reading it into memory.
+ * The kernel moves the bytes straight from the container to the new file if it can.
+ * @param options - pointer to options.
+ * @param wdp - pointer to directory entry of file.
+ * @return number of bytes written or -1 on error. Error message will have been displayed.
+ */
+static int rangeFileOut(Options_t *options, InWorkingDir_t *wdp)
+{
+	Rt11DirEnt_t *dirptr = &wdp->rt11;
+	FILE *oFile;
+	long retv;
+
+	oFile = statFopen(options, STAT_IO_HOST, wdp->ffull, "wb");
+	if ( !oFile )
+	{
+		msgErr(options, "Unable to open '%s' for output: %s\n",
+				wdp->ffull, strerror(errno));
+		return -1;
+	}
+	retv = fileCopy(options, STAT_IO_CONT, fileno(options->inp), (long)wdp->lba * BLKSIZ,
+					STAT_IO_HOST, fileno(oFile), 0, (long)dirptr->blocks * BLKSIZ);
+	if ( retv != dirptr->blocks * BLKSIZ )
+	{
+		msgErr(options, "Error copying %d bytes from '%s' starting at LBA %d to '%s'. Copied %ld: %s\n",
+				dirptr->blocks * BLKSIZ, options->container, wdp->lba, wdp->ffull,
+				retv, retv < 0 ? strerror(errno) : "Premature EOF");
+		fclose(oFile);
+		return -1;
+	}
+	if ( fclose(oFile) )
+	{
+		msgErr(options, "Error closing '%s': %s\n", wdp->ffull, strerror(errno));
+		return -1;
+	}
+	return retv;
+}
+
 /**
  * Copy an RT11 file out of container.
  * @param options - pointer to options.
@@ -108,21 +337,22 @@ int do_out(Options_t *options)
 		printf("do_out: numWdirs=%d, numArgFiles=%d\n",
 			   options->numWdirs, options->numArgFiles);
 	}
+	if ( options->tarFile )
+		return tarOut(options);
 	if ( options->outDir )
 		needChDir = 1;
 	wdp = options->wDirArray;
-	if ( options->numArgFiles )
+	if ( options->numArgFiles || options->where || options->numExcludes )
 	{
 		for ( ii = 0; ii < options->numWdirs; ++ii, ++wdp )
 		{
-			unsigned char *iBuf, *src, *dst;
-			FILE *oFile;
 			int retv, jj;
+			U64 traceStart;
 
 			dirptr = &wdp->rt11;
 			if ( !(dirptr->control & PERM) )
 				continue;
-			if ( !filterFilename(options, wdp->ffull) )
+			if ( !selectDirEnt(options, wdp) )
 				continue;
 			if ( needChDir )
 			{
@@ -162,130 +392,40 @@ int do_out(Options_t *options)
 					++cp;
 				}
 			}
-			iBuf = (unsigned char *)malloc(dirptr->blocks * BLKSIZ);
-			if ( !iBuf )
+			TRACE_START(options, traceStart);
+			statBegin(options, STAT_PH_HOSTOUT);
+#ifndef MINGW
+			if ( options->server )
 			{
-				fprintf(stderr, "Ran out of memory allocating %d bytes to read '%s'\n",
-						dirptr->blocks * BLKSIZ, wdp->ffull);
-				fclose(oFile);
-				return 1;
-			}
-			if ( !(options->cmdOpts & (CMDOPT_SINGLE_FLPY | CMDOPT_DOUBLE_FLPY)) )
-			{
-				retv = fseek(options->inp, wdp->lba * BLKSIZ, SEEK_SET);
-				if ( retv < 0 || ferror(options->inp) || (ftell(options->inp) != wdp->lba*BLKSIZ) )
-				{
-					fprintf(stderr, "Unable to seek to %d in input '%s': %s\n",
-							wdp->lba, options->container, strerror(errno));
-					fclose(oFile);
-					free(iBuf);
-					continue;
-				}
-				retv = fread(iBuf, 1, dirptr->blocks * BLKSIZ, options->inp);
-				if ( retv != dirptr->blocks * BLKSIZ )
-				{
-					fprintf(stderr, "Error reading %d bytes from '%s' starting at LBA %d. Read %d: %s\n",
-							dirptr->blocks * BLKSIZ, options->container,
-							wdp->lba, retv, strerror(errno));
-					fclose(oFile);
-					free(iBuf);
-					continue;
-				}
+				/* The container is somewhere rtpipd can get at it */
+				retv = clientFileOut(options, wdp);
 			}
 			else
+#endif
+			if ( (options->outOpts & OUTOPTS_ASC) && !(options->cmdOpts & (CMDOPT_SINGLE_FLPY | CMDOPT_DOUBLE_FLPY)) )
 			{
-				if ( wdp->lba * BLKSIZ >= options->floppyImageSize )
-				{
-					fprintf(stderr, "Error seeking to %d. Outside of floppy image of %d bytes. Probably corruption in container directory.\n", wdp->lba * BLKSIZ, options->floppyImageSize);
-					free(iBuf);
-					continue;
-				}
-				if ( (wdp->lba+dirptr->blocks)*BLKSIZ > options->floppyImageSize )
-				{
-					fprintf(stderr, "Error in file size of %d. Would read beyond EOF of container of %d bytes. Probably corruption in container directory.\n", dirptr->blocks * BLKSIZ, options->floppyImageSize);
-					free(iBuf);
-					continue;
-				}
-				retv = dirptr->blocks*BLKSIZ;
-				memcpy(iBuf,options->floppyImageUnscrambled+wdp->lba*BLKSIZ, retv);
+				/* Ascii files stop at the first null or control Z so don't read any more than needed */
+				retv = streamAsciiOut(options, wdp);
 			}
-			src = iBuf;
-			if ( (options->outOpts & OUTOPTS_ASC) )
+#ifndef MINGW
+			else if ( !(options->outOpts & OUTOPTS_ASC) && !(options->cmdOpts & (CMDOPT_SINGLE_FLPY | CMDOPT_DOUBLE_FLPY | CMDOPT_NOWRITE)) )
 			{
-				dst = src;
-				while ( src < iBuf + retv && *src && *src != ('Z' & 63) )
-				{
-					/* Leave lone cr's alone but change crlf to just lf */
-					if ( *src && (*src != '\r' || src[1] != '\n') )
-						*dst++ = *src;
-					++src;
-				}
-				retv = dst - iBuf;
+				/* Binary files from a hard disk image are copied by the kernel */
+				retv = rangeFileOut(options, wdp);
 			}
-			if ( !(options->cmdOpts & CMDOPT_NOWRITE) )
+#endif
+			else
 			{
-				oFile = fopen(wdp->ffull, "wb");
-				if ( !oFile )
-				{
-					fprintf(stderr, "Unable to open '%s' for output: %s\n",
-							wdp->ffull, strerror(errno));
-					continue;
-				}
-				if ( !(options->cmdOpts & CMDOPT_NOWRITE) )
-				{
-					oFile = fopen(wdp->ffull, "wb");
-					if ( !oFile )
-					{
-						fprintf(stderr, "Unable to open '%s' for output: %s\n",
-								wdp->ffull, strerror(errno));
-						continue;
-					}
-				}
-				jj = fwrite(iBuf, 1, retv, oFile);
-				if ( jj != retv )
-				{
-					fprintf(stderr, "Error writing %d bytes to '%s'. Wrote %d. '%s'\n",
-							retv, wdp->ffull, jj, strerror(errno));
-				}
-				fclose(oFile);
-				if ( (options->fileOpts & FILEOPTS_TIMESTAMP) )
-				{
-					struct utimbuf uTime;
-					struct tm tm;
-					int yr, age;
-
-					memset(&tm, 0, sizeof(tm));
-					tm.tm_mday = (wdp->rt11.date >> 5) & 31;
-					tm.tm_mon = ((wdp->rt11.date >> 10) & 15) - 1;
-					yr = wdp->rt11.date & 31;
-					age = (wdp->rt11.date >> 14) & 3;
-					switch (age)
-					{
-					case 1:
-						yr += 2004;
-						break;
-					case 2:
-						yr += 2036;
-						break;
-					case 3:
-						yr += 2068;
-						break;
-					default:
-						yr += 1972;
-						break;
-					}
-					tm.tm_year = yr - 1900;
-					if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
-					{
-						printf("do_out(): preserve timestamp: file '%s', bDate=0x%04X, age=%d, date=%02d/%02d/%04d, tm_mday=%d, tm_mon=%d, tm_year=%d\n",
-							   wdp->ffull, wdp->rt11.date, age, tm.tm_mday, tm.tm_mon + 1, tm.tm_year, tm.tm_mday, tm.tm_mon, tm.tm_year);
-					}
-					uTime.actime = time(NULL);
-					uTime.modtime = mktime(&tm);
-					utime(wdp->ffull, &uTime);
-				}
+				retv = wholeFileOut(options, wdp);
 			}
-			free(iBuf);
+			if ( retv >= 0 && !(options->cmdOpts & CMDOPT_NOWRITE) && (options->fileOpts & FILEOPTS_TIMESTAMP) )
+				setTimeStamp(options, wdp);
+			statEnd(options, STAT_PH_HOSTOUT);
+			TRACE_FILE(options, "out", traceStart, wdp->ffull, wdp->lba, dirptr->blocks, retv);
+			if ( retv == -2 )
+				return 1;
+			if ( retv < 0 )
+				continue;
 			if ( !(options->cmdOpts & CMDOPT_NOWRITE) )
 			{
 				if ( options->verbose || (options->outOpts & OUTOPTS_VERB) )
@@ -0,0 +1,653 @@
+/*  $Id: do_sync.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $
+
+	do_sync.c - Make a container's files match the files in a host directory.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtpip.h"
+
+/**
+ * @file do_sync.c
+ * Make a container's files match the files in a host directory. Called from rtpip.
+ */
+
+/*
+ * Note: A file is only copied if it is new or its contents are different. The
+ * contents are compared by a CRC32C of the file as it would be in the container
+ * (ascii converted and padded to a whole block). What the container's copy of a
+ * file hashed to is kept in a cache file next to the container (its name with
+ * SYNC_CACHE_EXT added). An entry is only believed if the file's name, LBA, size
+ * and date in the directory still match what they were, and if the host file's
+ * size and modify time still match too the host file isn't read at all. A changed
+ * file that still fits goes back where it was. The directory is only changed in
+ * memory and written once at the end like every other command.
+ */
+
+#define SYNC_CACHE_EXT  ".rtsync"   /* Added to container name to make cache name */
+#define SYNC_CHUNK_BLKS (64)        /* Blocks read at a time while hashing */
+
+/** What is remembered about one file between syncs */
+typedef struct
+{
+	char ffull[6+1+3+1];    /**< RT11 filename */
+	int lba;                /**< Where it is in the container */
+	int blocks;             /**< Size in container */
+	int date;               /**< RT11 date */
+	int ascii;              /**< Copied in as text */
+	U32 crc;                /**< CRC32C of the blocks in the container */
+	long hostSize;          /**< Size of host file it came from */
+	long hostTime;          /**< Modify time of host file it came from */
+} SyncCache_t;
+
+/** Everything about one sync */
+typedef struct
+{
+	SyncCache_t *cache;     /**< Cache as read in (sorted by name) */
+	int numCache;           /**< Number of entries in cache */
+	long cacheTime;         /**< When the sync that wrote the cache started */
+	long startTime;         /**< When this sync started */
+	SyncCache_t *newCache;  /**< Cache to write out (in host file order) */
+	int numNew;             /**< Number of entries in newCache */
+	U8 *buf;                /**< Buffer for hashing (SYNC_CHUNK_BLKS blocks) */
+	int copied;             /**< Files copied */
+	int inPlace;            /**< Of those, how many went back where they were */
+	int same;               /**< Files left alone */
+	int redated;            /**< Of those, how many had their date changed */
+	int deleted;            /**< Files deleted */
+	int failed;             /**< Files that couldn't be copied */
+	int blocks;             /**< Blocks copied */
+} Sync_t;
+
+/**
+ * Compare two cache entries by RT11 name (for qsort and bsearch).
+ * @param a - pointer to one SyncCache_t.
+ * @param b - pointer to the other.
+ * @return <0, 0 or >0.
+ */
+static int cmpCache(const void *a, const void *b)
+{
+	return strcmp(((const SyncCache_t *)a)->ffull, ((const SyncCache_t *)b)->ffull);
+}
+
+/**
+ * Compare two host files by RT11 name (for bsearch).
+ * @param a - pointer to one HostFile_t.
+ * @param b - pointer to the other.
+ * @return <0, 0 or >0.
+ */
+static int cmpHost(const void *a, const void *b)
+{
+	return strcmp(((const HostFile_t *)a)->ffull, ((const HostFile_t *)b)->ffull);
+}
+
+/**
+ * Make the name of the cache file.
+ * @param options - pointer to options.
+ * @param suffix - added to the end (for the temporary file).
+ * @return pointer to malloc'd name or NULL if out of memory (error will have been displayed).
+ */
+static char *cacheName(Options_t *options, const char *suffix)
+{
+	char *name;
+
+	name = (char *)malloc(strlen(options->container) + sizeof(SYNC_CACHE_EXT) + strlen(suffix));
+	if ( !name )
+	{
+		msgErr(options, "Ran out of memory for cache filename: %s\n", strerror(errno));
+		return NULL;
+	}
+	sprintf(name, "%s%s%s", options->container, SYNC_CACHE_EXT, suffix);
+	return name;
+}
+
+/**
+ * Read the cache. A missing or unreadable cache just means everything gets compared.
+ * @param options - pointer to options.
+ * @param sp - pointer to sync details.
+ * @return 0 if success; 1 if out of memory.
+ */
+static int readCache(Options_t *options, Sync_t *sp)
+{
+	char *name, line[128];
+	FILE *fp;
+	SyncCache_t ent, *cp;
+	int max = 0;
+
+	name = cacheName(options, "");
+	if ( !name )
+		return 1;
+	fp = fopen(name, "r");
+	if ( !fp )
+	{
+		if ( (options->syncOpts & SYNCOPTS_VERB) || options->verbose )
+			printf("No cache '%s'. Everything will be compared.\n", name);
+		free(name);
+		return 0;
+	}
+	while ( fgets(line, sizeof(line), fp) )
+	{
+		unsigned long crc;
+
+		if ( line[0] == '#' )
+		{
+			sscanf(line, "# started %ld", &sp->cacheTime);
+			continue;
+		}
+		if ( sscanf(line, "%10s %d %d %d %d %lx %ld %ld", ent.ffull, &ent.lba, &ent.blocks,
+					&ent.date, &ent.ascii, &crc, &ent.hostSize, &ent.hostTime) != 8 )
+		{
+			msgErr(options, "Ignored bad line in '%s': %s", name, line);
+			continue;
+		}
+		ent.crc = crc;
+		if ( sp->numCache >= max )
+		{
+			cp = (SyncCache_t *)realloc(sp->cache, (max + 256) * sizeof(SyncCache_t));
+			if ( !cp )
+			{
+				msgErr(options, "Ran out of memory for %d cache entries: %s\n", max + 256, strerror(errno));
+				fclose(fp);
+				free(name);
+				return 1;
+			}
+			sp->cache = cp;
+			max += 256;
+		}
+		sp->cache[sp->numCache++] = ent;
+	}
+	fclose(fp);
+	free(name);
+	if ( sp->numCache )
+		qsort(sp->cache, sp->numCache, sizeof(SyncCache_t), cmpCache);
+	return 0;
+}
+
+/**
+ * Write the cache (replacing the old one only if it all got written).
+ * @param options - pointer to options.
+ * @param sp - pointer to sync details.
+ * @return 0 if success; 1 if failure.
+ */
+static int writeCache(Options_t *options, Sync_t *sp)
+{
+	char *name, *tmpName;
+	FILE *fp;
+	SyncCache_t *cp;
+	int ii, sts = 0;
+
+	name = cacheName(options, "");
+	tmpName = cacheName(options, "-tmp");
+	if ( !name || !tmpName )
+	{
+		free(name);
+		free(tmpName);
+		return 1;
+	}
+	fp = fopen(tmpName, "w");
+	if ( !fp )
+	{
+		msgErr(options, "Unable to create '%s': %s\n", tmpName, strerror(errno));
+		sts = 1;
+	}
+	else
+	{
+		fprintf(fp, "# rtpip sync cache for %s\n"
+				"# started %ld\n"
+				"# name lba blocks date ascii crc32c hostsize hostmtime\n",
+				options->container, sp->startTime);
+		for ( ii = 0, cp = sp->newCache; ii < sp->numNew; ++ii, ++cp )
+		{
+			fprintf(fp, "%s %d %d %d %d %08lx %ld %ld\n", cp->ffull, cp->lba, cp->blocks,
+					cp->date, cp->ascii, (unsigned long)cp->crc, cp->hostSize, cp->hostTime);
+		}
+		if ( fclose(fp) )
+		{
+			msgErr(options, "Error writing '%s': %s\n", tmpName, strerror(errno));
+			sts = 1;
+		}
+#ifdef MINGW
+		if ( !sts )
+			unlink(name);
+#endif
+		if ( !sts && rename(tmpName, name) )
+		{
+			msgErr(options, "Unable to rename '%s' to '%s': %s\n", tmpName, name, strerror(errno));
+			sts = 1;
+		}
+		if ( sts )
+			unlink(tmpName);
+	}
+	free(name);
+	free(tmpName);
+	return sts;
+}
+
+/**
+ * Hash a host file the way it will be in the container. readInpFile() has to have
+ * been called for it already.
+ * @param options - pointer to options.
+ * @param sp - pointer to sync details.
+ * @param ep - pointer to host file.
+ * @param crcP - where to put the hash.
+ * @return 0 if success; 1 if failure.
+ */
+static int hashHost(Options_t *options, Sync_t *sp, const HostFile_t *ep, U32 *crcP)
+{
+	InHandle_t *ihp = &options->iHandle;
+	FILE *fp;
+	long left;
+	U32 crc;
+
+	if ( !ihp->directName )
+	{
+		/* Ascii files and files for floppies have already been read in */
+		*crcP = memCrc32c(0, ihp->inFileBuf, (size_t)ihp->fileBlks * BLKSIZ);
+		return 0;
+	}
+	fp = statFopen(options, STAT_IO_HOST, ep->path, "rb");
+	if ( !fp )
+	{
+		msgErr(options, "Error opening '%s' for input: %s\n", ep->path, strerror(errno));
+		return 1;
+	}
+	crc = 0;
+	for ( left = (long)ihp->fileBlks * BLKSIZ; left > 0; )
+	{
+		int len, got;
+
+		len = left > SYNC_CHUNK_BLKS * BLKSIZ ? SYNC_CHUNK_BLKS * BLKSIZ : (int)left;
+		got = statFread(options, STAT_IO_HOST, sp->buf, 1, len, fp);
+		if ( got < len )
+		{
+			if ( ferror(fp) )
+			{
+				msgErr(options, "Error reading '%s': %s\n", ep->path, strerror(errno));
+				fclose(fp);
+				return 1;
+			}
+			/* pad file to multiple of BLKSIZ with 0's */
+			memset(sp->buf + got, 0, len - got);
+		}
+		crc = memCrc32c(crc, sp->buf, len);
+		left -= len;
+	}
+	fclose(fp);
+	*crcP = crc;
+	return 0;
+}
+
+/**
+ * Hash a file's blocks in the container.
+ * @param options - pointer to options.
+ * @param sp - pointer to sync details.
+ * @param wdp - pointer to file's directory entry.
+ * @param crcP - where to put the hash.
+ * @return 0 if success; 1 if failure.
+ */
+static int hashContainer(Options_t *options, Sync_t *sp, const InWorkingDir_t *wdp, U32 *crcP)
+{
+	int left, lba;
+	U32 crc;
+
+	if ( (options->cmdOpts & (CMDOPT_DOUBLE_FLPY | CMDOPT_SINGLE_FLPY)) )
+	{
+		*crcP = memCrc32c(0, options->floppyImageUnscrambled + wdp->lba * BLKSIZ, (size_t)wdp->rt11.blocks * BLKSIZ);
+		return 0;
+	}
+	if ( statFseek(options, STAT_IO_CONT, options->inp, (long)wdp->lba * BLKSIZ, SEEK_SET) < 0 )
+	{
+		msgErr(options, "Error seeking to block %d of container: %s\n", wdp->lba, strerror(errno));
+		return 1;
+	}
+	crc = 0;
+	for ( left = wdp->rt11.blocks, lba = wdp->lba; left > 0; )
+	{
+		int len;
+
+		len = left > SYNC_CHUNK_BLKS ? SYNC_CHUNK_BLKS : left;
+		if ( statFread(options, STAT_IO_CONT, sp->buf, BLKSIZ, len, options->inp) != len )
+		{
+			msgErr(options, "Error reading blocks %d-%d of container: %s\n",
+					lba, lba + len - 1, strerror(errno));
+			return 1;
+		}
+		crc = memCrc32c(crc, sp->buf, (size_t)len * BLKSIZ);
+		left -= len;
+		lba += len;
+	}
+	*crcP = crc;
+	return 0;
+}
+
+/**
+ * Find a file in the container.
+ * @param options - pointer to options.
+ * @param name - Rad50 name.
+ * @return pointer to entry or NULL if not there.
+ */
+static InWorkingDir_t *findPerm(Options_t *options, const U16 name[3])
+{
+	InWorkingDir_t *wdp;
+	int ii;
+
+	for ( ii = 0, wdp = options->wDirArray; ii < options->numWdirs; ++ii, ++wdp )
+	{
+		if (    (wdp->rt11.control & PERM)
+			 && wdp->rt11.name[0] == name[0]
+			 && wdp->rt11.name[1] == name[1]
+			 && wdp->rt11.name[2] == name[2] )
+			return wdp;
+	}
+	return NULL;
+}
+
+/**
+ * Shrink a file in place, giving the blocks it no longer needs to an empty area
+ * right after it.
+ * @param options - pointer to options.
+ * @param wdp - pointer to file's directory entry.
+ * @param blocks - new size.
+ * @return 0 if success; 1 if out of directory entries.
+ */
+static int shrinkEnt(Options_t *options, InWorkingDir_t *wdp, int blocks)
+{
+	int extra = wdp->rt11.blocks - blocks;
+	int idx = wdp - options->wDirArray;
+	InWorkingDir_t *nxt = wdp + 1;
+
+	if ( !extra )
+		return 0;
+	if ( idx + 1 < options->numWdirs && !(nxt->rt11.control & PERM) )
+	{
+		/* Empty area after it already. Just make it bigger. */
+		nxt->lba -= extra;
+		nxt->rt11.blocks += extra;
+		nxt->rt11.control = EMPTY;
+	}
+	else
+	{
+		/* Same test as newDirEnt() (be sure to leave room for one last entry) */
+		if ( options->maxseg * options->numdent - 1 <= options->numWdirs )
+			return 1;
+		memmove(nxt + 1, nxt, (options->numWdirs - idx - 1) * sizeof(InWorkingDir_t));
+		++options->numWdirs;
+		memset(nxt, 0, sizeof(InWorkingDir_t));
+		nxt->rt11.control = EMPTY;
+		nxt->rt11.blocks = extra;
+		nxt->lba = wdp->lba + blocks;
+	}
+	nxt->freed = 1;
+	wdp->rt11.blocks = blocks;
+	options->totEmpty += extra;
+	options->totPerm -= extra;
+	return 0;
+}
+
+/**
+ * Copy a host file's blocks to where its directory entry says.
+ * @param options - pointer to options.
+ * @param wdp - pointer to file's directory entry.
+ * @return 0 if success; 1 if failure.
+ */
+static int copyIn(Options_t *options, InWorkingDir_t *wdp)
+{
+	InHandle_t *ihp = &options->iHandle;
+
+	if ( (options->cmdOpts & (CMDOPT_DOUBLE_FLPY | CMDOPT_SINGLE_FLPY)) )
+	{
+		memcpy(options->floppyImageUnscrambled + wdp->lba * BLKSIZ, ihp->inFileBuf, ihp->fileBlks * BLKSIZ);
+		options->dirDirty = 1;
+		return 0;
+	}
+	return writeFileToContainer(options, wdp) ? 1 : 0;
+}
+
+/**
+ * Delete the files that aren't in the host directory.
+ * @param options - pointer to options.
+ * @param sp - pointer to sync details.
+ * @param ents - pointer to host files (sorted by RT11 name).
+ * @param num - number of host files.
+ * @return nothing
+ */
+static void deleteMissing(Options_t *options, Sync_t *sp, HostFile_t *ents, int num)
+{
+	InWorkingDir_t *wdp;
+	HostFile_t key;
+	int ii;
+
+	for ( ii = 0, wdp = options->wDirArray; ii < options->numWdirs; ++ii, ++wdp )
+	{
+		if ( !(wdp->rt11.control & PERM) )
+			continue;
+		r50DecodeName(key.ffull, wdp->rt11.name);
+		if ( num && bsearch(&key, ents, num, sizeof(HostFile_t), cmpHost) )
+			continue;
+		if ( (options->syncOpts & SYNCOPTS_VERB) || (options->cmdOpts & CMDOPT_NOWRITE) || options->verbose )
+		{
+			printf("%seleted '%s', %d blocks at LBA %d\n",
+				   (options->cmdOpts & CMDOPT_NOWRITE) ? "Would have d" : "D",
+				   key.ffull, wdp->rt11.blocks, wdp->lba);
+		}
+		wdp->rt11.control = EMPTY;
+		wdp->freed = 1;
+		options->totEmpty += wdp->rt11.blocks;
+		options->totPerm -= wdp->rt11.blocks;
+		options->dirDirty = 1;
+		++sp->deleted;
+	}
+}
+
+/**
+ * Bring one host file into the container if it isn't there already.
+ * @param options - pointer to options.
+ * @param sp - pointer to sync details.
+ * @param ep - pointer to host file.
+ * @return 0 if success, 1 if this file failed, 2 if out of directory entries.
+ */
+static int syncOne(Options_t *options, Sync_t *sp, HostFile_t *ep)
+{
+	InHandle_t *ihp = &options->iHandle;
+	InWorkingDir_t *wdp;
+	SyncCache_t key, *cp, *np;
+	int retv, same;
+	U32 hostCrc, contCrc;
+
+	np = sp->newCache + sp->numNew;
+	strcpy(np->ffull, ep->ffull);
+	np->ascii = ep->ascii;
+	np->hostSize = ep->hostSize;
+	np->hostTime = ep->hostTime;
+	strcpy(key.ffull, ep->ffull);
+	cp = sp->numCache ? (SyncCache_t *)bsearch(&key, sp->cache, sp->numCache, sizeof(SyncCache_t), cmpCache) : NULL;
+	wdp = findPerm(options, ep->name);
+	/* Forget what the cache says if the file has been moved or changed since */
+	if ( cp && (!wdp || cp->lba != wdp->lba || cp->blocks != wdp->rt11.blocks
+				|| cp->date != wdp->rt11.date || cp->ascii != ep->ascii) )
+		cp = NULL;
+	if ( wdp && wdp->rt11.blocks == ep->blocks )
+	{
+		/* A file changed in the same second it was last looked at would have the same
+		 * modify time, so only one that hadn't been touched for a while is believed. */
+		if ( cp && cp->hostSize == ep->hostSize && cp->hostTime == ep->hostTime
+			 && cp->hostTime < sp->cacheTime )
+		{
+			/* Neither has changed since the last sync */
+			hostCrc = contCrc = cp->crc;
+			same = 1;
+		}
+		else
+		{
+			options->inOpts = ep->ascii ? INOPTS_ASC : 0;
+			statBegin(options, STAT_PH_HOSTIN);
+			retv = hostFileRead(options, ep);
+			if ( !retv )
+				retv = hashHost(options, sp, ep, &hostCrc);
+			statEnd(options, STAT_PH_HOSTIN);
+			if ( retv )
+				return 1;
+			if ( cp )
+				contCrc = cp->crc;
+			else if ( hashContainer(options, sp, wdp, &contCrc) )
+				return 1;
+			same = hostCrc == contCrc && ihp->fileBlks == ep->blocks;
+		}
+		if ( same )
+		{
+			++sp->same;
+			if ( (options->fileOpts & FILEOPTS_TIMESTAMP) && wdp->rt11.date != ep->date )
+			{
+				wdp->rt11.date = ep->date;
+				options->dirDirty = 1;
+				++sp->redated;
+			}
+			if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
+				printf("syncOne: '%s' is the same as %s (crc %08lX)\n", ep->path, ep->ffull, (unsigned long)hostCrc);
+			np->lba = wdp->lba;
+			np->blocks = wdp->rt11.blocks;
+			np->date = wdp->rt11.date;
+			np->crc = contCrc;
+			++sp->numNew;
+			return 0;
+		}
+	}
+	else
+	{
+		options->inOpts = ep->ascii ? INOPTS_ASC : 0;
+		statBegin(options, STAT_PH_HOSTIN);
+		retv = hostFileRead(options, ep);
+		if ( !retv )
+			retv = hashHost(options, sp, ep, &hostCrc);
+		statEnd(options, STAT_PH_HOSTIN);
+		if ( retv )
+			return 1;
+	}
+	/* It's new or it changed. It goes back where it was if it still fits. */
+	ihp->iNameR50[0] = ep->name[0];
+	ihp->iNameR50[1] = ep->name[1];
+	ihp->iNameR50[2] = ep->name[2];
+	strcpy(ihp->argFN, ep->ffull);
+	if ( ep->blocks != ihp->fileBlks )
+	{
+		msgErr(options, "'%s' changed size while being copied\n", ep->path);
+		return 1;
+	}
+	if ( wdp && ihp->fileBlks <= wdp->rt11.blocks && !shrinkEnt(options, wdp, ihp->fileBlks) )
+	{
+		++sp->inPlace;
+		options->dirDirty = 1;
+	}
+	else
+	{
+		retv = newDirEnt(options, ep->path, &wdp);
+		if ( retv )
+			return retv;
+	}
+	wdp->rt11.date = ep->date;
+	if ( (options->cmdOpts & CMDOPT_NOWRITE) )
+	{
+		printf("Would have copied '%s' to '%s', %d blocks at LBA %d\n",
+			   ep->path, ep->ffull, ihp->fileBlks, wdp->lba);
+	}
+	else
+	{
+		if ( copyIn(options, wdp) )
+			return 1;
+		if ( (options->syncOpts & SYNCOPTS_VERB) || options->verbose )
+		{
+			printf("Copied '%s' to '%s', %d blocks at LBA %d\n",
+				   ep->path, ep->ffull, ihp->fileBlks, wdp->lba);
+		}
+	}
+	++sp->copied;
+	sp->blocks += ihp->fileBlks;
+	np->lba = wdp->lba;
+	np->blocks = wdp->rt11.blocks;
+	np->date = wdp->rt11.date;
+	np->crc = hostCrc;
+	++sp->numNew;
+	return 0;
+}
+
+/**
+ * Make the container's files match the files in options->hostDir.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure.
+ */
+int do_sync(Options_t *options)
+{
+	Sync_t sync;
+	HostFile_t *ents;
+	int num, ii, retv, sts = 0;
+
+	memset(&sync, 0, sizeof(sync));
+	sync.startTime = (long)time(NULL);
+	if ( readCache(options, &sync) )
+		return 1;
+	if ( hostDirScan(options, &ents, &num) )
+	{
+		free(sync.cache);
+		return 1;
+	}
+	sync.newCache = (SyncCache_t *)malloc((num + 1) * sizeof(SyncCache_t));
+	sync.buf = (U8 *)malloc(SYNC_CHUNK_BLKS * BLKSIZ);
+	if ( !sync.newCache || !sync.buf )
+	{
+		msgErr(options, "Ran out of memory for %d files: %s\n", num, strerror(errno));
+		sts = 1;
+	}
+	else
+	{
+		/* Nothing is written where a file deleted this run was until the directory says it's gone */
+		options->holdFreed = 1;
+		if ( (options->syncOpts & SYNCOPTS_DELETE) )
+			deleteMissing(options, &sync, ents, num);
+		for ( ii = 0; ii < num; ++ii )
+		{
+			retv = syncOne(options, &sync, ents + ii);
+			if ( retv )
+				++sync.failed;
+			if ( retv == 2 )
+				break;
+		}
+		if ( (sync.copied || sync.deleted || sync.redated) && linearToDisk(options) )
+			sts = 1;
+		else if ( sync.failed && options->dirDirty )
+		{
+			/* What did get copied is kept (like in would), but rtpip still has to exit with 1 */
+			sts = writeNewDir(options);
+			options->dirDirty = 0;
+		}
+		/* Only what is certain goes in the cache, so it's written even if some files failed */
+		if ( !(options->cmdOpts & CMDOPT_NOWRITE) && writeCache(options, &sync) )
+			sts = 1;
+		if ( (options->syncOpts & SYNCOPTS_VERB) || (options->cmdOpts & CMDOPT_NOWRITE) || options->verbose )
+		{
+			printf("%sopied %d file%s (%d in place), %d blocks. %d unchanged (%d redated), %d deleted, %d failed. %d free blocks now.\n",
+				   (options->cmdOpts & CMDOPT_NOWRITE) ? "Would have c" : "C",
+				   sync.copied, sync.copied == 1 ? "" : "s", sync.inPlace, sync.blocks,
+				   sync.same, sync.redated, sync.deleted, sync.failed, options->totEmpty);
+		}
+		if ( sync.failed )
+			sts = 1;
+	}
+	free(sync.buf);
+	free(sync.newCache);
+	free(sync.cache);
+	hostDirFree(ents, num);
+	return sts;
+}
@@ -0,0 +1,257 @@
+/*  $Id: fcopy.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	fcopy.c - Copy bytes between files without a trip through user space.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MINGW
+	#if defined(__linux__)
+		#define _GNU_SOURCE
+	#else
+		#define _XOPEN_SOURCE 600
+	#endif
+#endif
+#include "rtpip.h"
+#if defined(__linux__) && !defined(MINGW)
+	#include <sys/syscall.h>
+	#include <sys/sendfile.h>
+	#include <sys/ioctl.h>
+	#include <linux/fs.h>
+#endif
+
+/**
+ * @file fcopy.c
+ * Copy a range of bytes from one open file to another. On Linux the files are first
+ * asked to share the blocks (a reflink, on filesystems like btrfs and xfs that can), then
+ * the kernel is asked to copy them with copy_file_range() and then sendfile(). Elsewhere,
+ * or when none of those work on the files given, the bytes go through a buffer that is
+ * kept for the rest of the run.
+ */
+
+#ifndef MINGW
+
+/**
+ * Make a range of outFd share the blocks of a range of inFd. Only works if the offsets
+ * and length are all multiples of the filesystem's block size.
+ * @param options - pointer to options.
+ * @param inFd - file to read.
+ * @param inOff - offset in inFd.
+ * @param outFd - file to write.
+ * @param outOff - offset in outFd.
+ * @param len - number of bytes.
+ * @return 0 if done, 1 if the bytes have to be copied.
+ */
+static int reflink(Options_t *options, int inFd, off_t inOff, int outFd, off_t outOff, long len)
+{
+	#if defined(__linux__) && defined(FICLONERANGE)
+	struct file_clone_range fcr;
+	struct stat st;
+
+	if ( options->noReflink || fstat(outFd, &st) || st.st_blksize <= 0
+		 || (inOff % st.st_blksize) || (outOff % st.st_blksize) || (len % st.st_blksize) )
+		return 1;
+	fcr.src_fd = inFd;
+	fcr.src_offset = inOff;
+	fcr.src_length = len;
+	fcr.dest_offset = outOff;
+	if ( !ioctl(outFd, FICLONERANGE, &fcr) )
+		return 0;
+	/* Any error other than bad alignment means this filesystem (or pair of them) can't */
+	if ( errno != EINVAL )
+		options->noReflink = 1;
+	return 1;
+	#else
+	return 1;
+	#endif
+}
+
+/**
+ * Copy with copy_file_range().
+ * @param inFd - file to read.
+ * @param inOff - pointer to offset in inFd. Advanced by amount copied.
+ * @param outFd - file to write.
+ * @param outOff - pointer to offset in outFd. Advanced by amount copied.
+ * @param len - number of bytes to copy.
+ * @return number of bytes copied or -1 on error with errno set.
+ */
+static long kernelCopy(int inFd, off_t *inOff, int outFd, off_t *outOff, size_t len)
+{
+	#if defined(__linux__) && defined(__NR_copy_file_range)
+	loff_t in = *inOff, out = *outOff;
+	long retv;
+
+	/* Done with syscall() so it works with a C library older than the kernel */
+	retv = syscall(__NR_copy_file_range, inFd, &in, outFd, &out, len, 0);
+	if ( retv > 0 )
+	{
+		*inOff = in;
+		*outOff = out;
+	}
+	return retv;
+	#else
+	errno = ENOSYS;
+	return -1;
+	#endif
+}
+
+/**
+ * Copy with sendfile(). The output's file position is put back afterwards.
+ * @param inFd - file to read.
+ * @param inOff - pointer to offset in inFd. Advanced by amount copied.
+ * @param outFd - file to write.
+ * @param outOff - pointer to offset in outFd. Advanced by amount copied.
+ * @param len - number of bytes to copy.
+ * @return number of bytes copied or -1 on error with errno set.
+ */
+static long sendCopy(int inFd, off_t *inOff, int outFd, off_t *outOff, size_t len)
+{
+	#if defined(__linux__)
+	off_t pos;
+	long retv;
+	int err;
+
+	pos = lseek(outFd, 0, SEEK_CUR);
+	if ( pos < 0 || lseek(outFd, *outOff, SEEK_SET) != *outOff )
+		return -1;
+	retv = sendfile(outFd, inFd, inOff, len);
+	err = errno;
+	lseek(outFd, pos, SEEK_SET);
+	errno = err;
+	if ( retv > 0 )
+		*outOff += retv;
+	return retv;
+	#else
+	errno = ENOSYS;
+	return -1;
+	#endif
+}
+
+/**
+ * Copy through the buffer in options. pread() and pwrite() are used so neither file's
+ * position moves under any FILE that may be open on it.
+ * @param options - pointer to options.
+ * @param inFd - file to read.
+ * @param inOff - pointer to offset in inFd. Advanced by amount copied.
+ * @param outFd - file to write.
+ * @param outOff - pointer to offset in outFd. Advanced by amount copied.
+ * @param len - number of bytes to copy.
+ * @return number of bytes copied or -1 on error with errno set.
+ */
+static long bufferCopy(Options_t *options, int inFd, off_t *inOff, int outFd, off_t *outOff, size_t len)
+{
+	long rlen, wlen, done;
+
+	if ( !options->copyBuf )
+	{
+		options->copyBuf = (U8 *)malloc(COPY_BUF_SIZE);
+		if ( !options->copyBuf )
+		{
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+	if ( len > COPY_BUF_SIZE )
+		len = COPY_BUF_SIZE;
+	rlen = pread(inFd, options->copyBuf, len, *inOff);
+	if ( rlen <= 0 )
+		return rlen;
+	for ( done = 0; done < rlen; done += wlen )
+	{
+		wlen = pwrite(outFd, options->copyBuf + done, rlen - done, *outOff + done);
+		if ( wlen <= 0 )
+			return -1;
+	}
+	*inOff += rlen;
+	*outOff += rlen;
+	return rlen;
+}
+
+/**
+ * Check whether an error means the method can never work on these files.
+ * @param err - errno from the failed call.
+ * @return non-zero if the next method should be tried.
+ */
+static int methodUnsupported(int err)
+{
+	return err == ENOSYS || err == EXDEV || err == EINVAL || err == EOPNOTSUPP
+#if defined(ENOTSUP) && ENOTSUP != EOPNOTSUPP
+		|| err == ENOTSUP
+#endif
+		|| err == EBADF || err == EPERM;
+}
+
+#endif	/* MINGW */
+
+/**
+ * Copy a range of bytes from one open file to another.
+ * @param options - pointer to options.
+ * @param inIo - STAT_IO_CONT or STAT_IO_HOST for the input.
+ * @param inFd - file to read.
+ * @param inOff - offset in inFd to start reading.
+ * @param outIo - STAT_IO_CONT or STAT_IO_HOST for the output.
+ * @param outFd - file to write.
+ * @param outOff - offset in outFd to start writing.
+ * @param len - number of bytes to copy.
+ * @return number of bytes copied (less than len if inFd ends early) or -1 on error with errno set.
+ */
+long fileCopy(Options_t *options, int inIo, int inFd, long inOff, int outIo, int outFd, long outOff, long len)
+{
+#ifndef MINGW
+	off_t in = inOff, out = outOff;
+	long retv = 0, total = 0;
+
+	if ( len > 0 && options->copyMethod == COPY_KERNEL && !reflink(options, inFd, in, outFd, out, len) )
+		total = len;
+	while ( total < len )
+	{
+		if ( options->copyMethod == COPY_KERNEL )
+		{
+			retv = kernelCopy(inFd, &in, outFd, &out, len - total);
+			if ( retv < 0 && !total && methodUnsupported(errno) )
+			{
+				options->copyMethod = COPY_SENDFILE;
+				continue;
+			}
+		}
+		else if ( options->copyMethod == COPY_SENDFILE )
+		{
+			retv = sendCopy(inFd, &in, outFd, &out, len - total);
+			if ( retv < 0 && !total && methodUnsupported(errno) )
+			{
+				options->copyMethod = COPY_BUFFER;
+				continue;
+			}
+		}
+		else
+		{
+			retv = bufferCopy(options, inFd, &in, outFd, &out, len - total);
+		}
+		if ( retv < 0 && errno == EINTR )
+			continue;
+		if ( retv <= 0 )
+			break;
+		total += retv;
+	}
+	statCount(options, inIo, 0, total);
+	statCount(options, outIo, 1, total);
+	return retv < 0 ? -1 : total;
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
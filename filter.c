@@ -0,0 +1,553 @@
+/*  $Id: filter.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	filter.c - Filename selection functions used by rtpip
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtpip.h"
+
+/**
+ * @file filter.c
+ * Filename selection functions used by rtpip.
+ */
+
+/*
+ * Note: With the -R option every name used to be run through regexec() once
+ * for each expression on the command line. Here all the expressions are
+ * glued together into a single alternation, \(re1\)\|\(re2\)\|..., so that
+ * one regexec() both decides whether a name matches and (by looking at which
+ * sub-expression participated) which of the expressions it matched. POSIX
+ * picks the alternative with the longest match, not the first one listed, so
+ * any expressions ahead of that one are tried on their own to find the first
+ * that matches; usually it is the first and there are none to try. The
+ * alternation is a GNU extension to basic regular expressions, so if the
+ * combined expression won't compile the expressions are just tried one at a
+ * time as before. Whatever the answer, it is remembered by Rad50 name so the
+ * same name never has to be checked twice.
+ *
+ * The --exclude filters are handled the same way (but one at a time) and
+ * their result is remembered in the same slot. The --where expression is
+ * compiled separately (see where.c) and is checked last since it depends
+ * on more than just the name.
+ */
+
+#define FILTMEMO_NEW  (-2)      /* Memo result not yet known */
+#define FILTMEMO_FREE (-3)      /* Memo slot not yet used */
+
+/**
+ * Get the index of the filter that matches a name.
+ * @param options - pointer to options
+ * @param name - pointer to null terminated filename to check.
+ * @return index of first filter (into argFiles) that matched or -1 if none matched.
+ */
+static int matchName(Options_t *options, const char *name)
+{
+	int ii, jj;
+
+#if !NO_REGEXP
+	if ( (options->fileOpts & FILEOPTS_REGEXP) )
+	{
+		jj = options->numArgFiles;
+		if ( options->rexUnion )
+		{
+			if ( regexec(options->rexUnion, name, options->rexNumMatch, options->rexMatch, 0) )
+				return -1;
+			for ( jj = 0; jj < options->numArgFiles; ++jj )
+			{
+				if ( options->rexMatch[options->rexGroups[jj]].rm_so != -1 )
+					break;
+			}
+			/* Leftmost-longest can pick a later expression over an earlier one that
+			 * also matches, so only those before it need to be tried on their own.
+			 * (Not finding one can't happen, but if it does, they all get tried.) */
+		}
+		for ( ii = 0; ii < jj; ++ii )
+		{
+			if ( !regexec(options->rexts + ii, name, 0, NULL, 0) )
+				return ii;
+		}
+		return jj < options->numArgFiles ? jj : -1;
+	}
+#endif
+	for ( ii = 0; ii < options->numArgFiles; ++ii )
+	{
+		if ( !normexec(options->normExprs + ii * 10, name) )
+			return ii;
+	}
+	return -1;
+}
+
+/**
+ * Get the memo slot for a Rad50 filename.
+ * @param options - pointer to options
+ * @param name - pointer to 3 word Rad50 filename.
+ * @return pointer to slot or NULL if no memo is available.
+ */
+static FilterMemo_t *memoSlot(Options_t *options, const unsigned short name[3])
+{
+	FilterMemo_t *mp;
+	unsigned int hash;
+
+	if ( !options->filterMemo )
+	{
+		int ii, need;
+
+		/* Make it at least twice as big as the largest possible directory */
+		need = 2 * options->maxseg * options->numdent;
+		if ( need < 64 )
+			need = 64;
+		for ( ii = 64; ii < need; ii <<= 1 )
+			;
+		options->filterMemo = (FilterMemo_t *)malloc(ii * sizeof(FilterMemo_t));
+		if ( !options->filterMemo )
+			return NULL;        /* Just means no memo */
+		options->filterMemoSize = ii;
+		options->filterMemoUsed = 0;
+		for ( ii = 0; ii < options->filterMemoSize; ++ii )
+			options->filterMemo[ii].which = FILTMEMO_FREE;
+	}
+	hash = (name[0] ^ ((unsigned int)name[1] << 5) ^ ((unsigned int)name[2] << 11)) * 2654435761U;
+	hash >>= 8;
+	while ( 1 )
+	{
+		mp = options->filterMemo + (hash & (options->filterMemoSize - 1));
+		if ( mp->which == FILTMEMO_FREE )
+		{
+			/* Stop adding names at half full so there is always an empty slot to end the probe */
+			if ( options->filterMemoUsed >= options->filterMemoSize / 2 )
+				return NULL;
+			++options->filterMemoUsed;
+			mp->name[0] = name[0];
+			mp->name[1] = name[1];
+			mp->name[2] = name[2];
+			mp->which = FILTMEMO_NEW;
+			mp->excluded = FILTMEMO_NEW;
+			return mp;
+		}
+		if ( mp->name[0] == name[0] && mp->name[1] == name[1] && mp->name[2] == name[2] )
+			return mp;
+		++hash;
+	}
+}
+
+/**
+ * Get the index of the filter that selected a directory entry.
+ * @param options - pointer to options
+ * @param wdp - pointer to directory entry.
+ * @return index of first filter (into argFiles) that matched or -1 if none matched.
+ */
+int filterWhich(Options_t *options, const InWorkingDir_t *wdp)
+{
+	FilterMemo_t *mp;
+	int which;
+
+	if ( !options->numArgFiles )
+		return -1;
+	mp = memoSlot(options, wdp->rt11.name);
+	if ( mp && mp->which != FILTMEMO_NEW )
+		return mp->which;
+	which = matchName(options, wdp->ffull);
+	if ( mp )
+		mp->which = which;
+	return which;
+}
+
+/**
+ * Filter directory entries based on input from command line.
+ * @param options - pointer to options
+ * @param wdp - pointer to directory entry.
+ * @return 1 if to handle file; 0 if to ignore file.
+ */
+int filterDirEnt(Options_t *options, const InWorkingDir_t *wdp)
+{
+	if ( !options->numArgFiles )
+		return 1;
+	return filterWhich(options, wdp) >= 0;
+}
+
+/**
+ * Check whether a name matches any of the --exclude filters.
+ * @param options - pointer to options
+ * @param name - pointer to null terminated filename to check.
+ * @return 1 if name is excluded; 0 if not.
+ */
+static int matchExclude(Options_t *options, const char *name)
+{
+	int ii;
+
+	for ( ii = 0; ii < options->numExcludes; ++ii )
+	{
+#if !NO_REGEXP
+		if ( options->exclRexts )
+		{
+			if ( !regexec(options->exclRexts + ii, name, 0, NULL, 0) )
+				return 1;
+			continue;
+		}
+#endif
+		if ( !normexec(options->exclNormExprs + ii * 10, name) )
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Select directory entries based on the filenames, --exclude
+ * and --where options from command line.
+ * @param options - pointer to options
+ * @param wdp - pointer to directory entry.
+ * @return 1 if to handle file; 0 if to ignore file.
+ */
+int selectDirEnt(Options_t *options, const InWorkingDir_t *wdp)
+{
+	if ( options->numArgFiles && filterWhich(options, wdp) < 0 )
+		return 0;
+	if ( options->numExcludes )
+	{
+		FilterMemo_t *mp;
+		int excluded;
+
+		mp = memoSlot(options, wdp->rt11.name);
+		if ( mp && mp->excluded != FILTMEMO_NEW )
+			excluded = mp->excluded;
+		else
+		{
+			excluded = matchExclude(options, wdp->ffull);
+			if ( mp )
+				mp->excluded = excluded;
+		}
+		if ( excluded )
+			return 0;
+	}
+	if ( options->where )
+		return whereExec(options->where, wdp);
+	return 1;
+}
+
+/**
+ * Filter filenames based on input from command line.
+ * @param options - pointer to options
+ * @param name - pointer to null terminated filename to check.
+ * @return 1 if to handle file; 0 if to ignore file.
+ */
+int filterFilename(Options_t *options, const char *name)
+{
+	if ( !options->numArgFiles )
+		return 1;
+	return matchName(options, name) >= 0;
+}
+
+/**
+ * Convert a filename wildcard into the form used by normexec().
+ * @param dst - pointer to 10 byte buffer into which to place result.
+ * @param src - pointer to null terminated filename wildcard.
+ * @return 0 on success, 1 if wildcard is invalid. Error message will have been displayed.
+ */
+int mkNormExpr(char *dst, const char *src)
+{
+	char *filePtr, cc;
+	const char *ext, *name = src;
+
+	/* prefill with ' ' */
+	memset(dst, ' ', 9);
+	dst[9] = 0;
+	ext = strchr(src, '.');
+	if ( ext )
+	{
+		if ( ext - src > 6 )
+		{
+			fprintf(stderr, "Filename is too long: '%s'. Cannot contain more than 6 characters.\n", name);
+			return 1;
+		}
+		if ( strlen(ext + 1) > 3 )
+		{
+			fprintf(stderr, "Filetype is too long: '%s'. Cannot contain more than 3 characters.\n", name);
+			return 1;
+		}
+	}
+	else if ( strlen(src) > 6 )
+	{
+		fprintf(stderr, "Filename is too long: '%s'. Cannot contain more than 6 characters.\n", name);
+		return 1;
+	}
+	filePtr = dst;
+	while ( *src && (!ext || src < ext) )
+	{
+		cc = *src++;
+		if ( cc == '*' )
+		{
+			memset(filePtr, '?', dst + 6 - filePtr);
+			break;
+		}
+		if ( islower(cc) )
+			cc = toupper(cc);
+		*filePtr++ = cc;
+	}
+	if ( ext )
+	{
+		src = ext + 1;
+		filePtr = dst + 6;
+		while ( *src )
+		{
+			cc = *src++;
+			if ( cc == '*' )
+			{
+				memset(filePtr, '?', dst + 9 - filePtr);
+				break;
+			}
+			if ( islower(cc) )
+				cc = toupper(cc);
+			*filePtr++ = cc;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Compile the --exclude filters.
+ * @param options - pointer to options
+ * @return 0 on success, 1 on error. Error message will have been displayed.
+ */
+int buildExcludes(Options_t *options)
+{
+	int ii;
+
+	if ( !options->numExcludes )
+		return 0;
+#if !NO_REGEXP
+	if ( (options->fileOpts & FILEOPTS_REGEXP) )
+	{
+		options->exclRexts = (regex_t *)calloc(options->numExcludes, sizeof(regex_t));
+		if ( !options->exclRexts )
+		{
+			fprintf(stderr, "Ran out of memory allocating %d bytes for exclude compiles\n",
+					(int)(options->numExcludes * sizeof(regex_t)));
+			return 1;
+		}
+		for ( ii = 0; ii < options->numExcludes; ++ii )
+		{
+			int cv;
+
+			cv = regcomp(options->exclRexts + ii, options->excludes[ii], REG_ICASE | REG_NOSUB);
+			if ( cv )
+			{
+				char tmp[512];
+				regerror(cv, options->exclRexts + ii, tmp, sizeof(tmp));
+				fprintf(stderr, "Error performing regex() on '%s': %s\n",
+						options->excludes[ii], tmp);
+				/* Only free the ones that compiled */
+				while ( --ii >= 0 )
+					regfree(options->exclRexts + ii);
+				free(options->exclRexts);
+				options->exclRexts = NULL;
+				return 1;
+			}
+		}
+		return 0;
+	}
+#endif
+	options->exclNormExprs = (char *)calloc(options->numExcludes, 10);
+	if ( !options->exclNormExprs )
+	{
+		fprintf(stderr, "Ran out of memory allocating %d bytes for exclude wildcards\n",
+				options->numExcludes * 10);
+		return 1;
+	}
+	for ( ii = 0; ii < options->numExcludes; ++ii )
+	{
+		if ( mkNormExpr(options->exclNormExprs + ii * 10, options->excludes[ii]) )
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Combine all the compiled regular expressions into one.
+ * @param options - pointer to options
+ * @return 0. A failure to combine them is not an error, they just get used one at a time.
+ */
+int buildRexUnion(Options_t *options)
+{
+#if !NO_REGEXP
+	char *expr, *dst;
+	const char *src;
+	int ii, len, grp, cv;
+
+	if ( options->numArgFiles < 2 || !options->rexts )
+		return 0;
+	len = 0;
+	for ( ii = 0; ii < options->numArgFiles; ++ii )
+	{
+		/* A back reference would point at the wrong group once wrapped */
+		for ( src = options->argFiles[ii]; *src; ++src )
+		{
+			if ( *src == '\\' && src[1] )
+			{
+				++src;
+				if ( isdigit(*src) )
+					return 0;
+			}
+		}
+		len += strlen(options->argFiles[ii]) + 6;
+	}
+	expr = (char *)malloc(len + 1);
+	options->rexGroups = (int *)malloc(options->numArgFiles * sizeof(int));
+	options->rexUnion = (regex_t *)calloc(1, sizeof(regex_t));
+	if ( !expr || !options->rexGroups || !options->rexUnion )
+	{
+		free(expr);
+		freeRexUnion(options);
+		return 0;
+	}
+	dst = expr;
+	grp = 1;
+	for ( ii = 0; ii < options->numArgFiles; ++ii )
+	{
+		if ( ii )
+		{
+			*dst++ = '\\';
+			*dst++ = '|';
+		}
+		*dst++ = '\\';
+		*dst++ = '(';
+		strcpy(dst, options->argFiles[ii]);
+		dst += strlen(dst);
+		*dst++ = '\\';
+		*dst++ = ')';
+		/* Remember which group belongs to this expression and skip over any it has inside */
+		options->rexGroups[ii] = grp;
+		grp += 1 + options->rexts[ii].re_nsub;
+	}
+	*dst = 0;
+	cv = regcomp(options->rexUnion, expr, REG_ICASE);
+	if ( !cv && options->rexUnion->re_nsub + 1 != (size_t)grp )
+	{
+		/* Didn't come out the way we expected, so don't trust it */
+		regfree(options->rexUnion);
+		cv = 1;
+	}
+	if ( !cv )
+	{
+		options->rexNumMatch = grp;
+		options->rexMatch = (regmatch_t *)malloc(grp * sizeof(regmatch_t));
+		if ( !options->rexMatch )
+		{
+			regfree(options->rexUnion);
+			cv = 1;
+		}
+	}
+	if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
+	{
+		printf("buildRexUnion(): %s %d expressions into '%s'\n",
+			   cv ? "Failed to combine" : "Combined", options->numArgFiles, expr);
+	}
+	free(expr);
+	if ( cv )
+	{
+		free(options->rexUnion);
+		options->rexUnion = NULL;
+		freeRexUnion(options);
+	}
+#endif
+	return 0;
+}
+
+/**
+ * Free the combined regular expression.
+ * @param options - pointer to options
+ * @return nothing
+ */
+void freeRexUnion(Options_t *options)
+{
+#if !NO_REGEXP
+	if ( options->rexUnion )
+	{
+		regfree(options->rexUnion);
+		free(options->rexUnion);
+		options->rexUnion = NULL;
+	}
+	if ( options->rexMatch )
+	{
+		free(options->rexMatch);
+		options->rexMatch = NULL;
+	}
+	if ( options->rexGroups )
+	{
+		free(options->rexGroups);
+		options->rexGroups = NULL;
+	}
+	options->rexNumMatch = 0;
+#endif
+}
+
+/**
+ * Free everything used to filter filenames.
+ * @param options - pointer to options
+ * @return nothing
+ */
+void freeFilters(Options_t *options)
+{
+#if !NO_REGEXP
+	freeRexUnion(options);
+	if ( options->rexts )
+	{
+		int ii;
+
+		for ( ii = 0; ii < options->numArgFiles; ++ii )
+			regfree(options->rexts + ii);
+		free(options->rexts);
+		options->rexts = NULL;
+	}
+	if ( options->exclRexts )
+	{
+		int ii;
+
+		for ( ii = 0; ii < options->numExcludes; ++ii )
+			regfree(options->exclRexts + ii);
+		free(options->exclRexts);
+		options->exclRexts = NULL;
+	}
+#endif
+	if ( options->exclNormExprs )
+	{
+		free(options->exclNormExprs);
+		options->exclNormExprs = NULL;
+	}
+	if ( options->excludes )
+	{
+		free((void *)options->excludes);
+		options->excludes = NULL;
+		options->numExcludes = 0;
+	}
+	if ( options->where )
+	{
+		whereFree(options->where);
+		options->where = NULL;
+	}
+	if ( options->normExprs )
+	{
+		free(options->normExprs);
+		options->normExprs = NULL;
+	}
+	if ( options->filterMemo )
+	{
+		free(options->filterMemo);
+		options->filterMemo = NULL;
+		options->filterMemoSize = 0;
+		options->filterMemoUsed = 0;
+	}
+}
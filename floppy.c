@@ -59,6 +59,7 @@ int descramble(Options_t *options)
 	int totBlocks;
 	U8 * src,*dst;
 
+	statBegin(options, STAT_PH_DESCRAMBLE);
 	sectorLen = (options->cmdOpts & CMDOPT_SINGLE_FLPY) ? 128 : 256;
 	totBlocks = (NUM_SECTORS * (NUM_TRACKS - 1));   /* assume block size is sector size */
 	if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) || options->verbose )
@@ -95,6 +96,7 @@ int descramble(Options_t *options)
 		/* advance output pointer */
 		dst += sectorLen;
 	}
+	statEnd(options, STAT_PH_DESCRAMBLE);
 	return 0;
 }
 
@@ -113,6 +115,7 @@ int rescramble(Options_t *options, U8 *optionalInput)
 	int totBlocks;
 	U8 * src,*dst;
 
+	statBegin(options, STAT_PH_DESCRAMBLE);
 	sectorLen = (options->cmdOpts & CMDOPT_SINGLE_FLPY) ? 128 : 256;
 	totBlocks = (NUM_SECTORS * (NUM_TRACKS - 1));   /* assume block size is sector size */
 	src = optionalInput ? optionalInput : options->floppyImageUnscrambled;
@@ -143,6 +146,7 @@ int rescramble(Options_t *options, U8 *optionalInput)
 		/* advance output pointer */
 		src += sectorLen;
 	}
+	statEnd(options, STAT_PH_DESCRAMBLE);
 	return 0;
 }
 
@@ -97,83 +97,65 @@ static int get_files(Options_t *options, int regExpFlg, int exprType, int argc,
 					break;
 				}
 			}
+			if ( !xit )
+				buildRexUnion(options);
 		}
 		else
 #endif	/* !NO_REGEXP */
 		{
-			char *homePtr, *filePtr, cc;
-			const char *src, *ext;
-
 			options->normExprs = (char *)retv;
-			homePtr = (char *)retv;
-			for ( ii = 0; ii < cnt; ++ii, homePtr += 10 )
+			for ( ii = 0; ii < cnt; ++ii )
 			{
-				/* point to temp filename */
-				filePtr = homePtr;
-				/* prefill with ' ' */
-				memset(filePtr, ' ', 9);
-				filePtr[9] = 0;
-				src = options->argFiles[ii];
-				ext = strchr(src, '.');
-				if ( ext )
-				{
-					if ( ext - src > 6 )
-					{
-						fprintf(stderr, "Filename is too long: '%s'. Cannot contain more than 6 characters.\n", src);
-						xit = 1;
-						break;
-					}
-					if ( strlen(ext + 1) > 3 )
-					{
-						fprintf(stderr, "Filetype is too long: '%s'. Cannot contain more than 3 characters.\n", src);
-						xit = 1;
-						break;
-					}
-				}
-				else if ( strlen(src) > 6 )
+				if ( mkNormExpr(options->normExprs + ii * 10, options->argFiles[ii]) )
 				{
-					fprintf(stderr, "Filename is too long: '%s'. Cannot contain more than 6 characters.\n", src);
 					xit = 1;
 					break;
 				}
-				while ( *src && (ext && src < ext) )
-				{
-					cc = *src++;
-					if ( cc == '*' )
-					{
-						memset(filePtr, '?', homePtr + 6 - filePtr);
-						break;
-					}
-					if ( islower(cc) )
-						cc = toupper(cc);
-					*filePtr++ = cc;
-				}
-				if ( ext )
-				{
-					src = ext + 1;
-					filePtr = homePtr + 6;
-					while ( *src )
-					{
-						cc = *src++;
-						if ( cc == '*' )
-						{
-							memset(filePtr, '?', homePtr + 9 - filePtr);
-							break;
-						}
-						if ( islower(cc) )
-							cc = toupper(cc);
-						*filePtr++ = cc;
-					}
-				}
 			}
 		}
 	}
 	return xit;
 }
 
+/**
+ * Handle the --where and --exclude options common to ls, out and del.
+ * @param options - pointer to options.
+ * @param opt - option letter.
+ * @param arg - option argument.
+ * @return 0 if success; non-zero if failure.
+ */
+static int get_select(Options_t *options, int opt, const char *arg)
+{
+	if ( opt == 'w' )
+	{
+		if ( options->where )
+		{
+			fprintf(stderr, "Only one --where expression allowed. Combine them with &&.\n");
+			return 1;
+		}
+		options->where = whereCompile(arg);
+		return options->where ? 0 : 1;
+	}
+	if ( !(options->numExcludes & 7) )
+	{
+		const char **newList;
+
+		newList = (const char **)realloc((void *)options->excludes, (options->numExcludes + 8) * sizeof(char *));
+		if ( !newList )
+		{
+			fprintf(stderr, "Ran out of memory allocating exclude list\n");
+			return 1;
+		}
+		options->excludes = newList;
+	}
+	options->excludes[options->numExcludes++] = arg;
+	return 0;
+}
+
 static struct option long_dir_opts[] = {
 	{ "all", 0, 0, 'a' },
 	{ "col", 1, 0, 'c' },
+	{ "exclude", 1, 0, 'x' },
 	{ "help", 0, 0, 'h' },
 	{ "full", 0, 0, 'f' },
 	{ "reverse", 0, 0, 'r' },
@@ -182,6 +164,7 @@ static struct option long_dir_opts[] = {
 #endif
 	{ "sort", 1, 0, 's' },
 	{ "verbose", 0, 0, 'v' },
+	{ "where", 1, 0, 'w' },
 	{ 0, 0, 0, 0 }
 };
 
@@ -194,9 +177,9 @@ static int get_ls(Options_t *options, int argc, char *const *argv)
 	while ( 1 )
 	{
 #if !NO_REGEXP
-		static const char Opts[] = "-ac:fh?rRs:v123456789";
+		static const char Opts[] = "-ac:fh?rRs:vw:x:123456789";
 #else
-		static const char Opts[] = "-ac:fh?rs:v123456789";
+		static const char Opts[] = "-ac:fh?rs:vw:x:123456789";
 #endif
 		goptret = getopt_long(argc, argv, Opts, long_dir_opts, &option_index);
 #if DEBUG_ARGS
@@ -240,6 +223,11 @@ static int get_ls(Options_t *options, int argc, char *const *argv)
 		case '9':
 			options->columns = goptret - '0';
 			continue;
+		case 'w':
+		case 'x':
+			if ( get_select(options, goptret, optarg) )
+				return 1;
+			continue;
 		case 'h':
 		case '?':
 			options->lsOpts |= LSOPTS_HELP;
@@ -254,30 +242,39 @@ static int get_ls(Options_t *options, int argc, char *const *argv)
 #endif
 		case 's':
 			sopt = 0;
+			options->numSortKeys = 0;
 			for (; optarg && *optarg; ++optarg )
 			{
-				if ( *optarg == 'n' )
-				{
-					sopt |= SORTBY_NAME;
-					continue;
-				}
-				if ( *optarg == 'd' )
-				{
-					sopt |= SORTBY_DATE;
+				int key;
+
+				if ( *optarg == ',' )
 					continue;
-				}
-				if ( *optarg == 't' )
+				switch (tolower(*optarg))
 				{
-					sopt |= SORTBY_TYPE;
-					continue;
+				case 'n':
+					key = SORTBY_NAME;
+					break;
+				case 'd':
+					key = SORTBY_DATE;
+					break;
+				case 't':
+					key = SORTBY_TYPE;
+					break;
+				case 's':
+					key = SORTBY_SIZE;
+					break;
+				default:
+					fprintf(stderr, "Undefined sort option(s): --sort='%s'\n", optarg);
+					return 1;
 				}
-				if ( *optarg == 's' )
-				{
-					sopt |= SORTBY_SIZE;
+				/* A key given more than once only counts the first time */
+				if ( (sopt & key) )
 					continue;
-				}
-				fprintf(stderr, "Undefined sort option(s): --sort='%s'\n", optarg);
-				return 1;
+				sopt |= key;
+				/* Uppercase means that key sorts in descending order */
+				if ( isupper(*optarg) )
+					key |= SORTBY_REV;
+				options->sortKeys[options->numSortKeys++] = key;
 			}
 			if ( !sopt )
 			{
@@ -306,6 +303,7 @@ static struct option long_in_opts[] = {
 	{ "rexp", 0, 0, 'R' },
 #endif
 	{ "assumeyes", 0, 0, 'y' },
+	{ "tar", 1, 0, 'T' },
 	{ "time", 0, 0, 't' },
 	{ "verbose", 0, 0, 'v' },
 	{ 0, 0, 0, 0 }
@@ -319,9 +317,9 @@ static int get_inp(Options_t *options, int argc, char *const *argv)
 	while ( 1 )
 	{
 #if !NO_REGEXP
-		static const char Opts[] = "-abd:Rtvhy?";
+		static const char Opts[] = "-abd:RtT:vhy?";
 #else
-		static const char Opts[] = "-abd:tvhy?";
+		static const char Opts[] = "-abd:tT:vhy?";
 #endif
 		goptret = getopt_long(argc, argv, Opts, long_in_opts, &option_index);
 #if DEBUG_ARGS
@@ -335,13 +333,16 @@ static int get_inp(Options_t *options, int argc, char *const *argv)
 #endif
 		if ( goptret < 0 )
 		{
-			options->inOpts = INOPTS_HELP;
+			/* Without filenames, in needs an archive to copy from */
+			if ( !options->tarFile )
+				options->inOpts = INOPTS_HELP;
 			return 0;
 		}
 		switch (goptret)
 		{
 		case 1:
-			return get_files(options, 0, (options->fileOpts & FILEOPTS_REGEXP), argc, argv);
+			/* With --tar the names pick members of the archive */
+			return get_files(options, options->tarFile != NULL, (options->fileOpts & FILEOPTS_REGEXP), argc, argv);
 		case 'a':
 			options->inOpts |= INOPTS_ASC;
 			continue;
@@ -407,6 +408,9 @@ static int get_inp(Options_t *options, int argc, char *const *argv)
 		case 'y':
 			options->inOpts |= INOPTS_NOASK;
 			continue;
+		case 'T':
+			options->tarFile = optarg;
+			continue;
 #if !NO_REGEXP
 		case 'R':
 			options->fileOpts |= FILEOPTS_REGEXP;
@@ -434,6 +438,7 @@ static int get_inp(Options_t *options, int argc, char *const *argv)
 static struct option long_out_opts[] = {
 	{ "ascii", 0, 0, 'a' },
 	{ "binary", 0, 0, 'b' },
+	{ "exclude", 1, 0, 'x' },
 	{ "help", 0, 0, 'h' },
 	{ "lower", 0, 0, 'l' },
 	{ "outdir", 1, 0, 'o' },
@@ -441,8 +446,10 @@ static struct option long_out_opts[] = {
 	{ "rexp", 0, 0, 'R' },
 #endif
 	{ "assumeyes", 0, 0, 'y' },
+	{ "tar", 1, 0, 'T' },
 	{ "time", 0, 0, 't' },
 	{ "verbose", 0, 0, 'v' },
+	{ "where", 1, 0, 'w' },
 	{ 0, 0, 0, 0 }
 };
 
@@ -454,9 +461,9 @@ static int get_out(Options_t *options, int argc, char *const *argv)
 	while ( 1 )
 	{
 #if !NO_REGEXP
-		static const char Opts[] = "-ablno:Rtvyh?";
+		static const char Opts[] = "-ablno:RtT:vw:x:yh?";
 #else
-		static const char Opts[] = "-ablno:tvyh?";
+		static const char Opts[] = "-ablno:tT:vw:x:yh?";
 #endif
 		goptret = getopt_long(argc, argv, Opts, long_out_opts, &option_index);
 #if DEBUG_ARGS
@@ -470,7 +477,9 @@ static int get_out(Options_t *options, int argc, char *const *argv)
 #endif
 		if ( goptret < 0 )
 		{
-			options->outOpts = OUTOPTS_HELP;
+			/* Without filenames, out needs something else to select files (an archive gets all of them) */
+			if ( !options->where && !options->numExcludes && !options->tarFile )
+				options->outOpts = OUTOPTS_HELP;
 			return 0;
 		}
 		switch (goptret)
@@ -489,6 +498,9 @@ static int get_out(Options_t *options, int argc, char *const *argv)
 		case 'o':
 			options->outDir = optarg;
 			continue;
+		case 'T':
+			options->tarFile = optarg;
+			continue;
 		case 'y':
 			options->outOpts |= OUTOPTS_NOASK;
 			continue;
@@ -503,6 +515,11 @@ static int get_out(Options_t *options, int argc, char *const *argv)
 		case 'v':
 			options->outOpts |= OUTOPTS_VERB;
 			continue;
+		case 'w':
+		case 'x':
+			if ( get_select(options, goptret, optarg) )
+				return 1;
+			continue;
 		case 'h':
 		case '?':
 			options->outOpts |= OUTOPTS_HELP;
@@ -517,12 +534,14 @@ static int get_out(Options_t *options, int argc, char *const *argv)
 }
 
 static struct option long_del_opts[] = {
+	{ "exclude", 1, 0, 'x' },
 	{ "help", 0, 0, 'h' },
 #if !NO_REGEXP
 	{ "rexp", 0, 0, 'R' },
 #endif
 	{ "assumeyes", 0, 0, 'y' },
 	{ "verbose", 0, 0, 'v' },
+	{ "where", 1, 0, 'w' },
 	{ 0, 0, 0, 0 }
 };
 
@@ -534,9 +553,9 @@ static int get_del(Options_t *options, int argc, char *const *argv)
 	while ( 1 )
 	{
 #if !NO_REGEXP
-		static const char Opts[] = "-hRvy?";
+		static const char Opts[] = "-hRvw:x:y?";
 #else
-		static const char Opts[] = "-hvy?";
+		static const char Opts[] = "-hvw:x:y?";
 #endif
 		goptret = getopt_long(argc, argv, Opts, long_del_opts, &option_index);
 #if DEBUG_ARGS
@@ -550,19 +569,26 @@ static int get_del(Options_t *options, int argc, char *const *argv)
 #endif
 		if ( goptret < 0 )
 		{
-			options->delOpts = DELOPTS_HELP;
+			/* Without filenames, del needs something else to select files */
+			if ( !options->where && !options->numExcludes )
+				options->delOpts = DELOPTS_HELP;
 			return 0;
 		}
 		switch (goptret)
 		{
 		case 1:
-			return get_files(options, 1, (options->lsOpts & DELOPTS_REGEXP), argc, argv);
+			return get_files(options, 1, (options->fileOpts & FILEOPTS_REGEXP), argc, argv);
 		case 'y':
 			options->delOpts |= DELOPTS_NOASK;
 			continue;
 		case 'v':
 			options->delOpts |= DELOPTS_VERB;
 			continue;
+		case 'w':
+		case 'x':
+			if ( get_select(options, goptret, optarg) )
+				return 1;
+			continue;
 		case 'h':
 		case '?':
 			options->delOpts |= DELOPTS_HELP;
@@ -570,6 +596,7 @@ static int get_del(Options_t *options, int argc, char *const *argv)
 #if !NO_REGEXP
 		case 'R':
 			options->delOpts |= DELOPTS_REGEXP;
+			options->fileOpts |= FILEOPTS_REGEXP;
 			continue;
 #endif
 		default:
@@ -645,6 +672,7 @@ static struct option long_new_opts[] = {
 	{ "blocks", 1, 0, 'b' },
 	{ "help", 0, 0, 'h' },
 	{ "assumeyes", 0, 0, 'y' },
+	{ "preallocate", 0, 0, 'p' },
 	{ "segments", 1, 0, 's' },
 	{ "verbose", 0, 0, 'v' },
 	{ 0, 0, 0, 0 }
@@ -658,7 +686,7 @@ static int get_new(Options_t *options, int argc, char *const *argv)
 	options->todo |= TODO_NEW;
 	while ( 1 )
 	{
-		goptret = getopt_long(argc, argv, "-b:h?s:vy", long_new_opts, &option_index);
+		goptret = getopt_long(argc, argv, "-b:h?ps:vy", long_new_opts, &option_index);
 #if DEBUG_ARGS
 		if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
 		{
@@ -680,6 +708,9 @@ static int get_new(Options_t *options, int argc, char *const *argv)
 		case 'v':
 			options->newOpts |= NEWOPTS_VERB;
 			continue;
+		case 'p':
+			options->newOpts |= NEWOPTS_PREALLOC;
+			continue;
 		case 'h':
 		case '?':
 			options->newOpts |= NEWOPTS_HELP;
@@ -698,7 +729,7 @@ static int get_new(Options_t *options, int argc, char *const *argv)
 			options->newDiskSize = strtoul(optarg, &retv, 0);
 			if ( options->newDiskSize < 400 || options->newDiskSize > 65535 || !retv || *retv )
 			{
-				fprintf(stderr, "Invalid disk size in 512 byte blocks: \"%s\". Must be 400 < n < 65535\n", optarg);
+				fprintf(stderr, "Invalid disk size in 512 byte blocks: \"%s\". Must be 400 <= n <= 65535\n", optarg);
 				return 1;
 			}
 			continue;
@@ -711,6 +742,448 @@ static int get_new(Options_t *options, int argc, char *const *argv)
 	return 0;
 }
 
+static struct option long_mkfs_opts[] = {
+	{ "ascii", 1, 0, 'a' },
+	{ "blocks", 1, 0, 'b' },
+	{ "from-dir", 1, 0, 'D' },
+	{ "help", 0, 0, 'h' },
+	{ "assumeyes", 0, 0, 'y' },
+	{ "preallocate", 0, 0, 'p' },
+	{ "segments", 1, 0, 's' },
+	{ "time", 0, 0, 't' },
+	{ "verbose", 0, 0, 'v' },
+	{ 0, 0, 0, 0 }
+};
+
+static int get_mkfs(Options_t *options, int argc, char *const *argv)
+{
+	int goptret;
+	char *retv;
+
+	options->todo |= TODO_MKFS;
+	while ( 1 )
+	{
+		goptret = getopt_long(argc, argv, "-a:b:D:h?ps:tvy", long_mkfs_opts, &option_index);
+#if DEBUG_ARGS
+		if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
+		{
+			printf("get_mkfs:, goptret=%d(%c), optarg=%p(\"%s\"), optind=%d, optopt=%d\n",
+				   goptret,
+				   isprint(goptret) ? goptret : '?',
+				   optarg, optarg, optind, optopt);
+		}
+#endif
+		if ( goptret < 0 )
+		{
+			if ( !options->hostDir )
+				options->newOpts = NEWOPTS_HELP;
+			return 0;
+		}
+		switch (goptret)
+		{
+		case 1:
+		case 'D':
+			if ( options->hostDir )
+			{
+				fprintf(stderr, "Only one directory allowed\n");
+				return 1;
+			}
+			options->hostDir = optarg;
+			continue;
+		case 'a':
+			options->asciiTypes = optarg;
+			continue;
+		case 'y':
+			options->newOpts |= NEWOPTS_NOASK;
+			continue;
+		case 'v':
+			options->newOpts |= NEWOPTS_VERB;
+			continue;
+		case 'p':
+			options->newOpts |= NEWOPTS_PREALLOC;
+			continue;
+		case 't':
+			options->fileOpts |= FILEOPTS_TIMESTAMP;
+			continue;
+		case 'h':
+		case '?':
+			options->newOpts |= NEWOPTS_HELP;
+			continue;
+		case 's':
+			retv = NULL;
+			options->newMaxSeg = strtoul(optarg, &retv, 0);
+			if ( options->newMaxSeg >= 32 || options->newMaxSeg < 1 || !retv || *retv )
+			{
+				fprintf(stderr, "Invalid segment number: \"%s\". Can only be 1 through 31\n", optarg);
+				return 1;
+			}
+			continue;
+		case 'b':
+			retv = NULL;
+			options->newDiskSize = strtoul(optarg, &retv, 0);
+			if ( options->newDiskSize < 400 || options->newDiskSize > 65535 || !retv || *retv )
+			{
+				fprintf(stderr, "Invalid disk size in 512 byte blocks: \"%s\". Must be 400 <= n <= 65535\n", optarg);
+				return 1;
+			}
+			continue;
+		default:
+			break;
+		}
+		break;
+	}
+	options->newOpts = NEWOPTS_HELP;
+	return 0;
+}
+
+static struct option long_sync_opts[] = {
+	{ "ascii", 1, 0, 'a' },
+	{ "delete", 0, 0, 'd' },
+	{ "from-dir", 1, 0, 'D' },
+	{ "help", 0, 0, 'h' },
+	{ "time", 0, 0, 't' },
+	{ "verbose", 0, 0, 'v' },
+	{ 0, 0, 0, 0 }
+};
+
+static int get_sync(Options_t *options, int argc, char *const *argv)
+{
+	int goptret;
+
+	options->todo |= TODO_SYNC;
+	while ( 1 )
+	{
+		goptret = getopt_long(argc, argv, "-a:dD:h?tv", long_sync_opts, &option_index);
+#if DEBUG_ARGS
+		if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
+		{
+			printf("get_sync:, goptret=%d(%c), optarg=%p(\"%s\"), optind=%d, optopt=%d\n",
+				   goptret,
+				   isprint(goptret) ? goptret : '?',
+				   optarg, optarg, optind, optopt);
+		}
+#endif
+		if ( goptret < 0 )
+		{
+			if ( !options->hostDir )
+				options->syncOpts = SYNCOPTS_HELP;
+			return 0;
+		}
+		switch (goptret)
+		{
+		case 1:
+		case 'D':
+			if ( options->hostDir )
+			{
+				fprintf(stderr, "Only one directory allowed\n");
+				return 1;
+			}
+			options->hostDir = optarg;
+			continue;
+		case 'a':
+			options->asciiTypes = optarg;
+			continue;
+		case 'd':
+			options->syncOpts |= SYNCOPTS_DELETE;
+			continue;
+		case 'v':
+			options->syncOpts |= SYNCOPTS_VERB;
+			continue;
+		case 't':
+			options->fileOpts |= FILEOPTS_TIMESTAMP;
+			continue;
+		case 'h':
+		case '?':
+			options->syncOpts |= SYNCOPTS_HELP;
+			continue;
+		default:
+			break;
+		}
+		break;
+	}
+	options->syncOpts = SYNCOPTS_HELP;
+	return 0;
+}
+
+static struct option long_diff_opts[] = {
+	{ "ascii", 1, 0, 'a' },
+	{ "exclude", 1, 0, 'x' },
+	{ "help", 0, 0, 'h' },
+	{ "machine", 0, 0, 'm' },
+	{ "other-double", 0, 0, 'F' },
+	{ "other-floppy", 0, 0, 'f' },
+	{ "quick", 0, 0, 'q' },
+#if !NO_REGEXP
+	{ "rexp", 0, 0, 'R' },
+#endif
+	{ "time", 0, 0, 't' },
+	{ "verbose", 0, 0, 'v' },
+	{ "where", 1, 0, 'w' },
+	{ 0, 0, 0, 0 }
+};
+
+static int get_diff(Options_t *options, int argc, char *const *argv)
+{
+	int goptret;
+
+	options->todo |= TODO_DIFF;
+	while ( 1 )
+	{
+#if !NO_REGEXP
+		static const char Opts[] = "-a:fFh?mqRtvw:x:";
+#else
+		static const char Opts[] = "-a:fFh?mqtvw:x:";
+#endif
+		goptret = getopt_long(argc, argv, Opts, long_diff_opts, &option_index);
+#if DEBUG_ARGS
+		if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
+		{
+			printf("get_diff:, goptret=%d(%c), optarg=%p(\"%s\"), optind=%d, optopt=%d\n",
+				   goptret,
+				   isprint(goptret) ? goptret : '?',
+				   optarg, optarg, optind, optopt);
+		}
+#endif
+		if ( goptret < 0 )
+		{
+			if ( !options->diffWith )
+				options->diffOpts = DIFFOPTS_HELP;
+			return 0;
+		}
+		switch (goptret)
+		{
+		case 1:
+			/* The first name is what to compare with, the rest pick the files */
+			if ( !options->diffWith )
+			{
+				options->diffWith = optarg;
+				continue;
+			}
+			return get_files(options, 1, (options->fileOpts & FILEOPTS_REGEXP), argc, argv);
+		case 'a':
+			options->asciiTypes = optarg;
+			continue;
+		case 'f':
+			options->diffOpts |= DIFFOPTS_SGL;
+			continue;
+		case 'F':
+			options->diffOpts |= DIFFOPTS_DBL;
+			continue;
+		case 'm':
+			options->diffOpts |= DIFFOPTS_MACHINE;
+			continue;
+		case 'q':
+			options->diffOpts |= DIFFOPTS_QUICK;
+			continue;
+		case 't':
+			options->fileOpts |= FILEOPTS_TIMESTAMP;
+			continue;
+		case 'v':
+			options->diffOpts |= DIFFOPTS_VERB;
+			continue;
+		case 'w':
+		case 'x':
+			if ( get_select(options, goptret, optarg) )
+				return 1;
+			continue;
+#if !NO_REGEXP
+		case 'R':
+			options->fileOpts |= FILEOPTS_REGEXP;
+			continue;
+#endif
+		case 'h':
+		case '?':
+			options->diffOpts |= DIFFOPTS_HELP;
+			continue;
+		default:
+			break;
+		}
+		break;
+	}
+	options->diffOpts = DIFFOPTS_HELP;
+	return 0;
+}
+
+static struct option long_manifest_opts[] = {
+	{ "ascii", 1, 0, 'a' },
+	{ "check", 1, 0, 'c' },
+	{ "csv", 0, 0, 'C' },
+	{ "exclude", 1, 0, 'x' },
+	{ "hash", 1, 0, 'H' },
+	{ "help", 0, 0, 'h' },
+	{ "jobs", 1, 0, 'j' },
+	{ "output", 1, 0, 'o' },
+#if !NO_REGEXP
+	{ "rexp", 0, 0, 'R' },
+#endif
+	{ "verbose", 0, 0, 'v' },
+	{ "where", 1, 0, 'w' },
+	{ 0, 0, 0, 0 }
+};
+
+/*
+ * Get the list of hashes for manifest.
+ * @param options - pointer to options list.
+ * @param arg - comma separated list of crc32c and/or sha256.
+ * @return 0 if success; non-zero if failure.
+ */
+static int get_hashes(Options_t *options, const char *arg)
+{
+	const char *cp;
+	int len;
+
+	while ( *arg )
+	{
+		cp = strchr(arg, ',');
+		len = cp ? cp - arg : (int)strlen(arg);
+		if ( len == 6 && !strncmp(arg, "crc32c", len) )
+			options->manOpts |= MANOPTS_CRC;
+		else if ( len == 6 && !strncmp(arg, "sha256", len) )
+			options->manOpts |= MANOPTS_SHA;
+		else
+		{
+			fprintf(stderr, "Unknown hash '%.*s'. Can be crc32c or sha256.\n", len, arg);
+			return 1;
+		}
+		arg += cp ? len + 1 : len;
+	}
+	return 0;
+}
+
+static int get_manifest(Options_t *options, int argc, char *const *argv)
+{
+	int goptret;
+	char *endp;
+
+	options->todo |= TODO_MANIFEST;
+	while ( 1 )
+	{
+#if !NO_REGEXP
+		static const char Opts[] = "-a:c:CH:h?j:o:Rvw:x:";
+#else
+		static const char Opts[] = "-a:c:CH:h?j:o:vw:x:";
+#endif
+		goptret = getopt_long(argc, argv, Opts, long_manifest_opts, &option_index);
+#if DEBUG_ARGS
+		if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
+		{
+			printf("get_manifest:, goptret=%d(%c), optarg=%p(\"%s\"), optind=%d, optopt=%d\n",
+				   goptret,
+				   isprint(goptret) ? goptret : '?',
+				   optarg, optarg, optind, optopt);
+		}
+#endif
+		if ( goptret < 0 )
+			return 0;
+		switch (goptret)
+		{
+		case 1:
+			return get_files(options, 1, (options->fileOpts & FILEOPTS_REGEXP), argc, argv);
+		case 'a':
+			options->asciiTypes = optarg;
+			continue;
+		case 'c':
+			options->manCheck = optarg;
+			continue;
+		case 'C':
+			options->manOpts |= MANOPTS_CSV;
+			continue;
+		case 'H':
+			if ( get_hashes(options, optarg) )
+				return 1;
+			continue;
+		case 'j':
+			options->manJobs = strtol(optarg, &endp, 0);
+			if ( *endp || options->manJobs < 1 )
+			{
+				fprintf(stderr, "Bad number of jobs '%s'\n", optarg);
+				return 1;
+			}
+			continue;
+		case 'o':
+			options->manOutput = optarg;
+			continue;
+		case 'v':
+			options->manOpts |= MANOPTS_VERB;
+			continue;
+		case 'w':
+		case 'x':
+			if ( get_select(options, goptret, optarg) )
+				return 1;
+			continue;
+#if !NO_REGEXP
+		case 'R':
+			options->fileOpts |= FILEOPTS_REGEXP;
+			continue;
+#endif
+		case 'h':
+		case '?':
+			options->manOpts |= MANOPTS_HELP;
+			continue;
+		default:
+			break;
+		}
+		break;
+	}
+	options->manOpts = MANOPTS_HELP;
+	return 0;
+}
+
+static struct option long_script_opts[] = {
+	{ "help", 0, 0, 'h' },
+	{ "verbose", 0, 0, 'v' },
+	{ 0, 0, 0, 0 }
+};
+
+static int get_script(Options_t *options, int argc, char *const *argv)
+{
+	int goptret;
+
+	options->todo |= TODO_SCRIPT;
+	while ( 1 )
+	{
+		goptret = getopt_long(argc, argv, "-h?v", long_script_opts, &option_index);
+#if DEBUG_ARGS
+		if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
+		{
+			printf("get_script:, goptret=%d(%c), optarg=%p(\"%s\"), optind=%d, optopt=%d\n",
+				   goptret,
+				   isprint(goptret) ? goptret : '?',
+				   optarg, optarg, optind, optopt);
+		}
+#endif
+		if ( goptret < 0 )
+		{
+			if ( !options->scriptFile )
+				options->scriptOpts = SCRIPTOPTS_HELP;
+			return 0;
+		}
+		switch (goptret)
+		{
+		case 1:
+			if ( options->scriptFile )
+			{
+				fprintf(stderr, "Only one script file allowed\n");
+				return 1;
+			}
+			options->scriptFile = optarg;
+			continue;
+		case 'v':
+			options->scriptOpts |= SCRIPTOPTS_VERB;
+			continue;
+		case 'h':
+		case '?':
+			options->scriptOpts |= SCRIPTOPTS_HELP;
+			continue;
+		default:
+			break;
+		}
+		break;
+	}
+	options->scriptOpts = SCRIPTOPTS_HELP;
+	return 0;
+}
+
 static int get_cmd(Options_t *options, int argc, char *const *argv)
 {
 	int goptret;
@@ -761,6 +1234,31 @@ static int get_cmd(Options_t *options, int argc, char *const *argv)
 				options->cmdState = CMDSTATE_NEW;
 				return 0;
 			}
+			if ( optarg && !strcmp(optarg, "script") )
+			{
+				options->cmdState = CMDSTATE_SCRIPT;
+				return 0;
+			}
+			if ( optarg && !strcmp(optarg, "mkfs") )
+			{
+				options->cmdState = CMDSTATE_MKFS;
+				return 0;
+			}
+			if ( optarg && !strcmp(optarg, "sync") )
+			{
+				options->cmdState = CMDSTATE_SYNC;
+				return 0;
+			}
+			if ( optarg && !strcmp(optarg, "diff") )
+			{
+				options->cmdState = CMDSTATE_DIFF;
+				return 0;
+			}
+			if ( optarg && !strcmp(optarg, "manifest") )
+			{
+				options->cmdState = CMDSTATE_MANIFEST;
+				return 0;
+			}
 			break;
 		case 'v':
 			options->verbose = 1;
@@ -775,12 +1273,16 @@ static int get_cmd(Options_t *options, int argc, char *const *argv)
 }
 
 static struct option long_cont_options[] = {
+	{ "cpu", 1, 0, 'C' },
 	{ "debug", 0, 0, 'd' },
 	{ "floppy", 0, 0, 'f' },
 	{ "double", 0, 0, 'F' },
 	{ "help", 0, 0, '?' },
 	{ "lba", 1, 0, 'L' },
 	{ "nowrite", 0, 0, 'n' },
+	{ "server", 2, 0, 'D' },
+	{ "stats", 2, 0, 'S' },
+	{ "trace", 1, 0, 'T' },
 	{ "verbose", 0, 0, 'v' },
 	{ 0, 0, 0, 0 }
 };
@@ -839,6 +1341,32 @@ static int get_container(Options_t *options, int argc, char *const *argv)
 		case 'n':
 			options->cmdOpts |= CMDOPT_NOWRITE;
 			continue;
+		case 'C':
+			if ( cpuForce(optarg) )
+				return 1;
+			continue;
+		case 'D':
+			/* An empty name means the default socket (see clientSocket()) */
+			options->server = optarg ? optarg : "";
+			continue;
+		case 'S':
+			if ( optarg && strcmp(optarg, "json") )
+			{
+				fprintf(stderr, "Invalid --stats format: \"%s\". Only json is supported.\n", optarg);
+				return 1;
+			}
+			if ( statInit(options, optarg ? STAT_FMT_JSON : STAT_FMT_TEXT) )
+				return 1;
+			continue;
+		case 'T':
+#if RTPIP_TRACE
+			if ( traceOpen(options, optarg) || statInit(options, STAT_FMT_NONE) )
+				return 1;
+			continue;
+#else
+			fprintf(stderr, "--trace is not available. Rebuild rtpip with 'make TRACE=1'.\n");
+			return 1;
+#endif
 		}
 		options->todo = TODO_HELP;
 		return 1;
@@ -848,36 +1376,92 @@ static int get_container(Options_t *options, int argc, char *const *argv)
 }
 
 /*
- * Process the command line arguments.
+ * Process the options and filenames that follow the command.
  * @param options - pointer to options list.
  * @param argc - number of command line arguments.
  * @param argv - pointer to array of command line arguments.
  * @return 0 if success; non-zero if failure.
  */
-int getcmds(Options_t *options, int argc, char *const *argv)
+static int get_cmdargs(Options_t *options, int argc, char *const *argv)
 {
-	if ( get_container(options, argc, argv) )
-		return 1;
-	if ( get_cmd(options, argc, argv) )
-		return 1;
 	switch (options->cmdState)
 	{
 	case CMDSTATE_LS:
-		return get_ls(options, argc, argv);
+		if ( get_ls(options, argc, argv) )
+			return 1;
+		break;
 	case CMDSTATE_IN:
 		return get_inp(options, argc, argv);
 	case CMDSTATE_OUT:
-		return get_out(options, argc, argv);
+		if ( get_out(options, argc, argv) )
+			return 1;
+		break;
 	case CMDSTATE_SQZ:
 		return get_sqz(options, argc, argv);
 	case CMDSTATE_DEL:
-		return get_del(options, argc, argv);
+		if ( get_del(options, argc, argv) )
+			return 1;
+		break;
 	case CMDSTATE_NEW:
 		return get_new(options, argc, argv);
-	default:
+	case CMDSTATE_SCRIPT:
+		return get_script(options, argc, argv);
+	case CMDSTATE_MKFS:
+		return get_mkfs(options, argc, argv);
+	case CMDSTATE_SYNC:
+		return get_sync(options, argc, argv);
+	case CMDSTATE_DIFF:
+		if ( get_diff(options, argc, argv) )
+			return 1;
 		break;
+	case CMDSTATE_MANIFEST:
+		if ( get_manifest(options, argc, argv) )
+			return 1;
+		break;
+	default:
+		options->todo =  TODO_HELP;
+		return 1;
 	}
-	options->todo =  TODO_HELP;
-	return 1;
+	/* Excludes are compiled last since -R can come after them */
+	return buildExcludes(options);
 }
 
+/*
+ * Process the command line arguments.
+ * @param options - pointer to options list.
+ * @param argc - number of command line arguments.
+ * @param argv - pointer to array of command line arguments.
+ * @return 0 if success; non-zero if failure.
+ */
+int getcmds(Options_t *options, int argc, char *const *argv)
+{
+	if ( get_container(options, argc, argv) )
+		return 1;
+	if ( get_cmd(options, argc, argv) )
+		return 1;
+	return get_cmdargs(options, argc, argv);
+}
+
+/*
+ * Process one line of a script. It is parsed just like a command line that
+ * starts with the command.
+ * @param options - pointer to options list.
+ * @param argc - number of arguments.
+ * @param argv - pointer to array of arguments (argv[1] is the command).
+ * @return 0 if success; non-zero if failure.
+ */
+int getScriptCmd(Options_t *options, int argc, char *const *argv)
+{
+	/* Setting optind to 0 makes getopt() start over with a new argv */
+	optind = 0;
+	if ( get_cmd(options, argc, argv) )
+		return 1;
+	if (    options->cmdState == CMDSTATE_NEW || options->cmdState == CMDSTATE_SCRIPT
+		 || options->cmdState == CMDSTATE_MKFS || options->cmdState == CMDSTATE_SYNC
+		 || options->cmdState == CMDSTATE_DIFF || options->cmdState == CMDSTATE_MANIFEST )
+	{
+		fprintf(stderr, "The '%s' command can't be used in a script\n", options->cmd);
+		return 1;
+	}
+	return get_cmdargs(options, argc, argv);
+}
@@ -0,0 +1,360 @@
+/*  $Id: imggen.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	imggen.c - Make synthetic RT11 container files for rtgen and rtbench.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtpip.h"
+
+/**
+ * @file imggen.c
+ * Make synthetic RT11 container files for rtgen and rtbench.
+ */
+
+/*
+ * Note: Everything is made from a private random number generator seeded
+ * from GenParams_t.seed so the same parameters always make the same image
+ * on every host. Files are laid down in LBA order with an optional empty
+ * area after each one (the fragmentation), then one empty area with what is
+ * left. Directory segments are filled in order leaving room in each one for
+ * an ENDBLK and a split so "in" has somewhere to go.
+ */
+
+static const char *const AscTypes[] = { "MAC", "TXT" };
+static const char *const BinTypes[] = { "SAV", "OBJ" };
+
+/** One entry of the directory being built */
+typedef struct
+{
+	Rt11DirEnt_t rt11;      /**< directory entry */
+	int lba;                /**< starting block */
+	int ascii;              /**< file is text */
+} GenEnt_t;
+
+/**
+ * Get the next pseudo random number.
+ * @param state - pointer to generator state.
+ * @return 32 bit random number.
+ */
+static unsigned long genRand(unsigned long *state)
+{
+	unsigned long xx = *state;
+
+	/* xorshift32 */
+	xx ^= (xx << 13) & 0xFFFFFFFFUL;
+	xx ^= xx >> 17;
+	xx ^= (xx << 5) & 0xFFFFFFFFUL;
+	*state = xx & 0xFFFFFFFFUL;
+	return *state;
+}
+
+/**
+ * Get a pseudo random number in a range.
+ * @param state - pointer to generator state.
+ * @param lo - lowest value.
+ * @param hi - highest value.
+ * @return number from lo to hi inclusive.
+ */
+static int genRange(unsigned long *state, int lo, int hi)
+{
+	if ( hi <= lo )
+		return lo;
+	return lo + (int)(genRand(state) % (unsigned long)(hi - lo + 1));
+}
+
+/**
+ * Pick a file size.
+ * @param gp - pointer to parameters.
+ * @param state - pointer to generator state.
+ * @return size in blocks.
+ */
+static int genSize(const GenParams_t *gp, unsigned long *state)
+{
+	int lo = gp->minBlks, hi = gp->maxBlks, bands, top;
+
+	if ( !gp->logSizes || lo >= hi )
+		return genRange(state, lo, hi);
+	/* Log uniform: pick one of the power of 2 bands between lo and hi then a size within it */
+	for ( bands = 0; (lo << (bands + 1)) <= hi; ++bands )
+		;
+	lo <<= genRange(state, 0, bands);
+	top = lo * 2 - 1;
+	return genRange(state, lo, top > hi ? hi : top);
+}
+
+/**
+ * Fill a buffer with text as it would appear in the container (crlf, ^Z, nulls).
+ * @param state - pointer to generator state.
+ * @param dst - where to put it.
+ * @param size - number of bytes in dst.
+ * @return nothing
+ */
+static void genText(unsigned long *state, char *dst, int size)
+{
+	static const char *const Ops[] = { "MOV", "ADD", "SUB", "CMP", "BNE", "JSR", "TST", "CLR" };
+	char line[80];
+	int len, used = 0, lineNo = 1;
+
+	/* Leave up to most of the last block unused like a real text file */
+	size -= genRange(state, 1, size > BLKSIZ ? BLKSIZ - 1 : size - 1);
+	while ( 1 )
+	{
+		len = sprintf(line, "L%05d:\t%s\tR%d,R%d\t\t; line %d\r\n",
+					  lineNo, Ops[genRand(state) & 7], (int)(genRand(state) & 7), (int)(genRand(state) & 7), lineNo);
+		if ( used + len + 1 > size )
+			break;
+		memcpy(dst + used, line, len);
+		used += len;
+		++lineNo;
+	}
+	dst[used] = 032;
+}
+
+/**
+ * Write one file to a host directory the way it would look copied out.
+ * @param hostDir - directory.
+ * @param name - filename (as in container).
+ * @param data - file contents in container.
+ * @param len - number of bytes to write.
+ * @param ascii - non-zero if text (strip cr's).
+ * @return 0 on success, 1 on failure.
+ */
+static int genHostFile(const char *hostDir, const char *name, const char *data, int len, int ascii)
+{
+	char path[1024], *cp;
+	FILE *fp;
+	int ii;
+
+	snprintf(path, sizeof(path), "%s/%s", hostDir, name);
+	for ( cp = path + strlen(hostDir) + 1; *cp; ++cp )
+	{
+		if ( isupper(*cp) )
+			*cp = tolower(*cp);
+	}
+	fp = fopen(path, "wb");
+	if ( !fp )
+	{
+		fprintf(stderr, "Unable to create '%s': %s\n", path, strerror(errno));
+		return 1;
+	}
+	if ( ascii )
+	{
+		for ( ii = 0; ii < len && data[ii] != 032; ++ii )
+		{
+			if ( data[ii] != '\r' )
+				fputc(data[ii], fp);
+		}
+	}
+	else
+		fwrite(data, 1, len, fp);
+	if ( fclose(fp) )
+	{
+		fprintf(stderr, "Error writing '%s': %s\n", path, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Make a synthetic RT11 container file.
+ * @param gp - pointer to parameters.
+ * @param path - name of container file to create (NULL to not make one).
+ * @param hostDir - name of existing directory into which to also write each file
+ * as it would be copied out (NULL to not write them).
+ * @return number of files made, -1 on error.
+ */
+int genImage(const GenParams_t *gp, const char *path, const char *hostDir)
+{
+	int blocks, segments, numdent, perSeg, maxEnts, numEnts, numFiles, ii, jj, lba, last, isFloppy;
+	unsigned long state;
+	GenEnt_t *ents;
+	U8 *img;
+	Rt11HomeBlock_t *home;
+	U16 ver[3];
+	char name[16];
+	FILE *fp;
+
+	isFloppy = gp->floppy;
+	blocks = gp->blocks;
+	segments = gp->segments;
+	if ( isFloppy )
+	{
+		int sectorLen = isFloppy == 1 ? 128 : 256;
+		blocks = NUM_SECTORS * (NUM_TRACKS - 1) * sectorLen / BLKSIZ;
+		if ( segments > (isFloppy == 1 ? MAX_SGL_FLPY_SEGS : MAX_DBL_FLPY_SEGS) )
+			segments = isFloppy == 1 ? MAX_SGL_FLPY_SEGS : MAX_DBL_FLPY_SEGS;
+	}
+	if ( segments < 1 || segments > MAXSEGMENTS - 1 )
+	{
+		fprintf(stderr, "Number of segments must be 1 to %d. Got %d.\n", MAXSEGMENTS - 1, segments);
+		return -1;
+	}
+	if ( blocks < DIRBLK + segments * BLKS_P_SEGMENT + 1 || blocks > 65535 )
+	{
+		fprintf(stderr, "Volume of %d blocks is not between %d and 65535\n", blocks, DIRBLK + segments * BLKS_P_SEGMENT + 1);
+		return -1;
+	}
+	if ( (gp->extra & 1) || gp->extra < 0 || gp->extra > 100 )
+	{
+		fprintf(stderr, "Extra bytes must be even and from 0 to 100. Got %d.\n", gp->extra);
+		return -1;
+	}
+	if ( gp->minBlks < 1 || gp->maxBlks < gp->minBlks )
+	{
+		fprintf(stderr, "Invalid file size range %d:%d\n", gp->minBlks, gp->maxBlks);
+		return -1;
+	}
+	numdent = (SEGSIZ - SEGLEN) / (DIRLEN + gp->extra);
+	perSeg = numdent - 2;
+	maxEnts = segments * perSeg;
+	ents = (GenEnt_t *)calloc(maxEnts, sizeof(GenEnt_t));
+	img = (U8 *)calloc(blocks, BLKSIZ);
+	if ( !ents || !img )
+	{
+		fprintf(stderr, "Ran out of memory for a %d block image\n", blocks);
+		free(ents);
+		free(img);
+		return -1;
+	}
+	state = gp->seed ? gp->seed : 1;
+	lba = DIRBLK + segments * BLKS_P_SEGMENT;
+	numEnts = numFiles = 0;
+	/* Lay down the files, leaving a slot for the last empty */
+	while ( numFiles < gp->files && numEnts < maxEnts - 1 )
+	{
+		GenEnt_t *ep = ents + numEnts;
+		int size = genSize(gp, &state);
+
+		if ( lba + size > blocks )
+			break;
+		ep->ascii = genRange(&state, 1, 100) <= gp->asciiPct;
+		ep->lba = lba;
+		snprintf(name, sizeof(name), "F%05d.%s", numFiles,
+				 ep->ascii ? AscTypes[genRand(&state) & 1] : BinTypes[genRand(&state) & 1]);
+		r50EncodeName(ep->rt11.name, name);
+		ep->rt11.control = PERM;
+		ep->rt11.blocks = size;
+		ep->rt11.date = (genRange(&state, 1, 12) << 10) | (genRange(&state, 1, 28) << 5) | genRange(&state, 0, 31);
+		if ( ep->ascii )
+			genText(&state, (char *)img + lba * BLKSIZ, size * BLKSIZ);
+		else
+		{
+			for ( jj = 0; jj < size * BLKSIZ; ++jj )
+				img[lba * BLKSIZ + jj] = (U8)genRand(&state);
+		}
+		if ( hostDir && genHostFile(hostDir, name, (char *)img + lba * BLKSIZ, size * BLKSIZ, ep->ascii) )
+		{
+			free(ents);
+			free(img);
+			return -1;
+		}
+		lba += size;
+		++numEnts;
+		++numFiles;
+		/* Leave a hole after this one */
+		if ( gp->fragPct && numEnts < maxEnts - 1 && genRange(&state, 1, 100) <= gp->fragPct )
+		{
+			size = genRange(&state, 1, gp->maxBlks > 16 ? gp->maxBlks / 8 : 2);
+			if ( lba + size > blocks )
+				size = blocks - lba;
+			if ( size <= 0 )
+				continue;
+			ep = ents + numEnts++;
+			ep->rt11.control = EMPTY;
+			ep->rt11.blocks = size;
+			ep->lba = lba;
+			lba += size;
+		}
+	}
+	/* All the rest is empty */
+	ents[numEnts].rt11.control = EMPTY;
+	ents[numEnts].rt11.blocks = blocks - lba;
+	ents[numEnts].lba = lba;
+	++numEnts;
+	if ( path )
+	{
+		/* Home block */
+		home = (Rt11HomeBlock_t *)(img + HOME_BLK_LBA * BLKSIZ);
+		memset(home, 0, sizeof(Rt11HomeBlock_t));
+		home->clusterSize = 1;
+		home->firstSegment = DIRBLK;
+		r50EncodeName(ver, "V3A");
+		home->version = ver[0];
+		memcpy(home->volumeID, "RT11A       ", 12);
+		memcpy(home->owner, "            ", 12);
+		memcpy(home->sysID, "DECRT11A    ", 12);
+		home->checksum = memSum16(home, (U16 *)&home->checksum - (U16 *)home);
+		/* Directory segments */
+		last = (numEnts + perSeg - 1) / perSeg;
+		for ( ii = 0; ii < last; ++ii )
+		{
+			Rt11SegEnt_t *segptr = (Rt11SegEnt_t *)(img + DIRBLK * BLKSIZ + ii * SEGSIZ);
+			U8 *dp = (U8 *)(segptr + 1);
+			int first = ii * perSeg, num = numEnts - first;
+
+			if ( num > perSeg )
+				num = perSeg;
+			segptr->smax = segments;
+			segptr->link = ii + 1 < last ? ii + 2 : 0;
+			segptr->last = last;
+			segptr->extra = gp->extra;
+			segptr->start = ents[first].lba;
+			for ( jj = 0; jj < num; ++jj, dp += DIRLEN + gp->extra )
+				memcpy(dp, &ents[first + jj].rt11, DIRLEN);
+			((Rt11DirEnt_t *)dp)->control = ENDBLK;
+		}
+		if ( isFloppy )
+		{
+			Options_t options;
+
+			memset(&options, 0, sizeof(options));
+			options.cmdOpts = isFloppy == 1 ? CMDOPT_SINGLE_FLPY : CMDOPT_DOUBLE_FLPY;
+			options.floppyImageSize = NUM_SECTORS * NUM_TRACKS * (isFloppy == 1 ? 128 : 256);
+			options.floppyImage = (U8 *)calloc(1, options.floppyImageSize);
+			if ( !options.floppyImage )
+			{
+				fprintf(stderr, "Ran out of memory for floppy image\n");
+				free(ents);
+				free(img);
+				return -1;
+			}
+			rescramble(&options, img);
+			free(img);
+			img = options.floppyImage;
+			blocks = options.floppyImageSize / BLKSIZ;
+		}
+		fp = fopen(path, "wb");
+		if ( !fp )
+		{
+			fprintf(stderr, "Unable to create '%s': %s\n", path, strerror(errno));
+			free(ents);
+			free(img);
+			return -1;
+		}
+		ii = fwrite(img, BLKSIZ, blocks, fp) != (size_t)blocks;
+		if ( fclose(fp) || ii )
+		{
+			fprintf(stderr, "Error writing '%s': %s\n", path, strerror(errno));
+			free(ents);
+			free(img);
+			return -1;
+		}
+	}
+	free(ents);
+	free(img);
+	return numFiles;
+}
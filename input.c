@@ -26,100 +26,125 @@
  */
 
 /**
- * Read input file and do any crlf processing.
+ * Read a host file (or a piece of a stream) into options->iHandle.inFileBuf, do any
+ * crlf processing and pad it to a whole number of blocks.
  * @param options - pointer to options.
+ * @param fileName - name of file for messages.
+ * @param inp - where to read it from.
+ * @param size - number of bytes to read.
  * @return 0 if success, 1 if failure
  */
-int readInpFile(Options_t *options, const char *fileName)
+int fillInpBuf(Options_t *options, const char *fileName, FILE *inp, long size)
 {
 	int retv, inBufSize;
-	struct stat st;
-	FILE *inp;
-	InHandle_t *ihp;
+	InHandle_t *ihp = &options->iHandle;
 
-	retv = stat(fileName, &st);
-	if ( retv )
-	{
-		fprintf(stderr, "Unable to stat '%s': %s\n", fileName, strerror(errno));
-		return 1;
-	}
-	ihp = &options->iHandle;
-	ihp->fileTimeStamp = st.st_ctime;
 	/* Round up buffer size to multiple of 512 */
-	inBufSize = (st.st_size + BLKSIZ - 1) & -BLKSIZ;
+	inBufSize = (size + BLKSIZ - 1) & -BLKSIZ;
 	if ( inBufSize > ihp->inFileBufSize )
 	{
 		ihp->inFileBuf = (char *)realloc(ihp->inFileBuf, inBufSize);
 		if ( !ihp->inFileBuf )
 		{
-			fprintf(stderr, "Unable to allocate %d bytes for input file: %s\n",
-					retv, strerror(errno));
+			msgErr(options, "Unable to allocate %d bytes for input file: %s\n",
+					inBufSize, strerror(errno));
+			ihp->inFileBufSize = 0;
 			return 1;
 		}
 		ihp->inFileBufSize = inBufSize;
 	}
-	inp = fopen(fileName, "rb");
-	if ( !inp )
+	retv = statFread(options, STAT_IO_HOST, ihp->inFileBuf, 1, size, inp);
+	if ( retv != size )
 	{
-		fprintf(stderr, "Error opening '%s' for input: %s\n",
-				fileName, strerror(errno));
-		return 1;
-	}
-	retv = fread(ihp->inFileBuf, 1, st.st_size, inp);
-	if ( retv != st.st_size )
-	{
-		fprintf(stderr, "Error reading '%s'. Expected %ld bytes, got %d: %s\n",
-				fileName, st.st_size, retv, strerror(errno));
-		fclose(inp);
+		msgErr(options, "Error reading '%s'. Expected %ld bytes, got %d: %s\n",
+				fileName, size, retv, ferror(inp) ? strerror(errno) : "Premature EOF");
 		return 1;
 	}
-	fclose(inp);
 	if ( (options->inOpts & INOPTS_ASC) )
 	{
-		char *oBuf, *src, *dst;
-		int oBufSize, hist;
+		size_t extra;
+		int oBufSize;
 
 		/* Copying an ASCII file.
-		   All files have to be a multple of BLKSIZ (512). Although not strictly necessary (could be an exact file size without a trailing null),
-		   we always null terminate the file so leave room for one additional byte */
-		oBufSize = (st.st_size * 2 + 1 + BLKSIZ - 1) & -BLKSIZ;
-		oBuf = (char *)calloc(oBufSize, 1);
-		if ( !oBuf )
-		{
-			fprintf(stderr, "Unable to allocate %d bytes for input file converted to crlf: %s\n",
-					oBufSize, strerror(errno));
-			return 1;
-		}
-		hist = 0;
-		dst = oBuf;
-		src = ihp->inFileBuf;
-		while ( src < ihp->inFileBuf + st.st_size )
+		   All files have to be a multple of BLKSIZ (512). Count the lone lf's first to know
+		   how big the result will be, then convert them to crlf's in place. */
+		extra = asciiCountLF(ihp->inFileBuf, size);
+		retv = size + extra;
+		oBufSize = (retv + BLKSIZ - 1) & -BLKSIZ;
+		if ( oBufSize > ihp->inFileBufSize )
 		{
-			/* Convert all lone lf's to crlf's */
-			if ( *src == '\n' && hist != '\r' )
-				*dst++ = '\r';
-			hist = *src++;
-			*dst++ = hist;
+			char *oBuf;
+
+			oBuf = (char *)realloc(ihp->inFileBuf, oBufSize);
+			if ( !oBuf )
+			{
+				msgErr(options, "Unable to allocate %d bytes for input file converted to crlf: %s\n",
+						oBufSize, strerror(errno));
+				return 1;
+			}
+			ihp->inFileBuf = oBuf;
+			ihp->inFileBufSize = oBufSize;
 		}
-		retv = (dst - oBuf);
-		free(ihp->inFileBuf);
-		ihp->inFileBuf = oBuf;
-		ihp->inFileBufSize = oBufSize;
+		asciiExpandLF(ihp->inFileBuf, size, extra);
+		/* pad file to multiple of BLKSIZ with 0's */
+		memset(ihp->inFileBuf + retv, 0, oBufSize - retv);
 		if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
 		{
 			printf("readInpFile: expanded '%s' from %ld bytes (%ld blocks) to %d bytes (%d blocks).\n",
 				   fileName,
-				   st.st_size, (st.st_size + BLKSIZ - 1) / BLKSIZ,
+				   size, (size + BLKSIZ - 1) / BLKSIZ,
 				   retv, (retv + BLKSIZ - 1) / BLKSIZ);
 		}
 	}
-	else if ( inBufSize - st.st_size )
+	else if ( inBufSize - size )
 	{
 		/* pad file to multiple of BLKSIZ with 0's */
-		memset(ihp->inFileBuf + st.st_size, 0, inBufSize - st.st_size);
+		memset(ihp->inFileBuf + size, 0, inBufSize - size);
 	}
 	ihp->fileBlks = (retv + BLKSIZ - 1) / BLKSIZ;
 	return 0;
 }
 
+/**
+ * Read input file and do any crlf processing.
+ * @param options - pointer to options.
+ * @return 0 if success, 1 if failure
+ */
+int readInpFile(Options_t *options, const char *fileName)
+{
+	int retv;
+	struct stat st;
+	FILE *inp;
+	InHandle_t *ihp;
+
+	retv = stat(fileName, &st);
+	if ( retv )
+	{
+		msgErr(options, "Unable to stat '%s': %s\n", fileName, strerror(errno));
+		return 1;
+	}
+	ihp = &options->iHandle;
+	ihp->fileTimeStamp = st.st_ctime;
+	ihp->directName = NULL;
+#ifndef MINGW
+	if ( !(options->inOpts & INOPTS_ASC) && !(options->cmdOpts & (CMDOPT_SINGLE_FLPY | CMDOPT_DOUBLE_FLPY)) )
+	{
+		/* Binary into a hard disk container. Leave the copying to writeFileToContainer() */
+		ihp->directName = fileName;
+		ihp->directSize = st.st_size;
+		ihp->fileBlks = (st.st_size + BLKSIZ - 1) / BLKSIZ;
+		return 0;
+	}
+#endif
+	inp = statFopen(options, STAT_IO_HOST, fileName, "rb");
+	if ( !inp )
+	{
+		msgErr(options, "Error opening '%s' for input: %s\n",
+				fileName, strerror(errno));
+		return 1;
+	}
+	retv = fillInpBuf(options, fileName, inp, st.st_size);
+	fclose(inp);
+	return retv;
+}
 
@@ -0,0 +1,489 @@
+/*  $Id: librtpip.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	librtpip.c - The rtpip commands as a library.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MINGW
+	#define _POSIX_C_SOURCE 200809L
+#endif
+#include "rtpip.h"
+#include "librtpip.h"
+#include <stdarg.h>
+#ifndef MINGW
+	#include <pthread.h>
+#endif
+
+/**
+ * @file librtpip.c
+ * The rtpip commands as a library. See librtpip.h.
+ *
+ * Each handle has its own Options_t set up the way the rtpip command line would
+ * (no prompts, no printing, no stats) and works through the same functions rtpip
+ * does. After anything that writes the directory the container is read back in
+ * from scratch so the handle always matches what is on disk.
+ *
+ * rt_list() and rt_read() only look at the handle, so any number of them can run at
+ * once. Everything else waits for them and for each other.
+ */
+
+struct RtHandle
+{
+	Options_t options;          /**< Everything about the container */
+	char *path;                 /**< Copy of container's name (options.container points here) */
+	int flags;                  /**< RT_OPEN_xxx */
+#ifndef MINGW
+	pthread_rwlock_t lock;      /**< Held for reading by rt_list() and rt_read(), for writing by the rest */
+#endif
+};
+
+#ifndef MINGW
+	#define RDLOCK(hp) pthread_rwlock_rdlock(&(hp)->lock)
+	#define LOCK(hp) pthread_rwlock_wrlock(&(hp)->lock)
+	#define UNLOCK(hp) pthread_rwlock_unlock(&(hp)->lock)
+
+static pthread_once_t initOnce = PTHREAD_ONCE_INIT;
+#else
+	#define RDLOCK(hp)
+	#define LOCK(hp)
+	#define UNLOCK(hp)
+#endif
+
+/**
+ * Fill in the tables the library functions would otherwise fill in on first use,
+ * so two threads can't both be doing it.
+ * @return nothing
+ */
+static void libInit(void)
+{
+	r50Init();
+	cpuLevel();
+}
+
+/**
+ * Throw away a message.
+ * @param user - not used.
+ * @param isError - not used.
+ * @param msg - not used.
+ * @return nothing
+ */
+static void noReport(void *user, int isError, const char *msg)
+{
+}
+
+/**
+ * Report an error without changing anything in the handle (msgErr() counts them),
+ * so it can be used while other threads are reading.
+ * @param hp - pointer to handle.
+ * @param fmt - printf() format followed by its arguments.
+ * @return nothing
+ */
+static void report(RtHandle_t *hp, const char *fmt, ...)
+{
+	char msg[1024];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+	hp->options.msgFunc(hp->options.msgUser, 1, msg);
+}
+
+/**
+ * Read the container's home block and directory.
+ * @param hp - pointer to handle.
+ * @return 0 on success, 1 on error (which will have been reported).
+ */
+static int load(RtHandle_t *hp)
+{
+	Options_t *options = &hp->options;
+
+	options->seg1LBA = DIRBLK;
+	if ( checkHeader(options) || parse_directory(options) )
+	{
+		freeContainer(options);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Write the directory and read it all back in.
+ * @param hp - pointer to handle.
+ * @return 0 on success, 1 on error (which will have been reported).
+ */
+static int commit(RtHandle_t *hp)
+{
+	Options_t *options = &hp->options;
+	int sts;
+
+	sts = linearToDisk(options);
+	if ( !sts )
+		sts = writeNewDir(options);
+	freeContainer(options);
+	if ( load(hp) )
+		return 1;
+	return sts;
+}
+
+/**
+ * Find a file. Nothing in the handle is changed.
+ * @param hp - pointer to handle.
+ * @param name - RT11 name of file.
+ * @return pointer to directory entry or NULL if not found (which will have been reported).
+ */
+static InWorkingDir_t *findFile(RtHandle_t *hp, const char *name)
+{
+	Options_t *options = &hp->options;
+	InWorkingDir_t *wdp;
+	unsigned short r50[3];
+	int ii;
+
+	if ( !options->wDirArray )
+	{
+		report(hp, "Container '%s' could not be read back in\n", options->container);
+		return NULL;
+	}
+	if ( r50EncodeName(r50, name) )
+	{
+		report(hp, "Filename '%s' is incompatible with RT11 name convention.\n", name);
+		return NULL;
+	}
+	wdp = options->wDirArray;
+	for ( ii = 0; ii < options->numWdirs; ++ii, ++wdp )
+	{
+		if (    (wdp->rt11.control & PERM)
+			 && wdp->rt11.name[0] == r50[0]
+			 && wdp->rt11.name[1] == r50[1]
+			 && wdp->rt11.name[2] == r50[2] )
+			return wdp;
+	}
+	report(hp, "No file '%s' in '%s'\n", name, options->container);
+	return NULL;
+}
+
+/**
+ * Check a handle can be written.
+ * @param hp - pointer to handle.
+ * @return 0 if it can, 1 if not (which will have been reported).
+ */
+static int canWrite(RtHandle_t *hp)
+{
+	if ( !(hp->flags & RT_OPEN_WRITE) )
+	{
+		msgErr(&hp->options, "Container '%s' was not opened for writing\n", hp->options.container);
+		return 1;
+	}
+	if ( !hp->options.wDirArray )
+	{
+		msgErr(&hp->options, "Container '%s' could not be read back in\n", hp->options.container);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Open a container.
+ * @param path - path to container file.
+ * @param flags - RT_OPEN_xxx.
+ * @param report - where messages go (NULL to throw them away).
+ * @param user - passed to report.
+ * @return handle or NULL on error (which will have been reported).
+ */
+RtHandle_t *rt_open(const char *path, int flags, RtReport_t report, void *user)
+{
+	RtHandle_t *hp;
+	Options_t *options;
+
+#ifndef MINGW
+	pthread_once(&initOnce, libInit);
+#else
+	libInit();
+#endif
+	hp = (RtHandle_t *)calloc(1, sizeof(RtHandle_t));
+	if ( hp )
+		hp->path = (char *)malloc(strlen(path) + 1);
+	if ( !hp || !hp->path )
+	{
+		if ( report )
+			report(user, 1, "Ran out of memory opening container\n");
+		free(hp);
+		return NULL;
+	}
+	strcpy(hp->path, path);
+	hp->flags = flags;
+	options = &hp->options;
+	options->container = hp->path;
+	options->msgFunc = report ? report : noReport;
+	options->msgUser = user;
+	if ( (flags & RT_OPEN_RX01) )
+		options->cmdOpts |= CMDOPT_SINGLE_FLPY;
+	else if ( (flags & RT_OPEN_RX02) )
+		options->cmdOpts |= CMDOPT_DOUBLE_FLPY;
+	options->inOpts = INOPTS_NOASK;
+	options->outOpts = OUTOPTS_NOASK;
+	options->delOpts = DELOPTS_NOASK;
+	options->sqzOpts = SQZOPTS_NOASK;
+	if ( load(hp) )
+	{
+		free(hp->path);
+		free(hp);
+		return NULL;
+	}
+#ifndef MINGW
+	pthread_rwlock_init(&hp->lock, NULL);
+#endif
+	return hp;
+}
+
+/**
+ * List the directory in the order entries are on the disk.
+ * @param hp - handle from rt_open().
+ * @param func - function to call with each entry.
+ * @param user - passed to func.
+ * @return 0, or what func returned if it stopped the listing.
+ */
+int rt_list(RtHandle_t *hp, RtListFunc_t func, void *user)
+{
+	Options_t *options = &hp->options;
+	InWorkingDir_t *wdp;
+	RtDirEnt_t ent;
+	int ii, sts = 0;
+
+	RDLOCK(hp);
+	wdp = options->wDirArray;
+	for ( ii = 0; wdp && ii < options->numWdirs && !sts; ++ii, ++wdp )
+	{
+		if ( (wdp->rt11.control & PERM) )
+			strcpy(ent.name, wdp->ffull);
+		else
+			ent.name[0] = 0;
+		ent.control = wdp->rt11.control;
+		ent.date = wdp->rt11.date;
+		ent.blocks = wdp->rt11.blocks;
+		ent.lba = wdp->lba;
+		ent.seg = wdp->segNo;
+		ent.segIdx = wdp->segIdx;
+		ent.channel = wdp->rt11.channel;
+		ent.procid = wdp->rt11.procid;
+		sts = func(user, &ent);
+	}
+	UNLOCK(hp);
+	return sts;
+}
+
+/**
+ * Read a file.
+ * @param hp - handle from rt_open().
+ * @param name - RT11 name of file.
+ * @param buf - where to put the file's contents (NULL to just get the size).
+ * @param bufSize - size of buf in bytes.
+ * @return size of file in bytes or -1 on error.
+ */
+long rt_read(RtHandle_t *hp, const char *name, void *buf, long bufSize)
+{
+	Options_t *options = &hp->options;
+	InWorkingDir_t *wdp;
+	long size, done, sts;
+
+	RDLOCK(hp);
+	wdp = findFile(hp, name);
+	if ( !wdp )
+	{
+		UNLOCK(hp);
+		return -1;
+	}
+	size = (long)wdp->rt11.blocks * BLKSIZ;
+	if ( buf && bufSize >= size )
+	{
+		if ( options->floppyImage )
+		{
+			if ( (long)wdp->lba * BLKSIZ + size > options->floppyImageSize )
+			{
+				report(hp, "File '%s' is outside of floppy image of %d bytes\n",
+					   wdp->ffull, options->floppyImageSize);
+				size = -1;
+			}
+			else
+				memcpy(buf, options->floppyImageUnscrambled + wdp->lba * BLKSIZ, size);
+		}
+		else
+		{
+#ifndef MINGW
+			/* pread() so readers don't fight over the file position */
+			for ( done = 0; done < size; done += sts )
+			{
+				sts = pread(fileno(options->inp), (char *)buf + done, size - done, (long)wdp->lba * BLKSIZ + done);
+				if ( sts <= 0 )
+					break;
+			}
+#else
+			done = -1;
+			if ( !fseek(options->inp, (long)wdp->lba * BLKSIZ, SEEK_SET) )
+				done = fread(buf, 1, size, options->inp);
+#endif
+			if ( done != size )
+			{
+				report(hp, "Error reading %ld bytes from '%s' starting at LBA %d: %s\n",
+					   size, options->container, wdp->lba, strerror(errno));
+				size = -1;
+			}
+		}
+	}
+	UNLOCK(hp);
+	return size;
+}
+
+/**
+ * Write a file, replacing one of the same name.
+ * @param hp - handle from rt_open().
+ * @param name - RT11 name of file.
+ * @param data - contents of file.
+ * @param len - number of bytes in data.
+ * @param date - RT11 date word.
+ * @return 0 on success, 1 on error.
+ */
+int rt_write(RtHandle_t *hp, const char *name, const void *data, long len, unsigned short date)
+{
+	Options_t *options = &hp->options;
+	InHandle_t *ihp = &options->iHandle;
+	InWorkingDir_t *wdp;
+	int need, sts;
+
+	LOCK(hp);
+	if ( canWrite(hp) || cvtName(options, name) )
+	{
+		UNLOCK(hp);
+		return 1;
+	}
+	if ( len < 0 || len > 65535L * BLKSIZ )
+	{
+		msgErr(options, "Can't write %ld bytes to '%s'\n", len, name);
+		UNLOCK(hp);
+		return 1;
+	}
+	need = (len + BLKSIZ - 1) & -BLKSIZ;
+	if ( need > ihp->inFileBufSize )
+	{
+		char *nBuf;
+
+		nBuf = (char *)realloc(ihp->inFileBuf, need);
+		if ( !nBuf )
+		{
+			msgErr(options, "Unable to allocate %d bytes for '%s'\n", need, name);
+			UNLOCK(hp);
+			return 1;
+		}
+		ihp->inFileBuf = nBuf;
+		ihp->inFileBufSize = need;
+	}
+	memcpy(ihp->inFileBuf, data, len);
+	memset(ihp->inFileBuf + len, 0, need - len);
+	ihp->directName = NULL;
+	ihp->fileBlks = need / BLKSIZ;
+	options->inDate = date;
+	sts = newDirEnt(options, name, &wdp);
+	if ( !sts )
+	{
+		if ( options->floppyImage )
+			memcpy(options->floppyImageUnscrambled + wdp->lba * BLKSIZ, ihp->inFileBuf, need);
+		else
+			sts = writeFileToContainer(options, wdp);
+	}
+	if ( !sts )
+		sts = commit(hp);
+	else
+	{
+		/* Put the directory back the way it is on the disk */
+		freeContainer(options);
+		load(hp);
+		sts = 1;
+	}
+	UNLOCK(hp);
+	return sts;
+}
+
+/**
+ * Delete a file.
+ * @param hp - handle from rt_open().
+ * @param name - RT11 name of file.
+ * @return 0 on success, 1 on error.
+ */
+int rt_delete(RtHandle_t *hp, const char *name)
+{
+	Options_t *options = &hp->options;
+	InWorkingDir_t *wdp;
+	int sts = 1;
+
+	LOCK(hp);
+	if ( !canWrite(hp) && (wdp = findFile(hp, name)) )
+	{
+		wdp->rt11.control = EMPTY;
+		options->totEmpty += wdp->rt11.blocks;
+		options->totPerm -= wdp->rt11.blocks;
+		sts = commit(hp);
+	}
+	UNLOCK(hp);
+	return sts;
+}
+
+/**
+ * Squeeze all the empty space into one area.
+ * @param hp - handle from rt_open().
+ * @return 0 on success, 1 on error.
+ */
+int rt_squeeze(RtHandle_t *hp)
+{
+	Options_t *options = &hp->options;
+	int sts = 1;
+
+	LOCK(hp);
+	if ( !canWrite(hp) )
+	{
+		sts = createNewContainer(options);
+		freeContainer(options);
+		if ( load(hp) )
+			sts = 1;
+	}
+	UNLOCK(hp);
+	return sts;
+}
+
+/**
+ * Close a container and free the handle.
+ * @param hp - handle from rt_open().
+ * @return 0
+ */
+int rt_close(RtHandle_t *hp)
+{
+	Options_t *options;
+
+	if ( !hp )
+		return 0;
+	options = &hp->options;
+	freeContainer(options);
+	free(options->iHandle.inFileBuf);
+	free(options->iHandle.argFN);
+	free(options->copyBuf);
+	free(hp->path);
+#ifndef MINGW
+	pthread_rwlock_destroy(&hp->lock);
+#endif
+	free(hp);
+	return 0;
+}
+
@@ -0,0 +1,142 @@
+/** $Id: librtpip.h,v 1.1 2026/10/18 00:00:00 dave Exp dave $
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ *  @file librtpip.h
+ *  Interface to librtpip, the rtpip commands as a library (make lib).
+ *
+ *  A container is opened with rt_open() which returns a handle holding everything
+ *  about it. Nothing is shared between handles, so any number of containers can be
+ *  open at once and each can be used by a different thread. Calls to rt_list() and
+ *  rt_read() on the same handle from different threads run at the same time, anything
+ *  else waits its turn. Nothing is printed and nothing is asked. Messages go to the
+ *  report function given to rt_open().
+ *
+ *  rt_write(), rt_delete() and rt_squeeze() write the directory before they return,
+ *  so the container is always as rtpip would have left it.
+ */
+
+#ifndef _LIBRTPIP_H_
+	#define _LIBRTPIP_H_ 1
+
+/** Open container handle (contents private to librtpip.c) */
+typedef struct RtHandle RtHandle_t;
+
+	#define RT_OPEN_WRITE  (1)      /**< Allow rt_write(), rt_delete() and rt_squeeze() */
+	#define RT_OPEN_RX01   (2)      /**< Container is a single density floppy image */
+	#define RT_OPEN_RX02   (4)      /**< Container is a double density floppy image */
+
+	#define RT_PROTEK      0100000  /**< RtDirEnt_t control: protected file */
+	#define RT_PERM        0002000  /**< RtDirEnt_t control: permanent file */
+	#define RT_EMPTY       0001000  /**< RtDirEnt_t control: empty area */
+	#define RT_TENT        0000400  /**< RtDirEnt_t control: tentative file */
+
+/** Where messages go.
+ * @param user - as given to rt_open().
+ * @param isError - non-zero if it is an error.
+ * @param msg - the message (ends with a newline).
+ */
+typedef void (*RtReport_t)(void *user, int isError, const char *msg);
+
+/** One directory entry as given to an RtListFunc_t. */
+typedef struct
+{
+	char name[11];              /**< "NAME.EXT" (empty string if not a file) */
+	unsigned short control;     /**< RT_PERM, RT_EMPTY, etc. */
+	unsigned short date;        /**< RT11 date word (0 if none) */
+	int blocks;                 /**< Size in 512 byte blocks */
+	int lba;                    /**< Starting block */
+	int seg;                    /**< Directory segment the entry is in */
+	int segIdx;                 /**< Index of entry in the segment */
+	unsigned char channel;      /**< Channel number (tentative files) */
+	unsigned char procid;       /**< Process ID (tentative files) */
+} RtDirEnt_t;
+
+/** Called by rt_list() for each entry.
+ * @param user - as given to rt_list().
+ * @param ent - pointer to entry (only good until the function returns).
+ * @return 0 to keep going, anything else to stop.
+ */
+typedef int (*RtListFunc_t)(void *user, const RtDirEnt_t *ent);
+
+/**
+ * Open a container.
+ * @param path - path to container file.
+ * @param flags - RT_OPEN_xxx.
+ * @param report - where messages go (NULL to throw them away).
+ * @param user - passed to report.
+ * @return handle or NULL on error (which will have been reported).
+ */
+extern RtHandle_t *rt_open(const char *path, int flags, RtReport_t report, void *user);
+
+/**
+ * List the directory in the order entries are on the disk. Empty areas are included.
+ * @param hp - handle from rt_open().
+ * @param func - function to call with each entry.
+ * @param user - passed to func.
+ * @return 0, or what func returned if it stopped the listing.
+ */
+extern int rt_list(RtHandle_t *hp, RtListFunc_t func, void *user);
+
+/**
+ * Read a file.
+ * @param hp - handle from rt_open().
+ * @param name - RT11 name of file ("NAME.EXT", case doesn't matter).
+ * @param buf - where to put the file's contents. If NULL or smaller than the file,
+ * nothing is read (so call with NULL to find out how big a buffer is needed).
+ * @param bufSize - size of buf in bytes.
+ * @return size of file in bytes (always a multiple of 512) or -1 on error.
+ */
+extern long rt_read(RtHandle_t *hp, const char *name, void *buf, long bufSize);
+
+/**
+ * Write a file, replacing one of the same name if there is one. The last block is
+ * padded with 0's.
+ * @param hp - handle from rt_open() with RT_OPEN_WRITE.
+ * @param name - RT11 name of file ("NAME.EXT", case doesn't matter).
+ * @param data - contents of file.
+ * @param len - number of bytes in data.
+ * @param date - RT11 date word (0 for 1-Jan-72 like rtpip in).
+ * @return 0 on success, 1 on error.
+ */
+extern int rt_write(RtHandle_t *hp, const char *name, const void *data, long len, unsigned short date);
+
+/**
+ * Delete a file.
+ * @param hp - handle from rt_open() with RT_OPEN_WRITE.
+ * @param name - RT11 name of file ("NAME.EXT", case doesn't matter).
+ * @return 0 on success, 1 on error (including no such file).
+ */
+extern int rt_delete(RtHandle_t *hp, const char *name);
+
+/**
+ * Squeeze all the empty space into one area at the end (like rtpip sqz). The old
+ * container is kept with .bak added to its name.
+ * @param hp - handle from rt_open() with RT_OPEN_WRITE.
+ * @return 0 on success, 1 on error.
+ */
+extern int rt_squeeze(RtHandle_t *hp);
+
+/**
+ * Close a container and free the handle.
+ * @param hp - handle from rt_open() (NULL is ok).
+ * @return 0
+ */
+extern int rt_close(RtHandle_t *hp);
+
+#endif	/* _LIBRTPIP_H_ */
@@ -0,0 +1,748 @@
+/*  $Id: microbench.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	microbench.c - Time rtpip's inner loops in isolation.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _POSIX_C_SOURCE 200112L
+#include "rtpip.h"
+
+/**
+ * @file microbench.c
+ * Time rtpip's inner loops in isolation. Built as rtpip_microbench.
+ */
+
+/*
+ * Note: Each benchmark is a function that does "iters" passes over a fixed
+ * set of data made up front. The number of passes is picked once so that a
+ * sample takes at least --time milliseconds and then --samples samples are
+ * taken. The time of each sample is divided by the number of items it
+ * handled (names, entries, images or buffers) to get ns/item, and the
+ * median and 99th percentile of those are reported. Anything the kernels
+ * compute is folded into Sink so the compiler can't throw the work away.
+ *
+ * Where a kernel replaced an older loop (Rad50, ascii, sort) the old way is
+ * timed alongside it so the two can be compared directly. The vector kernels
+ * run at whatever level cpuLevel() picks, so RTPIP_CPU=c shows the plain C.
+ */
+
+#define NUM_NAMES     (1024)            /**< Names used by the Rad50 and filter benchmarks */
+#define NUM_DIRENTS   (1000)            /**< Entries used by the sort benchmarks */
+#define TEXT_LEN      (64 * 1024)       /**< Bytes of text used by the ascii benchmarks */
+#define MAX_PATTERNS  (16)              /**< Most filters handed to filterFilename() */
+
+static volatile unsigned long Sink;     /**< Results go here so they aren't optimized out */
+
+/* Floppy images (RX01 and RX02) */
+static Options_t FlpyOpts[2];
+
+/* Names */
+static unsigned short R50Names[NUM_NAMES][3];
+static char AscNames[NUM_NAMES][12];    /**< "NAME.EXT" */
+static char PadNames[NUM_NAMES][10];    /**< "NAME  EXT" (6.3, space padded) */
+static char HostNames[NUM_NAMES][20];   /**< "some/dir/name.ext" */
+static Options_t CvtOpts;
+
+/* Filters */
+static char NormExprs[MAX_PATTERNS * 10];
+static Options_t FiltOpts[3];           /**< 1, 4 and 16 wildcards */
+#if !NO_REGEXP
+static Options_t RexOpts[3];            /**< 1, 4 and 16 regular expressions */
+#endif
+static const char *const Wilds[MAX_PATTERNS] =
+{
+	"*.MAC", "F0001*.*", "A*.SAV", "F?0?0?.TXT", "*.OBJ", "SYS*.*", "F00??7.SAV", "*.LST",
+	"B*.*", "F01*.MAC", "*.DAT", "F0000?.*", "Q*.OBJ", "F00999.TXT", "*.SYS", "F0100*.*"
+};
+static const char *const Rexs[MAX_PATTERNS] =
+{
+	"\\.MAC$", "^F0001", "^A.*\\.SAV$", "^F.0.0.\\.TXT$", "\\.OBJ$", "^SYS", "^F00..7\\.SAV$", "\\.LST$",
+	"^B", "^F01.*\\.MAC$", "\\.DAT$", "^F0000", "^Q.*\\.OBJ$", "^F00999\\.TXT$", "\\.SYS$", "^F0100"
+};
+
+/* Sorting */
+static InWorkingDir_t DirEnts[NUM_DIRENTS];
+static InWorkingDir_t *DirPtrs[NUM_DIRENTS];
+static InWorkingDir_t *SortPtrs[NUM_DIRENTS];
+static Options_t SortOpts;
+
+/* Text */
+static char *LfText, *CrlfText, *TextBuf, *ZeroBuf, *CopyBuf;
+static size_t LfTextLen, CrlfTextLen;
+
+/**
+ * Get the current monotonic time.
+ * @return time in nanoseconds.
+ */
+static U64 nowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (U64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Get a pseudo random number (xorshift32).
+ * @return next number.
+ */
+static unsigned int rnd(void)
+{
+	static unsigned int state = 12345;
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+/*
+ * The benchmarks. Each does iters passes over its data.
+ */
+
+static void bDescramble(long iters, int which)
+{
+	while ( iters-- > 0 )
+	{
+		descramble(FlpyOpts + which);
+		Sink += FlpyOpts[which].floppyImageUnscrambled[BLKSIZ];
+	}
+}
+
+static void bRescramble(long iters, int which)
+{
+	while ( iters-- > 0 )
+	{
+		rescramble(FlpyOpts + which, NULL);
+		Sink += FlpyOpts[which].floppyImage[BLKSIZ];
+	}
+}
+
+static void bFromRad50(long iters, int unused)
+{
+	char buf[12];
+	int ii;
+
+	while ( iters-- > 0 )
+	{
+		for ( ii = 0; ii < NUM_NAMES; ++ii )
+		{
+			fromRad50(buf, R50Names[ii][0]);
+			fromRad50(buf + 3, R50Names[ii][1]);
+			buf[6] = '.';
+			fromRad50(buf + 7, R50Names[ii][2]);
+			sqzSpaces(buf);
+			Sink += buf[1];
+		}
+	}
+}
+
+static void bDecodeName(long iters, int unused)
+{
+	char buf[12];
+	int ii;
+
+	while ( iters-- > 0 )
+	{
+		for ( ii = 0; ii < NUM_NAMES; ++ii )
+			Sink += r50DecodeName(buf, R50Names[ii]);
+	}
+}
+
+static void bDecodeNames(long iters, int unused)
+{
+	static char bufs[NUM_NAMES][12];
+
+	while ( iters-- > 0 )
+	{
+		r50DecodeNames(bufs[0], sizeof(bufs[0]), R50Names[0], 3, NUM_NAMES);
+		Sink += bufs[NUM_NAMES - 1][1];
+	}
+}
+
+static void bChar2r50(long iters, int unused)
+{
+	const char *src;
+	int ii, jj;
+	unsigned short word;
+
+	while ( iters-- > 0 )
+	{
+		for ( ii = 0; ii < NUM_NAMES; ++ii )
+		{
+			src = PadNames[ii];
+			for ( jj = 0; jj < 3; ++jj, src += 3 )
+			{
+				word = char2r50(src[0]) * 050 * 050 + char2r50(src[1]) * 050 + char2r50(src[2]);
+				Sink += word;
+			}
+		}
+	}
+}
+
+static void bEncodeName(long iters, int unused)
+{
+	unsigned short name[3];
+	int ii;
+
+	while ( iters-- > 0 )
+	{
+		for ( ii = 0; ii < NUM_NAMES; ++ii )
+		{
+			r50EncodeName(name, AscNames[ii]);
+			Sink += name[0];
+		}
+	}
+}
+
+static void bCvtName(long iters, int unused)
+{
+	int ii;
+
+	while ( iters-- > 0 )
+	{
+		for ( ii = 0; ii < NUM_NAMES; ++ii )
+		{
+			cvtName(&CvtOpts, HostNames[ii]);
+			Sink += CvtOpts.iHandle.iNameR50[0];
+		}
+	}
+}
+
+static void bNormexec(long iters, int numPats)
+{
+	int ii, jj;
+
+	while ( iters-- > 0 )
+	{
+		for ( ii = 0; ii < NUM_NAMES; ++ii )
+		{
+			for ( jj = 0; jj < numPats; ++jj )
+			{
+				if ( !normexec(NormExprs + jj * 10, AscNames[ii]) )
+					break;
+			}
+			Sink += jj;
+		}
+	}
+}
+
+static void bFilterFilename(long iters, int which)
+{
+	int ii;
+
+	while ( iters-- > 0 )
+	{
+		for ( ii = 0; ii < NUM_NAMES; ++ii )
+			Sink += filterFilename(FiltOpts + which, AscNames[ii]);
+	}
+}
+
+#if !NO_REGEXP
+static void bFilterRegex(long iters, int which)
+{
+	int ii;
+
+	while ( iters-- > 0 )
+	{
+		for ( ii = 0; ii < NUM_NAMES; ++ii )
+			Sink += filterFilename(RexOpts + which, AscNames[ii]);
+	}
+}
+#endif
+
+static void bQsort(long iters, int which)
+{
+	while ( iters-- > 0 )
+	{
+		memcpy(SortPtrs, DirPtrs, sizeof(SortPtrs));
+		qsort(SortPtrs, NUM_DIRENTS, sizeof(InWorkingDir_t *), cmpFuncs[which]);
+		Sink += SortPtrs[0]->lba;
+	}
+}
+
+static void bSortDirectory(long iters, int which)
+{
+	/* Same order as cmpFuncs[] */
+	static const U8 keys[4] = { SORTBY_NAME, SORTBY_TYPE, SORTBY_DATE, SORTBY_SIZE };
+
+	SortOpts.sortKeys[0] = keys[which & 3];
+	SortOpts.numSortKeys = 1;
+	SortOpts.sortby = SortOpts.sortKeys[0] | ((which & 4) ? SORTBY_REV : 0);
+	while ( iters-- > 0 )
+	{
+		memcpy(SortPtrs, DirPtrs, sizeof(SortPtrs));
+		sortDirectory(&SortOpts);
+		Sink += SortPtrs[0]->lba;
+	}
+}
+
+static void bMemcpy(long iters, int unused)
+{
+	while ( iters-- > 0 )
+	{
+		memcpy(TextBuf, LfText, LfTextLen);
+		Sink += TextBuf[LfTextLen - 1];
+	}
+}
+
+static void bExpandLoop(long iters, int unused)
+{
+	const char *src;
+	char *dst;
+	size_t ii;
+
+	/* What readInpFile() used to do */
+	while ( iters-- > 0 )
+	{
+		src = LfText;
+		dst = TextBuf;
+		for ( ii = 0; ii < LfTextLen; ++ii )
+		{
+			if ( src[ii] == '\n' && (!ii || src[ii - 1] != '\r') )
+				*dst++ = '\r';
+			*dst++ = src[ii];
+		}
+		Sink += dst - TextBuf;
+	}
+}
+
+static void bExpandLF(long iters, int unused)
+{
+	size_t extra;
+
+	while ( iters-- > 0 )
+	{
+		memcpy(TextBuf, LfText, LfTextLen);
+		extra = asciiCountLF(TextBuf, LfTextLen);
+		asciiExpandLF(TextBuf, LfTextLen, extra);
+		Sink += extra;
+	}
+}
+
+static void bStripLoop(long iters, int unused)
+{
+	const char *src;
+	char *dst;
+	size_t ii;
+	int cc, pendingCR;
+
+	/* What do_out() used to do */
+	while ( iters-- > 0 )
+	{
+		src = CrlfText;
+		dst = TextBuf;
+		pendingCR = 0;
+		for ( ii = 0; ii < CrlfTextLen; ++ii )
+		{
+			cc = src[ii];
+			if ( !cc || cc == 032 )
+				break;
+			if ( pendingCR && cc != '\n' )
+				*dst++ = '\r';
+			pendingCR = cc == '\r';
+			if ( !pendingCR )
+				*dst++ = cc;
+		}
+		Sink += dst - TextBuf;
+	}
+}
+
+static void bStripCR(long iters, int unused)
+{
+	AsciiStrip_t as;
+	size_t len;
+
+	while ( iters-- > 0 )
+	{
+		asciiStripInit(&as);
+		len = asciiStripCR(&as, CrlfText, CrlfTextLen, TextBuf);
+		len += asciiStripFinish(&as, TextBuf + len);
+		Sink += len;
+	}
+}
+
+static void bIsZero(long iters, int unused)
+{
+	while ( iters-- > 0 )
+		Sink += memIsZero(ZeroBuf, TEXT_LEN);
+}
+
+static void bMemcmp(long iters, int unused)
+{
+	while ( iters-- > 0 )
+		Sink += memcmp(LfText, CopyBuf, TEXT_LEN);
+}
+
+static void bDiff(long iters, int unused)
+{
+	while ( iters-- > 0 )
+		Sink += memDiff(LfText, CopyBuf, TEXT_LEN);
+}
+
+static void bSum16Loop(long iters, int unused)
+{
+	const U16 *wp;
+	U16 sum;
+	size_t ii;
+
+	while ( iters-- > 0 )
+	{
+		wp = (const U16 *)LfText;
+		for ( sum = 0, ii = 0; ii < TEXT_LEN / 2; ++ii )
+			sum += wp[ii];
+		Sink += sum;
+	}
+}
+
+static void bSum16(long iters, int unused)
+{
+	while ( iters-- > 0 )
+		Sink += memSum16(LfText, TEXT_LEN / 2);
+}
+
+/** Defines one benchmark */
+typedef struct
+{
+	const char *name;                   /**< Name used in results */
+	void (*func)(long iters, int arg);  /**< Does iters passes */
+	int arg;                            /**< Passed to func */
+	int items;                          /**< Items handled by one pass */
+	long bytes;                         /**< Bytes handled by one pass (0 if not meaningful) */
+} MicroBench_t;
+
+#define FLPY_BYTES(n) ((long)NUM_SECTORS * (NUM_TRACKS - 1) * 128 * (n))
+
+static const MicroBench_t Benches[] =
+{
+	{ "descramble RX01",                bDescramble,     0, 1, FLPY_BYTES(1) },
+	{ "descramble RX02",                bDescramble,     1, 1, FLPY_BYTES(2) },
+	{ "rescramble RX01",                bRescramble,     0, 1, FLPY_BYTES(1) },
+	{ "rescramble RX02",                bRescramble,     1, 1, FLPY_BYTES(2) },
+	{ "fromRad50 x3+sqzSpaces",         bFromRad50,      0, NUM_NAMES, 0 },
+	{ "r50DecodeName",                  bDecodeName,     0, NUM_NAMES, 0 },
+	{ "r50DecodeNames",                 bDecodeNames,    0, NUM_NAMES, 0 },
+	{ "char2r50 x9",                    bChar2r50,       0, NUM_NAMES, 0 },
+	{ "r50EncodeName",                  bEncodeName,     0, NUM_NAMES, 0 },
+	{ "cvtName",                        bCvtName,        0, NUM_NAMES, 0 },
+	{ "normexec 1 pattern",             bNormexec,       1, NUM_NAMES, 0 },
+	{ "normexec 4 patterns",            bNormexec,       4, NUM_NAMES, 0 },
+	{ "normexec 16 patterns",           bNormexec,      16, NUM_NAMES, 0 },
+	{ "filterFilename 1 wildcard",      bFilterFilename, 0, NUM_NAMES, 0 },
+	{ "filterFilename 4 wildcards",     bFilterFilename, 1, NUM_NAMES, 0 },
+	{ "filterFilename 16 wildcards",    bFilterFilename, 2, NUM_NAMES, 0 },
+#if !NO_REGEXP
+	{ "filterFilename -R 1 regex",      bFilterRegex,    0, NUM_NAMES, 0 },
+	{ "filterFilename -R 4 regexes",    bFilterRegex,    1, NUM_NAMES, 0 },
+	{ "filterFilename -R 16 regexes",   bFilterRegex,    2, NUM_NAMES, 0 },
+#endif
+	{ "qsort cmpName",                  bQsort,          0, NUM_DIRENTS, 0 },
+	{ "qsort cmpType",                  bQsort,          1, NUM_DIRENTS, 0 },
+	{ "qsort cmpDate",                  bQsort,          2, NUM_DIRENTS, 0 },
+	{ "qsort cmpSize",                  bQsort,          3, NUM_DIRENTS, 0 },
+	{ "qsort cmpName_r",                bQsort,          4, NUM_DIRENTS, 0 },
+	{ "qsort cmpDate_r",                bQsort,          6, NUM_DIRENTS, 0 },
+	{ "sortDirectory name",             bSortDirectory,  0, NUM_DIRENTS, 0 },
+	{ "sortDirectory type",             bSortDirectory,  1, NUM_DIRENTS, 0 },
+	{ "sortDirectory date",             bSortDirectory,  2, NUM_DIRENTS, 0 },
+	{ "sortDirectory size",             bSortDirectory,  3, NUM_DIRENTS, 0 },
+	{ "sortDirectory name -r",          bSortDirectory,  4, NUM_DIRENTS, 0 },
+	{ "sortDirectory date -r",          bSortDirectory,  6, NUM_DIRENTS, 0 },
+	{ "memcpy 64K (reference)",         bMemcpy,         0, 1, TEXT_LEN },
+	{ "lf->crlf byte loop 64K",         bExpandLoop,     0, 1, TEXT_LEN },
+	{ "asciiCountLF+ExpandLF 64K",      bExpandLF,       0, 1, TEXT_LEN },
+	{ "crlf->lf byte loop 64K",         bStripLoop,      0, 1, TEXT_LEN },
+	{ "asciiStripCR 64K",               bStripCR,        0, 1, TEXT_LEN },
+	{ "memIsZero 64K",                  bIsZero,         0, 1, TEXT_LEN },
+	{ "memcmp 64K (reference)",         bMemcmp,         0, 1, TEXT_LEN },
+	{ "memDiff 64K",                    bDiff,           0, 1, TEXT_LEN },
+	{ "word sum loop 64K",              bSum16Loop,      0, 1, TEXT_LEN },
+	{ "memSum16 64K",                   bSum16,          0, 1, TEXT_LEN }
+};
+#define NUM_BENCHES (int)(sizeof(Benches) / sizeof(Benches[0]))
+
+/**
+ * Make the data the benchmarks work on.
+ * @return 0 on success, 1 on error.
+ */
+static int setup(void)
+{
+	static const char *const exts[] = { "MAC", "SAV", "OBJ", "TXT", "LST", "DAT", "SYS", "BAK" };
+	int ii, jj, len;
+	char *dp;
+
+	/* Floppies filled with noise */
+	for ( ii = 0; ii < 2; ++ii )
+	{
+		Options_t *op = FlpyOpts + ii;
+
+		op->cmdOpts = ii ? CMDOPT_DOUBLE_FLPY : CMDOPT_SINGLE_FLPY;
+		op->floppyImageSize = NUM_SECTORS * NUM_TRACKS * 128 * (ii + 1);
+		op->floppyImage = (U8 *)malloc(op->floppyImageSize);
+		op->floppyImageUnscrambled = (U8 *)malloc(op->floppyImageSize);
+		if ( !op->floppyImage || !op->floppyImageUnscrambled )
+			return 1;
+		for ( jj = 0; jj < op->floppyImageSize; ++jj )
+			op->floppyImage[jj] = rnd();
+	}
+	/* Names */
+	for ( ii = 0; ii < NUM_NAMES; ++ii )
+	{
+		const char *ext = exts[rnd() % 8];
+		char name[8];
+
+		if ( (rnd() & 3) )
+			sprintf(name, "F%05d", (int)(rnd() % 1200));
+		else
+			sprintf(name, "%c%c%d", 'A' + (int)(rnd() % 26), 'A' + (int)(rnd() % 26), (int)(rnd() % 100));
+		sprintf(AscNames[ii], "%s.%s", name, ext);
+		sprintf(PadNames[ii], "%-6s%s", name, ext);
+		sprintf(HostNames[ii], "some/dir/%s", AscNames[ii]);
+		for ( dp = HostNames[ii]; *dp; ++dp )
+			*dp = tolower(*dp);
+		r50EncodeName(R50Names[ii], AscNames[ii]);
+	}
+	/* Filters */
+	for ( ii = 0; ii < MAX_PATTERNS; ++ii )
+	{
+		if ( mkNormExpr(NormExprs + ii * 10, Wilds[ii]) )
+			return 1;
+	}
+	for ( ii = 0; ii < 3; ++ii )
+	{
+		Options_t *op = FiltOpts + ii;
+
+		op->numArgFiles = 1 << (2 * ii);
+		op->argFiles = (char *const *)Wilds;
+		op->normExprs = NormExprs;
+#if !NO_REGEXP
+		op = RexOpts + ii;
+		op->numArgFiles = 1 << (2 * ii);
+		op->argFiles = (char *const *)Rexs;
+		op->fileOpts = FILEOPTS_REGEXP;
+		op->rexts = (regex_t *)calloc(op->numArgFiles, sizeof(regex_t));
+		if ( !op->rexts )
+			return 1;
+		for ( jj = 0; jj < op->numArgFiles; ++jj )
+		{
+			if ( regcomp(op->rexts + jj, Rexs[jj], REG_ICASE | REG_NOSUB) )
+				return 1;
+		}
+		buildRexUnion(op);
+#endif
+	}
+	/* Directory entries, about 1 in 8 of them empty */
+	for ( ii = 0; ii < NUM_DIRENTS; ++ii )
+	{
+		InWorkingDir_t *wdp = DirEnts + ii;
+
+		memcpy(wdp->rt11.name, R50Names[ii], sizeof(wdp->rt11.name));
+		r50DecodeName(wdp->ffull, wdp->rt11.name);
+		wdp->rt11.control = (rnd() & 7) ? PERM : EMPTY;
+		wdp->rt11.blocks = 1 + rnd() % 200;
+		wdp->rt11.date = ((rnd() % 12 + 1) << 10) | ((rnd() % 28 + 1) << 5) | (rnd() % 32) | ((rnd() & 3) << 14);
+		wdp->lba = ii;
+		DirPtrs[ii] = wdp;
+	}
+	SortOpts.linArray = SortPtrs;
+	SortOpts.numWdirs = NUM_DIRENTS;
+	/* Text: lines of 0 to 79 printable characters */
+	LfText = (char *)malloc(TEXT_LEN);
+	CrlfText = (char *)malloc(TEXT_LEN);
+	TextBuf = (char *)malloc(2 * TEXT_LEN + 2);
+	ZeroBuf = (char *)calloc(TEXT_LEN, 1);
+	CopyBuf = (char *)malloc(TEXT_LEN);
+	if ( !LfText || !CrlfText || !TextBuf || !ZeroBuf || !CopyBuf )
+		return 1;
+	len = 0;
+	while ( len < TEXT_LEN - 1 )
+	{
+		jj = rnd() % 80;
+		for ( ii = 0; ii < jj && len < TEXT_LEN - 1; ++ii )
+			LfText[len++] = ' ' + rnd() % 95;
+		LfText[len++] = '\n';
+	}
+	LfTextLen = len;
+	LfText[TEXT_LEN - 1] = '\n';
+	memcpy(CopyBuf, LfText, TEXT_LEN);     /* memDiff and memcmp compare these */
+	for ( ii = jj = 0; ii < (int)LfTextLen && jj < TEXT_LEN - 1; ++ii )
+	{
+		if ( LfText[ii] == '\n' )
+			CrlfText[jj++] = '\r';
+		CrlfText[jj++] = LfText[ii];
+	}
+	CrlfTextLen = jj;
+	return 0;
+}
+
+/**
+ * Compare two times for qsort().
+ */
+static int cmpDouble(const void *a, const void *b)
+{
+	double aa = *(const double *)a, bb = *(const double *)b;
+
+	return aa < bb ? -1 : aa > bb;
+}
+
+/**
+ * Show how to run rtpip_microbench.
+ * @return 1
+ */
+static int help_microbench(void)
+{
+	printf("Usage: rtpip_microbench [options] [name ...]\n"
+		   "where:\n"
+		   " -n N or --samples=N = number of samples of each benchmark (default 31)\n"
+		   " -t N or --time=N = minimum milliseconds per sample (default 2)\n"
+		   " -o file or --output=file = also write results as JSON to file\n"
+		   " -l or --list = just list the benchmarks\n"
+		   " -h or --help = this message\n"
+		   " name = only run benchmarks whose name contains this (default all)\n"
+		   "Times are per item: per name, per directory entry, per image or per 64K buffer.\n");
+	return 1;
+}
+
+static struct option long_micro_opts[] = {
+	{ "help", 0, 0, 'h' },
+	{ "list", 0, 0, 'l' },
+	{ "output", 1, 0, 'o' },
+	{ "samples", 1, 0, 'n' },
+	{ "time", 1, 0, 't' },
+	{ 0, 0, 0, 0 }
+};
+
+/**
+ * Time rtpip's inner loops.
+ * @param argc - number of command line arguments.
+ * @param argv - pointer to array of command line arguments.
+ * @return 0 on success, non-zero on failure.
+ */
+int main(int argc, char *const *argv)
+{
+	const char *output = NULL;
+	int goptret, option_index, samples = 31, minMs = 2, list = 0;
+	int ii, jj, kk, numResults = 0;
+	double *nsPer, median, p99;
+	long iters;
+	U64 start, elapsed;
+	FILE *json = NULL;
+
+	while ( (goptret = getopt_long(argc, argv, "hln:o:t:?", long_micro_opts, &option_index)) != -1 )
+	{
+		switch (goptret)
+		{
+		case 'l':
+			list = 1;
+			break;
+		case 'n':
+			samples = atoi(optarg);
+			if ( samples < 1 )
+				return help_microbench();
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 't':
+			minMs = atoi(optarg);
+			if ( minMs < 1 )
+				return help_microbench();
+			break;
+		default:
+			return help_microbench();
+		}
+	}
+	if ( list )
+	{
+		for ( ii = 0; ii < NUM_BENCHES; ++ii )
+			printf("%s\n", Benches[ii].name);
+		return 0;
+	}
+	nsPer = (double *)malloc(samples * sizeof(double));
+	if ( !nsPer || setup() )
+	{
+		fprintf(stderr, "Unable to set up benchmarks\n");
+		return 1;
+	}
+	if ( output )
+	{
+		json = fopen(output, "w");
+		if ( !json )
+		{
+			fprintf(stderr, "Unable to create '%s': %s\n", output, strerror(errno));
+			return 1;
+		}
+		fprintf(json, "{\"tool\":\"rtpip_microbench\",\"time\":%ld,\"samples\":%d,\"cpu\":\"%s\",\"results\":[",
+				(long)time(NULL), samples, cpuName(cpuLevel()));
+	}
+	printf("Kernels: %s (set RTPIP_CPU to change)\n", cpuName(cpuLevel()));
+	printf("%-32s %12s %12s %14s %10s\n", "Benchmark", "Median ns", "p99 ns", "Items/s", "MB/s");
+	for ( ii = 0; ii < NUM_BENCHES; ++ii )
+	{
+		const MicroBench_t *bp = Benches + ii;
+
+		if ( optind < argc )
+		{
+			for ( jj = optind; jj < argc && !strstr(bp->name, argv[jj]); ++jj )
+				;
+			if ( jj >= argc )
+				continue;
+		}
+		/* Warm up and find how many passes make a sample long enough */
+		for ( iters = 1; ; iters *= 2 )
+		{
+			start = nowNs();
+			bp->func(iters, bp->arg);
+			elapsed = nowNs() - start;
+			if ( elapsed >= (U64)minMs * 1000000 || iters >= (1L << 30) )
+				break;
+		}
+		for ( kk = 0; kk < samples; ++kk )
+		{
+			start = nowNs();
+			bp->func(iters, bp->arg);
+			elapsed = nowNs() - start;
+			nsPer[kk] = (double)elapsed / ((double)iters * bp->items);
+		}
+		qsort(nsPer, samples, sizeof(double), cmpDouble);
+		median = nsPer[samples / 2];
+		kk = (samples * 99 + 99) / 100 - 1;
+		p99 = nsPer[kk < samples ? kk : samples - 1];
+		printf("%-32s %12.2f %12.2f %14.0f", bp->name, median, p99, 1e9 / median);
+		if ( bp->bytes )
+			printf(" %10.1f\n", (double)bp->bytes / bp->items / median * 1e3);
+		else
+			printf(" %10s\n", "-");
+		if ( json )
+		{
+			fprintf(json, "%s\n{\"name\":\"%s\",\"items\":%d,\"bytes\":%ld,\"median_ns\":%.3f,\"p99_ns\":%.3f,\"ops_per_sec\":%.0f}",
+					numResults ? "," : "", bp->name, bp->items, bp->bytes, median, p99, 1e9 / median);
+		}
+		++numResults;
+	}
+	if ( json )
+	{
+		fprintf(json, "\n]}\n");
+		if ( fclose(json) )
+		{
+			fprintf(stderr, "Error writing '%s': %s\n", output, strerror(errno));
+			return 1;
+		}
+	}
+	free(nsPer);
+	return 0;
+}
@@ -18,7 +18,13 @@
 	along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#ifndef MINGW
+	#define _POSIX_C_SOURCE 200112L
+#endif
 #include "rtpip.h"
+#ifndef MINGW
+	#include <fcntl.h>
+#endif
 
 /**
  * @file output.c
@@ -41,7 +47,7 @@ static int mkTmpName(TmpBuf_t *bufP)
 	bufP->tmpContName = (char *)malloc(2 * ii + 2);
 	if ( !bufP->tmpContName )
 	{
-		fprintf(stderr, "Ran out of memory getting %d bytes for tmp filenames: %s\n",
+		msgErr(bufP->options, "Ran out of memory getting %d bytes for tmp filenames: %s\n",
 				2 * ii + 2, strerror(errno));
 		return 1;
 	}
@@ -57,11 +63,81 @@ static int mkTmpName(TmpBuf_t *bufP)
 	return 0;
 }
 
+/**
+ * Copy a host file into the container without reading it into memory. All the whole
+ * blocks are copied by the kernel if it can. The last partial block, if any, is read
+ * into a small buffer and padded with 0's.
+ * @param options - pointer to options
+ * @param wdp - pointer to directory entry
+ * @return 0 on success, 1 on error. Error message will have been displayed.
+ */
+static int directToContainer(Options_t *options, InWorkingDir_t *wdp)
+{
+	InHandle_t *ihp = &options->iHandle;
+	FILE *inp;
+	long body, tail, retv;
+
+	inp = statFopen(options, STAT_IO_HOST, ihp->directName, "rb");
+	if ( !inp )
+	{
+		msgErr(options, "Error opening '%s' for input: %s\n",
+				ihp->directName, strerror(errno));
+		return 1;
+	}
+	tail = ihp->directSize % BLKSIZ;
+	body = ihp->directSize - tail;
+	/* Anything written with stdio has to get there before the kernel writes around it */
+	fflush(options->inp);
+	retv = fileCopy(options, STAT_IO_HOST, fileno(inp), 0, STAT_IO_CONT, fileno(options->inp),
+					(long)wdp->lba * BLKSIZ, body);
+	if ( retv != body )
+	{
+		msgErr(options, "Error copying %ld bytes from '%s' to LBA %d. Copied %ld: %s\n",
+				body, ihp->directName, wdp->lba, retv, retv < 0 ? strerror(errno) : "Premature EOF");
+		fclose(inp);
+		return 1;
+	}
+	if ( tail )
+	{
+		if ( !ihp->inFileBufSize )
+		{
+			ihp->inFileBuf = (char *)malloc(BLKSIZ);
+			if ( !ihp->inFileBuf )
+			{
+				msgErr(options, "Unable to allocate %d bytes for input file: %s\n",
+						BLKSIZ, strerror(errno));
+				fclose(inp);
+				return 1;
+			}
+			ihp->inFileBufSize = BLKSIZ;
+		}
+		memset(ihp->inFileBuf, 0, BLKSIZ);
+		if ( statFseek(options, STAT_IO_HOST, inp, body, SEEK_SET)
+			 || (retv = statFread(options, STAT_IO_HOST, ihp->inFileBuf, 1, tail, inp)) != tail )
+		{
+			msgErr(options, "Error reading '%s'. Expected %ld bytes at %ld: %s\n",
+					ihp->directName, tail, body, strerror(errno));
+			fclose(inp);
+			return 1;
+		}
+		retv = statFseek(options, STAT_IO_CONT, options->inp, (long)wdp->lba * BLKSIZ + body, SEEK_SET);
+		if ( retv < 0 || statFwrite(options, STAT_IO_CONT, ihp->inFileBuf, BLKSIZ, 1, options->inp) != 1 )
+		{
+			msgErr(options, "Error writing block %ld for '%s': %s\n",
+					wdp->lba + body / BLKSIZ, ihp->argFN, strerror(errno));
+			fclose(inp);
+			return 1;
+		}
+	}
+	fclose(inp);
+	return 0;
+}
+
 /**
  * Write a file into container
  * @param options - pointer to options
  * @param wdp - pointer to directory entry
- * @return 0 on success, 1 on error
+ * @return 0 on success, 1 on error, 2 if just this file could not be written
  */
 int writeFileToContainer(Options_t *options, InWorkingDir_t *wdp)
 {
@@ -73,10 +149,10 @@ int writeFileToContainer(Options_t *options, InWorkingDir_t *wdp)
 	if ( !options->openedWrite )
 	{
 		fclose(options->inp);
-		options->inp = fopen(options->container, "rb+");
+		options->inp = statFopen(options, STAT_IO_CONT, options->container, "rb+");
 		if ( !options->inp )
 		{
-			fprintf(stderr, "Error reopening '%s' for r/w: %s\n",
+			msgErr(options, "Error reopening '%s' for r/w: %s\n",
 					options->container, strerror(errno));
 			return 1;
 		}
@@ -86,28 +162,36 @@ int writeFileToContainer(Options_t *options, InWorkingDir_t *wdp)
 	}
 	if ( (options->cmdOpts&CMDOPT_DBG_NORMAL) )
 	{
-		retv = fseek(options->inp, 0, SEEK_END);
+		retv = statFseek(options, STAT_IO_CONT, options->inp, 0, SEEK_END);
 		printf("writeFileToContainer(): Seeking to block %d to write %d blocks for file '%s' (current EOF block %ld)\n",
 			   wdp->lba,
 			   wdp->rt11.blocks,
 			   ihp->argFN,
 			   ftell(options->inp)/BLKSIZ);
 	}
-	retv = fseek(options->inp, wdp->lba * BLKSIZ, SEEK_SET);
+	retv = statFseek(options, STAT_IO_CONT, options->inp, wdp->lba * BLKSIZ, SEEK_SET);
 	if ( retv < 0 || ferror(options->inp) || (ftell(options->inp) != wdp->lba * BLKSIZ) )
 	{
-		fprintf(stderr, "Error seeking to %d to write file '%s': %s\n",
+		msgErr(options, "Error seeking to %d to write file '%s': %s\n",
 				wdp->lba, options->iHandle.argFN, strerror(errno));
-		return 0;
+		return 2;
 	}
-	wBuf = ihp->inFileBuf;
-	retv = fwrite(wBuf, BLKSIZ, dirptr->blocks, options->inp);
-	if ( retv != dirptr->blocks )
+	if ( ihp->directName )
 	{
-		fprintf(stderr, "Error writing %d blocks %d-%d for '%s': %s\n",
-				dirptr->blocks, wdp->lba, wdp->lba + dirptr->blocks - 1,
-				ihp->argFN, strerror(errno));
-		return 0;
+		if ( directToContainer(options, wdp) )
+			return 2;
+	}
+	else
+	{
+		wBuf = ihp->inFileBuf;
+		retv = statFwrite(options, STAT_IO_CONT, wBuf, BLKSIZ, dirptr->blocks, options->inp);
+		if ( retv != dirptr->blocks )
+		{
+			msgErr(options, "Error writing %d blocks %d-%d for '%s': %s\n",
+					dirptr->blocks, wdp->lba, wdp->lba + dirptr->blocks - 1,
+					ihp->argFN, strerror(errno));
+			return 2;
+		}
 	}
 	if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) || options->verbose || (options->inOpts & INOPTS_VERB) )
 	{
@@ -157,11 +241,7 @@ static void dumpAllSegments(const char *title, Options_t *options, const Rt11Seg
 			{
 				++files;
 				++totFiles;
-				fromRad50(fName, dirptr->name[0]);
-				fromRad50(fName + 3, dirptr->name[1]);
-				fName[6] = '.';
-				fromRad50(fName + 7, dirptr->name[2]);
-				sqzSpaces(fName);
+				r50DecodeName(fName, dirptr->name);
 				printf("        %2d:%2d: %-10.10s %5d %s",
 					   segNum, entNum,
 					   fName,
@@ -210,6 +290,35 @@ static void dumpAllSegments(const char *title, Options_t *options, const Rt11Seg
 }
 #endif
 
+/**
+ * Write whole blocks to a new file, seeking over any that are all zeros so
+ * they are left as holes (which read back as zeros).
+ * @param options - pointer to options
+ * @param buf - pointer to blocks to write
+ * @param len - number of bytes to write (a multiple of BLKSIZ)
+ * @param fp - file to write to; the caller has to make sure it ends up at least as long as it should be
+ * @return number of bytes written or skipped (len on success)
+ */
+static int sparseWrite(Options_t *options, const U8 *buf, int len, FILE *fp)
+{
+	int ii, run, zero;
+
+	for ( ii = 0; ii < len; ii += run )
+	{
+		zero = memIsZero(buf + ii, BLKSIZ);
+		for ( run = BLKSIZ; ii + run < len && memIsZero(buf + ii + run, BLKSIZ) == zero; run += BLKSIZ )
+			;
+		if ( zero )
+		{
+			if ( statFseek(options, STAT_IO_CONT, fp, run, SEEK_CUR) )
+				return ii;
+		}
+		else if ( statFwrite(options, STAT_IO_CONT, buf + ii, 1, run, fp) != run )
+			return ii;
+	}
+	return len;
+}
+
 /**
  * Create a new container file squeezing out all the empty space.
  * @param options - pointer to options
@@ -223,12 +332,13 @@ int createNewContainer(Options_t *options)
 	U8 * iBuf,*oBuf = NULL,*oBufRunning = NULL;
 	int iBufSize = 0, movedFiles = 0;
 	FILE *tmp;
-	int ii, dirNum, oSegNum, zLBA, dstLBA, iDstDent, wCnt; /* srcLBA, */
+	int ii, dirNum, oSegNum, dstLBA, iDstDent, wCnt; /* srcLBA, */
 	int maxSeg, maxEntPSeg;
 	const Rt11SegEnt_t *firstSrcSeg;
 	Rt11SegEnt_t * firstDstSeg,*dstseg;
 	InWorkingDir_t *wdp;
 	Rt11DirEnt_t *dstdir;
+	U64 traceStart;
 
 #if 0
 	if ((options->cmdOpts&CMDOPT_NOWRITE))
@@ -241,12 +351,12 @@ int createNewContainer(Options_t *options)
 	{
 		if ( !options->totEmpty || !options->totEmptyEntries )
 		{
-			printf("ERROR: There is no empty space available\n");
+			msgErr(options, "ERROR: There is no empty space available\n");
 			return 1;
 		}
 		if ( options->totEmptyEntries < 2 )
 		{
-			printf("Container is already squeezed\n");
+			msgOut(options, "Container is already squeezed\n");
 			return 0;
 		}
 	}
@@ -261,7 +371,7 @@ int createNewContainer(Options_t *options)
 	/* If user provided a segment count, use that */
 	if ( options->totPermEntries+maxSeg >= options->numdent * maxSeg )
 	{
-		fprintf(stderr, "ERROR: Too many files (%d) to fit in %d segments at %d files each\n", options->totPermEntries, maxSeg, options->numdent);
+		msgErr(options, "ERROR: Too many files (%d) to fit in %d segments at %d files each\n", options->totPermEntries, maxSeg, options->numdent);
 		return 1;
 	}
 	firstSrcSeg = (Rt11SegEnt_t *)options->directory;
@@ -290,19 +400,18 @@ int createNewContainer(Options_t *options)
 	}
 	if ( maxSeg < firstSrcSeg->smax )
 	{
-		printf("createNewContainer(): computed or provided maxSeg of %d which is less than %d. Using %d\n", maxSeg, firstSrcSeg->smax, firstSrcSeg->smax);
+		/* Nothing wrong with that; the new directory just can't be smaller than the old one */
+		if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) || options->verbose )
+			msgOut(options, "createNewContainer(): computed or provided maxSeg of %d which is less than %d. Using %d\n", maxSeg, firstSrcSeg->smax, firstSrcSeg->smax);
 		maxSeg = firstSrcSeg->smax;
 	}
 	/* Evenly distribute all the files among all available segments */
 	maxEntPSeg = options->totPermEntries / maxSeg;
-	if ( options->totPermEntries / maxSeg >= 1 )
-	{
-		if ( (maxEntPSeg % (options->totPermEntries / maxSeg)) )
-			++maxEntPSeg;
-	}
+	if ( (options->totPermEntries % maxSeg) )
+		++maxEntPSeg;
 	if ( maxEntPSeg >= options->numdent )
 	{
-		fprintf(stderr, "ERROR: Too many files (%d) to fit in %d segments at %d files each. (maxEntPSeg=%d)\n",
+		msgErr(options, "ERROR: Too many files (%d) to fit in %d segments at %d files each. (maxEntPSeg=%d)\n",
 				options->totPermEntries, maxSeg, options->numdent, maxEntPSeg);
 		return 1;
 	}
@@ -317,10 +426,10 @@ int createNewContainer(Options_t *options)
 	if ( mkTmpName(&tmpBufS) )
 		return 1;
 	/* Create the tmp file and open for writes */
-	tmp = fopen(tmpBufS.tmpContName, "wb");
+	tmp = statFopen(options, STAT_IO_CONT, tmpBufS.tmpContName, "wb");
 	if ( !tmp )
 	{
-		fprintf(stderr, "Error creating temp file '%s' for write: %s\n",
+		msgErr(options, "Error creating temp file '%s' for write: %s\n",
 				tmpBufS.tmpContName, strerror(errno));
 		free(tmpBufS.tmpContName);
 		return 1;
@@ -333,7 +442,7 @@ int createNewContainer(Options_t *options)
 	iBuf = (unsigned char *)malloc(iBufSize);
 	if ( !iBuf )
 	{
-		fprintf(stderr, "Ran out of memory getting a %d byte buffer: %s\n",
+		msgErr(options, "Ran out of memory getting a %d byte buffer: %s\n",
 				iBufSize, strerror(errno));
 		free(tmpBufS.tmpContName);
 		return 1;
@@ -347,7 +456,7 @@ int createNewContainer(Options_t *options)
 		oBuf = (unsigned char *)calloc(options->floppyImageSize, 1);
 		if ( !oBuf )
 		{
-			fprintf(stderr, "Ran out of memory getting a %d byte floppy output buffer: %s\n",
+			msgErr(options, "Ran out of memory getting a %d byte floppy output buffer: %s\n",
 					options->floppyImageSize, strerror(errno));
 			free(iBuf);
 			free(tmpBufS.tmpContName);
@@ -376,12 +485,12 @@ int createNewContainer(Options_t *options)
 	else
 	{
 		/* Seek the input container back to 0 */
-		fseek(options->inp, 0, SEEK_SET);
+		statFseek(options, STAT_IO_CONT, options->inp, 0, SEEK_SET);
 		/* Read the boot sectors and home block into our tmp buffer */
-		ans = fread(iBuf, 1, options->seg1LBA * BLKSIZ, options->inp);
+		ans = statFread(options, STAT_IO_CONT, iBuf, 1, options->seg1LBA * BLKSIZ, options->inp);
 		if ( ans != options->seg1LBA * BLKSIZ )
 		{
-			fprintf(stderr, "Error reading %ld boot and home blocks from '%s':%s\n",
+			msgErr(options, "Error reading %ld boot and home blocks from '%s':%s\n",
 					options->seg1LBA, options->container, strerror(errno));
 			free(iBuf);
 			fclose(tmp);
@@ -390,10 +499,10 @@ int createNewContainer(Options_t *options)
 			return 1;
 		}
 		/* And write the boot + home blocks to the tmp file */
-		ii = fwrite(iBuf, 1, ans, tmp);
+		ii = statFwrite(options, STAT_IO_CONT, iBuf, 1, ans, tmp);
 		if ( ii != ans )
 		{
-			fprintf(stderr, "Error writing %ld boot blocks to '%s':%s\n",
+			msgErr(options, "Error writing %ld boot blocks to '%s':%s\n",
 					options->seg1LBA, tmpBufS.tmpContName, strerror(errno));
 			free(iBuf);
 			fclose(tmp);
@@ -406,7 +515,7 @@ int createNewContainer(Options_t *options)
 		firstDstSeg = (Rt11SegEnt_t *)calloc(ii, 1);
 		if ( !firstDstSeg )
 		{
-			fprintf(stderr, "Ran out of memory calloc'ing %d bytes for output directory:%s\n",
+			msgErr(options, "Ran out of memory calloc'ing %d bytes for output directory:%s\n",
 					ii, strerror(errno));
 			free(iBuf);
 			fclose(tmp);
@@ -415,10 +524,10 @@ int createNewContainer(Options_t *options)
 			return 1;
 		}
 		/* Write the, so far, blank directory segments to the tmp file (just temporarily instead of seeking past them) */
-		ans = fwrite(firstDstSeg, 1, ii, tmp);
+		ans = statFwrite(options, STAT_IO_CONT, firstDstSeg, 1, ii, tmp);
 		if ( ii != ans )
 		{
-			fprintf(stderr, "Error writing %ld boot and home blocks to '%s':%s\n",
+			msgErr(options, "Error writing %ld boot and home blocks to '%s':%s\n",
 					options->seg1LBA, tmpBufS.tmpContName, strerror(errno));
 			fclose(tmp);
 			unlink(tmpBufS.tmpContName);
@@ -444,8 +553,11 @@ int createNewContainer(Options_t *options)
 	{
 		if ( !dstseg || (maxSeg > 1 && iDstDent >= maxEntPSeg && oSegNum < maxSeg) )
 		{
-			printf("Dir loop: dirNum=%d, iDstDent=%d, maxEntPSeg=%d, oSegNum=%d, maxSeg-1=%d\n",
-				   dirNum, iDstDent, maxEntPSeg, oSegNum, maxSeg-1);
+			if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
+			{
+				printf("Dir loop: dirNum=%d, iDstDent=%d, maxEntPSeg=%d, oSegNum=%d, maxSeg-1=%d\n",
+					   dirNum, iDstDent, maxEntPSeg, oSegNum, maxSeg-1);
+			}
 			if ( dstdir && oSegNum > 0 )
 			{
 				dstdir->blocks = 0;
@@ -454,9 +566,9 @@ int createNewContainer(Options_t *options)
 			}
 			dstseg = (Rt11SegEnt_t *)((U8 *)firstDstSeg + oSegNum * SEGSIZ);
 			++oSegNum;
-			if ( oSegNum >= MAXSEGMENTS - 1 )
+			if ( oSegNum > maxSeg )
 			{
-				fprintf(stderr, "ERROR: Fatal internal error. oSegNum became %d after %d files moved\n", oSegNum, dirNum);
+				msgErr(options, "ERROR: Fatal internal error. oSegNum became %d after %d files moved\n", oSegNum, dirNum);
 				fclose(tmp);
 				unlink(tmpBufS.tmpContName);
 				free(iBuf);
@@ -482,6 +594,7 @@ int createNewContainer(Options_t *options)
 		}
 		if ( (wdp->rt11.control & PERM) )
 		{
+			TRACE_START(options, traceStart);
 			*dstdir = wdp->rt11;	/* copy the whole directory entry */
 			/* advance the directory pointer */
 			dstdir = (Rt11DirEnt_t *)((U8 *)dstdir + DIRLEN + firstSrcSeg->extra);
@@ -493,7 +606,7 @@ int createNewContainer(Options_t *options)
 				U8 *src;
 				if ( eof > options->floppyImageSize / BLKSIZ )
 				{
-					fprintf(stderr, "ERROR: Fatal internal error. Read file '%s' with size of %d blocks at LBA %d is out of bounds. Disk size is %d blocks.\n",
+					msgErr(options, "ERROR: Fatal internal error. Read file '%s' with size of %d blocks at LBA %d is out of bounds. Disk size is %d blocks.\n",
 							wdp->ffull, wdp->rt11.blocks, wdp->lba, options->floppyImageSize / BLKSIZ);
 					fclose(tmp);
 					unlink(tmpBufS.tmpContName);
@@ -503,7 +616,7 @@ int createNewContainer(Options_t *options)
 				}
 				if ( dstLBA > options->floppyImageSize / BLKSIZ )
 				{
-					fprintf(stderr, "ERROR: Fatal internal error. Write file '%s' with size of %d blocks at LBA %d is out of bounds. Disk size is %d blocks.\n",
+					msgErr(options, "ERROR: Fatal internal error. Write file '%s' with size of %d blocks at LBA %d is out of bounds. Disk size is %d blocks.\n",
 							wdp->ffull, wdp->rt11.blocks, dstLBA, options->floppyImageSize / BLKSIZ);
 					fclose(tmp);
 					unlink(tmpBufS.tmpContName);
@@ -519,10 +632,10 @@ int createNewContainer(Options_t *options)
 			}
 			else
 			{
-				fseek(options->inp, wdp->lba * BLKSIZ, SEEK_SET);
+				statFseek(options, STAT_IO_CONT, options->inp, wdp->lba * BLKSIZ, SEEK_SET);
 				if ( ferror(tmp) )
 				{
-					fprintf(stderr, "Error seeking container file to %d: %s\n",
+					msgErr(options, "Error seeking container file to %d: %s\n",
 							wdp->lba * BLKSIZ, strerror(errno));
 					free(iBuf);
 					free(firstDstSeg);
@@ -535,12 +648,12 @@ int createNewContainer(Options_t *options)
 				if ( wCnt > iBufSize )
 				{
 					U8 *newBP;
-					fprintf(stderr, "Warning: Internal error. Need to copy %d byte file into %d byte buffer. Fixing it.\n",
+					msgErr(options, "Warning: Internal error. Need to copy %d byte file into %d byte buffer. Fixing it.\n",
 							wCnt, iBufSize);
 					newBP = (U8 *)realloc(iBuf, wCnt);
 					if ( !newBP )
 					{
-						fprintf(stderr, "No memory to reallocate %d byte buffer.\n", wCnt);
+						msgErr(options, "No memory to reallocate %d byte buffer.\n", wCnt);
 						free(iBuf);
 						free(firstDstSeg);
 						fclose(tmp);
@@ -551,10 +664,10 @@ int createNewContainer(Options_t *options)
 					iBuf = newBP;
 					iBufSize = wCnt;
 				}
-				retv = fread(iBuf, 1, wCnt, options->inp);
+				retv = statFread(options, STAT_IO_CONT, iBuf, 1, wCnt, options->inp);
 				if ( retv != wCnt )
 				{
-					fprintf(stderr, "Error reading %d bytes from container: %s\n",
+					msgErr(options, "Error reading %d bytes from container: %s\n",
 							wCnt, strerror(errno));
 					free(iBuf);
 					free(firstDstSeg);
@@ -563,10 +676,10 @@ int createNewContainer(Options_t *options)
 					free(tmpBufS.tmpContName);
 					return 1;
 				}
-				retv = fwrite(iBuf, 1, wCnt, tmp);
+				retv = sparseWrite(options, iBuf, wCnt, tmp);
 				if ( retv != wCnt )
 				{
-					fprintf(stderr, "Error writing %d bytes to tmp file: %s\n",
+					msgErr(options, "Error writing %d bytes to tmp file: %s\n",
 							wCnt, strerror(errno));
 					free(iBuf);
 					free(firstDstSeg);
@@ -582,6 +695,7 @@ int createNewContainer(Options_t *options)
 				printf("Moved %-10.10s, srcLBA: %6d, dstLBA: %6d, blocks: %4d, dstdir=%p-%p\n",
 					   wdp->ffull, wdp->lba, dstLBA, wdp->rt11.blocks, dstdir, (U8 *)dstdir + sizeof(Rt11DirEnt_t) + firstSrcSeg->extra - 1);
 			}
+			TRACE_FILE(options, "sqz", traceStart, wdp->ffull, wdp->lba, wdp->rt11.blocks, (long)wCnt);
 			dstLBA += wdp->rt11.blocks;
 		}
 /*        srcLBA += wdp->rt11.blocks; */
@@ -593,34 +707,6 @@ int createNewContainer(Options_t *options)
 		printf("Added <EMPTY> at segment %d, entry %d. LBA: %d, blocks: %d\n",
 			   oSegNum, iDstDent, dstLBA, dstdir->blocks);
 	}
-	zLBA = dstLBA;
-	if ( !isFloppy )
-	{
-		memset(iBuf, 0, iBufSize);    /* get a bunch of zeros */
-		for ( ii = 0; ii < dstdir->blocks; ii += iBufSize / BLKSIZ )
-		{
-			int sLBA;
-
-			sLBA = zLBA;
-			wCnt = iBufSize / BLKSIZ;
-			if ( wCnt > dstdir->blocks - ii )
-				wCnt = dstdir->blocks - ii;
-			zLBA += wCnt;
-			wCnt *= BLKSIZ;
-			retv = fwrite(iBuf, 1, wCnt, tmp);
-			if ( retv != wCnt )
-			{
-				fprintf(stderr, "Error writing %d bytes of zeros to tmp file starting at LBA %d: %s\n",
-						wCnt, sLBA, strerror(errno));
-				free(iBuf);
-				free(firstDstSeg);
-				fclose(tmp);
-				unlink(tmpBufS.tmpContName);
-				free(tmpBufS.tmpContName);
-				return 1;
-			}
-		}
-	}
 	dstLBA += dstdir->blocks;
 	/* advance directory index */
 	++iDstDent;
@@ -658,10 +744,10 @@ int createNewContainer(Options_t *options)
 			return 1;
 		}
 		/* Write the entire new floppy image */
-		retv = fwrite(options->floppyImage, 1, options->floppyImageSize, tmp);
+		retv = statFwrite(options, STAT_IO_CONT, options->floppyImage, 1, options->floppyImageSize, tmp);
 		if ( retv != options->floppyImageSize )
 		{
-			fprintf(stderr, "Error writing %d bytes of floppy image to tmp: %s\n",
+			msgErr(options, "Error writing %d bytes of floppy image to tmp: %s\n",
 					options->floppyImageSize, strerror(errno));
 			fclose(tmp);
 			unlink(tmpBufS.tmpContName);
@@ -674,10 +760,10 @@ int createNewContainer(Options_t *options)
 	else
 	{
 		/* Backup to segment area */
-		fseek(tmp, options->seg1LBA * BLKSIZ, SEEK_SET);
+		statFseek(options, STAT_IO_CONT, tmp, options->seg1LBA * BLKSIZ, SEEK_SET);
 		if ( ferror(tmp) )
 		{
-			fprintf(stderr, "Error seeking tmp file to %ld: %s\n",
+			msgErr(options, "Error seeking tmp file to %ld: %s\n",
 					options->seg1LBA * BLKSIZ, strerror(errno));
 			fclose(tmp);
 			unlink(tmpBufS.tmpContName);
@@ -687,10 +773,10 @@ int createNewContainer(Options_t *options)
 			return 1;
 		}
 		/* Write all the directory segments */
-		retv = fwrite(firstDstSeg, 1, maxSeg * SEGSIZ, tmp);
+		retv = statFwrite(options, STAT_IO_CONT, firstDstSeg, 1, maxSeg * SEGSIZ, tmp);
 		if ( retv != maxSeg * SEGSIZ )
 		{
-			fprintf(stderr, "Error writing %d bytes of directory at loc %ld to tmp: %s\n",
+			msgErr(options, "Error writing %d bytes of directory at loc %ld to tmp: %s\n",
 					maxSeg * SEGSIZ, options->seg1LBA * BLKSIZ, strerror(errno));
 			fclose(tmp);
 			unlink(tmpBufS.tmpContName);
@@ -699,6 +785,18 @@ int createNewContainer(Options_t *options)
 			free(tmpBufS.tmpContName);
 			return 1;
 		}
+		/* The empty space at the end (and any blocks of zeros skipped above) reads as zeros without being written */
+		if ( fflush(tmp) || ftruncate(fileno(tmp), (off_t)options->diskSize * BLKSIZ) )
+		{
+			msgErr(options, "Error setting size of tmp file to %d blocks: %s\n",
+					options->diskSize, strerror(errno));
+			fclose(tmp);
+			unlink(tmpBufS.tmpContName);
+			free(firstDstSeg);
+			free(iBuf);
+			free(tmpBufS.tmpContName);
+			return 1;
+		}
 		/* we're done */
 	}
 	fclose(tmp);
@@ -751,18 +849,18 @@ int writeNewDir(Options_t *options)
 			tmpBufS.options = options;
 			if ( mkTmpName(&tmpBufS) )
 				return 1;
-			tmp = fopen(tmpBufS.tmpContName, "wb");
+			tmp = statFopen(options, STAT_IO_CONT, tmpBufS.tmpContName, "wb");
 			if ( !tmp )
 			{
-				fprintf(stderr, "ERROR: Failed to open '%s' for write: %s\n", tmpBufS.tmpContName, strerror(errno));
+				msgErr(options, "ERROR: Failed to open '%s' for write: %s\n", tmpBufS.tmpContName, strerror(errno));
 				free(tmpBufS.tmpContName);
 				return 1;
 			}
 			/* Write the entire new floppy image */
-			ret = fwrite(options->floppyImage, 1, options->floppyImageSize, tmp);
+			ret = statFwrite(options, STAT_IO_CONT, options->floppyImage, 1, options->floppyImageSize, tmp);
 			if ( ret != options->floppyImageSize )
 			{
-				fprintf(stderr, "Error writing %d bytes of floppy image to '%s': %s\n",
+				msgErr(options, "Error writing %d bytes of floppy image to '%s': %s\n",
 						options->floppyImageSize, tmpBufS.tmpContName, strerror(errno));
 				fclose(tmp);
 				unlink(tmpBufS.tmpContName);
@@ -781,50 +879,50 @@ int writeNewDir(Options_t *options)
 			{
 				if ( (options->cmdOpts&CMDOPT_DBG_NORMAL) )
 				{
-					fseek(options->inp,0,SEEK_END);
+					statFseek(options, STAT_IO_CONT, options->inp,0,SEEK_END);
 					printf("writeNewDir(): Before reopen as r+: EOF block is %ld\n", ftell(options->inp)/BLKSIZ);
 				}
 				fclose(options->inp);
-				options->inp = fopen(options->container, "r+");
+				options->inp = statFopen(options, STAT_IO_CONT, options->container, "r+");
 				if ( !options->inp )
 				{
-					fprintf(stderr, "Error reopening '%s' for r/w: %s\n",
+					msgErr(options, "Error reopening '%s' for r/w: %s\n",
 							options->container, strerror(errno));
 					return 1;
 				}
 				options->openedWrite = 1;
 				if ( (options->cmdOpts&CMDOPT_DBG_NORMAL) )
 				{
-					fseek(options->inp,0,SEEK_END);
+					statFseek(options, STAT_IO_CONT, options->inp,0,SEEK_END);
 					printf("writeNewDir(): After reopen as r+: EOF block is %ld\n", ftell(options->inp)/BLKSIZ);
 				}
 			}
 			if ( (options->cmdOpts&CMDOPT_DBG_NORMAL) )
 			{
-				ret = fseek(options->inp,0,SEEK_END);
+				ret = statFseek(options, STAT_IO_CONT, options->inp,0,SEEK_END);
 				printf("writeNewDir(): Seeking to block %2ld to write %d directory segments. Current EOF is block %ld\n",
 					   options->seg1LBA,
 					   options->maxseg,
 					   ftell(options->inp)/BLKSIZ);
 			}
-			ret = fseek(options->inp, options->seg1LBA * BLKSIZ, SEEK_SET);
+			ret = statFseek(options, STAT_IO_CONT, options->inp, options->seg1LBA * BLKSIZ, SEEK_SET);
 			if ( ret < 0 || ferror(options->inp) || (ftell(options->inp) != options->seg1LBA * BLKSIZ) )
 			{
-				fprintf(stderr, "Error seeking to %ld: %s\n",
+				msgErr(options, "Error seeking to %ld: %s\n",
 						options->seg1LBA, strerror(errno));
 				return 1;
 			}
 			ans = options->maxseg * SEGSIZ;
-			ret = fwrite(options->directory, 1, ans, options->inp);
+			ret = statFwrite(options, STAT_IO_CONT, options->directory, 1, ans, options->inp);
 			if ( ret != ans )
 			{
-				fprintf(stderr, "Error writing directory. Expected to write %d bytes. Wrote %d. %s\n",
+				msgErr(options, "Error writing directory. Expected to write %d bytes. Wrote %d. %s\n",
 						ans, ret, strerror(errno));
 				return 1;
 			}
 			if ( (options->cmdOpts&CMDOPT_DBG_NORMAL) )
 			{
-				fseek(options->inp,0,SEEK_END);
+				statFseek(options, STAT_IO_CONT, options->inp,0,SEEK_END);
 				printf("writeNewDir(): Wrote %d bytes starting at LBA %ld to %s. (Current EOF is now block %ld)\n",
 					   ans, options->seg1LBA, options->container, ftell(options->inp));
 			}
@@ -859,10 +957,14 @@ int writeNewDir(Options_t *options)
  */
 int do_sqz(Options_t *options)
 {
-	return createNewContainer(options);
+	int sts;
+
+	statBegin(options, STAT_PH_COPY);
+	sts = createNewContainer(options);
+	statEnd(options, STAT_PH_COPY);
+	return sts;
 }
 
-#if 0
 /**
  * Fake boot sectors. The following gets copied to the first 5 blocks of
  * newly created container file when using the 'new' command.
@@ -891,68 +993,175 @@ static unsigned short idx_1700[]=
 	0042504, 0051103, 0030524, 0040461, 0020040, 0020040, 0000000, 0000000
 };
 /**/
-#endif
 
 /**
- * Create an empty container. 
+ * Lay down the boot blocks and home block of a new container.
+ * @param options - pointer to options (seg1LBA is where the first segment goes).
+ * @param img - pointer to at least options->seg1LBA blocks of 0's.
+ * @return nothing
+ */
+void newBootBlocks(Options_t *options, U8 *img)
+{
+	Rt11HomeBlock_t *home;
+
+	memcpy(img + 00000, idx_0000, sizeof(idx_0000));
+	memcpy(img + 01000, idx_1000, sizeof(idx_1000));
+	memcpy(img + 01700, idx_1700, sizeof(idx_1700));
+	home = (Rt11HomeBlock_t *)(img + HOME_BLK_LBA * BLKSIZ);
+	home->firstSegment = options->seg1LBA;
+	home->checksum = memSum16(home, (U16 *)&home->checksum - (U16 *)home);
+}
+
+/**
+ * Create an empty container. Only the boot blocks, home block and directory segments
+ * are written. The rest of a disk image is left as a hole (or allocated all at once
+ * with --preallocate). A floppy image is built in logical order and written through
+ * the interleave.
  * @param options - pointer to options.
  * @return 0 if success; 1 if failure.
  */
 int do_new(Options_t *options)
 {
-#if 1
-	fprintf(stderr, "The 'new' command is not yet supported\n");
-	return 1;
-#else
-	if ( !options.diskSize )
+	int isFloppy, blocks, maxSeg, dirBlks, imgSize, ii;
+	Rt11SegEnt_t *segptr;
+	Rt11DirEnt_t *dirptr;
+	struct stat st;
+	U8 *img;
+	FILE *fp;
+
+	isFloppy = (options->cmdOpts & (CMDOPT_DOUBLE_FLPY | CMDOPT_SINGLE_FLPY)) ? 1 : 0;
+	if ( isFloppy )
 	{
-		printf("Need to supply a disk size (-b option)\n");
-		return help_new( );
+		if ( options->newDiskSize )
+		{
+			msgErr(options, "The size of a floppy image is fixed. Cannot use --blocks with -f or -F\n");
+			return 1;
+		}
+		options->floppyImageSize = NUM_SECTORS * NUM_TRACKS * ((options->cmdOpts & CMDOPT_SINGLE_FLPY) ? 128 : 256);
+		/* Track 0 is not used */
+		blocks = NUM_SECTORS * (NUM_TRACKS - 1) * ((options->cmdOpts & CMDOPT_SINGLE_FLPY) ? 128 : 256) / BLKSIZ;
 	}
-	if ( !options.newMaxSeg )
+	else
 	{
-		Rt11SegEnt_t *segptr;
-		Rt11DirEnt_t *dirptr;
-		options.newMaxSeg = 4 + options.diskSize/1000;
-		if ( options.newMaxSeg > 31 )
-		options.newMaxSeg = 31;
-		options.directory = (unsigned char *)calloc(6*BLKSIZ+SEGSIZ, 1);
-		if ( !options.directory )
+		if ( !options->newDiskSize )
 		{
-			fprintf(stderr,"Unable to allocate %ld bytes for buffer: %s\n",
-					options.startLBA*BLKSIZ+SEGSIZ, strerror(errno));
+			msgErr(options, "Need to supply a disk size (--blocks=N)\n");
 			return 1;
 		}
-		options.inp = fopen( options.container, "wb");
-		if ( !options.inp )
+		blocks = options->newDiskSize;
+	}
+	maxSeg = options->newMaxSeg;
+	if ( !maxSeg )
+	{
+		/* Default is 4 segments plus one for each 1000 blocks */
+		maxSeg = 4 + blocks / 1000;
+		if ( maxSeg > MAXSEGMENTS - 1 )
+			maxSeg = MAXSEGMENTS - 1;
+		if ( (options->cmdOpts & CMDOPT_SINGLE_FLPY) && maxSeg > MAX_SGL_FLPY_SEGS )
+			maxSeg = MAX_SGL_FLPY_SEGS;
+		if ( (options->cmdOpts & CMDOPT_DOUBLE_FLPY) && maxSeg > MAX_DBL_FLPY_SEGS )
+			maxSeg = MAX_DBL_FLPY_SEGS;
+	}
+	if (    ((options->cmdOpts & CMDOPT_SINGLE_FLPY) && maxSeg > MAX_SGL_FLPY_SEGS)
+		 || ((options->cmdOpts & CMDOPT_DOUBLE_FLPY) && maxSeg > MAX_DBL_FLPY_SEGS) )
+	{
+		msgErr(options, "A %s density floppy can have no more than %d segments\n",
+			   (options->cmdOpts & CMDOPT_SINGLE_FLPY) ? "single" : "double",
+			   (options->cmdOpts & CMDOPT_SINGLE_FLPY) ? MAX_SGL_FLPY_SEGS : MAX_DBL_FLPY_SEGS);
+		return 1;
+	}
+	dirBlks = options->seg1LBA + maxSeg * BLKS_P_SEGMENT;
+	if ( options->seg1LBA <= HOME_BLK_LBA || dirBlks >= blocks )
+	{
+		msgErr(options, "No room for %d segments starting at block %ld in %d blocks\n", maxSeg, options->seg1LBA, blocks);
+		return 1;
+	}
+	if ( (options->newOpts & NEWOPTS_VERB) || options->verbose )
+		printf("Creating '%s': %d blocks, %d segments starting at block %ld, %d blocks free\n",
+			   options->container, blocks, maxSeg, options->seg1LBA, blocks - dirBlks);
+	if ( (options->cmdOpts & CMDOPT_NOWRITE) )
+		return 0;
+	if ( !stat(options->container, &st) && !(options->newOpts & NEWOPTS_NOASK) )
+	{
+		char prompt[128];
+
+		snprintf(prompt, sizeof(prompt) - 1, "Replace existing '%s'?", options->container);
+		if ( getYN(prompt, YN_NO) != YN_YES )
+			return 1;
+	}
+	/* A floppy image is small so build all of it. Only the directory area of a disk is needed. */
+	imgSize = (isFloppy ? blocks : dirBlks) * BLKSIZ;
+	img = (U8 *)calloc(imgSize + (isFloppy ? options->floppyImageSize : 0), 1);
+	if ( !img )
+	{
+		msgErr(options, "Ran out of memory getting a %d byte buffer: %s\n", imgSize, strerror(errno));
+		return 1;
+	}
+	newBootBlocks(options, img);
+	/* First segment has one empty area with all the free space */
+	segptr = (Rt11SegEnt_t *)(img + options->seg1LBA * BLKSIZ);
+	segptr->smax = maxSeg;
+	segptr->link = 0;
+	segptr->last = 1;
+	segptr->extra = 0;
+	segptr->start = dirBlks;
+	dirptr = (Rt11DirEnt_t *)(segptr + 1);
+	dirptr->control = EMPTY;
+	dirptr->blocks = blocks - dirBlks;
+	++dirptr;
+	dirptr->control = ENDBLK;
+	fp = statFopen(options, STAT_IO_CONT, options->container, "wb");
+	if ( !fp )
+	{
+		msgErr(options, "Error creating new container file '%s': %s\n", options->container, strerror(errno));
+		free(img);
+		return 1;
+	}
+	if ( isFloppy )
+	{
+		options->floppyImage = img + imgSize;
+		rescramble(options, img);
+		ii = statFwrite(options, STAT_IO_CONT, options->floppyImage, 1, options->floppyImageSize, fp);
+		options->floppyImage = NULL;
+		imgSize = options->floppyImageSize;
+	}
+	else
+		ii = statFwrite(options, STAT_IO_CONT, img, 1, imgSize, fp);
+	free(img);
+	if ( ii != imgSize || fflush(fp) )
+	{
+		msgErr(options, "Error writing %d bytes to '%s': %s\n", imgSize, options->container, strerror(errno));
+		fclose(fp);
+		return 1;
+	}
+	if ( !isFloppy )
+	{
+		/* The rest reads as zeros without being written */
+		if ( ftruncate(fileno(fp), (off_t)blocks * BLKSIZ) )
 		{
-			fprintf(stderr, "Error creating new container file '%s': %s\n",
-					options.container, strerror(errno));
+			msgErr(options, "Error setting size of '%s' to %d blocks: %s\n", options->container, blocks, strerror(errno));
+			fclose(fp);
 			return 1;
 		}
-		memcpy(options.directory+00000, idx_0000, sizeof(idx_0000));
-		memcpy(options.directory+01000, idx_1000, sizeof(idx_1000));
-		memcpy(options.directory+01700, idx_1700, sizeof(idx_1700));
-		segptr = (Rt11SegEnt_t *)(options.directory+6*BLKSIZ);
-		segptr->smax = options.newMaxSeg;
-		segptr->link = 0;
-		segptr->last = 1;
-		segptr->extra = 0;
-		segptr->start = 6+options.newMaxSeg*2;
-		dirptr = (Rt11DirEnt_t *)(segptr+1);
-		dirptr->control = EMPTY;
-		dirptr->blocks = options.diskSize - 6 - options.newMaxSeg*2;
-		++dirptr;
-		dirptr->control = ENDBLK;
-		ans = fwrite(options.directory,(6+2)*BLKSIZ, 1, options.inp);
-		fclose(options.inp);
-		options.inp = NULL;
-		free(options.directory);
-		options.directory = NULL;
-	}
+		if ( (options->newOpts & NEWOPTS_PREALLOC) )
+		{
+#ifndef MINGW
+			ii = posix_fallocate(fileno(fp), 0, (off_t)blocks * BLKSIZ);
+			if ( ii )
+			{
+				msgErr(options, "Error allocating %d blocks for '%s': %s\n", blocks, options->container, strerror(ii));
+				fclose(fp);
+				return 1;
+			}
+#else
+			msgOut(options, "--preallocate is not supported on this system\n");
 #endif
+		}
+	}
+	if ( fclose(fp) )
+	{
+		msgErr(options, "Error closing '%s': %s\n", options->container, strerror(errno));
+		return 1;
+	}
+	return 0;
 }
-
-
-
-
@@ -50,15 +50,15 @@ int checkHeader(Options_t *options)
 	sts = stat(options->container, &st);
 	if ( sts )
 	{
-		fprintf(stderr, "ERROR: Failed to stat '%s': %s\n", options->container, strerror(errno));
+		msgErr(options, "ERROR: Failed to stat '%s': %s\n", options->container, strerror(errno));
 		return 1;
 	}
 	options->containerSize = st.st_size;        /* Record size of entire container file */
 	options->containerBlocks = options->containerSize/BLKSIZ;
-	options->inp = fopen(options->container, "rb");
+	options->inp = statFopen(options, STAT_IO_CONT, options->container, "rb");
 	if ( !options->inp )
 	{
-		fprintf(stderr, "Unable to open input file '%s': %s\n",
+		msgErr(options, "Unable to open input file '%s': %s\n",
 				options->container, strerror(errno));
 		return 1;
 	}
@@ -72,7 +72,7 @@ int checkHeader(Options_t *options)
 		options->floppyImage = (U8 *)calloc(2, options->floppyImageSize);
 		if ( !options->floppyImage )
 		{
-			fprintf(stderr, "ERROR: No memory for %d byte floppy image\n", 2 * options->floppyImageSize);
+			msgErr(options, "ERROR: No memory for %d byte floppy image\n", 2 * options->floppyImageSize);
 			return 1;
 		}
 		options->floppyImageUnscrambled = options->floppyImage + options->floppyImageSize;
@@ -80,10 +80,10 @@ int checkHeader(Options_t *options)
 		lim = options->floppyImageSize;
 		if ( lim > st.st_size )
 			lim = st.st_size;
-		bufLen = fread(options->floppyImage, 1, lim, options->inp);
+		bufLen = statFread(options, STAT_IO_CONT, options->floppyImage, 1, lim, options->inp);
 		if ( bufLen != (int)lim )
 		{
-			fprintf(stderr, "Error reading floppy image. Expected %d bytes, got %d. %s\n",
+			msgErr(options, "Error reading floppy image. Expected %d bytes, got %d. %s\n",
 					(int)lim, bufLen, strerror(errno));
 			return 1;
 		}
@@ -98,19 +98,19 @@ int checkHeader(Options_t *options)
 	else
 	{
 		/* Seek the file to where the home block is */
-		sts = fseek(options->inp, HOME_BLK_LBA * BLKSIZ, SEEK_SET);
+		sts = statFseek(options, STAT_IO_CONT, options->inp, HOME_BLK_LBA * BLKSIZ, SEEK_SET);
 		if ( sts < 0 || ferror(options->inp) || (ftell(options->inp) != HOME_BLK_LBA*BLKSIZ) )
 		{
-			fprintf(stderr, "Error seeking conainer to home block. Wanted %d: %s\n",
+			msgErr(options, "Error seeking conainer to home block. Wanted %d: %s\n",
 					HOME_BLK_LBA * BLKSIZ,
 					strerror(errno));
 			return 1;
 		}
 		/* Read the home block */
-		bufLen = fread(&options->homeBlk, 1, BLKSIZ, options->inp);
+		bufLen = statFread(options, STAT_IO_CONT, &options->homeBlk, 1, BLKSIZ, options->inp);
 		if ( bufLen != BLKSIZ )
 		{
-			fprintf(stderr, "Error reading home block 0. Expected %d bytes, got %d. %s\n",
+			msgErr(options, "Error reading home block 0. Expected %d bytes, got %d. %s\n",
 					BLKSIZ, bufLen, strerror(errno));
 			return 1;
 		}
@@ -129,7 +129,7 @@ int checkHeader(Options_t *options)
 		owner[sizeof(owner) - 1] = 0;
 		strncpy(sysID, home->sysID, sizeof(sysID) - 1);
 		sysID[sizeof(volID) - 1] = 0;
-		printf("Home block:\n"
+		msgOut(options, "Home block:\n"
 			   "clusterSize=%d\n"   /* 0722-0723 */
 			   "firstSegment=%d\n"  /* 0724-0725 */
 			   "version=%s\n"       /* 0726-0727 */
@@ -147,12 +147,12 @@ int checkHeader(Options_t *options)
 			  );
 		if ( strncmp(home->sysID, "DECRT11A    ", 12) )
 		{
-			fprintf(stderr, "ERROR: Not a valid RT11 home block. Expected sysID to be 'DECRT11A    '\n");
+			msgErr(options, "ERROR: Not a valid RT11 home block. Expected sysID to be 'DECRT11A    '\n");
 			return 1;
 		}
 		if ( home->firstSegment != DIRBLK )
 		{
-			fprintf(stderr, "WARNING: Starting directory segment is not %d. It is %d instead.\n", DIRBLK, home->firstSegment);
+			msgErr(options, "WARNING: Starting directory segment is not %d. It is %d instead.\n", DIRBLK, home->firstSegment);
 		}
 	}
 	if ( !(options->cmdOpts & (CMDOPT_SINGLE_FLPY | CMDOPT_DOUBLE_FLPY)) )
@@ -161,23 +161,23 @@ int checkHeader(Options_t *options)
 		options->directory = (U8 *)malloc(SEGSIZ);
 		if ( !options->directory )
 		{
-			fprintf(stderr, "ERROR: Not enough memory for directory. Wanted %d bytes\n", SEGSIZ);
+			msgErr(options, "ERROR: Not enough memory for directory. Wanted %d bytes\n", SEGSIZ);
 			return 1;
 		}
 		/* Seek file to the first segment */
-		sts = fseek(options->inp, home->firstSegment * BLKSIZ, SEEK_SET);
+		sts = statFseek(options, STAT_IO_CONT, options->inp, home->firstSegment * BLKSIZ, SEEK_SET);
 		if ( sts < 0 || ferror(options->inp) || (ftell(options->inp) != home->firstSegment*BLKSIZ) )
 		{
-			fprintf(stderr, "ERROR: Failed to seek container to %d: %s\n", home->firstSegment * BLKSIZ, strerror(errno));
+			msgErr(options, "ERROR: Failed to seek container to %d: %s\n", home->firstSegment * BLKSIZ, strerror(errno));
 			free(options->directory);
 			options->directory = NULL;
 			return 1;
 		}
 		/* Read the first directory segment. This is to get the report of total segments available. */
-		sts = fread(options->directory, 1, SEGSIZ, options->inp);
+		sts = statFread(options, STAT_IO_CONT, options->directory, 1, SEGSIZ, options->inp);
 		if ( sts != SEGSIZ )
 		{
-			fprintf(stderr, "ERROR: Failed to read %d bytes of directory. Got %d: %s\n", SEGSIZ, sts, strerror(errno));
+			msgErr(options, "ERROR: Failed to read %d bytes of directory. Got %d: %s\n", SEGSIZ, sts, strerror(errno));
 			free(options->directory);
 			options->directory = NULL;
 			options->directorySize = 0;
@@ -191,7 +191,7 @@ int checkHeader(Options_t *options)
 		firstseg = (Rt11SegEnt_t *)realloc(firstseg, bufLen);
 		if ( !firstseg )
 		{
-			fprintf(stderr, "ERROR: Not enough memory for directory segments. Wanted %d bytes\n", bufLen);
+			msgErr(options, "ERROR: Not enough memory for directory segments. Wanted %d bytes\n", bufLen);
 			free(options->directory);
 			options->directory = NULL;
 			return 1;
@@ -201,10 +201,10 @@ int checkHeader(Options_t *options)
 		/* And how big they are (in bytes) */
 		options->directorySize = bufLen;
 		/* read the rest of the segments into the buffer */
-		sts = fread(options->directory + SEGSIZ, 1, bufLen - SEGSIZ, options->inp);
+		sts = statFread(options, STAT_IO_CONT, options->directory + SEGSIZ, 1, bufLen - SEGSIZ, options->inp);
 		if ( sts != bufLen - SEGSIZ )
 		{
-			fprintf(stderr, "ERROR: Failed to read %d bytes of directory. Got %d: %s\n", bufLen - SEGSIZ, sts, strerror(errno));
+			msgErr(options, "ERROR: Failed to read %d bytes of directory. Got %d: %s\n", bufLen - SEGSIZ, sts, strerror(errno));
 			free(options->directory);
 			options->directory = NULL;
 			options->directorySize = 0;
@@ -264,7 +264,7 @@ int parse_directory(Options_t *options)
 	options->wDirArray = (InWorkingDir_t *)calloc(ii, sizeof(InWorkingDir_t));
 	if ( !options->linArray || !options->wDirArray )
 	{
-		fprintf(stderr, "Unable to allocate %d bytes for working dirs\n",
+		msgErr(options, "Unable to allocate %d bytes for working dirs\n",
 				(int)(ii * sizeof(InWorkingDir_t *) + ii * sizeof(InWorkingDir_t)));
 		return 1;
 	}
@@ -340,11 +340,7 @@ int parse_directory(Options_t *options)
 			else
 			{
 				options->lastEmpty = NULL;
-				fromRad50(wdp->ffull, dirptr->name[0]);
-				fromRad50(wdp->ffull + 3, dirptr->name[1]);
-				wdp->ffull[6] = '.';
-				fromRad50(wdp->ffull + 7, dirptr->name[2]);
-				sqzSpaces(wdp->ffull);
+				r50DecodeName(wdp->ffull, dirptr->name);
 				options->totPerm += dirptr->blocks;
 				++options->totPermEntries;
 				if ( options->largestPerm < dirptr->blocks )
@@ -441,7 +437,7 @@ int linearToDisk(Options_t *options)
 		sugg = (2 * options->numWdirs + options->numdent - 1) / options->numdent;
 		if ( sugg > 31 )
 			sugg = 31;
-		fprintf(stderr, "Too many files to fit into too few segments. Have only %d.\n"
+		msgErr(options, "Too many files to fit into too few segments. Have only %d.\n"
 				"Suggest you \"sqz --segment=%d\"\n",
 				options->maxseg, sugg);
 		return 1;
@@ -483,6 +479,8 @@ int linearToDisk(Options_t *options)
 			}
 		}
 		*dirptr = wdp->rt11;
+		wdp->segNo = relseg;
+		wdp->segIdx = dentnum;
 		dirptr = (Rt11DirEnt_t *)((unsigned char *)dirptr + sizeof(Rt11DirEnt_t) + firstseg->extra);
 		accumLBA += wdp->rt11.blocks;
 		++dentnum;
@@ -496,4 +494,98 @@ int linearToDisk(Options_t *options)
 	return 0;
 }
 
+/**
+ * Bring linArray and the totals back in line with wDirArray after newDirEnt() or
+ * do_del() changed it, so another command can be run on the same directory.
+ * @param options - pointer to working area.
+ * @return nothing
+ */
+void relinkDirectory(Options_t *options)
+{
+	InWorkingDir_t *wdp;
+	Rt11DirEnt_t *dirptr;
+	int ii;
+
+	options->totEmpty = 0;
+	options->totEmptyEntries = 0;
+	options->totPerm = 0;
+	options->totPermEntries = 0;
+	options->largestPerm = 0;
+	options->lastEmpty = NULL;
+	wdp = options->wDirArray;
+	for ( ii = 0; ii < options->numWdirs; ++ii, ++wdp )
+	{
+		/* newDirEnt() moves entries around, so the pointers have to be made again */
+		options->linArray[ii] = wdp;
+		dirptr = &wdp->rt11;
+		if ( !(dirptr->control & PERM) )
+		{
+			options->lastEmpty = wdp;
+			options->totEmpty += dirptr->blocks;
+			++options->totEmptyEntries;
+		}
+		else
+		{
+			options->lastEmpty = NULL;
+			/* newDirEnt() only fills in the Rad50 name */
+			r50DecodeName(wdp->ffull, dirptr->name);
+			options->totPerm += dirptr->blocks;
+			++options->totPermEntries;
+			if ( options->largestPerm < dirptr->blocks )
+				options->largestPerm = dirptr->blocks;
+		}
+	}
+}
 
+/**
+ * Close the container and free everything checkHeader() and parse_directory() made,
+ * so they can be called again.
+ * @param options - pointer to working area.
+ * @return nothing
+ */
+void freeContainer(Options_t *options)
+{
+	if ( options->inp )
+	{
+		fclose(options->inp);
+		options->inp = NULL;
+	}
+	options->openedWrite = 0;
+	if ( options->floppyImage )
+	{
+		/* The directory is in the floppy image */
+		free(options->floppyImage);
+		options->floppyImage = NULL;
+		options->floppyImageUnscrambled = NULL;
+		options->floppyImageSize = 0;
+		options->directory = NULL;
+	}
+	if ( options->directory )
+	{
+		free(options->directory);
+		options->directory = NULL;
+	}
+	options->directorySize = 0;
+	if ( options->wDirArray )
+	{
+		free(options->wDirArray);
+		options->wDirArray = NULL;
+	}
+	if ( options->linArray )
+	{
+		free(options->linArray);
+		options->linArray = NULL;
+	}
+	options->numWdirs = 0;
+	options->totEmpty = 0;
+	options->totEmptyEntries = 0;
+	options->emptyAdds = 0;
+	options->totPerm = 0;
+	options->totPermEntries = 0;
+	options->largestPerm = 0;
+	options->lastEmpty = NULL;
+	options->diskSize = 0;
+	options->dirDirty = 0;
+	options->maxseg = 0;
+	options->numdent = 0;
+}
@@ -0,0 +1,184 @@
+/*  $Id: rad50.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	rad50.c - Table driven Rad50 conversions used by rtpip
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtpip.h"
+
+/**
+ * @file rad50.c
+ * Table driven Rad50 conversions used by rtpip.
+ */
+
+/*
+ * Note: fromRad50() and char2r50() (in utils.c) do the conversions the long
+ * way with divides and chains of compares. Here every possible 16 bit word
+ * is decoded once into a table holding its 3 characters with the spaces
+ * already squeezed out (and how many are left), so turning a filename into
+ * ASCII is three lookups and three short copies. Going the other way, a 256
+ * entry table gives the Rad50 code for each character (0 if it isn't one)
+ * and the position in the name picks the multiplier. The tables are filled
+ * the first time any of these functions are used.
+ */
+
+static const char R50Chars[] = " ABCDEFGHIJKLMNOPQRSTUVWXYZ$.%0123456789????????????????????????";
+
+static U8 DecTbl[65536][4];     /* 3 characters, spaces squeezed out, then the count of characters */
+static U8 EncTbl[256];          /* Rad50 code for each character, 0 if none */
+static const unsigned short Mult[3] = { 050 * 050, 050, 1 };
+static int tablesReady;
+
+/**
+ * Fill in the conversion tables.
+ * @return nothing
+ */
+void r50Init(void)
+{
+	int word, ii, len;
+	char cc[3];
+
+	for ( word = 0; word < 65536; ++word )
+	{
+		cc[0] = R50Chars[(word / (050 * 050)) & 63];
+		cc[1] = R50Chars[((word / 050) % 050) & 63];
+		cc[2] = R50Chars[(word % 050) & 63];
+		for ( ii = len = 0; ii < 3; ++ii )
+		{
+			if ( cc[ii] != ' ' )
+				DecTbl[word][len++] = cc[ii];
+		}
+		DecTbl[word][3] = len;
+	}
+	memset(EncTbl, 0, sizeof(EncTbl));
+	for ( ii = 1; ii < 40; ++ii )
+	{
+		EncTbl[(U8)R50Chars[ii]] = ii;
+		if ( isupper(R50Chars[ii]) )
+			EncTbl[tolower(R50Chars[ii])] = ii;
+	}
+	tablesReady = 1;
+}
+
+/**
+ * Convert a Rad50 filename to ASCII.
+ * @param dst - pointer to at least 11 bytes into which to put the null terminated name.
+ * @param name - pointer to 3 word Rad50 filename and type.
+ * @return length of name (not counting the null).
+ * @note The result is the same as fromRad50() three times then sqzSpaces().
+ */
+int r50DecodeName(char *dst, const unsigned short name[3])
+{
+	const U8 *tp;
+	char *out = dst;
+
+	if ( !tablesReady )
+		r50Init();
+	tp = DecTbl[name[0]];
+	memcpy(out, tp, 3);
+	out += tp[3];
+	tp = DecTbl[name[1]];
+	memcpy(out, tp, 3);
+	out += tp[3];
+	*out++ = '.';
+	tp = DecTbl[name[2]];
+	memcpy(out, tp, 3);
+	out += tp[3];
+	*out = 0;
+	return out - dst;
+}
+
+/**
+ * Convert an array of Rad50 filenames to ASCII.
+ * @param dst - pointer to first place to put a null terminated name (each at least 11 bytes).
+ * @param dstStride - number of bytes from one dst to the next.
+ * @param names - pointer to first 3 word Rad50 filename and type.
+ * @param nameStride - number of bytes from one name to the next.
+ * @param count - number of names to convert.
+ * @return nothing
+ */
+void r50DecodeNames(char *dst, size_t dstStride, const unsigned short *names, size_t nameStride, int count)
+{
+	if ( !tablesReady )
+		r50Init();
+	while ( count-- > 0 )
+	{
+		r50DecodeName(dst, names);
+		dst += dstStride;
+		names = (const unsigned short *)((const char *)names + nameStride);
+	}
+}
+
+/**
+ * Convert an ASCII filename to Rad50.
+ * @param name - pointer to 3 words into which to put the Rad50 filename and type.
+ * @param src - pointer to null terminated filename (upper or lowercase) of the form nnnnnn.ttt
+ * @return 0 on success, 1 if the name cannot be expressed in Rad50.
+ */
+int r50EncodeName(unsigned short name[3], const char *src)
+{
+	int pos, code;
+
+	if ( !tablesReady )
+		r50Init();
+	name[0] = name[1] = name[2] = 0;
+	for ( pos = 0; *src; ++src )
+	{
+		code = EncTbl[(U8)*src];
+		/* Spaces and anything else that isn't Rad50 is illegal */
+		if ( !code )
+			return 1;
+		/* A dot separates the filename from the filetype and can only appear once */
+		if ( code == R50_DOT )
+		{
+			if ( pos >= 7 )
+				return 1;
+			pos = 7;
+			continue;
+		}
+		/* No more than 6 characters of name or 3 of type */
+		if ( pos == 6 || pos > 9 )
+			return 1;
+		if ( pos < 6 )
+			name[pos / 3] += code * Mult[pos % 3];
+		else
+			name[2] += code * Mult[pos - 7];
+		++pos;
+	}
+	return 0;
+}
+
+/**
+ * Convert an array of ASCII filenames to Rad50.
+ * @param names - pointer to where to put the first 3 word Rad50 filename and type.
+ * @param nameStride - number of bytes from one name to the next.
+ * @param src - pointer to array of pointers to null terminated filenames.
+ * @param count - number of names to convert.
+ * @return number of names converted. If less than count, src[return value] is not a legal name.
+ */
+int r50EncodeNames(unsigned short *names, size_t nameStride, const char *const *src, int count)
+{
+	int ii;
+
+	for ( ii = 0; ii < count; ++ii )
+	{
+		if ( r50EncodeName(names, src[ii]) )
+			break;
+		names = (unsigned short *)((char *)names + nameStride);
+	}
+	return ii;
+}
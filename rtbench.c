@@ -0,0 +1,816 @@
+/*  $Id: rtbench.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	rtbench.c - Time rtpip commands over a matrix of synthetic containers.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _POSIX_C_SOURCE 200112L
+#include "rtpip.h"
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <dirent.h>
+
+/**
+ * @file rtbench.c
+ * Time rtpip commands over a matrix of synthetic containers.
+ */
+
+/*
+ * Note: Each container in Images[] is made once with genImage() and kept in
+ * memory. Every timed run of rtpip gets a fresh copy of it on disk (written
+ * before the clock starts) so "del", "in" and "sqz" always start from the
+ * same place. rtpip is run with fork()/exec() and its output thrown away.
+ * The result for each command and container is the median of the runs.
+ * After the last run "ls -a" is run on what is left and checked against the
+ * container it started from so a command that quietly did nothing (or only
+ * part of its job) is caught rather than timed.
+ */
+
+/** Defines one container in the matrix */
+typedef struct
+{
+	const char *label;      /**< Name used in results */
+	int quick;              /**< Include in --quick runs */
+	GenParams_t gp;         /**< How to make it */
+} BenchImage_t;
+
+static const BenchImage_t Images[] =
+{
+	/* label                     quick  blks  segs extra files min max  log frag asc flpy seed */
+	{ "RX01",                      1, {     0,  1,  0,   30, 1,   8, 0,   0, 50, 1, 1 } },
+	{ "RX02",                      1, {     0,  4,  0,   80, 1,  10, 0,  20, 50, 2, 2 } },
+	{ "4000-block",                1, {  4000,  4,  0,  150, 1,  32, 1,   0, 50, 0, 3 } },
+	{ "4000-block fragmented",     1, {  4000,  4,  0,  150, 1,  32, 1,  30, 50, 0, 4 } },
+	{ "20000-block",               0, { 20000, 16,  0,  700, 1,  64, 1,   0, 50, 0, 5 } },
+	{ "20000-block fragmented",    0, { 20000, 16,  0,  700, 1,  64, 1,  30, 50, 0, 6 } },
+	{ "20000-block extra 16",      0, { 20000, 16, 16,  500, 1,  64, 1,  10, 50, 0, 7 } },
+	{ "65535-block",               0, { 65535, 31,  0, 1000, 1, 128, 1,   0, 50, 0, 8 } },
+	{ "65535-block fragmented",    0, { 65535, 31,  0, 1000, 1, 128, 1,  30, 50, 0, 9 } }
+};
+#define NUM_IMAGES (int)(sizeof(Images) / sizeof(Images[0]))
+
+/** Defines one command to time */
+typedef struct
+{
+	const char *name;       /**< Name used in results */
+	int restore;            /**< Command changes the container */
+	const char *args[8];    /**< Arguments after container name (host files are added for "in") */
+	int hostAscii;          /**< -1 if no host files else percent of them that are text */
+} BenchCmd_t;
+
+static const BenchCmd_t Cmds[] =
+{
+	{ "ls",        0, { "ls", NULL }, -1 },
+	{ "ls-full",   0, { "ls", "-f", NULL }, -1 },
+	{ "out",       0, { "out", "-y", "-o", "out", "*.*", NULL }, -1 },
+	{ "out-ascii", 0, { "out", "-y", "-a", "-o", "out", "*.MAC", "*.TXT", NULL }, -1 },
+	{ "in",        1, { "in", "-y", NULL }, 0 },
+	{ "in-ascii",  1, { "in", "-y", "-a", NULL }, 100 },
+	{ "del",       1, { "del", "-y", "*.SAV", NULL }, -1 },
+	{ "sqz",       1, { "sqz", "-y", NULL }, -1 }
+};
+#define NUM_CMDS (int)(sizeof(Cmds) / sizeof(Cmds[0]))
+
+#define MAX_HOST_FILES  (20)    /**< Files copied in by the "in" commands */
+#define MAX_ARGS        (12 + MAX_HOST_FILES)
+#define DEF_TOLERANCE   (1.5)   /**< Default ratio of new/old time allowed by --compare */
+#define DEF_SLACK       (2.0)   /**< Default milliseconds allowed on top of that */
+
+/**
+ * Get the current monotonic time.
+ * @return time in nanoseconds.
+ */
+static U64 nowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (U64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Read a whole file into memory.
+ * @param path - filename.
+ * @param lenP - pointer to place to put length.
+ * @return pointer to malloc'd contents or NULL on error.
+ */
+static U8 *slurp(const char *path, long *lenP)
+{
+	FILE *fp;
+	U8 *buf;
+	long len;
+
+	fp = fopen(path, "rb");
+	if ( !fp )
+		return NULL;
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	buf = (U8 *)malloc(len ? len : 1);
+	if ( buf && fread(buf, 1, len, fp) != (size_t)len )
+	{
+		free(buf);
+		buf = NULL;
+	}
+	fclose(fp);
+	*lenP = len;
+	return buf;
+}
+
+/**
+ * Write a whole file.
+ * @param path - filename.
+ * @param buf - contents.
+ * @param len - length of contents.
+ * @return 0 on success, 1 on error.
+ */
+static int spill(const char *path, const U8 *buf, long len)
+{
+	FILE *fp;
+	int err;
+
+	fp = fopen(path, "wb");
+	if ( !fp )
+	{
+		fprintf(stderr, "Unable to create '%s': %s\n", path, strerror(errno));
+		return 1;
+	}
+	err = fwrite(buf, 1, len, fp) != (size_t)len;
+	if ( fclose(fp) || err )
+	{
+		fprintf(stderr, "Error writing '%s': %s\n", path, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Empty a directory (it has no subdirectories) or make it if it doesn't exist.
+ * @param path - directory name.
+ * @return 0 on success, 1 on error.
+ */
+static int emptyDir(const char *path)
+{
+	DIR *dp;
+	struct dirent *de;
+	char name[1024];
+
+	dp = opendir(path);
+	if ( !dp )
+	{
+		if ( mkdir(path, 0777) )
+		{
+			fprintf(stderr, "Unable to make directory '%s': %s\n", path, strerror(errno));
+			return 1;
+		}
+		return 0;
+	}
+	while ( (de = readdir(dp)) )
+	{
+		if ( !strcmp(de->d_name, ".") || !strcmp(de->d_name, "..") )
+			continue;
+		snprintf(name, sizeof(name), "%s/%s", path, de->d_name);
+		unlink(name);
+	}
+	closedir(dp);
+	return 0;
+}
+
+/**
+ * Get the names of the files in a directory.
+ * @param path - directory name.
+ * @param prefix - what to put in front of each name.
+ * @param names - where to put "prefix/name".
+ * @param max - maximum number of names.
+ * @return number of names found.
+ */
+static int listDir(const char *path, const char *prefix, char names[][32], int max)
+{
+	DIR *dp;
+	struct dirent *de;
+	int num = 0;
+
+	dp = opendir(path);
+	if ( !dp )
+		return 0;
+	while ( num < max && (de = readdir(dp)) )
+	{
+		if ( de->d_name[0] == '.' )
+			continue;
+		snprintf(names[num++], 32, "%s/%s", prefix, de->d_name);
+	}
+	closedir(dp);
+	return num;
+}
+
+/**
+ * Run a command and wait for it.
+ * @param dir - directory in which to run it.
+ * @param argv - command and its arguments.
+ * @param outName - file (relative to dir) to get stdout or NULL to throw it away.
+ * @return exit status of command, -1 if it couldn't be run.
+ */
+static int runCmd(const char *dir, char *const *argv, const char *outName)
+{
+	pid_t pid;
+	int sts, fd;
+
+	fflush(stdout);
+	pid = fork();
+	if ( pid < 0 )
+	{
+		fprintf(stderr, "Unable to fork: %s\n", strerror(errno));
+		return -1;
+	}
+	if ( !pid )
+	{
+		fd = open("/dev/null", O_RDWR);
+		if ( fd >= 0 )
+		{
+			dup2(fd, 0);
+			dup2(fd, 1);
+			dup2(fd, 2);
+		}
+		if ( chdir(dir) )
+			_exit(126);
+		if ( outName )
+		{
+			fd = open(outName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+			if ( fd < 0 )
+				_exit(126);
+			dup2(fd, 1);
+		}
+		execv(argv[0], argv);
+		_exit(127);
+	}
+	if ( waitpid(pid, &sts, 0) < 0 )
+		return -1;
+	return WIFEXITED(sts) ? WEXITSTATUS(sts) : -1;
+}
+
+/** What "ls -a" says about a container */
+typedef struct
+{
+	int files;              /**< Permanent files */
+	int empties;            /**< Empty areas */
+	int savs;               /**< *.SAV files */
+	char *text;             /**< Whole listing (malloc'd) */
+} BenchList_t;
+
+/**
+ * List a container with "ls -a".
+ * @param dir - directory holding the container.
+ * @param argv - rtpip, its options and container name with room for 2 more.
+ * @param nArgs - number of entries in argv.
+ * @param lp - pointer to place to put results.
+ * @return 0 on success, 1 on error.
+ */
+static int listImage(const char *dir, char **argv, int nArgs, BenchList_t *lp)
+{
+	char path[1024], *cp;
+	long len;
+
+	argv[nArgs] = "ls";
+	argv[nArgs + 1] = "-a";
+	argv[nArgs + 2] = NULL;
+	memset(lp, 0, sizeof(BenchList_t));
+	if ( runCmd(dir, argv, "ls.txt") )
+		return 1;
+	snprintf(path, sizeof(path), "%s/ls.txt", dir);
+	lp->text = (char *)slurp(path, &len);
+	if ( lp->text )
+		lp->text = (char *)realloc(lp->text, len + 1);
+	if ( !lp->text )
+		return 1;
+	lp->text[len] = 0;
+	cp = strstr(lp->text, "Total files:");
+	if ( !cp || sscanf(cp, "Total files: %d", &lp->files) != 1 )
+		return 1;
+	for ( cp = lp->text; (cp = strstr(cp, "<EMPTY>")); ++cp )
+		++lp->empties;
+	for ( cp = lp->text; (cp = strstr(cp, ".SAV ")); ++cp )
+		++lp->savs;
+	return 0;
+}
+
+/**
+ * See if a container listing has a file in it.
+ * @param lp - pointer to listing.
+ * @param name - filename (either case).
+ * @return non-zero if it is there.
+ */
+static int listHas(const BenchList_t *lp, const char *name)
+{
+	const char *cp;
+	int ii;
+
+	for ( cp = lp->text; cp; cp = strchr(cp, '\n') )
+	{
+		if ( *cp == '\n' )
+			++cp;
+		for ( ii = 0; name[ii] && cp[ii] == toupper((unsigned char)name[ii]); ++ii )
+			;
+		if ( !name[ii] && cp[ii] == ' ' )
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Check that a command did what it was supposed to.
+ * @param cp - pointer to command.
+ * @param before - listing of the container before the command.
+ * @param after - listing of the container after the command.
+ * @param work - scratch directory.
+ * @param hostNames - host files given to "in" commands.
+ * @param numHost - number of host files.
+ * @return NULL if all is well else what went wrong.
+ */
+static const char *checkCmd(const BenchCmd_t *cp, const BenchList_t *before, const BenchList_t *after,
+							const char *work, char hostNames[][32], int numHost)
+{
+	static char why[128];
+	char path[1024], names[MAX_HOST_FILES][32];
+	int ii, added, num;
+
+	if ( cp->hostAscii >= 0 )
+	{
+		/* Host files with the same name as one already there replace it */
+		for ( ii = added = 0; ii < numHost; ++ii )
+		{
+			if ( !listHas(after, hostNames[ii] + 5) )
+			{
+				snprintf(why, sizeof(why), "%s is not in the container", hostNames[ii] + 5);
+				return why;
+			}
+			if ( !listHas(before, hostNames[ii] + 5) )
+				++added;
+		}
+		if ( after->files != before->files + added )
+		{
+			snprintf(why, sizeof(why), "expected %d files, found %d", before->files + added, after->files);
+			return why;
+		}
+		return NULL;
+	}
+	if ( !strcmp(cp->args[0], "del") )
+	{
+		if ( after->savs || after->files != before->files - before->savs )
+		{
+			snprintf(why, sizeof(why), "expected %d files and no *.SAV, found %d and %d *.SAV",
+					 before->files - before->savs, after->files, after->savs);
+			return why;
+		}
+		return NULL;
+	}
+	if ( after->files != before->files )
+	{
+		snprintf(why, sizeof(why), "expected %d files, found %d", before->files, after->files);
+		return why;
+	}
+	if ( !strcmp(cp->args[0], "sqz") && after->empties > 1 )
+	{
+		snprintf(why, sizeof(why), "%d empty areas left after squeeze", after->empties);
+		return why;
+	}
+	if ( !strcmp(cp->args[0], "out") )
+	{
+		snprintf(path, sizeof(path), "%s/out", work);
+		num = listDir(path, "out", names, MAX_HOST_FILES);
+		if ( !num )
+			return "nothing was copied out";
+		/* "*.*" gets everything */
+		if ( !strcmp(cp->name, "out") && num < (before->files < MAX_HOST_FILES ? before->files : MAX_HOST_FILES) )
+		{
+			snprintf(why, sizeof(why), "only %d files were copied out", num);
+			return why;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Compare two times for qsort().
+ */
+static int cmpU64(const void *a, const void *b)
+{
+	U64 aa = *(const U64 *)a, bb = *(const U64 *)b;
+
+	return aa < bb ? -1 : aa > bb;
+}
+
+/** Defines one result kept for comparing to a baseline */
+typedef struct
+{
+	char name[64];          /**< "<command> <container>" */
+	double median;          /**< Median time in milliseconds */
+} BenchResult_t;
+
+/**
+ * Find a key in a JSON object.
+ * @param obj - pointer to text of object.
+ * @param end - pointer to end of object.
+ * @param key - key to find.
+ * @return pointer to the value or NULL if key is not there.
+ * @note Only handles the flat objects rtbench writes.
+ */
+static const char *jsonFind(const char *obj, const char *end, const char *key)
+{
+	char pat[64];
+	const char *cp;
+	size_t len;
+
+	snprintf(pat, sizeof(pat), "\"%s\":", key);
+	len = strlen(pat);
+	for ( cp = obj; cp + len <= end; ++cp )
+	{
+		if ( !strncmp(cp, pat, len) )
+			return cp + len;
+	}
+	return NULL;
+}
+
+/**
+ * Get a number from a JSON object.
+ * @param obj - pointer to text of object.
+ * @param end - pointer to end of object.
+ * @param key - key to find.
+ * @param def - value if key is not there.
+ * @return number.
+ */
+static double jsonNum(const char *obj, const char *end, const char *key, double def)
+{
+	const char *cp = jsonFind(obj, end, key);
+
+	return cp ? strtod(cp, NULL) : def;
+}
+
+/**
+ * Compare results against a baseline and show what changed.
+ * @param path - name of baseline JSON file (as written by rtbench).
+ * @param results - pointer to results of this run.
+ * @param numResults - number of results.
+ * @param tolerance - ratio of new/old time allowed (0 to use what the baseline says).
+ * @param slack - milliseconds allowed over that before it counts (-1 to use what the baseline says).
+ * @return number of regressions or -1 on error.
+ */
+static int compareBaseline(const char *path, const BenchResult_t *results, int numResults,
+						   double tolerance, double slack)
+{
+	char *text, *cp, *end, name[64];
+	const char *vp;
+	long len;
+	int ii, found, regressions = 0, *regressed;
+	double old, ratio, tol, slk, *olds;
+
+	text = (char *)slurp(path, &len);
+	if ( text )
+		text = (char *)realloc(text, len + 1);
+	regressed = (int *)calloc(numResults + 1, sizeof(int));
+	olds = (double *)calloc(numResults + 1, sizeof(double));
+	if ( !text || !regressed || !olds )
+	{
+		fprintf(stderr, "Unable to read baseline '%s': %s\n", path, strerror(errno));
+		free(text);
+		free(regressed);
+		free(olds);
+		return -1;
+	}
+	text[len] = 0;
+	/* Settings for all results are ahead of the results */
+	cp = strstr(text, "\"results\"");
+	if ( !cp )
+		cp = text + len;
+	if ( tolerance <= 0 )
+		tolerance = jsonNum(text, cp, "tolerance", DEF_TOLERANCE);
+	if ( slack < 0 )
+		slack = jsonNum(text, cp, "slack_ms", DEF_SLACK);
+	printf("\nCompared to %s (allowed: %.2fx + %.1f ms unless set per result):\n", path, tolerance, slack);
+	printf("%-36s %12s %12s %8s\n", "Result", "Baseline ms", "Now ms", "Ratio");
+	found = 0;
+	while ( (cp = strchr(cp, '{')) && (end = strchr(cp, '}')) )
+	{
+		vp = jsonFind(cp, end, "name");
+		if ( vp && *vp == '"' )
+		{
+			for ( ++vp, ii = 0; vp < end && *vp != '"' && ii < (int)sizeof(name) - 1; )
+				name[ii++] = *vp++;
+			name[ii] = 0;
+			for ( ii = 0; ii < numResults && strcmp(results[ii].name, name); ++ii )
+				;
+			old = jsonNum(cp, end, "median_ms", 0);
+			if ( ii < numResults && old > 0 )
+			{
+				++found;
+				tol = jsonNum(cp, end, "tolerance", tolerance);
+				slk = jsonNum(cp, end, "slack_ms", slack);
+				ratio = results[ii].median / old;
+				olds[ii] = old;
+				printf("%-36s %12.3f %12.3f %7.2fx", name, old, results[ii].median, ratio);
+				if ( results[ii].median > old * tol + slk )
+				{
+					printf("  REGRESSED\n");
+					regressed[ii] = 1;
+					++regressions;
+				}
+				else
+					printf("%s\n", ratio * tol < 1 ? "  faster" : "");
+			}
+		}
+		cp = end + 1;
+	}
+	if ( found < numResults )
+		printf("%d result%s not in the baseline\n", numResults - found, numResults - found == 1 ? " is" : "s are");
+	if ( regressions )
+	{
+		printf("\n%d regression%s:\n", regressions, regressions == 1 ? "" : "s");
+		for ( ii = 0; ii < numResults; ++ii )
+		{
+			if ( regressed[ii] )
+				printf("  %s: %.2fx slower\n", results[ii].name, results[ii].median / olds[ii]);
+		}
+	}
+	else
+		printf("\nNo regressions.\n");
+	free(text);
+	free(regressed);
+	free(olds);
+	return regressions;
+}
+
+/**
+ * Show how to run rtbench.
+ * @return 1
+ */
+static int help_rtbench(void)
+{
+	printf("Usage: rtbench [options]\n"
+		   "where:\n"
+		   " -r path or --rtpip=path = rtpip to time (default ./rtpip)\n"
+		   " -o file or --output=file = where to write JSON results (default bench.json)\n"
+		   " -n N or --runs=N = number of timed runs of each command (default 5)\n"
+		   " -w dir or --work=dir = scratch directory (default bench.tmp)\n"
+		   " -q or --quick = only the floppies and small containers\n"
+		   " -k or --keep = keep the scratch directory\n"
+		   " -c file or --compare=file = compare results to a baseline written by an earlier run and\n"
+		   "        exit with status 2 if anything got slower than allowed\n"
+		   " -t N or --tolerance=N = ratio of new/old time allowed (default 1.5)\n"
+		   " -s N or --slack=N = milliseconds allowed on top of that (default 2)\n"
+		   "        A baseline can set \"tolerance\" and \"slack_ms\" for all of its results (used\n"
+		   "        unless -t or -s is given) or for any one result (always used).\n"
+		   " -h or --help = this message\n");
+	return 1;
+}
+
+static struct option long_bench_opts[] = {
+	{ "compare", 1, 0, 'c' },
+	{ "help", 0, 0, 'h' },
+	{ "keep", 0, 0, 'k' },
+	{ "output", 1, 0, 'o' },
+	{ "quick", 0, 0, 'q' },
+	{ "rtpip", 1, 0, 'r' },
+	{ "runs", 1, 0, 'n' },
+	{ "slack", 1, 0, 's' },
+	{ "tolerance", 1, 0, 't' },
+	{ "work", 1, 0, 'w' },
+	{ 0, 0, 0, 0 }
+};
+
+/**
+ * Time rtpip commands over a matrix of synthetic containers.
+ * @param argc - number of command line arguments.
+ * @param argv - pointer to array of command line arguments.
+ * @return 0 on success, non-zero on failure.
+ */
+int main(int argc, char *const *argv)
+{
+	const char *rtpip = "./rtpip", *output = "bench.json", *work = "bench.tmp", *baseline = NULL;
+	char rtpipPath[1024], path[1024], hostNames[MAX_HOST_FILES][32];
+	char *args[MAX_ARGS];
+	int goptret, option_index, runs = 5, quick = 0, keep = 0;
+	int ii, jj, kk, nArgs, nPre, numHost, numResults = 0, sts;
+	const char *why;
+	BenchList_t before, after;
+	U64 *times, start;
+	U8 *image;
+	long imageLen;
+	FILE *json;
+	GenParams_t hp;
+	BenchResult_t results[NUM_IMAGES * NUM_CMDS];
+	double tolerance = 0, slack = -1;
+
+	while ( (goptret = getopt_long(argc, argv, "c:hkn:o:qr:s:t:w:?", long_bench_opts, &option_index)) != -1 )
+	{
+		switch (goptret)
+		{
+		case 'c':
+			baseline = optarg;
+			break;
+		case 'k':
+			keep = 1;
+			break;
+		case 'n':
+			runs = atoi(optarg);
+			if ( runs < 1 )
+				return help_rtbench();
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'q':
+			quick = 1;
+			break;
+		case 'r':
+			rtpip = optarg;
+			break;
+		case 's':
+			slack = atof(optarg);
+			if ( slack < 0 )
+				return help_rtbench();
+			break;
+		case 't':
+			tolerance = atof(optarg);
+			if ( tolerance < 1 )
+				return help_rtbench();
+			break;
+		case 'w':
+			work = optarg;
+			break;
+		default:
+			return help_rtbench();
+		}
+	}
+	if ( optind < argc )
+		return help_rtbench();
+	if ( baseline && !strcmp(baseline, output) )
+	{
+		fprintf(stderr, "The baseline and output files have to be different\n");
+		return 1;
+	}
+	/* rtpip is run from inside the scratch directory so it needs a full path */
+	if ( rtpip[0] != '/' )
+	{
+		if ( !getcwd(path, sizeof(path)) )
+		{
+			fprintf(stderr, "Unable to get current directory: %s\n", strerror(errno));
+			return 1;
+		}
+		snprintf(rtpipPath, sizeof(rtpipPath), "%s/%s", path, rtpip);
+	}
+	else
+		snprintf(rtpipPath, sizeof(rtpipPath), "%s", rtpip);
+	if ( access(rtpipPath, X_OK) )
+	{
+		fprintf(stderr, "Unable to run '%s': %s\n", rtpipPath, strerror(errno));
+		return 1;
+	}
+	times = (U64 *)malloc(runs * sizeof(U64));
+	json = fopen(output, "w");
+	if ( !times || !json )
+	{
+		fprintf(stderr, "Unable to create '%s': %s\n", output, strerror(errno));
+		return 1;
+	}
+	if ( emptyDir(work) )
+		return 1;
+	fprintf(json, "{\"tool\":\"rtbench\",\"time\":%ld,\"runs\":%d,\"tolerance\":%.2f,\"slack_ms\":%.1f,\"results\":[",
+			(long)time(NULL), runs, tolerance > 0 ? tolerance : DEF_TOLERANCE, slack >= 0 ? slack : DEF_SLACK);
+	printf("%-10s %-26s %6s %6s %12s %12s\n", "Command", "Container", "Blocks", "Files", "Median ms", "Min ms");
+	for ( ii = 0; ii < NUM_IMAGES; ++ii )
+	{
+		const BenchImage_t *bp = Images + ii;
+		int numFiles, blocks;
+
+		if ( quick && !bp->quick )
+			continue;
+		snprintf(path, sizeof(path), "%s/base.dsk", work);
+		numFiles = genImage(&bp->gp, path, NULL);
+		if ( numFiles < 0 )
+			return 1;
+		image = slurp(path, &imageLen);
+		if ( !image )
+		{
+			fprintf(stderr, "Unable to read back '%s': %s\n", path, strerror(errno));
+			return 1;
+		}
+		blocks = bp->gp.floppy ? NUM_SECTORS * (NUM_TRACKS - 1) * (bp->gp.floppy == 1 ? 128 : 256) / BLKSIZ : bp->gp.blocks;
+		nPre = 0;
+		args[nPre++] = rtpipPath;
+		if ( bp->gp.floppy )
+			args[nPre++] = bp->gp.floppy == 1 ? "-f" : "-F";
+		args[nPre++] = "work.dsk";
+		snprintf(path, sizeof(path), "%s/work.dsk", work);
+		if ( spill(path, image, imageLen) || listImage(work, args, nPre, &before) )
+		{
+			fprintf(stderr, "Unable to list %s\n", bp->label);
+			return 1;
+		}
+		for ( jj = 0; jj < NUM_CMDS; ++jj )
+		{
+			const BenchCmd_t *cp = Cmds + jj;
+
+			snprintf(path, sizeof(path), "%s/out", work);
+			if ( emptyDir(path) )
+				return 1;
+			numHost = 0;
+			if ( cp->hostAscii >= 0 )
+			{
+				/* Make some files to copy in that fit the container */
+				snprintf(path, sizeof(path), "%s/host", work);
+				if ( emptyDir(path) )
+					return 1;
+				hp = bp->gp;
+				hp.files = bp->gp.floppy ? MAX_HOST_FILES / 2 : MAX_HOST_FILES;
+				hp.fragPct = 0;
+				hp.asciiPct = cp->hostAscii;
+				hp.seed += 1000;
+				if ( genImage(&hp, NULL, path) < 0 )
+					return 1;
+				numHost = listDir(path, "host", hostNames, MAX_HOST_FILES);
+			}
+			nArgs = nPre;
+			for ( kk = 0; kk < 8 && cp->args[kk]; ++kk )
+				args[nArgs++] = (char *)cp->args[kk];
+			for ( kk = 0; kk < numHost; ++kk )
+				args[nArgs++] = hostNames[kk];
+			args[nArgs] = NULL;
+			snprintf(path, sizeof(path), "%s/work.dsk", work);
+			for ( kk = 0; kk < runs; ++kk )
+			{
+				if ( (cp->restore || !kk) && spill(path, image, imageLen) )
+					return 1;
+				start = nowNs();
+				sts = runCmd(work, args, NULL);
+				times[kk] = nowNs() - start;
+				if ( sts )
+				{
+					fprintf(stderr, "'%s' on %s exited with status %d\n", cp->name, bp->label, sts);
+					return 1;
+				}
+			}
+			why = listImage(work, args, nPre, &after) ? "unable to list the container" :
+				checkCmd(cp, &before, &after, work, hostNames, numHost);
+			free(after.text);
+			if ( why )
+			{
+				fprintf(stderr, "'%s' on %s did not do its job: %s\n", cp->name, bp->label, why);
+				return 1;
+			}
+			qsort(times, runs, sizeof(U64), cmpU64);
+			printf("%-10s %-26s %6d %6d %12.3f %12.3f\n",
+				   cp->name, bp->label, blocks, numFiles, times[runs / 2] / 1e6, times[0] / 1e6);
+			fprintf(json, "%s\n{\"name\":\"%s %s\",\"command\":\"%s\",\"container\":\"%s\","
+					"\"blocks\":%d,\"segments\":%d,\"extra\":%d,\"files\":%d,\"fragPct\":%d,"
+					"\"median_ms\":%.3f,\"min_ms\":%.3f,\"max_ms\":%.3f}",
+					numResults ? "," : "", cp->name, bp->label, cp->name, bp->label,
+					blocks, bp->gp.segments, bp->gp.extra, numFiles, bp->gp.fragPct,
+					times[runs / 2] / 1e6, times[0] / 1e6, times[runs - 1] / 1e6);
+			snprintf(results[numResults].name, sizeof(results[numResults].name), "%s %s", cp->name, bp->label);
+			results[numResults].median = times[runs / 2] / 1e6;
+			++numResults;
+		}
+		free(before.text);
+		free(image);
+	}
+	fprintf(json, "\n]}\n");
+	if ( fclose(json) )
+	{
+		fprintf(stderr, "Error writing '%s': %s\n", output, strerror(errno));
+		return 1;
+	}
+	if ( !keep )
+	{
+		snprintf(path, sizeof(path), "%s/out", work);
+		emptyDir(path);
+		rmdir(path);
+		snprintf(path, sizeof(path), "%s/host", work);
+		emptyDir(path);
+		rmdir(path);
+		emptyDir(work);
+		rmdir(work);
+	}
+	printf("Wrote %d results to %s\n", numResults, output);
+	free(times);
+	if ( baseline )
+	{
+		sts = compareBaseline(baseline, results, numResults, tolerance, slack);
+		if ( sts )
+			return sts < 0 ? 1 : 2;
+	}
+	return 0;
+}
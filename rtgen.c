@@ -0,0 +1,169 @@
+/*  $Id: rtgen.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	rtgen.c - Make synthetic RT11 container files.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtpip.h"
+
+/**
+ * @file rtgen.c
+ * Make synthetic RT11 container files for testing and benchmarking rtpip.
+ */
+
+/**
+ * Show how to run rtgen.
+ * @return 1
+ */
+static int help_rtgen(void)
+{
+	printf("Usage: rtgen [options] container [hostdir]\n"
+		   "where:\n"
+		   " -b N or --blocks=N = volume size in blocks (default 4000, max 65535)\n"
+		   " -s N or --segments=N = number of directory segments (default 4, max 31)\n"
+		   " -e N or --extra=N = extra bytes in each directory entry (default 0)\n"
+		   " -n N or --files=N = number of files (default 100, fewer if they don't fit)\n"
+		   " -z MIN:MAX[:log] or --sizes=MIN:MAX[:log] = file sizes in blocks (default 1:32).\n"
+		   "        With :log, sizes are spread evenly over powers of 2 instead of uniformly.\n"
+		   " -g N or --frag=N = percent chance of an empty area after each file (default 0)\n"
+		   " -a N or --ascii=N = percent of files that are text (default 50)\n"
+		   " -f or --floppy = make an RX01 single density floppy image\n"
+		   " -F or --double = make an RX02 double density floppy image\n"
+		   " -r N or --seed=N = random number seed (default 1)\n"
+		   " container = name of container file to create\n"
+		   " hostdir = optional existing directory into which to also write each file\n"
+		   "        as it would be after copying out (text has lf line endings)\n");
+	return 1;
+}
+
+static struct option long_gen_opts[] = {
+	{ "ascii", 1, 0, 'a' },
+	{ "blocks", 1, 0, 'b' },
+	{ "double", 0, 0, 'F' },
+	{ "extra", 1, 0, 'e' },
+	{ "files", 1, 0, 'n' },
+	{ "floppy", 0, 0, 'f' },
+	{ "frag", 1, 0, 'g' },
+	{ "help", 0, 0, 'h' },
+	{ "seed", 1, 0, 'r' },
+	{ "segments", 1, 0, 's' },
+	{ "sizes", 1, 0, 'z' },
+	{ 0, 0, 0, 0 }
+};
+
+/**
+ * Get a number from an option.
+ * @param arg - option argument.
+ * @param what - what it is (for error message).
+ * @param result - pointer to place to put number.
+ * @return 0 on success, 1 on failure.
+ */
+static int getNum(const char *arg, const char *what, int *result)
+{
+	char *endp = NULL;
+
+	*result = strtol(arg, &endp, 0);
+	if ( !endp || *endp || *result < 0 )
+	{
+		fprintf(stderr, "Invalid %s: \"%s\"\n", what, arg);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Make a synthetic RT11 container file.
+ * @param argc - number of command line arguments.
+ * @param argv - pointer to array of command line arguments.
+ * @return 0 on success, non-zero on failure.
+ */
+int main(int argc, char *const *argv)
+{
+	GenParams_t gp;
+	int goptret, option_index, num;
+	char *endp;
+
+	memset(&gp, 0, sizeof(gp));
+	gp.blocks = 4000;
+	gp.segments = 4;
+	gp.files = 100;
+	gp.minBlks = 1;
+	gp.maxBlks = 32;
+	gp.asciiPct = 50;
+	gp.seed = 1;
+	while ( (goptret = getopt_long(argc, argv, "a:b:e:fFg:hn:r:s:z:?", long_gen_opts, &option_index)) != -1 )
+	{
+		switch (goptret)
+		{
+		case 'a':
+			if ( getNum(optarg, "ascii percent", &gp.asciiPct) )
+				return 1;
+			break;
+		case 'b':
+			if ( getNum(optarg, "block count", &gp.blocks) )
+				return 1;
+			break;
+		case 'e':
+			if ( getNum(optarg, "extra byte count", &gp.extra) )
+				return 1;
+			break;
+		case 'f':
+			gp.floppy = 1;
+			break;
+		case 'F':
+			gp.floppy = 2;
+			break;
+		case 'g':
+			if ( getNum(optarg, "fragmentation percent", &gp.fragPct) )
+				return 1;
+			break;
+		case 'n':
+			if ( getNum(optarg, "file count", &gp.files) )
+				return 1;
+			break;
+		case 'r':
+			if ( getNum(optarg, "seed", &num) )
+				return 1;
+			gp.seed = num;
+			break;
+		case 's':
+			if ( getNum(optarg, "segment count", &gp.segments) )
+				return 1;
+			break;
+		case 'z':
+			gp.minBlks = strtol(optarg, &endp, 0);
+			if ( *endp == ':' )
+				gp.maxBlks = strtol(endp + 1, &endp, 0);
+			gp.logSizes = !strcmp(endp, ":log");
+			if ( (*endp && !gp.logSizes) || gp.minBlks < 1 || gp.maxBlks < gp.minBlks )
+			{
+				fprintf(stderr, "Invalid file sizes: \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			return help_rtgen();
+		}
+	}
+	if ( optind >= argc || argc - optind > 2 )
+		return help_rtgen();
+	num = genImage(&gp, argv[optind], optind + 1 < argc ? argv[optind + 1] : NULL);
+	if ( num < 0 )
+		return 1;
+	printf("Made '%s' with %d file%s.\n", argv[optind], num, num == 1 ? "" : "s");
+	return 0;
+}
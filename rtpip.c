@@ -50,6 +50,16 @@
  * --nowrite or -n = Do not write anything. Just say what would
  *   be written. @n
  * --verbose or -v = sets verbose mode. @n
+ * --stats[=json] = when done, show time spent in each phase, I/O
+ *   done to the container and host files and peak memory on stderr. @n
+ * --trace=file = write a span for each phase and each file copied,
+ *   deleted or moved to @b file in Chrome trace-event JSON. Only
+ *   available when built with make TRACE=1. @n
+ * --cpu=level = use @b level (c, sse2, sse4.2, avx2, avx512 or
+ *   neon) of vectorized kernels instead of the best the CPU can do.
+ *   RTPIP_CPU=level in the environment does the same. @n
+ * --server[=socket] = send the command to a running rtpipd, which
+ *   keeps containers open, instead of doing it here. @n
  * --debug or -d = sets normal debug mode. @n
  * --empty or -e = sets debug mode except do not squeeze when
  *   writing. @n
@@ -61,8 +71,8 @@
  *  (default=6). @n
  * 
  * <container> = path to container file. @n
- * <cmd> = one of @ref ls, @ref in, @ref out, @ref del, @ref new
- * or @ref sqz
+ * <cmd> = one of @ref ls, @ref in, @ref out, @ref del, @ref new,
+ * @ref mkfs, @ref sync, @ref diff, @ref manifest, @ref script or @ref sqz
  * 
  * @subsection ls
  * Optional cmdOpts available for ls (or dir) command: @n
@@ -99,9 +109,13 @@
  * @subsection in
  * Optional cmdOpts available for @b in command: @n Need to
  * write this. @n
+ * With @b --tar=file the files in a ustar archive (- for stdin) are copied in
+ * instead of host files. @n
  * @subsection out
  * Optional cmdOpts available for @b out command: @n Need to
  * write this. @n
+ * With @b --tar=file the files are written as a ustar archive (- for stdout)
+ * instead of as host files, with their dates as mtimes. @n
  * @subsection sqz
  * Optional cmdOpts available for @b sqz command: @n Need to
  * write this. @n
@@ -111,6 +125,32 @@
  * @subsection new 
  * Optional cmdOpts available for @b new command: @n Need to
  * write this. @n
+ * @subsection mkfs
+ * @b mkfs [-ptvy] [-a types] [-b N] [-s N] @b --from-dir=dir makes a new
+ * container holding every file in @b dir. Files whose filetype is in the
+ * comma separated @b types are copied in as text. @n
+ * @subsection sync
+ * @b sync [-dtv] [-a types] @b --from-dir=dir copies in only the files in
+ * @b dir that are new or different. A file that still fits goes back where
+ * it was. With @b -d files not in @b dir are deleted. What each file hashed to
+ * is kept in the container's name with .rtsync added. @n
+ * @subsection diff
+ * @b diff [-fFmqRtv] [-a types] [-w expr] [-x pat] @b other [file...] shows the
+ * files added, removed, resized, redated or changed in @b other, another
+ * container or a host directory. It exits with 0 if there are no
+ * differences, 1 if there are and 2 if there was trouble. @n
+ * @subsection manifest
+ * @b manifest [-CRv] [-a types] [-H hashes] [-j N] [-o file] [-c file]
+ * [-w expr] [-x pat] [file...] lists each file's name, blocks, date, LBA and
+ * CRC32C and/or SHA-256 (of the blocks and, for the types in @b -a, of the
+ * text out -a would make) as JSON or CSV. The files are hashed by @b N threads
+ * (default one per CPU). With @b -c the container is checked against a
+ * manifest written earlier and the files that don't match are named. @n
+ * @subsection script
+ * @b script [-v] @b file runs the ls, in, out, del and sqz commands
+ * listed one per line in @b file (- for stdin) against the container.
+ * The directory is read once and written once at the end, only if
+ * every command worked. @n
  * @section exam Examples
  * @b rtpip @b -F @b rt11_dy0.dsk @b ls @b -sn @b -6 @b "*.mac"
  *   @b "*.sys" @b "rt*.*" @b "??.*" @n
@@ -148,6 +188,21 @@ static int fakeArgv(const char *filename, Fakeargs_t *args)
 	return 0;
 }
 
+/**
+ * Display help for the --where expression (used by ls, out and del).
+ */
+static void help_where(void)
+{
+	printf("EXPR is made of comparisons joined with && (and), || (or), ! (not) and parens:\n"
+		   "  size (or blocks), lba, end, seg = compared with ==, !=, <, <=, > or >= to a number.\n"
+		   "  date = compared to a date in the form dd-mmm-yy or dd-mmm-yyyy.\n"
+		   "  type = compared to a filetype (i.e. type==mac).\n"
+		   "  name = compared with == or != to a filename wildcard (i.e. name==rt*.*).\n"
+		   "  protected, perm, empty, tent = true if the entry has that status.\n"
+		   "I.e. --where='size>100 && date>=01-jan-85 && !protected'\n"
+		  );
+}
+
 /**
  * Display help for ls command.
  */
@@ -163,11 +218,15 @@ static int help_ls(void)
 		   "--sort=t or -st = Sort by filetype.\n"
 		   "--sort=d or -sd = Sort by date.\n"
 		   "--sort=s or -ss = Sort by size.\n"
+		   "--sort=t,n,d or -st,n,d = Sort by more than one key in order of importance.\n"
+		   "    An uppercase key (i.e. -sD) sorts that key in descending order.\n"
 		   "--reverse or -r = Reverse sort.\n"
 #if !NO_REGEXP
 		   "--rexp or -R = filenames are regular expressions.\n"
 #endif
 		   "--verbose or -v = Set verbose mode.\n"
+		   "--where=EXPR or -w EXPR = Only list files for which EXPR is true (see below).\n"
+		   "--exclude=X or -x X = Don't list files matching X. Can be used more than once.\n"
 		   "Filters = zero or more filter strings.\n"
 #if !NO_REGEXP
 		   "If -R or --rexp then the strings are regular expressions. Either are used as\""
@@ -179,6 +238,7 @@ static int help_ls(void)
 #endif
 		   "The case of the names used in the filters does not matter (upper or lowercase will work equally well).\n"
 		  );
+	help_where();
 	return 1;
 }
 
@@ -187,7 +247,7 @@ static int help_ls(void)
  */
 static int help_out(void)
 {
-	printf("rtpip [opts] container out [-abh?lnv] file [file...]\n"
+	printf("rtpip [opts] container out [-abh?lnv] [-w EXPR] [-x X] file [file...]\n"
 		   "out command: Copy file(s) out of the container.\n"
 		   "--help or -h or -? = This message.\n"
 		   "--ascii or -a = Change crlf to just lf. Write until control Z. Doesn't write control Z.\n"
@@ -195,14 +255,19 @@ static int help_out(void)
 		   "--ctlz or -z = Write output until control Z found otherwise leave as binary. Doesn't write control Z.\n"
 		   "--outdir=X or -o X = set default output directory to X\n"
 		   "--lower or -l = Change filename to lowercase.\n"
+		   "--tar=X or -T X = Write the files to X (- for stdout) as a ustar archive instead of\n"
+		   "    as host files. Dates become mtimes and no questions are asked.\n"
 #if !NO_REGEXP
 		   "--rexp or -R = Filenames are regular expressions.\n"
 #endif
 		   "--time or -t = maintain file timestamps\n"
 		   "--assumeyes or -y = Assume YES instead of prompting.\n"
 		   "--verbose or -v = Sets verbose mode.\n"
+		   "--where=EXPR or -w EXPR = Only copy files for which EXPR is true (see below).\n"
+		   "--exclude=X or -x X = Don't copy files matching X. Can be used more than once.\n"
 		  );
-	printf("file = one or more name to select the file(s) to copy out.\n"
+	printf("file = one or more name to select the file(s) to copy out. Can be omitted if\n"
+		   "--where, --exclude or --tar is used (--tar then copies all of them).\n"
 #if !NO_REGEXP
 		   "If the -R or --rexp option is provided, then the name(s) are interpreted as\n"
 		   "regular expressions as defined in \"man 7 regex\" or \"man grep\".\n"
@@ -211,7 +276,9 @@ static int help_out(void)
 		   "characters, you will need to escape them from the shell.\n"
 #endif
 		   "The case of the names specified does not matter (upper or lowercase will work equally well).\n"
+		   "The -R option also applies to the --exclude names.\n"
 		  );
+	help_where();
 	return 1;
 }
 
@@ -221,6 +288,7 @@ static int help_out(void)
 static int help_in(void)
 {
 	printf("rtpip [opts] container in [-abh?qRtvz][d xx] file [file...]\n"
+		   "rtpip [opts] container in [-abh?Rtv][d xx] --tar=X [file...]\n"
 		   "in command: Copy file(s) into the container.\n"
 		   "--help or -h or -? = This message.\n"
 		   "--ascii or -a = Change lone lf's to crlf's while copying.\n"
@@ -231,9 +299,12 @@ static int help_in(void)
 #if !NO_REGEXP
 		   "--rexp or -R = Filenames are regular expressions.\n"
 #endif
+		   "--tar=X or -T X = Copy in the files in the ustar archive X (- for stdin) instead\n"
+		   "    of host files. No questions are asked.\n"
 		   "--time or -t = maintain file timestamps\n"
 		   "--verbose or -v = Sets verbose mode.\n"
-		   "file = one or more input files to copy.\n"
+		   "file = one or more input files to copy. With --tar, names that pick which\n"
+		   "    files in the archive are copied (all of them if there are none).\n"
 		  );
 	return 1;
 }
@@ -258,17 +329,140 @@ static int help_sqz(void)
  */
 static int help_new(void)
 {
-	printf("rtpip [opts] container new [-h?v] -b N -s N\n"
+	printf("rtpip [opts] container new [-h?pvy] -b N -s N\n"
 		   "new command: Create a new empty container file.\n"
 		   "--help or -h or -? = This message.\n"
 		   "--assumeyes or -y = Assume YES instead of prompting.\n"
 		   "--blocks=N or -b N = Sets number of (512 byte) blocks in new container file. Must be 400<=N<=65535\n"
-		   "--segment=N or -s N = Sets the number of segments in the new container file. 1<=n<=31.\n"
+		   "    (not used with -f or -F, a floppy is always its full size).\n"
+		   "--preallocate or -p = Allocate all the blocks on the host disk now instead of leaving them as a hole.\n"
+		   "--segments=N or -s N = Sets the number of segments in the new container file. 1<=n<=31.\n"
+		   "    (Default is 4 plus 1 for each 1000 blocks. No more than 2 on -f or 4 on -F)\n"
+		   "--verbose or -v = Sets verbose mode.\n"
+		  );
+	return 1;
+}
+
+/**
+ * Display help for mkfs command.
+ */
+static int help_mkfs(void)
+{
+	printf("rtpip [opts] container mkfs [-h?ptvy] [-a types] [-b N] [-s N] --from-dir=dir\n"
+		   "mkfs command: Create a new container holding all the files in a host directory.\n"
+		   "--help or -h or -? = This message.\n"
+		   "--from-dir=dir or -D dir (or just dir) = Host directory to copy in (subdirectories are left out).\n"
+		   "--ascii=types or -a types = Copy files with these comma separated filetypes in as text (lf to crlf). I.e. -a mac,txt\n"
+		   "--assumeyes or -y = Assume YES instead of prompting.\n"
+		   "--blocks=N or -b N = Sets number of (512 byte) blocks in new container file. Must be 400<=N<=65535\n"
+		   "    (Default is just enough for the files, but at least 400. Not used with -f or -F)\n"
+		   "--preallocate or -p = Allocate all the blocks on the host disk now instead of leaving the free space as a hole.\n"
+		   "--segments=N or -s N = Sets the number of segments in the new container file. 1<=n<=31.\n"
+		   "    (Default is enough to have them half full, but no fewer than new would make)\n"
+		   "--time or -t = Date each file with its host timestamp instead of 1-Jan-72.\n"
 		   "--verbose or -v = Sets verbose mode.\n"
 		  );
 	return 1;
 }
 
+/**
+ * Display help for sync command.
+ */
+static int help_sync(void)
+{
+	printf("rtpip [opts] container sync [-h?dtv] [-a types] --from-dir=dir\n"
+		   "sync command: Copy in only the files in a host directory that are new or different.\n"
+		   "--help or -h or -? = This message.\n"
+		   "--from-dir=dir or -D dir (or just dir) = Host directory to copy in (subdirectories are left out).\n"
+		   "--ascii=types or -a types = Copy files with these comma separated filetypes in as text (lf to crlf). I.e. -a mac,txt\n"
+		   "--delete or -d = Delete files in the container that aren't in the host directory.\n"
+		   "--time or -t = Date each file with its host timestamp instead of 1-Jan-72.\n"
+		   "--verbose or -v = Sets verbose mode.\n"
+		   "A file that changed but still fits is put back where it was. What each file\n"
+		   "hashed to is kept in the container's name with .rtsync added so unchanged files\n"
+		   "aren't read next time. Delete that file to have everything compared again.\n"
+		  );
+	return 1;
+}
+
+/**
+ * Display help for diff command.
+ */
+static int help_diff(void)
+{
+	printf("rtpip [opts] container diff [-h?fFmqRtv] [-a types] [-w expr] [-x pat] other [file...]\n"
+		   "diff command: Show how another container or a host directory differs from this container.\n"
+		   "--help or -h or -? = This message.\n"
+		   "--ascii=types or -a types = Compare host files with these comma separated filetypes as text (lf to crlf).\n"
+		   "--exclude=pat or -x pat = Leave out files matching pat.\n"
+		   "--machine or -m = One tab separated line per difference:\n"
+		   "    kind name blocks1 blocks2 date1 date2 block (- for anything there isn't)\n"
+		   "--other-floppy or -f = other is a single density floppy image.\n"
+		   "--other-double or -F = other is a double density floppy image.\n"
+		   "--quick or -q = Only compare names, sizes and dates, not contents.\n"
+#if !NO_REGEXP
+		   "--rexp or -R = filename list is regular expressions.\n"
+#endif
+		   "--time or -t = Compare dates with host timestamps (otherwise host file dates are ignored).\n"
+		   "--verbose or -v = Sets verbose mode.\n"
+		   "--where=expr or -w expr = Only files for which expr is true.\n"
+		   "Each difference is one of added (only in other), removed (only in container),\n"
+		   "resized, redated or changed (contents, with the first block that differs).\n"
+		   "Exits with 0 if there are no differences, 1 if there are and 2 if there was trouble.\n"
+		  );
+	return 1;
+}
+
+/**
+ * Display help for manifest command.
+ */
+static int help_manifest(void)
+{
+	printf("rtpip [opts] container manifest [-h?CRv] [-a types] [-c file] [-H hashes] [-j N] [-o file] [-w expr] [-x pat] [file...]\n"
+		   "manifest command: List the files with hashes of their contents, or check them against such a list.\n"
+		   "--help or -h or -? = This message.\n"
+		   "--ascii=types or -a types = Also hash files with these comma separated filetypes as text (as out -a makes it).\n"
+		   "--check=file or -c file = Check the files against a manifest written earlier and name the ones that differ.\n"
+		   "--csv or -C = Write CSV instead of JSON.\n"
+		   "--exclude=pat or -x pat = Leave out files matching pat.\n"
+		   "--hash=list or -H list = Comma separated hashes: crc32c and/or sha256 (default both).\n"
+		   "--jobs=N or -j N = Hash with N threads (default one per CPU).\n"
+		   "--output=file or -o file = Write the manifest to file instead of stdout.\n"
+#if !NO_REGEXP
+		   "--rexp or -R = filename list is regular expressions.\n"
+#endif
+		   "--verbose or -v = Sets verbose mode (with -c, also list the files that match).\n"
+		   "--where=expr or -w expr = Only files for which expr is true.\n"
+		   "Hashes are of all the blocks of each file. With -c each file is one of ok, changed,\n"
+		   "missing (only in the manifest) or extra (only in the container).\n"
+		   "Exits with 0 if everything matched and 1 if not.\n"
+		  );
+	return 1;
+}
+
+/**
+ * Display help for script command.
+ */
+static int help_script(void)
+{
+	printf("rtpip [opts] container script [-h?v] file\n"
+		   "script command: Run the commands in file (- for stdin) against the container.\n"
+		   "--help or -h or -? = This message.\n"
+		   "--verbose or -v = Show each command before running it.\n"
+		   "Each line of file is one ls, dir, in, out, del, rm or sqz command with its options\n"
+		   "and filenames, as they would follow the container on the command line. Words\n"
+		   "can be quoted with \" or ' and a # starts a comment. Nothing is asked. The\n"
+		   "directory is written once at the end and only if every command worked. If one\n"
+		   "fails, data already copied in stays in blocks the directory still lists as free.\n"
+		   "sqz can only be the last command. Host filenames are not expanded like the shell\n"
+		   "would. I.e.:\n"
+		   "    del *.obj\n"
+		   "    in -a src/foo.mac src/bar.mac\n"
+		   "    ls -sn\n"
+		  );
+	return 1;
+}
+
 static const char Version[] = "1.0.4";
 /**
  * Display help for global options.
@@ -284,17 +478,26 @@ static int help_em(const char *msg)
 	printf("rtpip version %s\n", Version);
 	printf("Usage: rtpip [-dfFh?v][-l N] container cmd [cmdOpts] [file...]\n"
 		   "where:\n"
+		   " --cpu=level = use level (c, sse2, sse4.2, avx2, avx512 or neon) of vector code\n"
 		   " -d or --debug = set debug mode\n"
 		   " -f or --floppy = image is of a floppy disk\n"
 		   " -F or --double = image is of a double density floppy disk\n"
 		   " -h, -? or --help = This message.\n"
 		   " -lN or --lba=N = set starting LBA to 'N' (defaults to 6)\n"
+		   " --server[=socket] = have rtpipd do the command (see below)\n"
+		   " --stats[=json] = show time, I/O and memory used on stderr when done\n"
+		   " --trace=file = write Chrome trace events to file (needs make TRACE=1)\n"
 		   " -v or --verbose = set verbose mode\n"
 		   " container - path to existing RT11 container file.\n"
-		   " cmd - one of 'del', 'dir', 'in', 'ls', 'new', 'out', 'rm' or 'sqz'.\n"
+		   " cmd - one of 'del', 'diff', 'dir', 'in', 'ls', 'manifest', 'mkfs', 'new', 'out',\n"
+		   "       'rm', 'script', 'sqz' or 'sync'.\n"
 		   " [cmdOpts] = optional options for specific command\n"
 		   " [file...] = optional input or output filename expressions\n\n"
-		   "For help on a specific cmd, use 'rtpip anything cmd -h'\n"
+		   "For help on a specific cmd, use 'rtpip anything cmd -h'\n\n"
+		   "With --server the command is sent to rtpipd, which keeps containers open so\n"
+		   "they don't have to be read again each time. The socket defaults to $RTPIPD_SOCKET\n"
+		   "or /tmp/rtpipd-<uid>.sock. ls, out, in, del and sqz can be sent, but not with\n"
+		   "--lba or sqz --segments. The exit status is 1 if anything went wrong.\n"
 		  );
 	return 1;
 }
@@ -307,7 +510,7 @@ static int help_em(const char *msg)
  */
 int main(int argc, char *const *argv)
 {
-	int ii;
+	int ii, sts = 0;
 	static Fakeargs_t fargs;
 	Options_t options;
 
@@ -343,13 +546,36 @@ int main(int argc, char *const *argv)
 	}
 	if ( (options.newOpts & NEWOPTS_HELP) )
 	{
-		return help_new();
+		return (options.todo & TODO_MKFS) ? help_mkfs() : help_new();
+	}
+	if ( (options.scriptOpts & SCRIPTOPTS_HELP) )
+	{
+		return help_script();
+	}
+	if ( (options.syncOpts & SYNCOPTS_HELP) )
+	{
+		return help_sync();
+	}
+	if ( (options.diffOpts & DIFFOPTS_HELP) )
+	{
+		return help_diff();
+	}
+	if ( (options.manOpts & MANOPTS_HELP) )
+	{
+		return help_manifest();
 	}
 	if ( (options.cmdOpts&CMDOPT_DBG_NORMAL) && !options.verbose )
 		++options.verbose;
-	if ( !(options.todo & TODO_NEW) )
+	if ( options.server )
+	{
+		/* rtpipd has the container open already */
+		statBegin(&options, STAT_PH_CMD);
+		sts = clientRun(&options);
+		statEnd(&options, STAT_PH_CMD);
+	}
+	else if ( !(options.todo & (TODO_NEW | TODO_MKFS)) )
 	{
-		int sts, bufLen;
+		int bufLen;
 
 		/* As I understand it, RT11 won't have more than 32 directory segments
 		 * And in all the cases I've run into, the segments start at the default block 6.
@@ -357,35 +583,45 @@ int main(int argc, char *const *argv)
 		 * that will include the home block and all the potential directory blocks. It may
 		 * be more than we need, but so what?
 		 */
-		options.inp = fopen(options.container, "rb");
+		options.inp = statFopen(&options, STAT_IO_CONT, options.container, "rb");
 		if ( !options.inp )
 		{
 			fprintf(stderr, "Unable to open input file '%s': %s\n",
 					options.container, strerror(errno));
+			statReport(&options);
 			return 1;
 		}
-		sts = fseek(options.inp, HOME_BLK_LBA * BLKSIZ, SEEK_SET);
+		sts = statFseek(&options, STAT_IO_CONT, options.inp, HOME_BLK_LBA * BLKSIZ, SEEK_SET);
 		if ( sts < 0 || ferror(options.inp) || (ftell(options.inp) != HOME_BLK_LBA*BLKSIZ) )
 		{
 			fprintf(stderr, "Error seeking conainer to home block. Wanted %d: %s\n",
 					HOME_BLK_LBA * BLKSIZ,
 					strerror(errno));
+			statReport(&options);
 			return 1;
 		}
-		bufLen = fread(&options.homeBlk, 1, BLKSIZ, options.inp);
+		bufLen = statFread(&options, STAT_IO_CONT, &options.homeBlk, 1, BLKSIZ, options.inp);
 		if ( bufLen != BLKSIZ )
 		{
 			fprintf(stderr, "Error reading home block 0. Expected %d bytes, got %d. %s\n",
 					BLKSIZ, bufLen, strerror(errno));
+			statReport(&options);
 			return 1;
 		}
-		if ( checkHeader(&options) )
+		statBegin(&options, STAT_PH_HEADER);
+		sts = checkHeader(&options);
+		statEnd(&options, STAT_PH_HEADER);
+		if ( sts )
 		{
+			statReport(&options);
 			return 1;
 		}
-		if ( !parse_directory(&options) )
+		statBegin(&options, STAT_PH_DIR);
+		sts = parse_directory(&options);
+		statEnd(&options, STAT_PH_DIR);
+		if ( !sts )
 		{
-			sts = 0;
+			statBegin(&options, STAT_PH_CMD);
 			if ( (options.todo & TODO_LIST) )
 			{
 				sts = do_directory(&options);
@@ -410,54 +646,48 @@ int main(int argc, char *const *argv)
 			{
 				sts = do_del(&options);
 			}
+			else if ( (options.todo & TODO_SCRIPT) )
+			{
+				sts = do_script(&options);
+			}
+			else if ( (options.todo & TODO_SYNC) )
+			{
+				sts = do_sync(&options);
+			}
+			else if ( (options.todo & TODO_DIFF) )
+			{
+				sts = do_diff(&options);
+			}
+			else if ( (options.todo & TODO_MANIFEST) )
+			{
+				sts = do_manifest(&options);
+			}
+			statEnd(&options, STAT_PH_CMD);
 			if ( !sts && options.dirDirty )
 			{
-				writeNewDir(&options);
+				statBegin(&options, STAT_PH_WRDIR);
+				sts = writeNewDir(&options);
+				statEnd(&options, STAT_PH_WRDIR);
 			}
 		}
 	}
 	else
 	{
-		do_new(&options);
+		statBegin(&options, STAT_PH_CMD);
+		sts = (options.todo & TODO_MKFS) ? do_mkfs(&options) : do_new(&options);
+		statEnd(&options, STAT_PH_CMD);
 	}
-#if !NO_REGEXP
-	if ( options.rexts )
+	statReport(&options);
+	freeFilters(&options);
+	freeContainer(&options);
+	if ( options.copyBuf )
 	{
-		for ( ii = 0; ii < options.numArgFiles; ++ii )
-			regfree(options.rexts + ii);
-		free(options.rexts);
-		options.rexts = NULL;
+		free(options.copyBuf);
+		options.copyBuf = NULL;
 	}
-#endif
-	if ( options.normExprs )
-	{
-		free(options.normExprs);
-		options.normExprs = NULL;
-	}
-	if ( options.inp )
-	{
-		fclose(options.inp);
-		options.inp = NULL;
-	}
-	if ( options.floppyImage )
-	{
-		free(options.floppyImage);
-		options.floppyImage = NULL;
-		options.floppyImageUnscrambled = NULL;
-		options.floppyImageSize = 0;
-		options.directory = NULL;
-		options.directorySize = 0;
-	}
-	if ( options.directory )
-	{
-		free(options.directory);
-		options.directory = NULL;
-		options.directorySize = 0;
-	}
-	if ( options.wDirArray )
-	{
-		free(options.wDirArray);
-		options.wDirArray = NULL;
-	}
-	return 0;
+	/* in, out and del carry on past a file they can't do (and the directory is
+	 * still written for the ones they could) but the exit status says so */
+	if ( !sts && options.numErrors )
+		sts = 1;
+	return sts;
 }
@@ -58,6 +58,8 @@ typedef unsigned char U8;       /* Some useful types */
 typedef char S8;
 typedef unsigned short U16;
 typedef short S16;
+typedef unsigned int U32;
+typedef unsigned long long U64;
 
 /** Defines the RT11 Home block 
   */
@@ -148,7 +150,12 @@ typedef enum {
 	CMDSTATE_OUT,       /**< Parsing out command options */
 	CMDSTATE_SQZ,       /**< Parsing squeeze command options */
 	CMDSTATE_DEL,       /**< Parsing del command options */
-	CMDSTATE_NEW        /**< Parsing new command options */
+	CMDSTATE_NEW,       /**< Parsing new command options */
+	CMDSTATE_SCRIPT,    /**< Parsing script command options */
+	CMDSTATE_MKFS,      /**< Parsing mkfs command options */
+	CMDSTATE_SYNC,      /**< Parsing sync command options */
+	CMDSTATE_DIFF,      /**< Parsing diff command options */
+	CMDSTATE_MANIFEST   /**< Parsing manifest command options */
 } CmdState_t;
 
 	#if 0
@@ -178,8 +185,27 @@ typedef struct
 	int lba;                /**< Logical block (index to starting 512 byte block on disk) */
 	U8 segNo;               /**< Directory segment entry found in */
 	U8 segIdx;              /**< Index into directory segment where entry found */
+	U8 freed;               /**< Was a permanent file until deleted during this run */
 } InWorkingDir_t;
 
+/** Defines a remembered filter result.
+ * 
+ * Filter results are kept by Rad50 filename so a name only has to be checked once.
+ */
+typedef struct
+{
+	unsigned short name[3]; /**< Rad50 filename and type */
+	short which;            /**< Index of matching filter, -1 if no match */
+	short excluded;         /**< 1 if name matched an --exclude, 0 if not */
+} FilterMemo_t;
+
+/** Defines a compiled --where expression (see where.c) */
+typedef struct WhereProg WhereProg_t;
+/** Statistics gathered with --stats (private to stats.c) */
+typedef struct Stats Stats_t;
+/** Trace output from --trace (private to trace.c) */
+typedef struct Trace Trace_t;
+
 	#if 0
 /** Defines array useful for sorting.
  * 
@@ -200,6 +226,8 @@ typedef struct
 	InWorkingDir_t *sizeMatch;
 	char *inFileBuf;
 	int inFileBufSize;
+	const char *directName;     /**< Host file copied straight into container by writeFileToContainer() (NULL if in inFileBuf) */
+	long directSize;            /**< Size in bytes of directName */
 /*	char *outFileBuf; */
 /*	int outFileBufSize; */
 	int fileBlks;
@@ -209,6 +237,13 @@ typedef struct
 	time_t fileTimeStamp;
 } InHandle_t;
 
+/** Where messages go instead of stdout and stderr (used by librtpip).
+ * @param user - options->msgUser.
+ * @param isError - non-zero if it is an error (would have gone to stderr).
+ * @param msg - the message (ends with a newline).
+ */
+typedef void (*MsgFunc_t)(void *user, int isError, const char *msg);
+
 /** Defines the command options and other interfaces between internal functions.
  */
 typedef struct
@@ -243,8 +278,35 @@ typedef struct
 	int numArgFiles;                /**< Number of filenames in argFiles */
 #if !NO_REGEXP
 	regex_t *rexts;                 /**< Pointer to regex compiles */
+	regex_t *rexUnion;              /**< Pointer to all the regex's combined into one (NULL if couldn't) */
+	int *rexGroups;                 /**< Pointer to array of group numbers in rexUnion, one for each regex */
+	regmatch_t *rexMatch;           /**< Pointer to array of matches filled in by rexUnion */
+	int rexNumMatch;                /**< Number of items in rexMatch */
 #endif
 	char *normExprs;                /**< Pointer to array of filename strings each 10 chars in length (6+3+null) */
+	const char **excludes;          /**< Pointer to array of --exclude filters (from command line) */
+	int numExcludes;                /**< Number of items in excludes */
+#if !NO_REGEXP
+	regex_t *exclRexts;             /**< Pointer to regex compiles of excludes */
+#endif
+	char *exclNormExprs;            /**< Pointer to array of exclude filename strings each 10 chars in length */
+	WhereProg_t *where;             /**< Pointer to compiled --where expression (NULL if none) */
+	MsgFunc_t msgFunc;              /**< Where msgErr() and msgOut() send messages (NULL for stderr and stdout) */
+	void *msgUser;                  /**< Passed to msgFunc */
+	int numErrors;                  /**< Number of messages sent through msgErr() */
+	Stats_t *stats;                 /**< Pointer to statistics (NULL unless --stats or --trace) */
+#if RTPIP_TRACE
+	Trace_t *trace;                 /**< Pointer to trace output (NULL unless --trace) */
+#endif
+	U8 *copyBuf;                    /**< Pointer to buffer used by fileCopy() when the kernel can't copy (NULL until needed) */
+	int copyMethod;                 /**< How fileCopy() moves bytes (one of COPY_xxx) */
+#define COPY_KERNEL   (0)           /**< copy_file_range() */
+#define COPY_SENDFILE (1)           /**< sendfile() */
+#define COPY_BUFFER   (2)           /**< pread() and pwrite() through copyBuf */
+	int noReflink;                  /**< fileCopy() found it can't share blocks between files */
+	FilterMemo_t *filterMemo;       /**< Pointer to filter results remembered by Rad50 name */
+	int filterMemoSize;             /**< Number of items in filterMemo (a power of 2) */
+	int filterMemoUsed;             /**< Number of items in filterMemo in use */
 	CmdState_t cmdState;            /**< Current state of command line parser */
 	int segnum;                     /**< Number of segments used in RT11 directory */
 	int maxseg;                     /**< Number of segments available in RT11 directory */
@@ -267,6 +329,8 @@ typedef struct
 #define SORTBY_DATE (4)             /**< Sort by date */
 #define SORTBY_SIZE (8)             /**< Sort by file size */
 #define SORTBY_REV  (16)            /**< Sort descending order */
+	U8 sortKeys[4];                 /**< Sort keys in order of importance (SORTBY_xxx, SORTBY_REV if descending) */
+	int numSortKeys;                /**< Number of items in sortKeys */
 	int lsOpts;                     /**< Holds ls cmd options */
 #define LSOPTS_HELP (1)             /**< Show help for ls command */
 #define LSOPTS_ALL  (2)             /**< Show all details in ls */
@@ -288,6 +352,7 @@ typedef struct
 /* #define INOPTS_CTLZ (32)            **< Add Control-Z to end of ascii file */
 	unsigned short inDate;          /**< Date to use while copying in files */
 	const char *outDir;             /**< output directory */
+	const char *tarFile;            /**< ustar archive out writes or in reads instead of host files ("-" for stdout or stdin) */
 	int delOpts;
 #define DELOPTS_HELP (1)            /**< Help mode */
 #define DELOPTS_VERB (2)            /**< Verbose */
@@ -301,8 +366,40 @@ typedef struct
 #define NEWOPTS_HELP (1)            /**< Help mode */
 #define NEWOPTS_VERB (2)            /**< Verbose */
 #define NEWOPTS_NOASK (4)           /**< No prompts */
+#define NEWOPTS_PREALLOC (8)        /**< Allocate all the blocks instead of leaving a hole */
 	int newMaxSeg;                  /**< New number of segments to use during a new */
 	int newDiskSize;                /**< Size of new container file */
+	int scriptOpts;
+#define SCRIPTOPTS_HELP (1)         /**< Help mode */
+#define SCRIPTOPTS_VERB (2)         /**< Show each command before running it */
+	const char *scriptFile;         /**< File of commands for script cmd ("-" for stdin) */
+	int syncOpts;
+#define SYNCOPTS_HELP (1)           /**< Help mode */
+#define SYNCOPTS_VERB (2)           /**< Verbose */
+#define SYNCOPTS_DELETE (4)         /**< Delete files that aren't in the host directory */
+	int diffOpts;
+#define DIFFOPTS_HELP (1)           /**< Help mode */
+#define DIFFOPTS_VERB (2)           /**< Verbose */
+#define DIFFOPTS_MACHINE (4)        /**< One tab separated line per difference */
+#define DIFFOPTS_QUICK (8)          /**< Don't compare contents */
+#define DIFFOPTS_SGL (16)           /**< Other container is a single density floppy image */
+#define DIFFOPTS_DBL (32)           /**< Other container is a double density floppy image */
+	const char *diffWith;           /**< Container or host directory diff compares with */
+	int manOpts;
+#define MANOPTS_HELP (1)            /**< Help mode */
+#define MANOPTS_VERB (2)            /**< Verbose */
+#define MANOPTS_CSV  (4)            /**< Write CSV instead of JSON */
+#define MANOPTS_CRC  (8)            /**< Include CRC32C's */
+#define MANOPTS_SHA  (16)           /**< Include SHA-256's */
+	int manJobs;                    /**< Threads hashing files for manifest (0 for one per CPU) */
+	const char *manOutput;          /**< File manifest is written to (NULL for stdout) */
+	const char *manCheck;           /**< Manifest to check the container against (NULL to write one) */
+	const char *hostDir;            /**< Host directory mkfs and sync copy in */
+	const char *asciiTypes;         /**< Comma separated filetypes mkfs and sync copy in as text */
+	int holdFreed;                  /**< Don't put new files where files deleted during this run were */
+	const char *server;             /**< Socket of the rtpipd to send the command to (NULL to do it here) */
+	int serverFd;                   /**< Connection to rtpipd */
+	char *serverPath;               /**< Absolute path of container as sent to rtpipd */
 	int todo;                       /**< Command to execute */
 #define TODO_LIST (1)               /**< Directory listing */
 #define TODO_INP  (2)               /**< Copy files into container */
@@ -311,6 +408,11 @@ typedef struct
 #define TODO_SQZ  (16)              /**< Squeeze empty space */
 #define TODO_DEL  (32)              /**< Delete file(s) */
 #define TODO_NEW  (64)              /**< New container file */
+#define TODO_SCRIPT (128)           /**< Run commands from a file */
+#define TODO_MKFS (256)             /**< New container filled from a host directory */
+#define TODO_SYNC (512)             /**< Make container match a host directory */
+#define TODO_DIFF (1024)            /**< Compare with another container or a host directory */
+#define TODO_MANIFEST (2048)        /**< List files with their hashes */
 } Options_t;
 
 /* Defines for floppy diskette support functions */
@@ -328,6 +430,15 @@ typedef struct
  */
 extern int getcmds(Options_t *options, int argc, char *const *argv);
 
+/** getScriptCmd - get the command and its options from one line of a script.
+ * @param options - pointer to options.
+ * @param argc - count of arguments.
+ * @param argv - pointer to array of arguments (argv[1] is the command).
+ * 
+ * @return - 0 if success. 1 if failure.
+ */
+extern int getScriptCmd(Options_t *options, int argc, char *const *argv);
+
 /* Functions found in rtutils.c */
 
 	#define R50_DOLLAR  (27)
@@ -380,10 +491,110 @@ extern int getYN(const char *prompt, int def);
 	#define INSTR_LEN (12)
 extern char* dateStr(char outStr[INSTR_LEN], unsigned short date);
 
+/**
+ * dateIso - convert RT11 date to yyyy-mm-dd
+ * @param outStr - pointer to output string
+ * @param date - RT11 date (0 gives "-")
+ * @return pointer to output string
+ */
+extern char* dateIso(char outStr[INSTR_LEN], unsigned short date);
+
+/**
+ * dateKey - convert RT11 date to a number that sorts in date order
+ * @param date - RT11 date
+ * @return (year-1972)*512 + month*32 + day (always fits in 16 bits)
+ */
+extern int dateKey(unsigned short date);
+
+/**
+ * timeToDate - convert a host time to an RT11 date
+ * @param tim - time to convert (local time is used)
+ * @return RT11 date with the age bits set for years past 2003
+ */
+extern unsigned short timeToDate(time_t tim);
+
+/**
+ * dateToTime - convert an RT11 date to a host time
+ * @param date - RT11 date
+ * @return midnight (local time) of that day
+ */
+extern time_t dateToTime(unsigned short date);
+
 extern int mkOFBuf(InHandle_t *ihp, int *need);
 
 extern int cvtName(Options_t *options, const char *fileName);
 
+/**
+ * See if a filename has one of the --ascii filetypes.
+ * @param options - pointer to options.
+ * @param ffull - RT11 filename (uppercase).
+ * @return 1 if it does, 0 if not.
+ */
+extern int isAsciiType(Options_t *options, const char *ffull);
+
+/**
+ * Show an error message on stderr (or hand it to options->msgFunc if there is one).
+ * @param options - pointer to options.
+ * @param fmt - printf() format followed by its arguments.
+ * @return nothing
+ */
+extern void msgErr(Options_t *options, const char *fmt, ...);
+
+/**
+ * Show a message on stdout (or hand it to options->msgFunc if there is one).
+ * @param options - pointer to options.
+ * @param fmt - printf() format followed by its arguments.
+ * @return nothing
+ */
+extern void msgOut(Options_t *options, const char *fmt, ...);
+
+/* Functions found in rad50.c */
+
+/**
+ * Fill in the conversion tables. The first conversion does this if it hasn't been
+ * done, so it only needs calling before converting from more than one thread.
+ * @return nothing
+ */
+extern void r50Init(void);
+
+/**
+ * Convert a Rad50 filename to ASCII.
+ * @param dst - pointer to at least 11 bytes into which to put the null terminated name.
+ * @param name - pointer to 3 word Rad50 filename and type.
+ * @return length of name (not counting the null).
+ * @note The result is the same as fromRad50() three times then sqzSpaces().
+ */
+extern int r50DecodeName(char *dst, const unsigned short name[3]);
+
+/**
+ * Convert an array of Rad50 filenames to ASCII.
+ * @param dst - pointer to first place to put a null terminated name (each at least 11 bytes).
+ * @param dstStride - number of bytes from one dst to the next.
+ * @param names - pointer to first 3 word Rad50 filename and type.
+ * @param nameStride - number of bytes from one name to the next.
+ * @param count - number of names to convert.
+ * @return nothing
+ */
+extern void r50DecodeNames(char *dst, size_t dstStride, const unsigned short *names, size_t nameStride, int count);
+
+/**
+ * Convert an ASCII filename to Rad50.
+ * @param name - pointer to 3 words into which to put the Rad50 filename and type.
+ * @param src - pointer to null terminated filename (upper or lowercase) of the form nnnnnn.ttt
+ * @return 0 on success, 1 if the name cannot be expressed in Rad50.
+ */
+extern int r50EncodeName(unsigned short name[3], const char *src);
+
+/**
+ * Convert an array of ASCII filenames to Rad50.
+ * @param names - pointer to where to put the first 3 word Rad50 filename and type.
+ * @param nameStride - number of bytes from one name to the next.
+ * @param src - pointer to array of pointers to null terminated filenames.
+ * @param count - number of names to convert.
+ * @return number of names converted. If less than count, src[return value] is not a legal name.
+ */
+extern int r50EncodeNames(unsigned short *names, size_t nameStride, const char *const *src, int count);
+
 /* Functions found in floppy.c */
 
 /** descramble - Rearranges the diskette container file
@@ -438,10 +649,33 @@ extern int parse_directory(Options_t *options);
  */
 extern int linearToDisk(Options_t *options);
 
+/**
+ * Close the container and free everything checkHeader() and parse_directory() made,
+ * so they can be called again.
+ * @param options - pointer to working area.
+ * @return nothing
+ */
+extern void freeContainer(Options_t *options);
+
+/**
+ * Bring linArray and the totals back in line with wDirArray after newDirEnt() or
+ * do_del() changed it, so another command can be run on the same directory.
+ * @param options - pointer to working area.
+ * @return nothing
+ */
+extern void relinkDirectory(Options_t *options);
+
 /* Functions found in sort.c */
 
 extern int (*cmpFuncs[8])(const void *a1, const void *a2);
 
+/**
+ * Sort the linear directory array according to the sort options.
+ * @param options - pointer to options.
+ * @return 0 on success, 1 on error. Error message will have been displayed.
+ */
+extern int sortDirectory(Options_t *options);
+
 /**
  * Compare filename against a filter.
  * @param filter - pointer to filter filename.
@@ -450,6 +684,32 @@ extern int (*cmpFuncs[8])(const void *a1, const void *a2);
  */
 extern int normexec(const char *filter, const char *name);
 
+/* Functions found in filter.c */
+
+/**
+ * Convert a filename wildcard into the form used by normexec().
+ * @param dst - pointer to 10 byte buffer into which to place result.
+ * @param src - pointer to null terminated filename wildcard.
+ * @return 0 on success, 1 if wildcard is invalid. Error message will have been displayed.
+ */
+extern int mkNormExpr(char *dst, const char *src);
+
+/**
+ * Compile the --exclude filters.
+ * @param options - pointer to options
+ * @return 0 on success, 1 on error. Error message will have been displayed.
+ */
+extern int buildExcludes(Options_t *options);
+
+/**
+ * Select directory entries based on the filenames, --exclude
+ * and --where options from command line.
+ * @param options - pointer to options
+ * @param wdp - pointer to directory entry.
+ * @return 1 if to handle file; 0 if to ignore file.
+ */
+extern int selectDirEnt(Options_t *options, const InWorkingDir_t *wdp);
+
 /**
  * Filter filenames based on input from command line.
  * @param options - pointer to options
@@ -458,6 +718,68 @@ extern int normexec(const char *filter, const char *name);
  */
 extern int filterFilename(Options_t *options, const char *name);
 
+/**
+ * Filter directory entries based on input from command line.
+ * Results are remembered by Rad50 name.
+ * @param options - pointer to options
+ * @param wdp - pointer to directory entry.
+ * @return 1 if to handle file; 0 if to ignore file.
+ */
+extern int filterDirEnt(Options_t *options, const InWorkingDir_t *wdp);
+
+/**
+ * Get the index of the filter that selected a directory entry.
+ * @param options - pointer to options
+ * @param wdp - pointer to directory entry.
+ * @return index of first filter (into argFiles) that matched or -1 if none matched.
+ */
+extern int filterWhich(Options_t *options, const InWorkingDir_t *wdp);
+
+/**
+ * Combine all the compiled regular expressions into one.
+ * @param options - pointer to options
+ * @return 0. A failure to combine them is not an error, they just get used one at a time.
+ */
+extern int buildRexUnion(Options_t *options);
+
+/**
+ * Free the combined regular expression.
+ * @param options - pointer to options
+ * @return nothing
+ */
+extern void freeRexUnion(Options_t *options);
+
+/**
+ * Free everything used to filter filenames.
+ * @param options - pointer to options
+ * @return nothing
+ */
+extern void freeFilters(Options_t *options);
+
+/* Functions found in where.c */
+
+/**
+ * Compile a --where expression.
+ * @param expr - pointer to null terminated expression.
+ * @return pointer to compiled expression or NULL if error. Error message will have been displayed.
+ */
+extern WhereProg_t *whereCompile(const char *expr);
+
+/**
+ * Run a compiled --where expression against a directory entry.
+ * @param prog - pointer to compiled expression.
+ * @param wdp - pointer to directory entry.
+ * @return 1 if entry is selected; 0 if not.
+ */
+extern int whereExec(const WhereProg_t *prog, const InWorkingDir_t *wdp);
+
+/**
+ * Free a compiled --where expression.
+ * @param prog - pointer to compiled expression.
+ * @return nothing
+ */
+extern void whereFree(WhereProg_t *prog);
+
 /* Functions found in do_dir.c */
 
 /**
@@ -492,15 +814,171 @@ extern int do_del(Options_t *options);
  */
 extern int preDelete(Options_t *options);
 
+/* Functions found in fcopy.c */
+
+#define COPY_BUF_SIZE (64*BLKSIZ)   /**< Size of buffer used when the kernel can't copy */
+
+/**
+ * Copy a range of bytes from one open file to another, in the kernel if possible.
+ * Neither file's position is changed unless sendfile() ends up being used (then the
+ * output's is). Flush any FILE open on either before calling.
+ * @param options - pointer to options.
+ * @param inIo - STAT_IO_CONT or STAT_IO_HOST for the input.
+ * @param inFd - file to read.
+ * @param inOff - offset in inFd to start reading.
+ * @param outIo - STAT_IO_CONT or STAT_IO_HOST for the output.
+ * @param outFd - file to write.
+ * @param outOff - offset in outFd to start writing.
+ * @param len - number of bytes to copy.
+ * @return number of bytes copied (less than len if inFd ends early) or -1 on error with errno set.
+ */
+extern long fileCopy(Options_t *options, int inIo, int inFd, long inOff, int outIo, int outFd, long outOff, long len);
+
+/* Functions found in cpu.c */
+
+#define CPU_SCALAR (0)              /**< Plain C */
+#define CPU_SSE2   (1)              /**< x86 SSE2 */
+#define CPU_SSE42  (2)              /**< x86 SSE4.2 (and SSSE3) */
+#define CPU_AVX2   (3)              /**< x86 AVX2 */
+#define CPU_AVX512 (4)              /**< x86 AVX-512F and BW */
+#define CPU_NEON   (5)              /**< ARM NEON */
+#define CPU_MAX    (6)
+
+/**
+ * Get the level of kernels in use, picking one if not yet done.
+ * The best the CPU can do is used unless RTPIP_CPU or --cpu says otherwise.
+ * @return one of CPU_xxx.
+ */
+extern int cpuLevel(void);
+
+/**
+ * Get the name of a level.
+ * @param level - one of CPU_xxx.
+ * @return name as used with --cpu.
+ */
+extern const char *cpuName(int level);
+
+/**
+ * Use a lower level of kernels than the best the CPU can do.
+ * @param name - name of level (as from cpuName()).
+ * @return 0 on success, 1 on error. Error message will have been displayed.
+ */
+extern int cpuForce(const char *name);
+
+/**
+ * Check whether a buffer is all zeros.
+ * @param buf - pointer to buffer.
+ * @param len - number of bytes in buffer.
+ * @return 1 if every byte is 0, 0 if not.
+ */
+extern int memIsZero(const void *buf, size_t len);
+
+/**
+ * Find the first byte that differs between two buffers.
+ * @param aa - pointer to one buffer.
+ * @param bb - pointer to the other.
+ * @param len - number of bytes to compare.
+ * @return index of first byte that differs or len if they are the same.
+ */
+extern size_t memDiff(const void *aa, const void *bb, size_t len);
+
+/**
+ * Add up 16 bit words (as for the home block checksum).
+ * @param buf - pointer to words. Must be 2 byte aligned.
+ * @param numWords - number of words.
+ * @return sum of the words modulo 65536.
+ */
+extern U16 memSum16(const void *buf, size_t numWords);
+
+/**
+ * Compute a CRC32C (Castagnoli, as used by iSCSI and ext4). It can be done in pieces
+ * by passing what the last piece returned.
+ * @param crc - 0 to start, or what was returned for the data before buf.
+ * @param buf - pointer to data.
+ * @param len - number of bytes.
+ * @return CRC of everything so far.
+ */
+extern U32 memCrc32c(U32 crc, const void *buf, size_t len);
+
+/* Functions found in ascii.c */
+
+/**
+ * Count the lf's that are not preceeded by a cr.
+ * @param src - pointer to text.
+ * @param len - number of bytes of text.
+ * @return number of lone lf's.
+ */
+extern size_t asciiCountLF(const char *src, size_t len);
+
+/**
+ * Change lone lf's to crlf's in place.
+ * @param buf - pointer to text. Must have room for len+extra bytes.
+ * @param len - number of bytes of text.
+ * @param extra - number of lone lf's in text (as returned by asciiCountLF()).
+ * @return nothing
+ */
+extern void asciiExpandLF(char *buf, size_t len, size_t extra);
+
+/** Defines the state kept while stripping cr's from a file handed over in pieces */
+typedef struct
+{
+	int pendingCR;          /**< Last piece ended with a cr not yet written */
+	int done;               /**< Found the null or control Z that ends the text */
+} AsciiStrip_t;
+
+/**
+ * Get ready to strip cr's from a file.
+ * @param asp - pointer to state.
+ * @return nothing
+ */
+extern void asciiStripInit(AsciiStrip_t *asp);
+
+/**
+ * Change crlf's to lf's and stop at the first null or control Z.
+ * @param asp - pointer to state (see asciiStripInit()).
+ * @param src - pointer to next piece of text.
+ * @param len - number of bytes in this piece.
+ * @param dst - where to put result. Must have room for len+1 bytes. Can be the
+ * same as src only if this is the first (or only) piece.
+ * @return number of bytes written to dst.
+ */
+extern size_t asciiStripCR(AsciiStrip_t *asp, const char *src, size_t len, char *dst);
+
+/**
+ * Finish stripping cr's from a file.
+ * @param asp - pointer to state.
+ * @param dst - where to put any last byte. Must have room for 1 byte.
+ * @return number of bytes written to dst.
+ */
+extern size_t asciiStripFinish(AsciiStrip_t *asp, char *dst);
+
+/**
+ * Pick the kernels now instead of on first use, so threads can't both be doing it.
+ * @return nothing
+ */
+extern void asciiInit(void);
+
 /* Functions found in input.c */
 
 /**
- * Read input file and do any crlf processing.
+ * Read input file and do any crlf processing. A binary file going into a hard disk
+ * container is not read at all; writeFileToContainer() copies it straight over.
  * @param options - pointer to options.
  * @return 0 if success, 1 if failure
  */
 extern int readInpFile(Options_t *options, const char *fileName);
 
+/**
+ * Read a host file (or a piece of a stream) into options->iHandle.inFileBuf, do any
+ * crlf processing and pad it to a whole number of blocks.
+ * @param options - pointer to options.
+ * @param fileName - name of file for messages.
+ * @param inp - where to read it from.
+ * @param size - number of bytes to read.
+ * @return 0 if success, 1 if failure
+ */
+extern int fillInpBuf(Options_t *options, const char *fileName, FILE *inp, long size);
+
 /* Functions found in do_in.c */
 
 /**
@@ -510,11 +988,39 @@ extern int readInpFile(Options_t *options, const char *fileName);
  */
 extern int do_in(Options_t *options);
 
+/**
+ * Make a directory entry for the file described by options->iHandle, deleting any
+ * existing file of the same name. It goes in the smallest empty area it fits.
+ * @param options - pointer to options.
+ * @param what - name of file for error messages.
+ * @param wdpp - pointer to place to put pointer to new entry.
+ * @return 0 if success, 1 if not enough room for the file, 2 if out of directory entries.
+ * Error message will have been displayed.
+ */
+extern int newDirEnt(Options_t *options, const char *what, InWorkingDir_t **wdpp);
+
+/**
+ * Copy the file read by readInpFile() or fillInpBuf() into the container.
+ * @param options - pointer to options.
+ * @param what - name of file for messages.
+ * @param traceStart - when reading it started (for --trace).
+ * @return 0 if success, 1 if it wasn't copied, 2 if out of directory entries or
+ * 3 if the container couldn't be written. Error message will have been displayed.
+ */
+extern int copyInFile(Options_t *options, const char *what, U64 traceStart);
+
+/**
+ * Put the new files in the directory and say what was done.
+ * @param options - pointer to options.
+ * @return nothing
+ */
+extern void inSummary(Options_t *options);
+
 /**
  * Write a file into container
  * @param options - pointer to options
  * @param wdp - pointer to directory entry
- * @return 0 on success, 1 on error
+ * @return 0 on success, 1 on error, 2 if just this file could not be written
  */
 extern int writeFileToContainer(Options_t *options, InWorkingDir_t *wdp);
 
@@ -548,5 +1054,364 @@ extern int do_sqz(Options_t *options);
  */
 extern int do_new(Options_t *options);
 
+/**
+ * Lay down the boot blocks and home block of a new container.
+ * @param options - pointer to options (seg1LBA is where the first segment goes).
+ * @param img - pointer to at least options->seg1LBA blocks of 0's.
+ * @return nothing
+ */
+extern void newBootBlocks(Options_t *options, U8 *img);
+
+/* Functions found in do_mkfs.c */
+
+/** One file in a host directory (see hostDirScan()) */
+typedef struct
+{
+	char *path;             /**< Host path */
+	char ffull[6+1+3+1];    /**< RT11 filename */
+	U16 name[3];            /**< Rad50 filename */
+	int blocks;             /**< Size in container */
+	int ascii;              /**< Copy in as text */
+	U16 date;               /**< RT11 date */
+	long hostSize;          /**< Size on host */
+	time_t hostTime;        /**< Modify time on host */
+	char *text;             /**< Text converted while it was sized (malloc'd, NULL once used or if not text) */
+} HostFile_t;
+
+/**
+ * Get the list of files in options->hostDir and size each one as it will be in the container.
+ * @param options - pointer to options.
+ * @param entsP - where to put the pointer to the list (sorted by RT11 name).
+ * @param numP - where to put the number of files.
+ * @return 0 if success; 1 if failure (nothing is returned).
+ */
+extern int hostDirScan(Options_t *options, HostFile_t **entsP, int *numP);
+
+/**
+ * Free a list of host files.
+ * @param ents - pointer to list (from hostDirScan()).
+ * @param num - number of entries.
+ * @return nothing
+ */
+extern void hostDirFree(HostFile_t *ents, int num);
+
+/**
+ * Get a file from hostDirScan() ready to copy in, as readInpFile() would. Text
+ * converted by the scan is handed over rather than read again.
+ * @param options - pointer to options (inOpts set for the file as for readInpFile()).
+ * @param ep - pointer to file.
+ * @return 0 if success, 1 if failure
+ */
+extern int hostFileRead(Options_t *options, HostFile_t *ep);
+
+/**
+ * Make a new container holding all the files in a host directory.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure.
+ */
+extern int do_mkfs(Options_t *options);
+
+/* Functions found in do_diff.c */
+
+/**
+ * Show how the container and the container or host directory in options->diffWith differ.
+ * @param options - pointer to options.
+ * @return 0 if they are the same, 1 if they differ, 2 if there was trouble.
+ */
+extern int do_diff(Options_t *options);
+
+/* Functions found in do_manifest.c */
+
+/**
+ * Write a manifest of the selected files in the container (or check the container
+ * against the one in options->manCheck).
+ * @param options - pointer to options.
+ * @return 0 if success (and everything matched); 1 if not.
+ */
+extern int do_manifest(Options_t *options);
+
+/* Functions found in tar.c */
+
+/**
+ * Write the selected files to options->tarFile as a ustar archive.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure.
+ */
+extern int tarOut(Options_t *options);
+
+/**
+ * Copy the files in the ustar archive options->tarFile into the container.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if the archive couldn't be read.
+ */
+extern int tarIn(Options_t *options);
+
+/* Functions found in sha256.c */
+
+/** State of a SHA-256 being computed */
+typedef struct
+{
+	U32 state[8];           /**< Hash so far */
+	U32 lenLo;              /**< Bytes hashed (low 32 bits) */
+	U32 lenHi;              /**< Bytes hashed (high 32 bits) */
+	U8 buf[64];             /**< Bytes not yet hashed */
+	size_t used;            /**< Number of bytes in buf */
+} Sha256_t;
+
+/**
+ * Start a SHA-256.
+ * @param ctx - pointer to state.
+ * @return nothing
+ */
+extern void sha256Init(Sha256_t *ctx);
+
+/**
+ * Add some data to a SHA-256.
+ * @param ctx - pointer to state.
+ * @param data - pointer to data.
+ * @param len - number of bytes.
+ * @return nothing
+ */
+extern void sha256Update(Sha256_t *ctx, const void *data, size_t len);
+
+/**
+ * Finish a SHA-256.
+ * @param ctx - pointer to state.
+ * @param digest - where to put the 32 byte hash.
+ * @return nothing
+ */
+extern void sha256Final(Sha256_t *ctx, U8 digest[32]);
+
+/* Functions found in do_sync.c */
+
+/**
+ * Make the container's files match the files in options->hostDir.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure.
+ */
+extern int do_sync(Options_t *options);
+
+/* Functions found in script.c */
+
+/**
+ * Run the commands in options->scriptFile against the container, writing the
+ * directory once at the end and only if all of them worked.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure (nothing will have been written).
+ */
+extern int do_script(Options_t *options);
+
+/* Functions found in client.c */
+
+	#define RTPIPD_CHUNK  (65536)   /**< Most bytes of file sent in one frame */
+	#define RTPIPD_ENTSIZ (28)      /**< Bytes per directory entry in an ls reply */
+	#define RTPIPD_MAXHDR (4096)    /**< Longest request header */
+
+/**
+ * Get the path of rtpipd's socket.
+ * @param name - path given with --server or -s (NULL or empty for the default).
+ * @param buf - place to build the default.
+ * @param bufSize - size of buf.
+ * @return pointer to path.
+ */
+extern const char *clientSocket(const char *name, char *buf, int bufSize);
+
+/**
+ * Send one frame (4 byte big endian length followed by the bytes).
+ * @param fd - socket.
+ * @param buf - pointer to bytes.
+ * @param len - number of bytes (0 is an end marker).
+ * @return 0 if success; 1 if failure.
+ */
+extern int frameSend(int fd, const void *buf, long len);
+
+/**
+ * Receive one frame.
+ * @param fd - socket.
+ * @param bufp - pointer to malloc'd buffer (grown as needed, can point to NULL).
+ * @param sizep - pointer to size of *bufp.
+ * @param maxLen - longest frame allowed.
+ * @return length of frame or -1 on error or end of file.
+ */
+extern long frameRecv(int fd, char **bufp, long *sizep, long maxLen);
+
+/**
+ * Do the command by sending it to rtpipd (--server).
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure.
+ */
+extern int clientRun(Options_t *options);
+
+/**
+ * Copy a file out of the container through rtpipd. Used by do_out().
+ * @param options - pointer to options.
+ * @param wdp - pointer to directory entry of file.
+ * @return number of bytes written (or would have been), -1 on error or -2 if the
+ * connection to rtpipd is gone.
+ */
+extern int clientFileOut(Options_t *options, InWorkingDir_t *wdp);
+
+/* Functions found in stats.c */
+
+	#define STAT_PH_TOTAL      (0)  /**< Whole run */
+	#define STAT_PH_HEADER     (1)  /**< checkHeader() */
+	#define STAT_PH_DIR        (2)  /**< parse_directory() */
+	#define STAT_PH_DESCRAMBLE (3)  /**< descramble() and rescramble() */
+	#define STAT_PH_CMD        (4)  /**< The ls, in, out, del, sqz or new command */
+	#define STAT_PH_HOSTIN     (5)  /**< Reading host files in readInpFile() */
+	#define STAT_PH_HOSTOUT    (6)  /**< Creating host files in do_out() */
+	#define STAT_PH_COPY       (7)  /**< Copying files in createNewContainer() */
+	#define STAT_PH_WRDIR      (8)  /**< writeNewDir() */
+	#define STAT_PH_MAX        (9)
+
+	#define STAT_IO_CONT       (0)  /**< I/O to container file */
+	#define STAT_IO_HOST       (1)  /**< I/O to host file */
+	#define STAT_IO_MAX        (2)
+
+	#define STAT_FMT_NONE      (0)  /**< Gather stats but don't show them (for --trace) */
+	#define STAT_FMT_TEXT      (1)  /**< Show stats as a table */
+	#define STAT_FMT_JSON      (2)  /**< Show stats as JSON */
+
+/**
+ * Turn on statistics gathering.
+ * @param options - pointer to options.
+ * @param format - one of STAT_FMT_xxx. If called more than once, the highest is used.
+ * @return 0 on success, 1 if out of memory.
+ */
+extern int statInit(Options_t *options, int format);
+
+/**
+ * Mark the start of a phase. Does nothing if stats are not on.
+ * @param options - pointer to options.
+ * @param phase - one of STAT_PH_xxx
+ * @return nothing
+ */
+extern void statBegin(Options_t *options, int phase);
+
+/**
+ * Mark the end of a phase. Does nothing if stats are not on.
+ * @param options - pointer to options.
+ * @param phase - one of STAT_PH_xxx
+ * @return nothing
+ */
+extern void statEnd(Options_t *options, int phase);
+
+/**
+ * fopen(), fread(), fwrite() and fseek() that count what they do.
+ * @param options - pointer to options.
+ * @param io - STAT_IO_CONT or STAT_IO_HOST.
+ * The rest of the parameters and the return values are the same as the stdio function.
+ */
+extern FILE *statFopen(Options_t *options, int io, const char *name, const char *mode);
+extern size_t statFread(Options_t *options, int io, void *buf, size_t size, size_t nmemb, FILE *fp);
+extern size_t statFwrite(Options_t *options, int io, const void *buf, size_t size, size_t nmemb, FILE *fp);
+extern int statFseek(Options_t *options, int io, FILE *fp, long offset, int whence);
+
+/**
+ * Count I/O done some other way than with the above.
+ * @param options - pointer to options.
+ * @param io - STAT_IO_CONT or STAT_IO_HOST.
+ * @param isWrite - non-zero if bytes were written, 0 if read.
+ * @param bytes - number of bytes.
+ * @return nothing
+ */
+extern void statCount(Options_t *options, int io, int isWrite, long bytes);
+
+/**
+ * Display the statistics on stderr and free them. Does nothing if stats are not on.
+ * Also finishes the trace file if there is one.
+ * @param options - pointer to options.
+ * @return nothing
+ */
+extern void statReport(Options_t *options);
+
+/* Functions found in trace.c (only with make TRACE=1) */
+
+/*
+ * The TRACE_xxx macros are used at the call sites so that a build without
+ * RTPIP_TRACE has no trace code at all. Declare a U64 for the start time and
+ * mark it with TRACE_START() where the span begins.
+ */
+#if RTPIP_TRACE
+	#define TRACE_START(o, v) ((v) = (o)->trace ? traceNow() : 0)
+	#define TRACE_FILE(o, cat, v, name, lba, blocks, bytes) \
+		do { if ( (o)->trace ) traceFile((o), (cat), (v), (name), (lba), (blocks), (bytes)); } while (0)
+
+/**
+ * Get the current monotonic time.
+ * @return time in nanoseconds.
+ */
+extern U64 traceNow(void);
+
+/**
+ * Open the trace output file.
+ * @param options - pointer to options.
+ * @param fileName - name of trace file to create.
+ * @return 0 on success, 1 on failure.
+ */
+extern int traceOpen(Options_t *options, const char *fileName);
+
+/**
+ * Write a span for one phase.
+ * @param options - pointer to options.
+ * @param name - name of phase.
+ * @param start - traceNow() at start of phase.
+ * @param end - traceNow() at end of phase.
+ * @return nothing
+ */
+extern void tracePhase(Options_t *options, const char *name, U64 start, U64 end);
+
+/**
+ * Write a span for one file.
+ * @param options - pointer to options.
+ * @param cat - category of span (usually the command name).
+ * @param start - traceNow() at start of span.
+ * @param name - filename.
+ * @param lba - starting block of file in container.
+ * @param blocks - number of blocks in container.
+ * @param bytes - number of bytes copied (0 if none).
+ * @return nothing
+ */
+extern void traceFile(Options_t *options, const char *cat, U64 start, const char *name, int lba, int blocks, long bytes);
+
+/**
+ * Finish and close the trace output file.
+ * @param options - pointer to options.
+ * @return nothing
+ */
+extern void traceClose(Options_t *options);
+#else
+	#define TRACE_START(o, v) ((void)&(v))
+	#define TRACE_FILE(o, cat, v, name, lba, blocks, bytes) do { } while (0)
+#endif
+
+/* Functions found in imggen.c (used by rtgen and rtbench) */
+
+/** Defines the synthetic container to make */
+typedef struct
+{
+	int blocks;             /**< Volume size in blocks (ignored for floppies) */
+	int segments;           /**< Number of directory segments */
+	int extra;              /**< Extra bytes in each directory entry */
+	int files;              /**< Number of files to make (fewer if they don't fit) */
+	int minBlks;            /**< Smallest file in blocks */
+	int maxBlks;            /**< Largest file in blocks */
+	int logSizes;           /**< Pick file sizes log uniform instead of uniform */
+	int fragPct;            /**< Percent chance of an empty area after each file */
+	int asciiPct;           /**< Percent of files that are text */
+	int floppy;             /**< 0 = hard disk, 1 = RX01 single density, 2 = RX02 double density */
+	unsigned long seed;     /**< Random number seed */
+} GenParams_t;
+
+/**
+ * Make a synthetic RT11 container file.
+ * @param gp - pointer to parameters.
+ * @param path - name of container file to create (NULL to not make one).
+ * @param hostDir - name of existing directory into which to also write each file
+ * as it would be copied out (NULL to not write them).
+ * @return number of files made, -1 on error.
+ */
+extern int genImage(const GenParams_t *gp, const char *path, const char *hostDir);
+
 #endif  /* _RTPIP_H_ */
 
@@ -0,0 +1,622 @@
+/*  $Id: rtpipd.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	rtpipd.c - Keep RT11 containers open and do rtpip commands sent to it.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _XOPEN_SOURCE 700
+#include "rtpip.h"
+#include "librtpip.h"
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * @file rtpipd.c
+ * rtpipd listens on a Unix domain socket for requests from rtpip --server (see
+ * client.c for what they look like). Each container asked for is opened with
+ * librtpip the first time and kept open, so its directory (or, for a floppy, the
+ * whole image) is only read once. It is read again only if the file changes behind
+ * rtpipd's back (checked with stat() on every request).
+ *
+ * Each connection gets its own thread. ls and out of the same container run at the
+ * same time; in, del and sqz wait for everything else using it to finish.
+ */
+
+/** One open container */
+typedef struct Container
+{
+	struct Container *next;     /**< Next one in list */
+	char *path;                 /**< Absolute path with no links */
+	int flags;                  /**< RT_OPEN_xxx */
+	RtHandle_t *hp;             /**< Open handle (NULL if it couldn't be opened) */
+	pthread_rwlock_t lock;      /**< Held for reading by ls and read, for writing by the rest */
+	struct stat st;             /**< What the file looked like when hp was last made to match it */
+} Container_t;
+
+/** One connection from a client */
+typedef struct
+{
+	int fd;                     /**< Socket */
+	char *hdr;                  /**< Request header */
+	long hdrSize;               /**< Size of hdr */
+	char *data;                 /**< File or directory being sent or received */
+	long dataLen;               /**< Bytes used in data */
+	long dataSize;              /**< Size of data */
+	char *msgs;                 /**< Messages for the status frame (starts with the status) */
+	long msgLen;                /**< Bytes used in msgs */
+	long msgSize;               /**< Size of msgs */
+} Conn_t;
+
+static Container_t *containers;
+static pthread_mutex_t containersLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t connKey;
+static volatile sig_atomic_t stopNow;
+static int verbose;
+
+/**
+ * Collect a message from librtpip for the reply to the request being done.
+ * @param user - not used (the connection comes from the thread).
+ * @param isError - not used.
+ * @param msg - the message.
+ * @return nothing
+ */
+static void report(void *user, int isError, const char *msg)
+{
+	Conn_t *conn = (Conn_t *)pthread_getspecific(connKey);
+	long len = strlen(msg);
+	char *nBuf;
+
+	if ( !conn )
+	{
+		fputs(msg, stderr);
+		return;
+	}
+	if ( conn->msgLen + len + 1 > conn->msgSize )
+	{
+		nBuf = (char *)realloc(conn->msgs, conn->msgLen + len + 1024);
+		if ( !nBuf )
+			return;
+		conn->msgs = nBuf;
+		conn->msgSize = conn->msgLen + len + 1024;
+	}
+	memcpy(conn->msgs + conn->msgLen, msg, len);
+	conn->msgLen += len;
+}
+
+/**
+ * Collect a message about a file for the reply to the request being done.
+ * @param fmt - message with %s for the path and then one for strerror(errno).
+ * @param path - path of file.
+ * @return nothing
+ */
+static void reportErrno(const char *fmt, const char *path)
+{
+	char msg[1024];
+
+	snprintf(msg, sizeof(msg), fmt, path, strerror(errno));
+	report(NULL, 1, msg);
+}
+
+/**
+ * Make sure the data buffer is big enough.
+ * @param conn - pointer to connection.
+ * @param need - number of bytes needed.
+ * @return 0 if success; 1 if out of memory (which will have been reported).
+ */
+static int needData(Conn_t *conn, long need)
+{
+	char *nBuf;
+
+	if ( need <= conn->dataSize )
+		return 0;
+	nBuf = (char *)realloc(conn->data, need);
+	if ( !nBuf )
+	{
+		report(NULL, 1, "rtpipd ran out of memory\n");
+		return 1;
+	}
+	conn->data = nBuf;
+	conn->dataSize = need;
+	return 0;
+}
+
+/**
+ * Check that the container's file hasn't changed since it was read.
+ * @param cp - pointer to container.
+ * @return non-zero if the handle still matches the file.
+ */
+static int isFresh(Container_t *cp)
+{
+	struct stat st;
+
+	if ( !cp->hp || stat(cp->path, &st) )
+		return 0;
+	return st.st_dev == cp->st.st_dev && st.st_ino == cp->st.st_ino
+		&& st.st_size == cp->st.st_size && st.st_mtime == cp->st.st_mtime
+		&& st.st_mtim.tv_nsec == cp->st.st_mtim.tv_nsec;
+}
+
+/**
+ * Lock a container, (re)opening it first if it changed.
+ * @param cp - pointer to container.
+ * @param write - non-zero to lock it for writing.
+ * @return 0 if success; 1 if it couldn't be opened (which will have been reported).
+ */
+static int lockContainer(Container_t *cp, int write)
+{
+	while ( 1 )
+	{
+		if ( write )
+			pthread_rwlock_wrlock(&cp->lock);
+		else
+			pthread_rwlock_rdlock(&cp->lock);
+		if ( isFresh(cp) )
+			return 0;
+		pthread_rwlock_unlock(&cp->lock);
+		pthread_rwlock_wrlock(&cp->lock);
+		/* Somebody else may have done it while this was waiting */
+		if ( !isFresh(cp) )
+		{
+			rt_close(cp->hp);
+			cp->hp = NULL;
+			/* stat() first so a change while it is being read is seen next time */
+			if ( stat(cp->path, &cp->st) )
+			{
+				reportErrno("Unable to open input file '%s': %s\n", cp->path);
+				pthread_rwlock_unlock(&cp->lock);
+				return 1;
+			}
+			cp->hp = rt_open(cp->path, cp->flags, report, NULL);
+			if ( !cp->hp )
+			{
+				pthread_rwlock_unlock(&cp->lock);
+				return 1;
+			}
+			if ( verbose )
+				fprintf(stderr, "rtpipd: read '%s'\n", cp->path);
+		}
+		if ( write )
+			return 0;
+		pthread_rwlock_unlock(&cp->lock);
+	}
+}
+
+/**
+ * Unlock a container after writing to it. What it looks like now is what the
+ * handle matches.
+ * @param cp - pointer to container.
+ * @return nothing
+ */
+static void unlockWritten(Container_t *cp)
+{
+	if ( stat(cp->path, &cp->st) )
+	{
+		rt_close(cp->hp);
+		cp->hp = NULL;
+	}
+	pthread_rwlock_unlock(&cp->lock);
+}
+
+/**
+ * Find a container, adding it to the list if it isn't there yet.
+ * @param path - path to container.
+ * @param flags - RT_OPEN_RX01 or RT_OPEN_RX02.
+ * @return pointer to container or NULL on error (which will have been reported).
+ */
+static Container_t *getContainer(const char *path, int flags)
+{
+	Container_t *cp;
+	char *real;
+
+	real = realpath(path, NULL);
+	if ( !real )
+	{
+		reportErrno("Unable to open input file '%s': %s\n", path);
+		return NULL;
+	}
+	flags = (flags & (RT_OPEN_RX01 | RT_OPEN_RX02)) | RT_OPEN_WRITE;
+	pthread_mutex_lock(&containersLock);
+	for ( cp = containers; cp; cp = cp->next )
+	{
+		if ( cp->flags == flags && !strcmp(cp->path, real) )
+			break;
+	}
+	if ( !cp )
+	{
+		cp = (Container_t *)calloc(1, sizeof(Container_t));
+		if ( cp )
+		{
+			cp->path = real;
+			real = NULL;
+			cp->flags = flags;
+			pthread_rwlock_init(&cp->lock, NULL);
+			cp->next = containers;
+			containers = cp;
+		}
+		else
+			report(NULL, 1, "rtpipd ran out of memory\n");
+	}
+	pthread_mutex_unlock(&containersLock);
+	free(real);
+	return cp;
+}
+
+/**
+ * Send conn->data as data frames.
+ * @param conn - pointer to connection.
+ * @param len - number of bytes.
+ * @param chunk - most bytes in one frame.
+ * @return 0 if success; 1 if the connection is gone.
+ */
+static int sendData(Conn_t *conn, long len, long chunk)
+{
+	long sent, part;
+
+	for ( sent = 0; sent < len; sent += part )
+	{
+		part = len - sent;
+		if ( part > chunk )
+			part = chunk;
+		if ( frameSend(conn->fd, conn->data + sent, part) )
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Add one directory entry to the ls reply (see client.c for the layout).
+ * @param user - pointer to connection.
+ * @param ent - pointer to entry.
+ * @return 0 to keep going, 1 if out of memory.
+ */
+static int listEnt(void *user, const RtDirEnt_t *ent)
+{
+	Conn_t *conn = (Conn_t *)user;
+	unsigned char *ep;
+
+	if ( needData(conn, conn->dataLen + RTPIPD_ENTSIZ) )
+		return 1;
+	ep = (unsigned char *)conn->data + conn->dataLen;
+	memset(ep, 0, 12);
+	strncpy((char *)ep, ent->name, 11);
+	ep[12] = ent->control >> 8;
+	ep[13] = ent->control & 0xFF;
+	ep[14] = ent->date >> 8;
+	ep[15] = ent->date & 0xFF;
+	ep[16] = (ent->blocks >> 24) & 0xFF;
+	ep[17] = (ent->blocks >> 16) & 0xFF;
+	ep[18] = (ent->blocks >> 8) & 0xFF;
+	ep[19] = ent->blocks & 0xFF;
+	ep[20] = (ent->lba >> 24) & 0xFF;
+	ep[21] = (ent->lba >> 16) & 0xFF;
+	ep[22] = (ent->lba >> 8) & 0xFF;
+	ep[23] = ent->lba & 0xFF;
+	ep[24] = ent->seg;
+	ep[25] = ent->segIdx;
+	ep[26] = ent->channel;
+	ep[27] = ent->procid;
+	conn->dataLen += RTPIPD_ENTSIZ;
+	return 0;
+}
+
+/**
+ * Get the contents of a file being written (the frames after the header).
+ * @param conn - pointer to connection.
+ * @param lenp - pointer to place to put number of bytes.
+ * @return 0 if success, 1 if too big or out of memory (reported, the rest is still
+ * read) or -1 if the connection is gone.
+ */
+static int recvData(Conn_t *conn, long *lenp)
+{
+	char *buf = NULL;
+	long size = 0, len;
+	int sts = 0;
+
+	*lenp = 0;
+	while ( (len = frameRecv(conn->fd, &buf, &size, RTPIPD_CHUNK)) > 0 )
+	{
+		if ( sts )
+			continue;
+		if ( *lenp + len > 65535L * BLKSIZ )
+		{
+			report(NULL, 1, "File is too big for an RT11 container\n");
+			sts = 1;
+			continue;
+		}
+		if ( needData(conn, *lenp + len) )
+		{
+			sts = 1;
+			continue;
+		}
+		memcpy(conn->data + *lenp, buf, len);
+		*lenp += len;
+	}
+	free(buf);
+	return len < 0 ? -1 : sts;
+}
+
+/**
+ * Do one request and send the reply.
+ * @param conn - pointer to connection.
+ * @param op - request.
+ * @param path - path to container.
+ * @param flags - RT_OPEN_RX01 or RT_OPEN_RX02.
+ * @param name - RT11 filename.
+ * @param date - RT11 date.
+ * @return 0 if success; 1 if the connection is gone.
+ */
+static int doRequest(Conn_t *conn, const char *op, const char *path, int flags,
+					 const char *name, unsigned short date)
+{
+	Container_t *cp;
+	long len = 0;
+	int sts = 0, isWrite;
+
+	isWrite = !strcmp(op, "write");
+	/* The status goes in front of the messages */
+	conn->msgLen = 1;
+	if ( isWrite && (sts = recvData(conn, &len)) < 0 )
+		return 1;
+	cp = NULL;
+	if ( !sts && !(cp = getContainer(path, flags)) )
+		sts = 1;
+	if ( !cp )
+		;
+	else if ( !strcmp(op, "ls") || !strcmp(op, "read") )
+	{
+		sts = lockContainer(cp, 0);
+		if ( !sts )
+		{
+			if ( op[0] == 'l' )
+			{
+				conn->dataLen = 0;
+				sts = rt_list(cp->hp, listEnt, conn);
+				len = conn->dataLen;
+			}
+			else
+			{
+				/* Both under the same lock so the size can't change in between */
+				len = rt_read(cp->hp, name, NULL, 0);
+				sts = len < 0 || needData(conn, len) || rt_read(cp->hp, name, conn->data, len) != len;
+			}
+			pthread_rwlock_unlock(&cp->lock);
+		}
+		if ( !sts && sendData(conn, len, op[0] == 'l' ? RTPIPD_CHUNK / RTPIPD_ENTSIZ * RTPIPD_ENTSIZ : RTPIPD_CHUNK) )
+			return 1;
+	}
+	else if ( !strcmp(op, "del") || !strcmp(op, "sqz") )
+	{
+		sts = lockContainer(cp, 1);
+		if ( !sts )
+		{
+			sts = op[0] == 'd' ? rt_delete(cp->hp, name) : rt_squeeze(cp->hp);
+			unlockWritten(cp);
+		}
+	}
+	else if ( isWrite )
+	{
+		sts = lockContainer(cp, 1);
+		if ( !sts )
+		{
+			sts = rt_write(cp->hp, name, conn->data, len, date);
+			unlockWritten(cp);
+		}
+	}
+	else
+	{
+		report(NULL, 1, "Unknown request\n");
+		sts = 1;
+	}
+	if ( verbose )
+		fprintf(stderr, "rtpipd: %s %s%s%s%s\n", op, path, *name ? " " : "", name, sts ? " failed" : "");
+	conn->msgs[0] = sts ? '1' : '0';
+	return frameSend(conn->fd, NULL, 0) || frameSend(conn->fd, conn->msgs, conn->msgLen);
+}
+
+/**
+ * Serve one connection.
+ * @param arg - pointer to connection.
+ * @return NULL
+ */
+static void *serve(void *arg)
+{
+	Conn_t *conn = (Conn_t *)arg;
+	const char *field[5];
+	char *cp, *end;
+	long len;
+	int ii;
+
+	pthread_setspecific(connKey, conn);
+	/* Room for the status at the front of msgs */
+	report(NULL, 0, " ");
+	while ( conn->msgs && (len = frameRecv(conn->fd, &conn->hdr, &conn->hdrSize, RTPIPD_MAXHDR)) > 0 )
+	{
+		end = conn->hdr + len;
+		for ( ii = 0, cp = conn->hdr; ii < 5 && cp < end; ++ii )
+		{
+			field[ii] = cp;
+			cp += strlen(cp) + 1;
+		}
+		if ( ii < 5 )
+			break;
+		if ( doRequest(conn, field[0], field[1], atoi(field[2]), field[3],
+					   (unsigned short)strtoul(field[4], NULL, 10)) )
+			break;
+	}
+	close(conn->fd);
+	free(conn->hdr);
+	free(conn->data);
+	free(conn->msgs);
+	free(conn);
+	return NULL;
+}
+
+/**
+ * Ask the accept() loop to stop.
+ * @param sig - not used.
+ * @return nothing
+ */
+static void stopIt(int sig)
+{
+	stopNow = 1;
+}
+
+/**
+ * Display help.
+ * @return 1
+ */
+static int help(void)
+{
+	printf("Usage: rtpipd [-v] [-s socket]\n"
+		   "Keeps RT11 containers open and does the commands rtpip --server sends it.\n"
+		   "where:\n"
+		   " -h, -? or --help = This message.\n"
+		   " -s socket or --socket=socket = listen on socket instead of $RTPIPD_SOCKET or\n"
+		   "                                /tmp/rtpipd-<uid>.sock\n"
+		   " -v or --verbose = show each request on stderr\n"
+		   "Stop it with SIGINT or SIGTERM. Anything being written is finished first.\n");
+	return 1;
+}
+
+static struct option long_opts[] = {
+	{ "help", 0, 0, 'h' },
+	{ "socket", 1, 0, 's' },
+	{ "verbose", 0, 0, 'v' },
+	{ 0, 0, 0, 0 }
+};
+
+/**
+ * Program main entry point.
+ * @param argc - number of command line arguments.
+ * @param argv - pointer to array of command line arguments.
+ * @return 0 on success, non-zero on failure.
+ */
+int main(int argc, char *const *argv)
+{
+	struct sockaddr_un addr;
+	struct sigaction sa;
+	sigset_t stopSigs, oldSigs;
+	pthread_attr_t attr;
+	pthread_t tid;
+	const char *sockName = NULL, *path;
+	char pathBuf[64];
+	Container_t *cp;
+	Conn_t *conn;
+	int opt, lfd, fd;
+	mode_t oldMask;
+
+	while ( (opt = getopt_long(argc, argv, "h?s:v", long_opts, NULL)) != -1 )
+	{
+		switch (opt)
+		{
+		case 's':
+			sockName = optarg;
+			break;
+		case 'v':
+			++verbose;
+			break;
+		default:
+			return help();
+		}
+	}
+	if ( optind < argc )
+		return help();
+	path = clientSocket(sockName, pathBuf, sizeof(pathBuf));
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if ( strlen(path) >= sizeof(addr.sun_path) )
+	{
+		fprintf(stderr, "Socket path '%s' is too long\n", path);
+		return 1;
+	}
+	strcpy(addr.sun_path, path);
+	lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( lfd < 0 )
+	{
+		fprintf(stderr, "Unable to make a socket: %s\n", strerror(errno));
+		return 1;
+	}
+	/* Don't pull the socket out from under one that's running */
+	if ( !connect(lfd, (struct sockaddr *)&addr, sizeof(addr)) )
+	{
+		fprintf(stderr, "rtpipd is already running on '%s'\n", path);
+		return 1;
+	}
+	close(lfd);
+	lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(path);
+	/* Only this user can connect */
+	oldMask = umask(077);
+	if ( lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) || listen(lfd, 16) )
+	{
+		fprintf(stderr, "Unable to listen on '%s': %s\n", path, strerror(errno));
+		return 1;
+	}
+	umask(oldMask);
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+	/* No SA_RESTART so accept() stops when asked to */
+	sa.sa_handler = stopIt;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sigemptyset(&stopSigs);
+	sigaddset(&stopSigs, SIGINT);
+	sigaddset(&stopSigs, SIGTERM);
+	pthread_key_create(&connKey, NULL);
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if ( verbose )
+		fprintf(stderr, "rtpipd: listening on '%s'\n", path);
+	while ( !stopNow )
+	{
+		fd = accept(lfd, NULL, NULL);
+		if ( fd < 0 )
+		{
+			if ( errno == EINTR || errno == ECONNABORTED )
+				continue;
+			fprintf(stderr, "Error accepting connection: %s\n", strerror(errno));
+			break;
+		}
+		conn = (Conn_t *)calloc(1, sizeof(Conn_t));
+		if ( !conn )
+		{
+			close(fd);
+			continue;
+		}
+		conn->fd = fd;
+		/* Only this thread gets SIGINT and SIGTERM, so they interrupt accept() */
+		pthread_sigmask(SIG_BLOCK, &stopSigs, &oldSigs);
+		if ( pthread_create(&tid, &attr, serve, conn) )
+		{
+			close(fd);
+			free(conn);
+		}
+		pthread_sigmask(SIG_SETMASK, &oldSigs, NULL);
+	}
+	unlink(path);
+	close(lfd);
+	/* Wait for anything being written to finish. The locks are never let go. */
+	pthread_mutex_lock(&containersLock);
+	for ( cp = containers; cp; cp = cp->next )
+		pthread_rwlock_wrlock(&cp->lock);
+	if ( verbose )
+		fprintf(stderr, "rtpipd: stopped\n");
+	return 0;
+}
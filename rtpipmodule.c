@@ -0,0 +1,487 @@
+/*  $Id: rtpipmodule.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	rtpipmodule.c - The rtpip commands as a CPython module.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <stdlib.h>
+#include <string.h>
+#include "librtpip.h"
+
+/**
+ * @file rtpipmodule.c
+ * The rtpip module for CPython (make python). It is a thin layer over librtpip:
+ *
+ *     import rtpip
+ *     with rtpip.Container("rt11.dsk", write=True) as c:
+ *         for ent in c:
+ *             if ent.control & rtpip.PERM:
+ *                 print(ent.name, ent.blocks, ent.date, ent.lba)
+ *         data = c.read("SWAP.SYS")
+ *         c.write("HELLO.TXT", b"Hello\r\n")
+ *         c.delete("JUNK.OBJ")
+ *         c.squeeze()
+ *
+ * The GIL is let go while librtpip works on the container, so Python threads can
+ * work on different containers (or read the same one) at the same time. Errors
+ * raise rtpip.Error with librtpip's messages.
+ */
+
+/** Messages collected during one call */
+typedef struct
+{
+	char *text;                 /**< Messages (null terminated) */
+	size_t len;                 /**< Bytes in text */
+} Msgs_t;
+
+/** Container object */
+typedef struct
+{
+	PyObject_HEAD
+	RtHandle_t *hp;             /**< Open handle (NULL once closed) */
+	int busy;                   /**< Number of calls that let go of the GIL (changed only with the GIL held) */
+} Container_t;
+
+static PyObject *RtError;
+static PyTypeObject DirEntType;
+static Py_tss_t msgKey = Py_tss_NEEDS_INIT;
+
+static PyStructSequence_Field dirEntFields[] = {
+	{ "name", "RT11 filename (empty if the entry is not a file)" },
+	{ "blocks", "size in 512 byte blocks" },
+	{ "date", "RT11 date word (0 if none)" },
+	{ "lba", "starting block" },
+	{ "control", "control bits (PERM, EMPTY, TENT, PROTEK)" },
+	{ NULL, NULL }
+};
+
+static PyStructSequence_Desc dirEntDesc = {
+	"rtpip.DirEnt",
+	"One directory entry.",
+	dirEntFields,
+	5
+};
+
+/**
+ * Collect a message from librtpip for the call being made in this thread.
+ * @param user - not used.
+ * @param isError - not used.
+ * @param msg - the message.
+ * @return nothing
+ */
+static void report(void *user, int isError, const char *msg)
+{
+	Msgs_t *mp = (Msgs_t *)PyThread_tss_get(&msgKey);
+	size_t len = strlen(msg);
+	char *nText;
+
+	if ( !mp )
+		return;
+	nText = (char *)realloc(mp->text, mp->len + len + 1);
+	if ( !nText )
+		return;
+	mp->text = nText;
+	memcpy(mp->text + mp->len, msg, len + 1);
+	mp->len += len;
+}
+
+/**
+ * Raise rtpip.Error with the messages collected.
+ * @param mp - pointer to messages.
+ * @param what - what failed (used if there are no messages).
+ * @return NULL
+ */
+static PyObject *raiseMsgs(Msgs_t *mp, const char *what)
+{
+	/* Drop the last newline */
+	if ( mp->len && mp->text[mp->len - 1] == '\n' )
+		mp->text[--mp->len] = 0;
+	PyErr_SetString(RtError, mp->len ? mp->text : what);
+	return NULL;
+}
+
+/**
+ * Get ready to call librtpip: make sure the container is open and collect messages.
+ * @param self - pointer to container.
+ * @param mp - pointer to messages.
+ * @return 0 if ok, 1 if closed (exception set).
+ */
+static int callBegin(Container_t *self, Msgs_t *mp)
+{
+	if ( !self->hp )
+	{
+		PyErr_SetString(PyExc_ValueError, "container is closed");
+		return 1;
+	}
+	mp->text = NULL;
+	mp->len = 0;
+	PyThread_tss_set(&msgKey, mp);
+	++self->busy;
+	return 0;
+}
+
+/**
+ * Done calling librtpip.
+ * @param self - pointer to container.
+ * @param mp - pointer to messages.
+ * @return nothing
+ */
+static void callEnd(Container_t *self, Msgs_t *mp)
+{
+	--self->busy;
+	PyThread_tss_set(&msgKey, NULL);
+	free(mp->text);
+	mp->text = NULL;
+}
+
+static int Container_init(Container_t *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = { "path", "write", "floppy", NULL };
+	PyObject *pathObj;
+	Msgs_t msgs;
+	RtHandle_t *hp;
+	const char *path;
+	int write = 0, floppy = 0, flags;
+
+	if ( !PyArg_ParseTupleAndKeywords(args, kwds, "O&|pi", kwlist, PyUnicode_FSConverter, &pathObj, &write, &floppy) )
+		return -1;
+	if ( floppy < 0 || floppy > 2 )
+	{
+		Py_DECREF(pathObj);
+		PyErr_SetString(PyExc_ValueError, "floppy must be 0 (hard disk), 1 (RX01) or 2 (RX02)");
+		return -1;
+	}
+	if ( self->hp || self->busy )
+	{
+		Py_DECREF(pathObj);
+		PyErr_SetString(PyExc_ValueError, "container is already open");
+		return -1;
+	}
+	flags = (write ? RT_OPEN_WRITE : 0) | (floppy == 1 ? RT_OPEN_RX01 : 0) | (floppy == 2 ? RT_OPEN_RX02 : 0);
+	path = PyBytes_AS_STRING(pathObj);
+	msgs.text = NULL;
+	msgs.len = 0;
+	PyThread_tss_set(&msgKey, &msgs);
+	Py_BEGIN_ALLOW_THREADS
+	hp = rt_open(path, flags, report, NULL);
+	Py_END_ALLOW_THREADS
+	PyThread_tss_set(&msgKey, NULL);
+	Py_DECREF(pathObj);
+	if ( !hp )
+	{
+		raiseMsgs(&msgs, "unable to open container");
+		free(msgs.text);
+		return -1;
+	}
+	free(msgs.text);
+	self->hp = hp;
+	return 0;
+}
+
+static void Container_dealloc(Container_t *self)
+{
+	/* Nothing can be busy once the last reference is gone */
+	rt_close(self->hp);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Container_close(Container_t *self, PyObject *unused)
+{
+	if ( self->busy )
+	{
+		PyErr_SetString(PyExc_RuntimeError, "container is in use by another thread");
+		return NULL;
+	}
+	rt_close(self->hp);
+	self->hp = NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject *Container_enter(Container_t *self, PyObject *unused)
+{
+	Py_INCREF(self);
+	return (PyObject *)self;
+}
+
+static PyObject *Container_exit(Container_t *self, PyObject *args)
+{
+	PyObject *sts = Container_close(self, NULL);
+
+	if ( !sts )
+		return NULL;
+	Py_DECREF(sts);
+	Py_RETURN_FALSE;
+}
+
+/** Entries collected by listEnt() */
+typedef struct
+{
+	RtDirEnt_t *ents;           /**< Entries */
+	int num;                    /**< Number in ents */
+	int max;                    /**< Room in ents */
+} EntList_t;
+
+/**
+ * Save one directory entry (called by rt_list() without the GIL).
+ * @param user - pointer to EntList_t.
+ * @param ent - pointer to entry.
+ * @return 0 to keep going, 1 if out of memory.
+ */
+static int listEnt(void *user, const RtDirEnt_t *ent)
+{
+	EntList_t *lp = (EntList_t *)user;
+	RtDirEnt_t *nEnts;
+
+	if ( lp->num >= lp->max )
+	{
+		nEnts = (RtDirEnt_t *)realloc(lp->ents, (lp->max + 256) * sizeof(RtDirEnt_t));
+		if ( !nEnts )
+			return 1;
+		lp->ents = nEnts;
+		lp->max += 256;
+	}
+	lp->ents[lp->num++] = *ent;
+	return 0;
+}
+
+static PyObject *Container_iter(Container_t *self)
+{
+	PyObject *list, *item, *iter = NULL;
+	EntList_t el;
+	Msgs_t msgs;
+	int ii, sts;
+
+	if ( callBegin(self, &msgs) )
+		return NULL;
+	el.ents = NULL;
+	el.num = el.max = 0;
+	Py_BEGIN_ALLOW_THREADS
+	sts = rt_list(self->hp, listEnt, &el);
+	Py_END_ALLOW_THREADS
+	list = sts ? PyErr_NoMemory() : PyList_New(el.num);
+	for ( ii = 0; list && ii < el.num; ++ii )
+	{
+		item = PyStructSequence_New(&DirEntType);
+		if ( !item )
+		{
+			Py_CLEAR(list);
+			break;
+		}
+		PyStructSequence_SET_ITEM(item, 0, PyUnicode_FromString(el.ents[ii].name));
+		PyStructSequence_SET_ITEM(item, 1, PyLong_FromLong(el.ents[ii].blocks));
+		PyStructSequence_SET_ITEM(item, 2, PyLong_FromLong(el.ents[ii].date));
+		PyStructSequence_SET_ITEM(item, 3, PyLong_FromLong(el.ents[ii].lba));
+		PyStructSequence_SET_ITEM(item, 4, PyLong_FromLong(el.ents[ii].control));
+		if ( PyErr_Occurred() )
+		{
+			Py_DECREF(item);
+			Py_CLEAR(list);
+			break;
+		}
+		PyList_SET_ITEM(list, ii, item);
+	}
+	free(el.ents);
+	callEnd(self, &msgs);
+	if ( list )
+	{
+		iter = PyObject_GetIter(list);
+		Py_DECREF(list);
+	}
+	return iter;
+}
+
+static PyObject *Container_read(Container_t *self, PyObject *args)
+{
+	PyObject *data = NULL;
+	const char *name;
+	Msgs_t msgs;
+	long size, got = 0;
+
+	if ( !PyArg_ParseTuple(args, "s", &name) || callBegin(self, &msgs) )
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	size = rt_read(self->hp, name, NULL, 0);
+	Py_END_ALLOW_THREADS
+	while ( size >= 0 )
+	{
+		data = PyBytes_FromStringAndSize(NULL, size);
+		if ( !data )
+			break;
+		Py_BEGIN_ALLOW_THREADS
+		got = rt_read(self->hp, name, PyBytes_AS_STRING(data), size);
+		Py_END_ALLOW_THREADS
+		/* Got bigger while the GIL was let go, so try again */
+		if ( got <= size )
+			break;
+		Py_CLEAR(data);
+		size = got;
+	}
+	if ( data && got != size )
+	{
+		/* It shrank. Only the front of the buffer was used. */
+		if ( got < 0 )
+			Py_CLEAR(data);
+		else
+			_PyBytes_Resize(&data, got);
+	}
+	if ( !data && !PyErr_Occurred() )
+		raiseMsgs(&msgs, "read failed");
+	callEnd(self, &msgs);
+	return data;
+}
+
+static PyObject *Container_write(Container_t *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = { "name", "data", "date", NULL };
+	const char *name;
+	Py_buffer buf;
+	Msgs_t msgs;
+	int date = 0, sts;
+
+	if ( !PyArg_ParseTupleAndKeywords(args, kwds, "sy*|i", kwlist, &name, &buf, &date) )
+		return NULL;
+	if ( date < 0 || date > 0xFFFF )
+	{
+		PyBuffer_Release(&buf);
+		PyErr_SetString(PyExc_ValueError, "date must be an RT11 date word");
+		return NULL;
+	}
+	if ( callBegin(self, &msgs) )
+	{
+		PyBuffer_Release(&buf);
+		return NULL;
+	}
+	Py_BEGIN_ALLOW_THREADS
+	sts = rt_write(self->hp, name, buf.buf, buf.len, (unsigned short)date);
+	Py_END_ALLOW_THREADS
+	PyBuffer_Release(&buf);
+	if ( sts )
+		raiseMsgs(&msgs, "write failed");
+	callEnd(self, &msgs);
+	if ( sts )
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject *Container_delete(Container_t *self, PyObject *args)
+{
+	const char *name;
+	Msgs_t msgs;
+	int sts;
+
+	if ( !PyArg_ParseTuple(args, "s", &name) || callBegin(self, &msgs) )
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	sts = rt_delete(self->hp, name);
+	Py_END_ALLOW_THREADS
+	if ( sts )
+		raiseMsgs(&msgs, "delete failed");
+	callEnd(self, &msgs);
+	if ( sts )
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject *Container_squeeze(Container_t *self, PyObject *unused)
+{
+	Msgs_t msgs;
+	int sts;
+
+	if ( callBegin(self, &msgs) )
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	sts = rt_squeeze(self->hp);
+	Py_END_ALLOW_THREADS
+	if ( sts )
+		raiseMsgs(&msgs, "squeeze failed");
+	callEnd(self, &msgs);
+	if ( sts )
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+static PyMethodDef Container_methods[] = {
+	{ "read", (PyCFunction)Container_read, METH_VARARGS,
+	  "read(name) -> bytes\nRead a file (always a multiple of 512 bytes)." },
+	{ "write", (PyCFunction)(void (*)(void))Container_write, METH_VARARGS | METH_KEYWORDS,
+	  "write(name, data, date=0)\nWrite a file, replacing one of the same name. date is an RT11 date word (0 for 1-Jan-72)." },
+	{ "delete", (PyCFunction)Container_delete, METH_VARARGS,
+	  "delete(name)\nDelete a file." },
+	{ "squeeze", (PyCFunction)Container_squeeze, METH_NOARGS,
+	  "squeeze()\nSqueeze all the free space to the end. The old container is kept with .bak added to its name." },
+	{ "close", (PyCFunction)Container_close, METH_NOARGS,
+	  "close()\nClose the container." },
+	{ "__enter__", (PyCFunction)Container_enter, METH_NOARGS, NULL },
+	{ "__exit__", (PyCFunction)Container_exit, METH_VARARGS, NULL },
+	{ NULL, NULL, 0, NULL }
+};
+
+static PyTypeObject ContainerType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"rtpip.Container",
+};
+
+static PyModuleDef rtpipModule = {
+	PyModuleDef_HEAD_INIT,
+	"rtpip",
+	"Read and write RT11 container files (see librtpip.h).",
+	-1,
+	NULL
+};
+
+PyMODINIT_FUNC PyInit_rtpip(void)
+{
+	PyObject *mod;
+
+	if ( PyThread_tss_create(&msgKey) )
+		return NULL;
+	ContainerType.tp_basicsize = sizeof(Container_t);
+	ContainerType.tp_flags = Py_TPFLAGS_DEFAULT;
+	ContainerType.tp_doc = "Container(path, write=False, floppy=0)\n"
+		"An open RT11 container. floppy is 1 for an RX01 image (rtpip -f) or 2 for an RX02\n"
+		"image (rtpip -F). Iterating over it gives a DirEnt for each directory entry,\n"
+		"empty areas included, in the order they are on the disk.";
+	ContainerType.tp_new = PyType_GenericNew;
+	ContainerType.tp_init = (initproc)Container_init;
+	ContainerType.tp_dealloc = (destructor)Container_dealloc;
+	ContainerType.tp_iter = (getiterfunc)Container_iter;
+	ContainerType.tp_methods = Container_methods;
+	if ( PyType_Ready(&ContainerType) < 0 || PyStructSequence_InitType2(&DirEntType, &dirEntDesc) < 0 )
+		return NULL;
+	mod = PyModule_Create(&rtpipModule);
+	if ( !mod )
+		return NULL;
+	RtError = PyErr_NewException("rtpip.Error", NULL, NULL);
+	Py_INCREF(&ContainerType);
+	Py_INCREF(&DirEntType);
+	if (    !RtError
+		 || PyModule_AddObject(mod, "Error", RtError)
+		 || PyModule_AddObject(mod, "Container", (PyObject *)&ContainerType)
+		 || PyModule_AddObject(mod, "DirEnt", (PyObject *)&DirEntType)
+		 || PyModule_AddIntConstant(mod, "PERM", RT_PERM)
+		 || PyModule_AddIntConstant(mod, "EMPTY", RT_EMPTY)
+		 || PyModule_AddIntConstant(mod, "TENT", RT_TENT)
+		 || PyModule_AddIntConstant(mod, "PROTEK", RT_PROTEK) )
+	{
+		Py_DECREF(mod);
+		return NULL;
+	}
+	return mod;
+}
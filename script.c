@@ -0,0 +1,364 @@
+/*  $Id: script.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	script.c - Run a list of commands against one container.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MINGW
+	#define _POSIX_C_SOURCE 200112L
+#endif
+#include "rtpip.h"
+
+/**
+ * @file script.c
+ * Run a list of commands against one container (the script command). The container is
+ * opened and its directory parsed once. Each command works on the directory in memory,
+ * which is written once by main() after the last command, and only if every command
+ * worked.
+ *
+ * Each line of the script is a command with its options and filenames, just as they
+ * would follow the container on the command line (i.e. "in -a foo.mac bar.mac").
+ * Words are separated by spaces or tabs and can be quoted with " or '. A # at the
+ * start of a word starts a comment. None of the commands ask before doing something.
+ */
+
+/**
+ * Read a whole script into memory.
+ * @param options - pointer to options.
+ * @param name - path to script or "-" for stdin.
+ * @return pointer to null terminated contents (caller frees) or NULL on error.
+ */
+static char *readScript(Options_t *options, const char *name)
+{
+	FILE *inp;
+	char *buf, *nBuf;
+	size_t len = 0, bufSize = 4096, got;
+
+	if ( !strcmp(name, "-") )
+		inp = stdin;
+	else
+		inp = fopen(name, "r");
+	if ( !inp )
+	{
+		msgErr(options, "Unable to open script '%s': %s\n", name, strerror(errno));
+		return NULL;
+	}
+	buf = (char *)malloc(bufSize);
+	while ( buf )
+	{
+		got = fread(buf + len, 1, bufSize - len - 1, inp);
+		len += got;
+		if ( len < bufSize - 1 )
+			break;
+		bufSize *= 2;
+		nBuf = (char *)realloc(buf, bufSize);
+		if ( !nBuf )
+			free(buf);
+		buf = nBuf;
+	}
+	if ( !buf )
+		msgErr(options, "Ran out of memory reading script '%s'\n", name);
+	else if ( ferror(inp) )
+	{
+		msgErr(options, "Error reading script '%s': %s\n", name, strerror(errno));
+		free(buf);
+		buf = NULL;
+	}
+	else
+		buf[len] = 0;
+	if ( inp != stdin )
+		fclose(inp);
+	return buf;
+}
+
+/**
+ * Split a line into words in place.
+ * @param line - pointer to null terminated line. Gets changed.
+ * @param argvp - pointer to argument array (grown as needed). argv[0] is left as the
+ * name of the script command so the result can be handed to getScriptCmd().
+ * @param maxp - pointer to number of items in *argvp.
+ * @return number of words, -1 if a quote isn't closed or -2 if out of memory.
+ */
+static int splitLine(char *line, char ***argvp, int *maxp)
+{
+	char *src = line, *dst, quote;
+	int argc = 0;
+
+	while ( 1 )
+	{
+		while ( *src == ' ' || *src == '\t' || *src == '\r' )
+			++src;
+		if ( !*src || *src == '#' )
+			break;
+		/* Leave room for argv[0] and the NULL at the end */
+		if ( argc + 2 >= *maxp )
+		{
+			char **nArgv;
+
+			nArgv = (char **)realloc(*argvp, (*maxp + 32) * sizeof(char *));
+			if ( !nArgv )
+				return -2;
+			*argvp = nArgv;
+			*maxp += 32;
+		}
+		(*argvp)[++argc] = dst = src;
+		quote = 0;
+		for (; *src; ++src )
+		{
+			if ( quote )
+			{
+				if ( *src == quote )
+					quote = 0;
+				else
+					*dst++ = *src;
+				continue;
+			}
+			if ( *src == '"' || *src == '\'' )
+			{
+				quote = *src;
+				continue;
+			}
+			if ( *src == ' ' || *src == '\t' || *src == '\r' )
+				break;
+			*dst++ = *src;
+		}
+		if ( quote )
+			return -1;
+		if ( *src )
+			++src;
+		*dst = 0;
+	}
+	(*argvp)[0] = "script";
+	(*argvp)[argc + 1] = NULL;
+	return argc;
+}
+
+/**
+ * Get the first word of a line.
+ * @param line - pointer to line.
+ * @param lenp - pointer to place to put length of word.
+ * @return pointer to word or NULL if line is blank or a comment.
+ */
+static const char *firstWord(const char *line, int *lenp)
+{
+	const char *end;
+
+	while ( *line == ' ' || *line == '\t' || *line == '\r' )
+		++line;
+	if ( !*line || *line == '#' )
+		return NULL;
+	for ( end = line; *end && *end != ' ' && *end != '\t' && *end != '\r'; ++end )
+		;
+	*lenp = end - line;
+	return line;
+}
+
+/**
+ * Put back the options the last command changed so the next one starts clean.
+ * @param options - pointer to options.
+ * @param verbose - verbose level from the command line.
+ * @return nothing
+ */
+static void resetCmd(Options_t *options, int verbose)
+{
+	/* Has to come first since it uses numArgFiles */
+	freeFilters(options);
+	options->cmd = NULL;
+	options->argFiles = NULL;
+	options->numArgFiles = 0;
+	options->cmdState = CMDSTATE_CMD;
+	options->todo = 0;
+	options->lsOpts = 0;
+	options->outOpts = 0;
+	options->inOpts = 0;
+	options->delOpts = 0;
+	options->sqzOpts = 0;
+	options->fileOpts = 0;
+	options->sortby = 0;
+	options->numSortKeys = 0;
+	options->columns = 0;
+	options->inDate = 0;
+	options->outDir = NULL;
+	options->tarFile = NULL;
+	options->newMaxSeg = 0;
+	options->verbose = verbose;
+	options->iHandle.totIns = 0;
+	options->iHandle.totUsed = 0;
+}
+
+/**
+ * Check whether the options asked for help (or were wrong, which also asks for help).
+ * @param options - pointer to options.
+ * @return non-zero if help was asked for.
+ */
+static int wantsHelp(Options_t *options)
+{
+	return (options->lsOpts & LSOPTS_HELP) || (options->outOpts & OUTOPTS_HELP)
+		|| (options->inOpts & INOPTS_HELP) || (options->delOpts & DELOPTS_HELP)
+		|| (options->sqzOpts & SQZOPTS_HELP);
+}
+
+/**
+ * Get the current directory so it can be put back after out --outdir.
+ * @return pointer to path (caller frees) or NULL on error.
+ */
+static char *saveCwd(void)
+{
+	char *buf = NULL, *nBuf;
+	size_t size = 256;
+
+	while ( 1 )
+	{
+		nBuf = (char *)realloc(buf, size);
+		if ( !nBuf )
+			break;
+		buf = nBuf;
+		if ( getcwd(buf, size) )
+			return buf;
+		if ( errno != ERANGE )
+			break;
+		size *= 2;
+	}
+	free(buf);
+	return NULL;
+}
+
+/**
+ * Run the commands in options->scriptFile against the container, writing the
+ * directory once at the end and only if all of them worked.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure (nothing will have been written).
+ */
+int do_script(Options_t *options)
+{
+	char *text, *textEnd, *line, *next, **argv = NULL, *cwd = NULL;
+	const char *word;
+	int argc, maxArgs = 0, lineNo, sqzLine = 0, len, verbose, sts = 0, errs, ii;
+
+	text = readScript(options, options->scriptFile);
+	if ( !text )
+		return 1;
+	textEnd = text + strlen(text);
+	/* Check the commands before doing any of them. sqz writes a whole new container,
+	 * so it can only be the last thing done. */
+	for ( lineNo = 1, line = text; line; ++lineNo, line = next )
+	{
+		next = strchr(line, '\n');
+		if ( next )
+			*next++ = 0;
+		word = firstWord(line, &len);
+		if ( !word )
+			continue;
+		if ( sqzLine )
+		{
+			msgErr(options, "Line %d of '%s': nothing can follow the sqz on line %d\n",
+				   lineNo, options->scriptFile, sqzLine);
+			free(text);
+			return 1;
+		}
+		if ( len == 3 && !strncmp(word, "sqz", 3) )
+			sqzLine = lineNo;
+	}
+	/* Floppy images are changed in memory so there the space can be used right away */
+	if ( !(options->cmdOpts & (CMDOPT_SINGLE_FLPY | CMDOPT_DOUBLE_FLPY)) )
+		options->holdFreed = 1;
+	verbose = options->verbose;
+	for ( lineNo = 1, line = text; !sts && line <= textEnd; ++lineNo, line = next )
+	{
+		/* The check above left each line null terminated */
+		next = line + strlen(line) + 1;
+		if ( !firstWord(line, &len) )
+			continue;
+		resetCmd(options, verbose);
+		argc = splitLine(line, &argv, &maxArgs);
+		if ( argc < 0 )
+		{
+			msgErr(options, "Line %d of '%s': %s\n", lineNo, options->scriptFile,
+				   argc == -1 ? "missing closing quote" : "ran out of memory");
+			sts = 1;
+			break;
+		}
+		if ( (options->scriptOpts & SCRIPTOPTS_VERB) )
+		{
+			printf("%d:", lineNo);
+			for ( ii = 1; ii <= argc; ++ii )
+				printf(" %s", argv[ii]);
+			printf("\n");
+		}
+		if ( getScriptCmd(options, argc + 1, argv) || wantsHelp(options) )
+		{
+			msgErr(options, "Line %d of '%s': bad command or options (see rtpip x %s -h)\n",
+				   lineNo, options->scriptFile, argv[1]);
+			sts = 1;
+			break;
+		}
+		options->inOpts |= INOPTS_NOASK;
+		options->outOpts |= OUTOPTS_NOASK;
+		options->delOpts |= DELOPTS_NOASK;
+		options->sqzOpts |= SQZOPTS_NOASK;
+		/* Make whatever the last command wrote visible to this one */
+		if ( options->inp )
+			fflush(options->inp);
+		relinkDirectory(options);
+		errs = options->numErrors;
+		if ( (options->todo & TODO_LIST) )
+		{
+			sts = do_directory(options);
+		}
+		else if ( (options->todo & TODO_OUT) )
+		{
+			if ( options->outDir && !cwd && !(cwd = saveCwd()) )
+			{
+				msgErr(options, "Unable to get current directory: %s\n", strerror(errno));
+				sts = 1;
+				break;
+			}
+			sts = do_out(options);
+			if ( cwd && chdir(cwd) )
+			{
+				msgErr(options, "Unable to chdir() back to '%s': %s\n", cwd, strerror(errno));
+				sts = 1;
+			}
+		}
+		else if ( (options->todo & TODO_INP) )
+		{
+			sts = do_in(options);
+		}
+		else if ( (options->todo & TODO_DEL) )
+		{
+			sts = do_del(options);
+		}
+		else if ( (options->todo & TODO_SQZ) )
+		{
+			/* The new container has everything in it, so the old directory mustn't be written */
+			sts = do_sqz(options);
+			options->dirDirty = 0;
+		}
+		/* Commands carry on past a file they can't do, but a script stops */
+		if ( options->numErrors != errs )
+			sts = 1;
+		if ( sts )
+			msgErr(options, "Script stopped at line %d of '%s'. The directory of '%s' was not changed.\n",
+				   lineNo, options->scriptFile, options->container);
+	}
+	resetCmd(options, verbose);
+	options->todo = TODO_SCRIPT;
+	free(argv);
+	free(cwd);
+	free(text);
+	return sts;
+}
@@ -0,0 +1,165 @@
+/*  $Id: sha256.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $
+
+	sha256.c - SHA-256 (FIPS 180-4).
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtpip.h"
+
+/**
+ * @file sha256.c
+ * SHA-256 (FIPS 180-4). Used by manifest. Nothing is shared between
+ * contexts so any number of threads can each be doing one.
+ */
+
+static const U32 K[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROR(x, n)   (((x) >> (n)) | ((x) << (32 - (n))))
+
+/**
+ * Hash one 64 byte block.
+ * @param ctx - pointer to context.
+ * @param blk - pointer to block.
+ * @return nothing
+ */
+static void sha256Block(Sha256_t *ctx, const U8 *blk)
+{
+	U32 w[64], a, b, c, d, e, f, g, h, t1, t2;
+	int ii;
+
+	for ( ii = 0; ii < 16; ++ii, blk += 4 )
+		w[ii] = ((U32)blk[0] << 24) | ((U32)blk[1] << 16) | ((U32)blk[2] << 8) | blk[3];
+	for ( ; ii < 64; ++ii )
+	{
+		t1 = ROR(w[ii - 2], 17) ^ ROR(w[ii - 2], 19) ^ (w[ii - 2] >> 10);
+		t2 = ROR(w[ii - 15], 7) ^ ROR(w[ii - 15], 18) ^ (w[ii - 15] >> 3);
+		w[ii] = t1 + w[ii - 7] + t2 + w[ii - 16];
+	}
+	a = ctx->state[0];
+	b = ctx->state[1];
+	c = ctx->state[2];
+	d = ctx->state[3];
+	e = ctx->state[4];
+	f = ctx->state[5];
+	g = ctx->state[6];
+	h = ctx->state[7];
+	for ( ii = 0; ii < 64; ++ii )
+	{
+		t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) + K[ii] + w[ii];
+		t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	ctx->state[0] += a;
+	ctx->state[1] += b;
+	ctx->state[2] += c;
+	ctx->state[3] += d;
+	ctx->state[4] += e;
+	ctx->state[5] += f;
+	ctx->state[6] += g;
+	ctx->state[7] += h;
+}
+
+void sha256Init(Sha256_t *ctx)
+{
+	ctx->state[0] = 0x6a09e667;
+	ctx->state[1] = 0xbb67ae85;
+	ctx->state[2] = 0x3c6ef372;
+	ctx->state[3] = 0xa54ff53a;
+	ctx->state[4] = 0x510e527f;
+	ctx->state[5] = 0x9b05688c;
+	ctx->state[6] = 0x1f83d9ab;
+	ctx->state[7] = 0x5be0cd19;
+	ctx->lenLo = ctx->lenHi = 0;
+	ctx->used = 0;
+}
+
+void sha256Update(Sha256_t *ctx, const void *data, size_t len)
+{
+	const U8 *src = (const U8 *)data;
+	U32 lo;
+
+	/* Keep a 64 bit count of bytes in two halves */
+	lo = ctx->lenLo + (U32)len;
+	if ( lo < ctx->lenLo )
+		++ctx->lenHi;
+	ctx->lenLo = lo;
+	if ( ctx->used )
+	{
+		size_t take = 64 - ctx->used;
+
+		if ( take > len )
+			take = len;
+		memcpy(ctx->buf + ctx->used, src, take);
+		ctx->used += take;
+		src += take;
+		len -= take;
+		if ( ctx->used < 64 )
+			return;
+		sha256Block(ctx, ctx->buf);
+		ctx->used = 0;
+	}
+	for ( ; len >= 64; len -= 64, src += 64 )
+		sha256Block(ctx, src);
+	if ( len )
+	{
+		memcpy(ctx->buf, src, len);
+		ctx->used = len;
+	}
+}
+
+void sha256Final(Sha256_t *ctx, U8 digest[32])
+{
+	U32 hi, lo;
+	int ii;
+
+	/* Length in bits */
+	hi = (ctx->lenHi << 3) | (ctx->lenLo >> 29);
+	lo = ctx->lenLo << 3;
+	ctx->buf[ctx->used++] = 0x80;
+	if ( ctx->used > 56 )
+	{
+		memset(ctx->buf + ctx->used, 0, 64 - ctx->used);
+		sha256Block(ctx, ctx->buf);
+		ctx->used = 0;
+	}
+	memset(ctx->buf + ctx->used, 0, 56 - ctx->used);
+	for ( ii = 0; ii < 4; ++ii )
+	{
+		ctx->buf[56 + ii] = (U8)(hi >> (24 - 8 * ii));
+		ctx->buf[60 + ii] = (U8)(lo >> (24 - 8 * ii));
+	}
+	sha256Block(ctx, ctx->buf);
+	for ( ii = 0; ii < 32; ++ii )
+		digest[ii] = (U8)(ctx->state[ii >> 2] >> (24 - 8 * (ii & 3)));
+}
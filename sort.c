@@ -346,6 +346,212 @@ int (*cmpFuncs[8])(const void *a1, const void *a2) =
   cmpSize_r
 };
 
+/*
+ * Note: sortDirectory() doesn't use the compare functions above. Each entry
+ * instead gets a composite key, built once, made of 16 bit fields in order of
+ * importance. The entries are then put in order with a stable LSD radix sort
+ * one byte at a time. A descending field just has its bits inverted and any
+ * byte that is the same in every key is skipped. The empty entries are split
+ * off first and sorted by size alone, the same as the compare functions do.
+ */
+
+#define SORT_FLD_NAME0 (0)      /* First 3 characters of filename */
+#define SORT_FLD_NAME1 (1)      /* Last 3 characters of filename */
+#define SORT_FLD_TYPE  (2)      /* Filetype */
+#define SORT_FLD_DATE  (3)      /* Date (as from dateKey()) */
+#define SORT_FLD_SIZE  (4)      /* Size in blocks */
+#define SORT_MAX_FLDS  (5)
+
+typedef struct
+{
+    U64 key[2];                 /* Fields packed most important first */
+    InWorkingDir_t *wdp;        /* Entry this key belongs to */
+} SortItem_t;
+
+/**
+ * Stable LSD radix sort on composite keys.
+ * @param src - pointer to array of items to sort.
+ * @param dst - pointer to scratch array of the same size.
+ * @param num - number of items.
+ * @param numWords - number of words in key to sort on (1 or 2).
+ * @return pointer to whichever of src or dst has the sorted result.
+ */
+static SortItem_t *radixSort(SortItem_t *src, SortItem_t *dst, int num, int numWords)
+{
+    unsigned int counts[2*8][256], *cnt, sum, cc;
+    int ii, word, byte, shift;
+    SortItem_t *tmp;
+    U64 key;
+
+    if ( num < 2 )
+        return src;
+    memset(counts, 0, sizeof(counts));
+    for (ii=0; ii < num; ++ii)
+    {
+        for (word=0; word < numWords; ++word)
+        {
+            key = src[ii].key[word];
+            for (byte=0; byte < 8; ++byte, key >>= 8)
+                ++counts[word*8+byte][key & 0xFF];
+        }
+    }
+    for (word=numWords-1; word >= 0; --word)
+    {
+        for (byte=0; byte < 8; ++byte)
+        {
+            cnt = counts[word*8+byte];
+            shift = byte*8;
+            /* Nothing to do if every key has the same value here */
+            if ( cnt[(src[0].key[word] >> shift) & 0xFF] == (unsigned int)num )
+                continue;
+            for (sum=0, ii=0; ii < 256; ++ii)
+            {
+                cc = cnt[ii];
+                cnt[ii] = sum;
+                sum += cc;
+            }
+            for (ii=0; ii < num; ++ii)
+                dst[cnt[(src[ii].key[word] >> shift) & 0xFF]++] = src[ii];
+            tmp = src;
+            src = dst;
+            dst = tmp;
+        }
+    }
+    return src;
+}
+
+/**
+ * Sort the linear directory array according to the sort options.
+ * @param options - pointer to options.
+ * @return 0 on success, 1 on error. Error message will have been displayed.
+ */
+int sortDirectory(Options_t *options)
+{
+    U8 flds[SORT_MAX_FLDS], keys[4];
+    int ii, jj, kk, numFlds, numKeys, numPerm, numEmpty, rev, used;
+    unsigned short inv[SORT_MAX_FLDS], val;
+    SortItem_t *items, *sorted, *ip;
+    InWorkingDir_t *wdp;
+
+    if ( options->numWdirs < 2 )
+        return 0;
+    /* Turn the sort keys into a list of fields */
+    numKeys = options->numSortKeys;
+    memcpy(keys, options->sortKeys, numKeys);
+    if ( !numKeys )
+        keys[numKeys++] = SORTBY_NAME;
+    rev = (options->sortby & SORTBY_REV) ? SORTBY_REV : 0;
+    numFlds = 0;
+    used = 0;
+    for (ii=0; ii < numKeys; ++ii)
+    {
+        int fld[3], nf = 1;
+
+        switch (keys[ii] & ~SORTBY_REV)
+        {
+        case SORTBY_NAME:
+            fld[0] = SORT_FLD_NAME0;
+            fld[1] = SORT_FLD_NAME1;
+            fld[2] = SORT_FLD_TYPE;
+            nf = 3;
+            break;
+        case SORTBY_TYPE:
+            fld[0] = SORT_FLD_TYPE;
+            break;
+        case SORTBY_DATE:
+            fld[0] = SORT_FLD_DATE;
+            break;
+        case SORTBY_SIZE:
+        default:
+            fld[0] = SORT_FLD_SIZE;
+            break;
+        }
+        for (jj=0; jj < nf; ++jj)
+        {
+            if ( (used & (1 << fld[jj])) )
+                continue;
+            used |= 1 << fld[jj];
+            inv[numFlds] = ((keys[ii] ^ rev) & SORTBY_REV) ? 0xFFFF : 0;
+            flds[numFlds++] = fld[jj];
+        }
+    }
+    /* Ties are always broken by the full filename */
+    for (ii=SORT_FLD_NAME0; ii <= SORT_FLD_TYPE; ++ii)
+    {
+        if ( !(used & (1 << ii)) )
+        {
+            inv[numFlds] = rev ? 0xFFFF : 0;
+            flds[numFlds++] = ii;
+        }
+    }
+    items = (SortItem_t *)malloc(2 * options->numWdirs * sizeof(SortItem_t));
+    if ( !items )
+    {
+        msgErr(options, "Ran out of memory malloc()ing %d bytes for sort\n",
+                (int)(2 * options->numWdirs * sizeof(SortItem_t)));
+        return 1;
+    }
+    /* Files go at the front of the list and empties at the back */
+    for (numPerm=0, ii=0; ii < options->numWdirs; ++ii)
+    {
+        if ( (options->linArray[ii]->rt11.control & PERM) )
+            ++numPerm;
+    }
+    numEmpty = 0;
+    for (ii=0, jj=0; ii < options->numWdirs; ++ii)
+    {
+        wdp = options->linArray[ii];
+        if ( !(wdp->rt11.control & PERM) )
+        {
+            ip = items + numPerm + numEmpty++;
+            ip->key[0] = (U64)wdp->rt11.blocks << 48;
+            ip->key[1] = 0;
+            ip->wdp = wdp;
+            continue;
+        }
+        ip = items + jj++;
+        ip->key[0] = 0;
+        ip->key[1] = 0;
+        ip->wdp = wdp;
+        for (kk=0; kk < numFlds; ++kk)
+        {
+            switch (flds[kk])
+            {
+            case SORT_FLD_NAME0:
+                val = wdp->rt11.name[0];
+                break;
+            case SORT_FLD_NAME1:
+                val = wdp->rt11.name[1];
+                break;
+            case SORT_FLD_TYPE:
+                val = wdp->rt11.name[2];
+                break;
+            case SORT_FLD_DATE:
+                val = dateKey(wdp->rt11.date);
+                break;
+            case SORT_FLD_SIZE:
+            default:
+                val = wdp->rt11.blocks;
+                break;
+            }
+            ip->key[kk >> 2] |= (U64)(unsigned short)(val ^ inv[kk]) << ((3 - (kk & 3)) * 16);
+        }
+    }
+    if ( (options->cmdOpts & CMDOPT_DBG_NORMAL) )
+    {
+        printf("sortDirectory: %d keys, %d fields, %d files, %d empties\n",
+               numKeys, numFlds, numPerm, numEmpty);
+    }
+    sorted = radixSort(items, items + options->numWdirs, numPerm, (numFlds + 3) >> 2);
+    for (ii=0; ii < numPerm; ++ii)
+        options->linArray[ii] = sorted[ii].wdp;
+    sorted = radixSort(items + numPerm, items + options->numWdirs + numPerm, numEmpty, 1);
+    for (ii=0; ii < numEmpty; ++ii)
+        options->linArray[numPerm + ii] = sorted[ii].wdp;
+    free(items);
+    return 0;
+}
+
 /**
  * Compare filename against a filter.
  * @param filter - pointer to filter filename.
@@ -386,42 +592,5 @@ int normexec(const char *filter, const char *name )
     return 0;
 }
 
-/**
- * Filter filenames based on input from command line.
- * @param options - pointer to options
- * @param name - pointer to null terminated filename to check.
- * @return 1 if to handle file; 0 if to ignore file.
- */
-int filterFilename( Options_t *options, const char *name )
-{
-    int ii, jj;
-    if ( !options->numArgFiles )
-        return 1;
-    for (ii=0; ii < options->numArgFiles; ++ii)
-    {
-#if !NO_REGEXP
-        if ( (options->fileOpts&FILEOPTS_REGEXP) )
-        {
-            jj = regexec(options->rexts + ii, name, 0, NULL, 0);
-#if 0
-            printf("filterFilename(): Checked file: '%s' against regular expression '%s'. Returned %s\n",
-                name, options->argFiles[ii], jj ? "NOMATCH":"MATCH" );
-#endif
-        }
-        else
-#endif
-        {
-            jj = normexec(options->normExprs + ii*10, name);
-#if 0
-            printf("filterFilename(): Checked file: '%s' against normal expression '%s'. Returned %s\n",
-                   name, options->normExprs+(ii*10), jj ? "NOMATCH":"MATCH");
-#endif
-        }
-        if ( !jj )
-            return 1;
-    }
-    return 0;
-}
-
 
 
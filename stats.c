@@ -0,0 +1,362 @@
+/*  $Id: stats.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	stats.c - Timing and I/O statistics gathered with --stats.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MINGW
+	#define _POSIX_C_SOURCE 200112L
+#endif
+#include "rtpip.h"
+#ifndef MINGW
+	#include <sys/resource.h>
+#endif
+
+/**
+ * @file stats.c
+ * Timing and I/O statistics gathered with --stats.
+ */
+
+/*
+ * Note: Everything here is a no-op unless --stats or --trace was on the
+ * command line (options->stats is NULL otherwise), so the cost when it is off
+ * is a call and a compare. When it is on, a phase costs two reads each of the
+ * wall and cpu clocks and an I/O call costs a few adds. With --trace each
+ * phase is also written as a span. Phases may nest (e.g. "copy" happens
+ * inside "command"), each one counts its own total.
+ */
+
+/** Defines the time spent in one phase */
+typedef struct
+{
+	U64 wallNs;             /**< Total wall time in nanoseconds */
+	U64 cpuNs;              /**< Total cpu time in nanoseconds */
+	U64 wallStart;          /**< Wall time at statBegin() */
+	U64 cpuStart;           /**< Cpu time at statBegin() */
+	int calls;              /**< Number of times phase completed */
+	int depth;              /**< Number of statBegin()'s not yet ended */
+} StatPhase_t;
+
+/** Defines the I/O done to one kind of file */
+typedef struct
+{
+	U64 reads;              /**< Number of reads */
+	U64 readBytes;          /**< Number of bytes read */
+	U64 writes;             /**< Number of writes */
+	U64 writeBytes;         /**< Number of bytes written */
+	U64 seeks;              /**< Number of seeks */
+	int files;              /**< Number of files opened */
+} StatIo_t;
+
+struct Stats
+{
+	int format;                     /**< How to show report (STAT_FMT_xxx) */
+	StatPhase_t phase[STAT_PH_MAX]; /**< Time spent in each phase */
+	StatIo_t io[STAT_IO_MAX];       /**< I/O done to containers and host files */
+};
+
+static const char *const PhaseNames[STAT_PH_MAX] =
+{
+	"total",
+	"checkHeader",
+	"parse_directory",
+	"descramble",
+	"command",
+	"host_in",
+	"host_out",
+	"copy",
+	"writeNewDir"
+};
+
+static const char *const IoNames[STAT_IO_MAX] =
+{
+	"container",
+	"host"
+};
+
+/**
+ * Get the current wall and cpu times.
+ * @param wall - pointer to place to put monotonic wall time in nanoseconds.
+ * @param cpu - pointer to place to put process cpu time in nanoseconds.
+ * @return nothing
+ */
+static void getTimes(U64 *wall, U64 *cpu)
+{
+#ifndef MINGW
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	*wall = (U64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	*cpu = (U64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+	*wall = *cpu = (U64)clock() * (1000000000ULL / CLOCKS_PER_SEC);
+#endif
+}
+
+/**
+ * Turn on statistics gathering.
+ * @param options - pointer to options.
+ * @param format - one of STAT_FMT_xxx. If called more than once, the highest is used.
+ * @return 0 on success, 1 if out of memory.
+ */
+int statInit(Options_t *options, int format)
+{
+	if ( !options->stats )
+	{
+		options->stats = (Stats_t *)calloc(1, sizeof(Stats_t));
+		if ( !options->stats )
+		{
+			fprintf(stderr, "Ran out of memory allocating %d bytes for stats\n", (int)sizeof(Stats_t));
+			return 1;
+		}
+		statBegin(options, STAT_PH_TOTAL);
+	}
+	if ( format > options->stats->format )
+		options->stats->format = format;
+	return 0;
+}
+
+/**
+ * Mark the start of a phase.
+ * @param options - pointer to options.
+ * @param phase - one of STAT_PH_xxx
+ * @return nothing
+ */
+void statBegin(Options_t *options, int phase)
+{
+	StatPhase_t *pp;
+
+	if ( !options->stats )
+		return;
+	pp = options->stats->phase + phase;
+	/* Only the outermost of recursive begins counts */
+	if ( pp->depth++ )
+		return;
+	getTimes(&pp->wallStart, &pp->cpuStart);
+}
+
+/**
+ * Mark the end of a phase.
+ * @param options - pointer to options.
+ * @param phase - one of STAT_PH_xxx
+ * @return nothing
+ */
+void statEnd(Options_t *options, int phase)
+{
+	StatPhase_t *pp;
+	U64 wall, cpu;
+
+	if ( !options->stats )
+		return;
+	pp = options->stats->phase + phase;
+	if ( !pp->depth || --pp->depth )
+		return;
+	getTimes(&wall, &cpu);
+	pp->wallNs += wall - pp->wallStart;
+	pp->cpuNs += cpu - pp->cpuStart;
+	++pp->calls;
+#if RTPIP_TRACE
+	tracePhase(options, PhaseNames[phase], pp->wallStart, wall);
+#endif
+}
+
+/**
+ * Open a file and count it.
+ * @param options - pointer to options.
+ * @param io - STAT_IO_CONT if file is a container, STAT_IO_HOST otherwise.
+ * @param name - filename.
+ * @param mode - fopen() mode.
+ * @return same as fopen().
+ */
+FILE *statFopen(Options_t *options, int io, const char *name, const char *mode)
+{
+	FILE *fp;
+
+	fp = fopen(name, mode);
+	if ( fp && options->stats )
+		++options->stats->io[io].files;
+	return fp;
+}
+
+/**
+ * Read from a file and count it.
+ * @param options - pointer to options.
+ * @param io - STAT_IO_CONT or STAT_IO_HOST.
+ * @param buf, size, nmemb, fp - same as fread().
+ * @return same as fread().
+ */
+size_t statFread(Options_t *options, int io, void *buf, size_t size, size_t nmemb, FILE *fp)
+{
+	size_t retv;
+
+	retv = fread(buf, size, nmemb, fp);
+	if ( options->stats )
+	{
+		++options->stats->io[io].reads;
+		options->stats->io[io].readBytes += retv * size;
+	}
+	return retv;
+}
+
+/**
+ * Write to a file and count it.
+ * @param options - pointer to options.
+ * @param io - STAT_IO_CONT or STAT_IO_HOST.
+ * @param buf, size, nmemb, fp - same as fwrite().
+ * @return same as fwrite().
+ */
+size_t statFwrite(Options_t *options, int io, const void *buf, size_t size, size_t nmemb, FILE *fp)
+{
+	size_t retv;
+
+	retv = fwrite(buf, size, nmemb, fp);
+	if ( options->stats )
+	{
+		++options->stats->io[io].writes;
+		options->stats->io[io].writeBytes += retv * size;
+	}
+	return retv;
+}
+
+/**
+ * Count I/O done some other way than with statFread() or statFwrite().
+ * @param options - pointer to options.
+ * @param io - STAT_IO_CONT or STAT_IO_HOST.
+ * @param isWrite - non-zero if bytes were written, 0 if read.
+ * @param bytes - number of bytes.
+ * @return nothing
+ */
+void statCount(Options_t *options, int io, int isWrite, long bytes)
+{
+	if ( options->stats )
+	{
+		if ( isWrite )
+		{
+			++options->stats->io[io].writes;
+			options->stats->io[io].writeBytes += bytes;
+		}
+		else
+		{
+			++options->stats->io[io].reads;
+			options->stats->io[io].readBytes += bytes;
+		}
+	}
+}
+
+/**
+ * Seek a file and count it.
+ * @param options - pointer to options.
+ * @param io - STAT_IO_CONT or STAT_IO_HOST.
+ * @param fp, offset, whence - same as fseek().
+ * @return same as fseek().
+ */
+int statFseek(Options_t *options, int io, FILE *fp, long offset, int whence)
+{
+	if ( options->stats )
+		++options->stats->io[io].seeks;
+	return fseek(fp, offset, whence);
+}
+
+/**
+ * Get the peak memory used by this process.
+ * @return peak resident set size in kilobytes (0 if not known).
+ */
+static long peakMemory(void)
+{
+#ifndef MINGW
+	struct rusage ru;
+
+	if ( !getrusage(RUSAGE_SELF, &ru) )
+		return ru.ru_maxrss;
+#endif
+	return 0;
+}
+
+/**
+ * Display the statistics on stderr and free them. Also finishes the trace file.
+ * @param options - pointer to options.
+ * @return nothing
+ */
+void statReport(Options_t *options)
+{
+	Stats_t *sp = options->stats;
+	StatPhase_t *pp;
+	StatIo_t *ip;
+	int ii;
+	const char *sep;
+
+	if ( !sp )
+		return;
+	/* Close anything left open by an early exit */
+	for ( ii = 0; ii < STAT_PH_MAX; ++ii )
+	{
+		if ( sp->phase[ii].depth )
+		{
+			sp->phase[ii].depth = 1;
+			statEnd(options, ii);
+		}
+	}
+#if RTPIP_TRACE
+	traceClose(options);
+#endif
+	if ( sp->format == STAT_FMT_JSON )
+	{
+		fprintf(stderr, "{\"phases\":{");
+		for ( sep = "", ii = 0; ii < STAT_PH_MAX; ++ii )
+		{
+			pp = sp->phase + ii;
+			if ( !pp->calls )
+				continue;
+			fprintf(stderr, "%s\"%s\":{\"calls\":%d,\"wall_us\":%llu,\"cpu_us\":%llu}",
+					sep, PhaseNames[ii], pp->calls, pp->wallNs / 1000, pp->cpuNs / 1000);
+			sep = ",";
+		}
+		fprintf(stderr, "},\"io\":{");
+		for ( sep = "", ii = 0; ii < STAT_IO_MAX; ++ii )
+		{
+			ip = sp->io + ii;
+			fprintf(stderr, "%s\"%s\":{\"files\":%d,\"reads\":%llu,\"read_bytes\":%llu,\"writes\":%llu,\"write_bytes\":%llu,\"seeks\":%llu}",
+					sep, IoNames[ii], ip->files, ip->reads, ip->readBytes, ip->writes, ip->writeBytes, ip->seeks);
+			sep = ",";
+		}
+		fprintf(stderr, "},\"peak_rss_kb\":%ld}\n", peakMemory());
+	}
+	else if ( sp->format == STAT_FMT_TEXT )
+	{
+		fprintf(stderr, "%-16s %6s %12s %12s\n", "Phase", "Calls", "Wall ms", "CPU ms");
+		for ( ii = 0; ii < STAT_PH_MAX; ++ii )
+		{
+			pp = sp->phase + ii;
+			if ( !pp->calls )
+				continue;
+			fprintf(stderr, "%-16s %6d %12.3f %12.3f\n",
+					PhaseNames[ii], pp->calls, pp->wallNs / 1e6, pp->cpuNs / 1e6);
+		}
+		fprintf(stderr, "%-10s %6s %8s %12s %8s %12s %8s\n",
+				"I/O", "Files", "Reads", "Bytes read", "Writes", "Bytes wrtn", "Seeks");
+		for ( ii = 0; ii < STAT_IO_MAX; ++ii )
+		{
+			ip = sp->io + ii;
+			fprintf(stderr, "%-10s %6d %8llu %12llu %8llu %12llu %8llu\n",
+					IoNames[ii], ip->files, ip->reads, ip->readBytes, ip->writes, ip->writeBytes, ip->seeks);
+		}
+		fprintf(stderr, "Peak memory: %ld KB\n", peakMemory());
+	}
+	free(sp);
+	options->stats = NULL;
+}
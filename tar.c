@@ -0,0 +1,572 @@
+/*  $Id: tar.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $
+
+	tar.c - Copy files out of or into a container as a ustar archive.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtpip.h"
+#ifdef MINGW
+	#include <fcntl.h>
+	#include <io.h>
+#endif
+
+/**
+ * @file tar.c
+ * Copy files out of or into a container as a ustar archive. Called by do_out() and do_in()
+ * for out --tar and in --tar.
+ */
+
+/*
+ * Note: A tar archive is made of 512 byte blocks just like a container, so a binary
+ * file goes straight from one to the other a chunk at a time. Nothing but the archive
+ * itself (which can be stdin or stdout) is touched on the host.
+ */
+
+#define TAR_CHUNK_BLKS (64)     /* Blocks copied at a time */
+#define TAR_NAME_LEN   (256)    /* Longest member name kept (only the last part is used) */
+
+/* Where things are in a ustar header */
+#define TAR_NAME     (0)
+#define TAR_MODE     (100)
+#define TAR_UID      (108)
+#define TAR_GID      (116)
+#define TAR_SIZE     (124)
+#define TAR_MTIME    (136)
+#define TAR_CHKSUM   (148)
+#define TAR_TYPE     (156)
+#define TAR_MAGIC    (257)
+#define TAR_VERSION  (263)
+#define TAR_PREFIX   (345)
+
+static const char Zeros[2 * BLKSIZ];
+
+/**
+ * Open the archive.
+ * @param options - pointer to options.
+ * @param forWrite - non-zero for out, 0 for in.
+ * @return pointer to FILE or NULL on error. Error message will have been displayed.
+ */
+static FILE *tarOpen(Options_t *options, int forWrite)
+{
+	FILE *fp;
+
+	if ( !strcmp(options->tarFile, "-") )
+	{
+		fp = forWrite ? stdout : stdin;
+#ifdef MINGW
+		_setmode(_fileno(fp), _O_BINARY);
+#endif
+		return fp;
+	}
+	fp = statFopen(options, STAT_IO_HOST, options->tarFile, forWrite ? "wb" : "rb");
+	if ( !fp )
+		msgErr(options, "Unable to open '%s' for %s: %s\n",
+				options->tarFile, forWrite ? "output" : "input", strerror(errno));
+	return fp;
+}
+
+/**
+ * Add up the bytes of a header as if the checksum field was spaces.
+ * @param hdr - pointer to header.
+ * @return checksum.
+ */
+static unsigned long tarChecksum(const unsigned char *hdr)
+{
+	unsigned long sum = 0;
+	int ii;
+
+	for ( ii = 0; ii < BLKSIZ; ++ii )
+		sum += (ii >= TAR_CHKSUM && ii < TAR_CHKSUM + 8) ? ' ' : hdr[ii];
+	return sum;
+}
+
+/**
+ * Get an octal number out of a header.
+ * @param fld - pointer to field.
+ * @param len - size of field.
+ * @return value or -1 if it isn't octal.
+ */
+static long tarNumber(const char *fld, int len)
+{
+	long val = 0;
+	int ii;
+
+	for ( ii = 0; ii < len && fld[ii] == ' '; ++ii )
+		;
+	for ( ; ii < len && fld[ii] >= '0' && fld[ii] <= '7'; ++ii )
+		val = val * 8 + fld[ii] - '0';
+	if ( ii < len && fld[ii] && fld[ii] != ' ' )
+		return -1;
+	return val;
+}
+
+/**
+ * Write a header.
+ * @param options - pointer to options.
+ * @param fp - archive (NULL if nothing is to be written).
+ * @param name - member name.
+ * @param size - bytes of data that follow.
+ * @param mtime - modify time.
+ * @return 0 if success; 1 if failure.
+ */
+static int tarHeader(Options_t *options, FILE *fp, const char *name, long size, time_t mtime)
+{
+	char hdr[BLKSIZ];
+
+	if ( !fp )
+		return 0;
+	memset(hdr, 0, sizeof(hdr));
+	strncpy(hdr + TAR_NAME, name, 99);
+	sprintf(hdr + TAR_MODE, "%07o", 0644);
+	sprintf(hdr + TAR_UID, "%07o", 0);
+	sprintf(hdr + TAR_GID, "%07o", 0);
+	sprintf(hdr + TAR_SIZE, "%011lo", (unsigned long)size);
+	sprintf(hdr + TAR_MTIME, "%011lo", mtime > 0 ? (unsigned long)mtime : 0UL);
+	hdr[TAR_TYPE] = '0';
+	memcpy(hdr + TAR_MAGIC, "ustar", 6);
+	memcpy(hdr + TAR_VERSION, "00", 2);
+	/* Six digits, a null and a space */
+	sprintf(hdr + TAR_CHKSUM, "%06lo", tarChecksum((unsigned char *)hdr));
+	hdr[TAR_CHKSUM + 7] = ' ';
+	return statFwrite(options, STAT_IO_HOST, hdr, 1, BLKSIZ, fp) != BLKSIZ;
+}
+
+/**
+ * Read some blocks of a file in the container.
+ * @param options - pointer to options.
+ * @param wdp - pointer to directory entry of file.
+ * @param blk - first block of file to read.
+ * @param nBlks - number of blocks.
+ * @param dst - where to put them.
+ * @return 0 if success; 1 if failure. Error message will have been displayed.
+ */
+static int readBlks(Options_t *options, InWorkingDir_t *wdp, int blk, int nBlks, char *dst)
+{
+	long pos = (long)(wdp->lba + blk) * BLKSIZ;
+	int retv;
+
+	if ( (options->cmdOpts & (CMDOPT_SINGLE_FLPY | CMDOPT_DOUBLE_FLPY)) )
+	{
+		if ( pos + (long)nBlks * BLKSIZ > options->floppyImageSize )
+		{
+			msgErr(options, "Error in file size of '%s'. Would read beyond EOF of container of %d bytes. Probably corruption in container directory.\n",
+					wdp->ffull, options->floppyImageSize);
+			return 1;
+		}
+		memcpy(dst, options->floppyImageUnscrambled + pos, nBlks * BLKSIZ);
+		return 0;
+	}
+	/* The file is read in order, so only the first piece needs a seek */
+	if ( !blk )
+	{
+		retv = statFseek(options, STAT_IO_CONT, options->inp, pos, SEEK_SET);
+		if ( retv < 0 || ferror(options->inp) || ftell(options->inp) != pos )
+		{
+			msgErr(options, "Unable to seek to %d in input '%s': %s\n",
+					wdp->lba, options->container, strerror(errno));
+			return 1;
+		}
+	}
+	retv = statFread(options, STAT_IO_CONT, dst, 1, nBlks * BLKSIZ, options->inp);
+	if ( retv != nBlks * BLKSIZ )
+	{
+		msgErr(options, "Error reading %d bytes from '%s' starting at LBA %d. Read %d: %s\n",
+				nBlks * BLKSIZ, options->container, wdp->lba + blk, retv, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Write one file to the archive.
+ * @param options - pointer to options.
+ * @param fp - archive (NULL if nothing is to be written).
+ * @param wdp - pointer to directory entry of file.
+ * @param name - member name.
+ * @param buf - buffer of TAR_CHUNK_BLKS blocks.
+ * @return number of bytes in the archive (or would have been), -1 if the file couldn't
+ * be read or -2 if the archive couldn't be written (or is now broken). Error message will
+ * have been displayed.
+ */
+static long tarOne(Options_t *options, FILE *fp, InWorkingDir_t *wdp, const char *name, char *buf)
+{
+	long size = (long)wdp->rt11.blocks * BLKSIZ, pad;
+	time_t mtime = wdp->rt11.date ? dateToTime(wdp->rt11.date) : 0;
+	int blk, nBlks;
+
+	if ( (options->outOpts & OUTOPTS_ASC) )
+	{
+		AsciiStrip_t as;
+		char *data;
+
+		/* The header needs the size, so the whole file is read and stripped first */
+		data = (char *)malloc(size + 1);
+		if ( !data )
+		{
+			msgErr(options, "Ran out of memory allocating %ld bytes to read '%s'\n", size, wdp->ffull);
+			return -1;
+		}
+		if ( size && readBlks(options, wdp, 0, wdp->rt11.blocks, data) )
+		{
+			free(data);
+			return -1;
+		}
+		asciiStripInit(&as);
+		size = asciiStripCR(&as, data, size, data);
+		size += asciiStripFinish(&as, data + size);
+		pad = (BLKSIZ - size % BLKSIZ) % BLKSIZ;
+		if (    tarHeader(options, fp, name, size, mtime)
+			 || (fp && statFwrite(options, STAT_IO_HOST, data, 1, size, fp) != size)
+			 || (fp && pad && statFwrite(options, STAT_IO_HOST, Zeros, 1, pad, fp) != pad) )
+		{
+			msgErr(options, "Error writing '%s' to '%s': %s\n", name, options->tarFile, strerror(errno));
+			free(data);
+			return -2;
+		}
+		free(data);
+		return size;
+	}
+	if ( tarHeader(options, fp, name, size, mtime) )
+	{
+		msgErr(options, "Error writing '%s' to '%s': %s\n", name, options->tarFile, strerror(errno));
+		return -2;
+	}
+	for ( blk = 0; blk < wdp->rt11.blocks; blk += nBlks )
+	{
+		nBlks = wdp->rt11.blocks - blk;
+		if ( nBlks > TAR_CHUNK_BLKS )
+			nBlks = TAR_CHUNK_BLKS;
+		/* The header is already out, so the archive can't be finished properly */
+		if ( readBlks(options, wdp, blk, nBlks, buf) )
+			return -2;
+		if ( fp && (int)statFwrite(options, STAT_IO_HOST, buf, BLKSIZ, nBlks, fp) != nBlks )
+		{
+			msgErr(options, "Error writing '%s' to '%s': %s\n", name, options->tarFile, strerror(errno));
+			return -2;
+		}
+	}
+	return size;
+}
+
+/**
+ * Write the selected files to options->tarFile as a ustar archive.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if failure.
+ */
+int tarOut(Options_t *options)
+{
+	InWorkingDir_t *wdp;
+	FILE *fp = NULL, *msg = stdout;
+	char name[6+1+3+1], *buf, *cp;
+	int ii, filesCopied = 0, sts = 0;
+	long retv;
+	U64 traceStart;
+
+	/* The messages mustn't get mixed in with the archive */
+	if ( !strcmp(options->tarFile, "-") )
+		msg = stderr;
+	buf = (char *)malloc(TAR_CHUNK_BLKS * BLKSIZ);
+	if ( !buf )
+	{
+		msgErr(options, "Ran out of memory allocating %d bytes\n", TAR_CHUNK_BLKS * BLKSIZ);
+		return 1;
+	}
+	if ( !(options->cmdOpts & CMDOPT_NOWRITE) && !(fp = tarOpen(options, 1)) )
+	{
+		free(buf);
+		return 1;
+	}
+	for ( ii = 0, wdp = options->wDirArray; ii < options->numWdirs; ++ii, ++wdp )
+	{
+		if ( !(wdp->rt11.control & PERM) || !selectDirEnt(options, wdp) )
+			continue;
+		strcpy(name, wdp->ffull);
+		if ( (options->outOpts & OUTOPTS_LC) )
+		{
+			for ( cp = name; *cp; ++cp )
+			{
+				if ( isupper(*cp) )
+					*cp = tolower(*cp);
+			}
+		}
+		TRACE_START(options, traceStart);
+		statBegin(options, STAT_PH_HOSTOUT);
+		retv = tarOne(options, fp, wdp, name, buf);
+		statEnd(options, STAT_PH_HOSTOUT);
+		TRACE_FILE(options, "out", traceStart, name, wdp->lba, wdp->rt11.blocks, retv);
+		if ( retv == -2 )
+		{
+			sts = 1;
+			break;
+		}
+		if ( retv < 0 )
+		{
+			sts = 1;
+			continue;
+		}
+		if ( !fp )
+		{
+			fprintf(msg, "Would have Copied %-12.12s %5d blocks @ LBA %6d, would have written %7ld bytes.\n",
+					name, wdp->rt11.blocks, wdp->lba, retv);
+		}
+		else if ( options->verbose || (options->outOpts & OUTOPTS_VERB) )
+		{
+			fprintf(msg, "Copied %-12.12s %5d blocks @ LBA %6d, wrote %7ld bytes.\n",
+					name, wdp->rt11.blocks, wdp->lba, retv);
+		}
+		++filesCopied;
+	}
+	free(buf);
+	if ( fp )
+	{
+		/* Two blocks of zeros end the archive */
+		if ( !sts && statFwrite(options, STAT_IO_HOST, Zeros, 1, sizeof(Zeros), fp) != sizeof(Zeros) )
+			sts = 1;
+		if ( fflush(fp) || ferror(fp) )
+			sts = 1;
+		if ( fp != stdout && fclose(fp) )
+			sts = 1;
+		if ( sts && !options->numErrors )
+			msgErr(options, "Error writing '%s': %s\n", options->tarFile, strerror(errno));
+	}
+	if ( options->verbose || (options->outOpts & OUTOPTS_VERB) )
+	{
+		fprintf(msg, "%d files %scopied to '%s'.\n", filesCopied,
+				fp ? "" : "potentially ", options->tarFile);
+	}
+	return sts;
+}
+
+/**
+ * Read and throw away some of the archive.
+ * @param options - pointer to options.
+ * @param fp - archive.
+ * @param len - number of bytes.
+ * @return 0 if success; 1 if the archive ended first.
+ */
+static int tarSkip(Options_t *options, FILE *fp, long len)
+{
+	char buf[BLKSIZ];
+	long got;
+
+	for ( ; len > 0; len -= got )
+	{
+		got = statFread(options, STAT_IO_HOST, buf, 1, len > BLKSIZ ? BLKSIZ : len, fp);
+		if ( got <= 0 )
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Read the data of a pax extended header or a GNU long name and pick out the name.
+ * @param options - pointer to options.
+ * @param fp - archive.
+ * @param type - 'x' or 'L'.
+ * @param size - bytes of data.
+ * @param name - where to put the name (if there is one).
+ * @return 0 if success; 1 if the archive ended first.
+ */
+static int tarLongName(Options_t *options, FILE *fp, int type, long size, char name[TAR_NAME_LEN + 1])
+{
+	char *data, *cp, *end;
+	long len;
+
+	data = (char *)malloc(size + 1);
+	if ( !data )
+		return tarSkip(options, fp, (size + BLKSIZ - 1) & -BLKSIZ);
+	if ( statFread(options, STAT_IO_HOST, data, 1, size, fp) != size )
+	{
+		free(data);
+		return 1;
+	}
+	data[size] = 0;
+	if ( type == 'L' )
+	{
+		strncpy(name, data, TAR_NAME_LEN);
+		name[TAR_NAME_LEN] = 0;
+	}
+	else
+	{
+		/* Records are "len key=value\n" */
+		for ( cp = data; cp < data + size; cp += len )
+		{
+			len = strtol(cp, &end, 10);
+			if ( len <= 0 || *end != ' ' || cp + len > data + size )
+				break;
+			if ( !strncmp(end + 1, "path=", 5) )
+			{
+				end += 6;
+				len -= end - cp;
+				if ( len > TAR_NAME_LEN )
+					len = TAR_NAME_LEN;
+				memcpy(name, end, len - 1);
+				name[len - 1] = 0;
+				break;
+			}
+		}
+	}
+	free(data);
+	return tarSkip(options, fp, (BLKSIZ - size % BLKSIZ) % BLKSIZ);
+}
+
+/**
+ * Copy the files in the ustar archive options->tarFile into the container.
+ * @param options - pointer to options.
+ * @return 0 if success; 1 if the archive couldn't be read or a file couldn't be copied.
+ */
+int tarIn(Options_t *options)
+{
+	unsigned char hdr[BLKSIZ];
+	char name[TAR_NAME_LEN + 1], longName[TAR_NAME_LEN + 1];
+	InHandle_t *ihp = &options->iHandle;
+	InWorkingDir_t wd;
+	FILE *fp;
+	long size, got, offset = 0;
+	int retv, type, failed = 0, sts = 0;
+	U64 traceStart = 0;
+
+	fp = tarOpen(options, 0);
+	if ( !fp )
+		return 1;
+	/* Nothing is written where a file replaced this run was until the directory says it's gone */
+	if ( !(options->cmdOpts & (CMDOPT_SINGLE_FLPY | CMDOPT_DOUBLE_FLPY)) )
+		options->holdFreed = 1;
+	memset(&wd, 0, sizeof(wd));
+	wd.rt11.control = PERM;
+	longName[0] = 0;
+	while ( 1 )
+	{
+		got = statFread(options, STAT_IO_HOST, hdr, 1, BLKSIZ, fp);
+		/* Some archives just stop without the blocks of zeros */
+		if ( !got && feof(fp) )
+			break;
+		if ( got != BLKSIZ )
+		{
+			msgErr(options, "'%s' ended in the middle of a header\n", options->tarFile);
+			sts = 1;
+			break;
+		}
+		if ( !memcmp(hdr, Zeros, BLKSIZ) )
+			break;
+		if ( tarNumber((char *)hdr + TAR_CHKSUM, 8) != (long)tarChecksum(hdr) )
+		{
+			msgErr(options, "'%s' isn't a tar archive (bad header checksum at byte %ld)\n",
+					options->tarFile, offset);
+			sts = 1;
+			break;
+		}
+		size = tarNumber((char *)hdr + TAR_SIZE, 12);
+		if ( size < 0 )
+		{
+			msgErr(options, "Member at byte %ld of '%s' is too big\n", offset, options->tarFile);
+			sts = 1;
+			break;
+		}
+		offset += BLKSIZ + ((size + BLKSIZ - 1) & -BLKSIZ);
+		type = hdr[TAR_TYPE];
+		if ( type == 'x' || type == 'L' )
+		{
+			/* The name of the next member */
+			if ( tarLongName(options, fp, type, size, longName) )
+			{
+				msgErr(options, "'%s' ended in the middle of a member\n", options->tarFile);
+				sts = 1;
+				break;
+			}
+			continue;
+		}
+		if ( longName[0] )
+		{
+			strcpy(name, longName);
+			longName[0] = 0;
+		}
+		else if ( hdr[TAR_PREFIX] && !memcmp(hdr + TAR_MAGIC, "ustar", 5) )
+			sprintf(name, "%.155s/%.100s", (char *)hdr + TAR_PREFIX, (char *)hdr + TAR_NAME);
+		else
+			sprintf(name, "%.100s", (char *)hdr + TAR_NAME);
+		/* Only regular files are copied in. Directories, links and the like are skipped. */
+		if ( type != '0' && type != 0 && type != '7' )
+		{
+			if ( options->verbose || (options->inOpts & INOPTS_VERB) )
+				printf("Skipped '%s' (not a regular file)\n", name);
+			if ( tarSkip(options, fp, (size + BLKSIZ - 1) & -BLKSIZ) )
+			{
+				msgErr(options, "'%s' ended in the middle of a member\n", options->tarFile);
+				sts = 1;
+				break;
+			}
+			continue;
+		}
+		/* Convert name to RAD50 (anything before the last / is dropped) */
+		retv = cvtName(options, name);
+		if ( !retv )
+		{
+			/* Filenames pick the members like they pick files for out */
+			memcpy(wd.rt11.name, ihp->iNameR50, sizeof(wd.rt11.name));
+			r50DecodeName(wd.ffull, wd.rt11.name);
+			wd.rt11.blocks = (size + BLKSIZ - 1) / BLKSIZ;
+			if ( !selectDirEnt(options, &wd) )
+				retv = -1;
+		}
+		if ( retv )
+		{
+			if ( retv > 0 )
+				++failed;
+			if ( tarSkip(options, fp, (size + BLKSIZ - 1) & -BLKSIZ) )
+			{
+				msgErr(options, "'%s' ended in the middle of a member\n", options->tarFile);
+				sts = 1;
+				break;
+			}
+			continue;
+		}
+		ihp->directName = NULL;
+		ihp->fileTimeStamp = (time_t)tarNumber((char *)hdr + TAR_MTIME, 12);
+		TRACE_START(options, traceStart);
+		statBegin(options, STAT_PH_HOSTIN);
+		retv = fillInpBuf(options, name, fp, size);
+		if ( !retv )
+			retv = tarSkip(options, fp, (BLKSIZ - size % BLKSIZ) % BLKSIZ);
+		statEnd(options, STAT_PH_HOSTIN);
+		if ( retv )
+		{
+			sts = 1;
+			break;
+		}
+		retv = copyInFile(options, name, traceStart);
+		if ( retv )
+			++failed;
+		if ( retv == 3 )
+			sts = 1;
+		if ( retv >= 2 )
+			break;
+	}
+	if ( fp != stdin )
+		fclose(fp);
+	/* A broken archive leaves the container as it was */
+	if ( sts )
+		return 1;
+	inSummary(options);
+	if ( failed && options->dirDirty )
+	{
+		/* What did get copied is kept (like in would), but rtpip still has to exit with 1 */
+		sts = writeNewDir(options);
+		options->dirDirty = 0;
+	}
+	return failed ? 1 : sts;
+}
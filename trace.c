@@ -0,0 +1,191 @@
+/*  $Id: trace.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	trace.c - Chrome trace-event output for --trace.
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MINGW
+	#define _POSIX_C_SOURCE 200112L
+#endif
+#include "rtpip.h"
+
+/**
+ * @file trace.c
+ * Chrome trace-event output for --trace. Only built with make TRACE=1.
+ */
+
+/*
+ * Note: The output is the JSON object format of the Chrome trace-event
+ * spec, which chrome://tracing and ui.perfetto.dev both load. Every span is
+ * a complete ("X") event written when it ends, so nothing is kept in memory
+ * and a run that dies early still leaves everything up to that point (the
+ * viewers accept a missing closing bracket).
+ */
+
+struct Trace
+{
+	FILE *fp;               /**< Trace output file */
+	U64 t0;                 /**< traceNow() when trace started */
+	int pid;                /**< Process ID to put in each event */
+	int numEvents;          /**< Number of events written so far */
+};
+
+/**
+ * Get the current monotonic time.
+ * @return time in nanoseconds.
+ */
+U64 traceNow(void)
+{
+#ifndef MINGW
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (U64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+	return (U64)clock() * (1000000000ULL / CLOCKS_PER_SEC);
+#endif
+}
+
+/**
+ * Write a string as a JSON string.
+ * @param fp - file to write to.
+ * @param str - string to write.
+ * @return nothing
+ */
+static void putJsonStr(FILE *fp, const char *str)
+{
+	int cc;
+
+	fputc('"', fp);
+	while ( (cc = (U8)*str++) )
+	{
+		if ( cc == '"' || cc == '\\' )
+			fprintf(fp, "\\%c", cc);
+		else if ( cc < ' ' || cc > '~' )
+			fprintf(fp, "\\u%04x", cc);
+		else
+			fputc(cc, fp);
+	}
+	fputc('"', fp);
+}
+
+/**
+ * Start writing a complete event.
+ * @param tp - pointer to trace.
+ * @param name - name of span.
+ * @param cat - category of span.
+ * @param start - traceNow() at start of span.
+ * @param end - traceNow() at end of span.
+ * @return nothing
+ */
+static void startEvent(Trace_t *tp, const char *name, const char *cat, U64 start, U64 end)
+{
+	if ( tp->numEvents++ )
+		fputs(",\n", tp->fp);
+	fputs("{\"name\":", tp->fp);
+	putJsonStr(tp->fp, name);
+	fprintf(tp->fp, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":1",
+			cat, (start - tp->t0) / 1000.0, (end - start) / 1000.0, tp->pid);
+}
+
+/**
+ * Open the trace output file.
+ * @param options - pointer to options.
+ * @param fileName - name of trace file to create.
+ * @return 0 on success, 1 on failure.
+ */
+int traceOpen(Options_t *options, const char *fileName)
+{
+	Trace_t *tp;
+
+	if ( options->trace )
+		traceClose(options);
+	tp = (Trace_t *)calloc(1, sizeof(Trace_t));
+	if ( !tp )
+	{
+		fprintf(stderr, "Ran out of memory allocating %d bytes for trace\n", (int)sizeof(Trace_t));
+		return 1;
+	}
+	tp->fp = fopen(fileName, "w");
+	if ( !tp->fp )
+	{
+		fprintf(stderr, "Unable to create trace file '%s': %s\n", fileName, strerror(errno));
+		free(tp);
+		return 1;
+	}
+	tp->t0 = traceNow();
+	tp->pid = getpid();
+	fprintf(tp->fp, "{\"traceEvents\":[\n"
+			"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,\"args\":{\"name\":\"rtpip\"}}",
+			tp->pid);
+	tp->numEvents = 1;
+	options->trace = tp;
+	return 0;
+}
+
+/**
+ * Write a span for one phase.
+ * @param options - pointer to options.
+ * @param name - name of phase.
+ * @param start - traceNow() at start of phase.
+ * @param end - traceNow() at end of phase.
+ * @return nothing
+ */
+void tracePhase(Options_t *options, const char *name, U64 start, U64 end)
+{
+	if ( !options->trace )
+		return;
+	startEvent(options->trace, name, "phase", start, end);
+	fputs("}", options->trace->fp);
+}
+
+/**
+ * Write a span for one file.
+ * @param options - pointer to options.
+ * @param cat - category of span (usually the command name).
+ * @param start - traceNow() at start of span.
+ * @param name - filename.
+ * @param lba - starting block of file in container.
+ * @param blocks - number of blocks in container.
+ * @param bytes - number of bytes copied (0 if none).
+ * @return nothing
+ */
+void traceFile(Options_t *options, const char *cat, U64 start, const char *name, int lba, int blocks, long bytes)
+{
+	if ( !options->trace )
+		return;
+	startEvent(options->trace, name, cat, start, traceNow());
+	fprintf(options->trace->fp, ",\"args\":{\"lba\":%d,\"blocks\":%d,\"bytes\":%ld}}",
+			lba, blocks, bytes);
+}
+
+/**
+ * Finish and close the trace output file.
+ * @param options - pointer to options.
+ * @return nothing
+ */
+void traceClose(Options_t *options)
+{
+	Trace_t *tp = options->trace;
+
+	if ( !tp )
+		return;
+	fputs("\n],\"displayTimeUnit\":\"ms\"}\n", tp->fp);
+	fclose(tp->fp);
+	free(tp);
+	options->trace = NULL;
+}
@@ -19,6 +19,7 @@
 */
 
 #include "rtpip.h"
+#include <stdarg.h>
 
 /**
  * @file rtutils.c
@@ -66,6 +67,59 @@ static const char *const months[] = {
 
 static const char r50[] = " ABCDEFGHIJKLMNOPQRSTUVWXYZ$.%0123456789????????????????????????";
 
+/**
+ * Format a message and hand it to options->msgFunc.
+ * @param options - pointer to options.
+ * @param isError - non-zero if it is an error.
+ * @param fmt - printf() format.
+ * @param ap - arguments.
+ * @return nothing
+ */
+static void msgSend(Options_t *options, int isError, const char *fmt, va_list ap)
+{
+	char msg[1024];
+
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	options->msgFunc(options->msgUser, isError, msg);
+}
+
+/**
+ * Show an error message on stderr (or hand it to options->msgFunc if there is one).
+ * @param options - pointer to options.
+ * @param fmt - printf() format followed by its arguments.
+ * @return nothing
+ */
+void msgErr(Options_t *options, const char *fmt, ...)
+{
+	va_list ap;
+
+	++options->numErrors;
+	va_start(ap, fmt);
+	if ( options->msgFunc )
+		msgSend(options, 1, fmt, ap);
+	else
+		vfprintf(stderr, fmt, ap);
+	va_end(ap);
+}
+
+/**
+ * Show a message on stdout (or hand it to options->msgFunc if there is one).
+ * @param options - pointer to options.
+ * @param fmt - printf() format followed by its arguments.
+ * @return nothing
+ */
+void msgOut(Options_t *options, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	if ( options->msgFunc )
+		msgSend(options, 0, fmt, ap);
+	else
+		vprintf(fmt, ap);
+	va_end(ap);
+}
+
 /**
  * Convert a single ascii character to a rad50 integer.
  * @param src - ascii character
@@ -210,6 +264,83 @@ char* dateStr(char outStr[INSTR_LEN], unsigned short date)
 	return outStr;
 }
 
+char* dateIso(char outStr[INSTR_LEN], unsigned short date)
+{
+	int yr = (date & 31) + 1972 + 32 * ((date >> 14) & 3);
+
+	if ( !date )
+		strcpy(outStr, "-");
+	else
+		snprintf(outStr, INSTR_LEN, "%04d-%02d-%02d", yr, (date >> 10) & 15, (date >> 5) & 31);
+	return outStr;
+}
+
+/**
+ * dateKey - convert RT11 date to a number that sorts in date order
+ * @param date - RT11 date
+ * @return (year-1972)*512 + month*32 + day (always fits in 16 bits)
+ */
+int dateKey(unsigned short date)
+{
+	int yr = (date & 31) + 32 * ((date >> 14) & 3);
+
+	return (yr << 9) | (((date >> 10) & 15) << 5) | ((date >> 5) & 31);
+}
+
+/**
+ * timeToDate - convert a host time to an RT11 date
+ * @param tim - time to convert (local time is used)
+ * @return RT11 date with the age bits set for years past 2003
+ */
+unsigned short timeToDate(time_t tim)
+{
+	int yr, mo, day, age;
+	struct tm *tm;
+
+	tm = localtime(&tim);
+	yr = tm->tm_year + 1900;
+	mo = tm->tm_mon + 1;
+	day = tm->tm_mday;
+	age = 0;
+	if ( yr >= 1972 && yr < 2004  )
+	{
+		yr -= 1972;
+		age = 0;
+	}
+	else if ( yr >= 2004 && yr < 2036 )
+	{
+		yr -= 2004;
+		age = 1;
+	}
+	else if ( yr >= 2036 && yr < 2068 )
+	{
+		yr -= 2036;
+		age = 2;
+	}
+	else
+	{
+		yr -= 2068;
+		age = 3;
+	}
+	return (age << 14) | ((mo & 15) << 10) | ((day & 31) << 5) | (yr & 31);
+}
+
+/**
+ * dateToTime - convert an RT11 date to a host time
+ * @param date - RT11 date
+ * @return midnight (local time) of that day
+ */
+time_t dateToTime(unsigned short date)
+{
+	struct tm tm;
+
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_mday = (date >> 5) & 31;
+	tm.tm_mon = ((date >> 10) & 15) - 1;
+	tm.tm_year = (date & 31) + 32 * ((date >> 14) & 3) + 1972 - 1900;
+	return mktime(&tm);
+}
+
 #if 0
 /** mkOFBuf - create or expand output buffer 
  *  @param ihp - pointer to input details
@@ -234,22 +365,58 @@ int mkOFBuf(InHandle_t *ihp, int *need)
 }
 #endif
 
+/**
+ * See if a filename has one of the --ascii filetypes.
+ * @param options - pointer to options.
+ * @param ffull - RT11 filename (uppercase).
+ * @return 1 if it does, 0 if not.
+ */
+int isAsciiType(Options_t *options, const char *ffull)
+{
+	const char *ext, *cp;
+	int len;
+
+	if ( !options->asciiTypes )
+		return 0;
+	ext = strchr(ffull, '.');
+	ext = ext ? ext + 1 : "";
+	len = strlen(ext);
+	for ( cp = options->asciiTypes; *cp; cp += *cp ? 1 : 0 )
+	{
+		const char *end = strchr(cp, ',');
+		int ii;
+
+		if ( !end )
+			end = cp + strlen(cp);
+		if ( end - cp == len )
+		{
+			for ( ii = 0; ii < len && toupper((unsigned char)cp[ii]) == ext[ii]; ++ii )
+				;
+			if ( ii == len )
+				return 1;
+		}
+		cp = end;
+	}
+	return 0;
+}
+
 int cvtName(Options_t *options, const char *fileName)
 {
 	char *cp;
 	const char *ccp;
-	int retv, cc, r50;
+	int retv, cc;
 
 	retv = strlen(fileName);
 	if ( retv > options->iHandle.argFNLen )
 	{
-		options->iHandle.argFN = (char *)malloc(retv + 1);
-		if ( !options->iHandle.argFN )
+		cp = (char *)realloc(options->iHandle.argFN, retv + 1);
+		if ( !cp )
 		{
-			fprintf(stderr, "Unable to allocate %d bytes for filename '%s': %s\n",
+			msgErr(options, "Unable to allocate %d bytes for filename '%s': %s\n",
 					retv, fileName, strerror(errno));
 			return 1;
 		}
+		options->iHandle.argFN = cp;
 		options->iHandle.argFNLen = retv;
 	}
 
@@ -261,79 +428,17 @@ int cvtName(Options_t *options, const char *fileName)
 		++ccp;
 
 	strcpy(options->iHandle.argFN, ccp);
-	cp = options->iHandle.argFN;
-	retv = 0;
-	options->iHandle.iNameR50[0] = 0;
-	options->iHandle.iNameR50[1] = 0;
-	options->iHandle.iNameR50[2] = 0;
-	for ( retv = 0; (cc = *cp); ++cp )
+	/* Make it uppercase (that's how it is stored in the directory) */
+	for ( cp = options->iHandle.argFN; (cc = *cp); ++cp )
 	{
-		/* If lowercase, make it upper */
-		if ( tolower(cc) )
-			cc = *cp = toupper(cc);
-		/* convert character to RAD50 */
-		r50 = char2r50(cc);
-		/* If it returns as r50 space, it's illegal */
-		if ( !r50 )
-			break;
-		/* if it's a dot, it is the filename/filetype separator. It doesn't get included */
-		if ( r50 == R50_DOT )
-		{
-			/* if we've already seen a dot, then the name is illegal */
-			if ( retv >= 7 )
-				break;
-			/* else jump to filetype conversion */
-			retv = 7;
-			continue;
-		}
-		switch (retv)
-		{
-		case 0:
-			options->iHandle.iNameR50[0] = r50 * 050 * 050;
-			++retv;
-			continue;
-		case 1:
-			options->iHandle.iNameR50[0] += r50 * 050;
-			++retv;
-			continue;
-		case 2:
-			options->iHandle.iNameR50[0] += r50;
-			++retv;
-			continue;
-		case 3:
-			options->iHandle.iNameR50[1] = r50 * 050 * 050;
-			++retv;
-			continue;
-		case 4:
-			options->iHandle.iNameR50[1] += r50 * 050;
-			++retv;
-			continue;
-		case 5:
-			options->iHandle.iNameR50[1] += r50;
-			++retv;
-			continue;
-		case 7:
-			options->iHandle.iNameR50[2] = r50 * 050 * 050;
-			++retv;
-			continue;
-		case 8:
-			options->iHandle.iNameR50[2] += r50 * 050;
-			++retv;
-			continue;
-		case 9:
-			options->iHandle.iNameR50[2] += r50;
-			++retv;
-			continue;
-			/* If there's more than 9 characters, it's illegal */
-		default:
-			break;
-		}
-		break;
+		if ( islower(cc) )
+			*cp = toupper(cc);
 	}
-	/* If there's more stuff in the filenamoptions->iHandle.iNameR50[0],e, then it's illegal */
-	if ( *cp )
+	/* Then convert it to RAD50. It's illegal if it has anything that isn't Rad50,
+	 * more than one dot, more than 6 characters of filename or more than 3 of filetype. */
+	if ( r50EncodeName(options->iHandle.iNameR50, options->iHandle.argFN) )
 	{
-		fprintf(stderr, "Filename '%s' is incompatible with RT11 name convention.\n",
+		msgErr(options, "Filename '%s' is incompatible with RT11 name convention.\n",
 				fileName);
 		return 1;
 	}
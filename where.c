@@ -0,0 +1,581 @@
+/*  $Id: where.c,v 1.1 2026/10/18 00:00:00 dave Exp dave $ $
+
+	where.c - Directory entry selection expressions used by rtpip
+
+	Copyright (C) 2008 David Shepperd
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtpip.h"
+
+/**
+ * @file where.c
+ * Directory entry selection expressions (--where) used by rtpip.
+ */
+
+/*
+ * The expression given to --where is compiled once into a short list of
+ * instructions which are then run against each directory entry. The syntax is:
+ *
+ * expr    := and [ '||' and ]...
+ * and     := unary [ '&&' unary ]...
+ * unary   := '!' unary | '(' expr ')' | flag | field relation value
+ * flag    := protected | perm | empty | tent
+ * field   := size (or blocks) | date | lba | end | seg | type | name
+ * relation:= '==' (or '=') | '!=' | '<' | '<=' | '>' | '>='
+ *
+ * Numbers can be decimal, octal (leading 0) or hex (leading 0x). Dates are
+ * dd-mmm-yy (yy of 00-71 being 20yy) or dd-mmm-yyyy. Types are up to 3 Rad50
+ * characters. Names are filename wildcards the same as on the command line
+ * and can only be tested with '==' or '!='. The 'end' field is the LBA just
+ * past the end of the file.
+ *
+ * Each comparison leaves a single true/false result. '&&' and '||' are
+ * compiled to conditional jumps around their right hand side, so there is
+ * never more than one result pending and the machine needs no stack.
+ */
+
+enum
+{
+	WOP_CMP,        /* Compare a numeric field against value */
+	WOP_NAME,       /* Compare the filename against pat */
+	WOP_FLAG,       /* Test control bits in value */
+	WOP_NOT,        /* Invert the result */
+	WOP_JF,         /* If result is false, jump to value */
+	WOP_JT          /* If result is true, jump to value */
+};
+
+enum
+{
+	WF_SIZE,        /* Blocks in file */
+	WF_DATE,        /* Creation date (as a sortable number) */
+	WF_LBA,         /* Starting LBA */
+	WF_END,         /* LBA just past the end of file */
+	WF_SEG,         /* Directory segment number */
+	WF_TYPE,        /* Rad50 filetype */
+	WF_NAME         /* Filename wildcard */
+};
+
+enum
+{
+	WREL_EQ,
+	WREL_NE,
+	WREL_LT,
+	WREL_LE,
+	WREL_GT,
+	WREL_GE
+};
+
+#define WHERE_MAX_NEST (64)     /* Maximum depth of parens and !'s */
+
+/** Defines one compiled instruction */
+struct WhereInst
+{
+	U8 op;                      /**< One of WOP_xxx */
+	U8 field;                   /**< One of WF_xxx */
+	U8 rel;                     /**< One of WREL_xxx */
+	int value;                  /**< Value to compare against or target of jump */
+	char pat[10];               /**< Normalized filename wildcard (WOP_NAME only) */
+};
+
+/** Defines the compiled expression */
+struct WhereProg
+{
+	struct WhereInst *code;     /**< Pointer to array of instructions */
+	int numCode;                /**< Number of instructions used */
+	int maxCode;                /**< Number of instructions allocated */
+};
+
+typedef struct
+{
+	const char *expr;           /* Start of expression (for error messages) */
+	const char *cp;             /* Current parse point */
+	WhereProg_t *prog;          /* Program being built */
+	int nest;                   /* Current nesting depth */
+} WhereParse_t;
+
+static const struct
+{
+	const char *name;
+	int field;
+} Fields[] = {
+	{ "size", WF_SIZE },
+	{ "blocks", WF_SIZE },
+	{ "date", WF_DATE },
+	{ "lba", WF_LBA },
+	{ "end", WF_END },
+	{ "seg", WF_SEG },
+	{ "type", WF_TYPE },
+	{ "name", WF_NAME },
+	{ NULL, 0 }
+};
+
+static const struct
+{
+	const char *name;
+	int bits;
+} Flags[] = {
+	{ "protected", PROTEK },
+	{ "perm", PERM },
+	{ "empty", EMPTY },
+	{ "tent", TENT },
+	{ NULL, 0 }
+};
+
+static int whereError(WhereParse_t *wp, const char *msg)
+{
+	fprintf(stderr, "Invalid --where expression '%s': %s at '%s'\n",
+			wp->expr, msg, *wp->cp ? wp->cp : "<end>");
+	return 1;
+}
+
+static void skipWhite(WhereParse_t *wp)
+{
+	while ( isspace(*wp->cp) )
+		++wp->cp;
+}
+
+/**
+ * Append an instruction to the program.
+ * @param wp - pointer to parse state.
+ * @param op - instruction.
+ * @return index of new instruction or -1 if out of memory.
+ */
+static int emit(WhereParse_t *wp, int op)
+{
+	WhereProg_t *prog = wp->prog;
+	struct WhereInst *ip;
+
+	if ( prog->numCode >= prog->maxCode )
+	{
+		int newMax = prog->maxCode ? 2 * prog->maxCode : 16;
+		ip = (struct WhereInst *)realloc(prog->code, newMax * sizeof(struct WhereInst));
+		if ( !ip )
+		{
+			fprintf(stderr, "Ran out of memory compiling --where expression\n");
+			return -1;
+		}
+		prog->code = ip;
+		prog->maxCode = newMax;
+	}
+	ip = prog->code + prog->numCode;
+	memset(ip, 0, sizeof(*ip));
+	ip->op = op;
+	return prog->numCode++;
+}
+
+/**
+ * Get a value token (everything up to white space, a paren or an operator).
+ * @param wp - pointer to parse state.
+ * @param dst - where to put the token.
+ * @param dstLen - size of dst.
+ * @return length of token, 0 if none.
+ */
+static int getValue(WhereParse_t *wp, char *dst, int dstLen)
+{
+	int len = 0;
+
+	skipWhite(wp);
+	while ( *wp->cp && !isspace(*wp->cp) && !strchr("()&|!<>=", *wp->cp) )
+	{
+		if ( len < dstLen - 1 )
+			dst[len] = *wp->cp;
+		++len;
+		++wp->cp;
+	}
+	dst[len < dstLen ? len : dstLen - 1] = 0;
+	return len;
+}
+
+/**
+ * Parse a date in dd-mmm-yy or dd-mmm-yyyy form. Two digit years 72-99 are
+ * 1972-1999 and 00-71 are 2000-2071.
+ * @param str - pointer to null terminated date.
+ * @param key - where to deposit the result (same as dateKey()).
+ * @return 0 on success, 1 on failure.
+ */
+static int parseDate(const char *str, int *key)
+{
+	static const char *const Months[12] = {
+		"jan", "feb", "mar", "apr", "may", "jun",
+		"jul", "aug", "sep", "oct", "nov", "dec"
+	};
+	char *end, mons[4];
+	int day, mon, yr;
+
+	day = strtol(str, &end, 10);
+	if ( day < 1 || day > 31 || *end != '-' || strlen(end) < 5 || end[4] != '-' )
+		return 1;
+	for ( mon = 0; mon < 3; ++mon )
+		mons[mon] = tolower(end[1 + mon]);
+	mons[3] = 0;
+	for ( mon = 0; mon < 12; ++mon )
+	{
+		if ( !strcmp(mons, Months[mon]) )
+			break;
+	}
+	if ( mon >= 12 )
+		return 1;
+	yr = strtol(end + 5, &end, 10);
+	if ( *end )
+		return 1;
+	if ( yr < 72 )
+		yr += 2000;
+	else if ( yr < 100 )
+		yr += 1900;
+	if ( yr < 1972 || yr > 2099 )
+		return 1;
+	*key = ((yr - 1972) << 9) | ((mon + 1) << 5) | day;
+	return 0;
+}
+
+static int parseOr(WhereParse_t *wp);
+
+/**
+ * Parse a comparison, flag, negation or parenthesized expression.
+ * @param wp - pointer to parse state.
+ * @return 0 on success, 1 on failure.
+ */
+static int parseUnary(WhereParse_t *wp)
+{
+	char ident[16], value[32];
+	const char *start;
+	int ii, field, rel, len, idx;
+	struct WhereInst *ip;
+
+	skipWhite(wp);
+	if ( ++wp->nest > WHERE_MAX_NEST )
+		return whereError(wp, "nested too deeply");
+	if ( *wp->cp == '!' && wp->cp[1] != '=' )
+	{
+		++wp->cp;
+		if ( parseUnary(wp) || emit(wp, WOP_NOT) < 0 )
+			return 1;
+		--wp->nest;
+		return 0;
+	}
+	if ( *wp->cp == '(' )
+	{
+		++wp->cp;
+		if ( parseOr(wp) )
+			return 1;
+		skipWhite(wp);
+		if ( *wp->cp != ')' )
+			return whereError(wp, "expected ')'");
+		++wp->cp;
+		--wp->nest;
+		return 0;
+	}
+	start = wp->cp;
+	for ( len = 0; isalpha(*wp->cp); ++wp->cp, ++len )
+	{
+		if ( len < (int)sizeof(ident) - 1 )
+			ident[len] = tolower(*wp->cp);
+	}
+	ident[len < (int)sizeof(ident) ? len : (int)sizeof(ident) - 1] = 0;
+	if ( !len )
+		return whereError(wp, "expected a field name");
+	for ( ii = 0; Flags[ii].name; ++ii )
+	{
+		if ( !strcmp(ident, Flags[ii].name) )
+		{
+			if ( (idx = emit(wp, WOP_FLAG)) < 0 )
+				return 1;
+			wp->prog->code[idx].value = Flags[ii].bits;
+			--wp->nest;
+			return 0;
+		}
+	}
+	for ( ii = 0; Fields[ii].name; ++ii )
+	{
+		if ( !strcmp(ident, Fields[ii].name) )
+			break;
+	}
+	if ( !Fields[ii].name )
+	{
+		wp->cp = start;
+		return whereError(wp, "unknown field");
+	}
+	field = Fields[ii].field;
+	skipWhite(wp);
+	if ( wp->cp[0] == '=' )
+	{
+		rel = WREL_EQ;
+		wp->cp += (wp->cp[1] == '=') ? 2 : 1;
+	}
+	else if ( wp->cp[0] == '!' && wp->cp[1] == '=' )
+	{
+		rel = WREL_NE;
+		wp->cp += 2;
+	}
+	else if ( wp->cp[0] == '<' )
+	{
+		rel = (wp->cp[1] == '=') ? WREL_LE : WREL_LT;
+		wp->cp += (wp->cp[1] == '=') ? 2 : 1;
+	}
+	else if ( wp->cp[0] == '>' )
+	{
+		rel = (wp->cp[1] == '=') ? WREL_GE : WREL_GT;
+		wp->cp += (wp->cp[1] == '=') ? 2 : 1;
+	}
+	else
+		return whereError(wp, "expected a relation");
+	start = wp->cp;
+	if ( !getValue(wp, value, sizeof(value)) )
+		return whereError(wp, "expected a value");
+	if ( (idx = emit(wp, field == WF_NAME ? WOP_NAME : WOP_CMP)) < 0 )
+		return 1;
+	ip = wp->prog->code + idx;
+	ip->field = field;
+	ip->rel = rel;
+	switch (field)
+	{
+	case WF_NAME:
+		if ( rel != WREL_EQ && rel != WREL_NE )
+		{
+			wp->cp = start;
+			return whereError(wp, "names can only be compared with == or !=");
+		}
+		if ( mkNormExpr(ip->pat, value) )
+			return 1;
+		break;
+	case WF_DATE:
+		if ( parseDate(value, &ip->value) )
+		{
+			wp->cp = start;
+			return whereError(wp, "expected a date of the form dd-mmm-yy");
+		}
+		break;
+	case WF_TYPE:
+		if ( strlen(value) > 3 )
+		{
+			wp->cp = start;
+			return whereError(wp, "filetype is longer than 3 characters");
+		}
+		for ( ii = 0, ip->value = 0; ii < 3; ++ii )
+		{
+			int r50 = 0;
+			if ( value[ii] )
+			{
+				r50 = char2r50(value[ii]);
+				if ( !r50 || r50 == R50_DOT )
+				{
+					wp->cp = start;
+					return whereError(wp, "filetype is not Rad50");
+				}
+			}
+			ip->value = ip->value * 050 + r50;
+		}
+		break;
+	default:
+		{
+			char *end;
+			long num = strtol(value, &end, 0);
+			if ( *end || num < 0 || num > 0x7FFFFFFF )
+			{
+				wp->cp = start;
+				return whereError(wp, "expected a number");
+			}
+			ip->value = num;
+		}
+		break;
+	}
+	--wp->nest;
+	return 0;
+}
+
+/**
+ * Parse a list of unary's separated by &&.
+ * @param wp - pointer to parse state.
+ * @return 0 on success, 1 on failure.
+ */
+static int parseAnd(WhereParse_t *wp)
+{
+	int jmp;
+
+	if ( parseUnary(wp) )
+		return 1;
+	while ( 1 )
+	{
+		skipWhite(wp);
+		if ( wp->cp[0] != '&' || wp->cp[1] != '&' )
+			return 0;
+		wp->cp += 2;
+		if ( (jmp = emit(wp, WOP_JF)) < 0 || parseUnary(wp) )
+			return 1;
+		wp->prog->code[jmp].value = wp->prog->numCode;
+	}
+}
+
+/**
+ * Parse a list of and's separated by ||.
+ * @param wp - pointer to parse state.
+ * @return 0 on success, 1 on failure.
+ */
+static int parseOr(WhereParse_t *wp)
+{
+	int jmp;
+
+	if ( parseAnd(wp) )
+		return 1;
+	while ( 1 )
+	{
+		skipWhite(wp);
+		if ( wp->cp[0] != '|' || wp->cp[1] != '|' )
+			return 0;
+		wp->cp += 2;
+		if ( (jmp = emit(wp, WOP_JT)) < 0 || parseAnd(wp) )
+			return 1;
+		wp->prog->code[jmp].value = wp->prog->numCode;
+	}
+}
+
+/**
+ * Compile a --where expression.
+ * @param expr - pointer to null terminated expression.
+ * @return pointer to compiled expression or NULL if error. Error message will have been displayed.
+ */
+WhereProg_t *whereCompile(const char *expr)
+{
+	WhereParse_t wp;
+
+	memset(&wp, 0, sizeof(wp));
+	wp.expr = expr;
+	wp.cp = expr;
+	wp.prog = (WhereProg_t *)calloc(1, sizeof(WhereProg_t));
+	if ( !wp.prog )
+	{
+		fprintf(stderr, "Ran out of memory compiling --where expression\n");
+		return NULL;
+	}
+	if ( !parseOr(&wp) )
+	{
+		skipWhite(&wp);
+		if ( !*wp.cp )
+			return wp.prog;
+		whereError(&wp, "unexpected text");
+	}
+	whereFree(wp.prog);
+	return NULL;
+}
+
+/**
+ * Free a compiled --where expression.
+ * @param prog - pointer to compiled expression.
+ * @return nothing
+ */
+void whereFree(WhereProg_t *prog)
+{
+	if ( prog )
+	{
+		free(prog->code);
+		free(prog);
+	}
+}
+
+/**
+ * Run a compiled --where expression against a directory entry.
+ * @param prog - pointer to compiled expression.
+ * @param wdp - pointer to directory entry.
+ * @return 1 if entry is selected; 0 if not.
+ */
+int whereExec(const WhereProg_t *prog, const InWorkingDir_t *wdp)
+{
+	const struct WhereInst *ip, *end;
+	int result = 1, val;
+
+	ip = prog->code;
+	end = ip + prog->numCode;
+	while ( ip < end )
+	{
+		switch (ip->op)
+		{
+		case WOP_CMP:
+			switch (ip->field)
+			{
+			case WF_SIZE:
+				val = wdp->rt11.blocks;
+				break;
+			case WF_DATE:
+				val = dateKey(wdp->rt11.date);
+				break;
+			case WF_LBA:
+				val = wdp->lba;
+				break;
+			case WF_END:
+				val = wdp->lba + wdp->rt11.blocks;
+				break;
+			case WF_SEG:
+				val = wdp->segNo;
+				break;
+			case WF_TYPE:
+			default:
+				val = wdp->rt11.name[2];
+				break;
+			}
+			switch (ip->rel)
+			{
+			case WREL_EQ:
+				result = val == ip->value;
+				break;
+			case WREL_NE:
+				result = val != ip->value;
+				break;
+			case WREL_LT:
+				result = val < ip->value;
+				break;
+			case WREL_LE:
+				result = val <= ip->value;
+				break;
+			case WREL_GT:
+				result = val > ip->value;
+				break;
+			case WREL_GE:
+			default:
+				result = val >= ip->value;
+				break;
+			}
+			break;
+		case WOP_NAME:
+			result = !normexec(ip->pat, wdp->ffull);
+			if ( ip->rel == WREL_NE )
+				result = !result;
+			break;
+		case WOP_FLAG:
+			result = (wdp->rt11.control & ip->value) != 0;
+			break;
+		case WOP_NOT:
+			result = !result;
+			break;
+		case WOP_JF:
+			if ( !result )
+			{
+				ip = prog->code + ip->value;
+				continue;
+			}
+			break;
+		case WOP_JT:
+		default:
+			if ( result )
+			{
+				ip = prog->code + ip->value;
+				continue;
+			}
+			break;
+		}
+		++ip;
+	}
+	return result;
+}